@@ -17,6 +17,7 @@
 #include "cn24/util/Config.h"
 #include "cn24/util/Dataset.h"
 #include "cn24/util/Tensor.h"
+#include "cn24/util/TensorFile.h"
 #include "cn24/util/CompressedTensor.h"
 #include "cn24/util/TensorViewer.h"
 #include "cn24/util/CombinedTensor.h"
@@ -36,15 +37,24 @@
 #include "cn24/util/CSVStatSink.h"
 #include "cn24/util/JSONParsing.h"
 #include "cn24/util/MNISTDataset.h"
+#include "cn24/util/SyntheticDataset.h"
 #include "cn24/util/MemoryMappedFile.h"
 #include "cn24/util/MemoryMappedTar.h"
+#include "cn24/util/FeatureCache.h"
+#include "cn24/util/ParameterFile.h"
 #include "cn24/util/BoundingBox.h"
+#include "cn24/util/NonMaximumSuppression.h"
 #include "cn24/util/Test.h"
 #include "cn24/util/ClassManager.h"
 #include "cn24/util/Segment.h"
 #include "cn24/util/SegmentSet.h"
 #include "cn24/util/PathFinder.h"
 #include "cn24/util/ActiveLearningPolicy.h"
+#include "cn24/util/PredictionDump.h"
+#include "cn24/util/LocalSocket.h"
+#include "cn24/util/BatchQueue.h"
+#include "cn24/util/BoundedQueue.h"
+#include "cn24/util/ReorderWindow.h"
 
 #include "cn24/math/TensorMath.h"
 #include "cn24/math/Optimizer.h"
@@ -70,6 +80,7 @@
 #include "cn24/net/ErrorLayer.h"
 #include "cn24/net/DummyErrorLayer.h"
 #include "cn24/net/YOLOLossLayer.h"
+#include "cn24/net/SoftmaxCrossEntropyLayer.h"
 #include "cn24/net/YOLODetectionLayer.h"
 #include "cn24/net/YOLODynamicOutputLayer.h"
 #include "cn24/net/StatLayer.h"
@@ -80,6 +91,7 @@
 #include "cn24/net/ConcatenationLayer.h"
 #include "cn24/net/GradientAccumulationLayer.h"
 #include "cn24/net/SumLayer.h"
+#include "cn24/net/FusedElementwiseLayer.h"
 #include "cn24/net/Trainer.h"
 #include "cn24/net/NetGraph.h"
 #include "cn24/net/NetGraphNode.h"
@@ -88,6 +100,7 @@
 #include "cn24/net/HMaxActivationFunction.h"
 #include "cn24/net/SparsityReLULayer.h"
 #include "cn24/net/SparsityLossLayer.h"
+#include "cn24/net/BatchPredictor.h"
 
 #include "cn24/factory/JSONNetGraphFactory.h"
 #include "cn24/factory/JSONDatasetFactory.h"
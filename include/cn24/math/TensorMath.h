@@ -16,6 +16,8 @@
 #ifndef CONV_TENSORMATH_H
 #define CONV_TENSORMATH_H
 
+#include <cstdint>
+
 #include "../util/Log.h"
 #include "../util/Config.h"
 #include "../util/Tensor.h"
@@ -119,6 +121,28 @@ public:
     const Tensor& source_a,
     const Tensor& source_b,
     Tensor& target);
+
+  /**
+   * @brief Max-pooling on the CPU. Stores the position of each maximum
+   *   within its input map (y * width + x) in argmax, which needs one
+   *   element per target element.
+   */
+  static void MAXPOOL(
+    const Tensor& source,
+    Tensor& target,
+    std::int32_t* argmax,
+    const int region_width,
+    const int region_height,
+    const int stride_width,
+    const int stride_height);
+
+  /**
+   * @brief Routes the target gradient back to the maxima found by MAXPOOL.
+   */
+  static void MAXPOOLBACKWARD(
+    Tensor& source_delta,
+    const Tensor& target_delta,
+    const std::int32_t* argmax);
 };
   
 }
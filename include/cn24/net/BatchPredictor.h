@@ -0,0 +1,179 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file BatchPredictor.h
+ * @class BatchPredictor
+ * @brief Runs a pretrained network on batches of images
+ *
+ * The network is built once for a fixed batch size. Each sample of the batch
+ * is filled with an image, unused samples are cleared. Segmentation networks
+ * accept images up to the configured size, smaller images are padded like
+ * predictImage does. For the other tasks, images are resized to the
+ * dataset's input size.
+ *
+ * Segmentation networks can also predict images of any size in overlapping
+ * tiles of the network's input size, see PredictTiled.
+ *
+ * The batch size and the maximum image size can be changed later without
+ * building the network again, see Reshape.
+ *
+ * Predictors built from the same configuration can share one set of
+ * parameters and run in separate threads, see ShareParameters.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_BATCHPREDICTOR_H
+#define CONV_BATCHPREDICTOR_H
+
+#include <string>
+#include <vector>
+
+#include "../util/Tensor.h"
+#include "../util/Dataset.h"
+#include "../util/BoundingBox.h"
+#include "../util/ClassManager.h"
+#include "../factory/JSONNetGraphFactory.h"
+#include "NetGraph.h"
+#include "NetGraphNode.h"
+#include "InputLayer.h"
+
+namespace Conv {
+
+class BatchPredictor {
+public:
+  /**
+   * @brief The largest downsampling factor of a segmentation network.
+   *   Image sizes and tile positions are multiples of it.
+   */
+  static const unsigned int stride = 32;
+
+  /**
+   * @brief Builds the network for a batch of images
+   *
+   * @param width Maximum image width for segmentation, rounded up to a
+   *   multiple of the stride. Ignored for the other tasks.
+   * @param height Maximum image height for segmentation, see width
+   */
+  BatchPredictor(JSONNetGraphFactory* factory, Dataset* dataset, ClassManager* class_manager,
+    unsigned int batch_size, unsigned int width = 0, unsigned int height = 0);
+  ~BatchPredictor();
+
+  /**
+   * @brief Returns true if the network is complete and parameters are loaded
+   */
+  bool IsReady() const { return complete_ && parameters_loaded_; }
+  bool LoadParameters(const std::string& path);
+  /**
+   * @brief Uses the parameters of another ready predictor instead of
+   *   loading them, see NetGraph::ShareParameters
+   */
+  bool ShareParameters(BatchPredictor& source);
+
+  /**
+   * @brief Changes the batch size and, for segmentation, the maximum image
+   *   size. The parameters are kept, all samples are cleared.
+   *
+   * @returns False if the network doesn't support the new shape, it keeps
+   *   the old one in that case
+   */
+  bool Reshape(unsigned int batch_size, unsigned int width = 0, unsigned int height = 0);
+
+  unsigned int GetBatchSize() const { return data_tensor_.samples(); }
+  unsigned int GetWidth() const { return data_tensor_.width(); }
+  unsigned int GetHeight() const { return data_tensor_.height(); }
+  Task GetTask() const { return task_; }
+  NetGraph& GetGraph() { return graph_; }
+
+  /**
+   * @brief Copies an image into a sample of the batch
+   *
+   * Fails if the image has the wrong number of maps or, for segmentation,
+   * if it is larger than the network's input.
+   */
+  bool SetSample(unsigned int sample, Tensor& image);
+  void ClearSample(unsigned int sample);
+
+  /**
+   * @brief Runs the network on the whole batch
+   */
+  void Predict();
+
+  /**
+   * @brief Returns the detections of a sample in the original image's
+   *   coordinates
+   */
+  void GetDetections(unsigned int sample, unsigned int original_width, unsigned int original_height,
+    std::vector<BoundingBox>& boxes);
+
+  /**
+   * @brief Returns the highest scoring class of a sample
+   */
+  unsigned int GetClass(unsigned int sample, datum& score);
+
+  /**
+   * @brief Colorizes the segmentation of a sample and crops it to the
+   *   original image's size
+   */
+  void GetSegmentation(unsigned int sample, unsigned int original_width, unsigned int original_height,
+    Tensor& image);
+
+  /**
+   * @brief Segments an image of any size in overlapping tiles
+   *
+   * Neighboring tiles overlap by twice the overlap. The outer half of each
+   * tile's overlap is ignored, the inner half is blended with the
+   * neighboring tile. If the overlap is at least twice the receptive field's
+   * radius, the result is the same as predicting the whole image at once.
+   * The overlap is rounded up to a multiple of the stride, so the tiles
+   * need to be larger than twice that.
+   * Memory only grows with the tile size, except for the output.
+   *
+   * @param output Network output for the whole image, one map per class
+   */
+  bool PredictTiled(Tensor& image, Tensor& output, unsigned int overlap);
+
+  /**
+   * @brief Estimates the radius of the segmentation network's receptive
+   *   field by changing a single input pixel
+   */
+  unsigned int EstimateReceptiveField();
+
+  /**
+   * @brief Loads a PNG or JPEG image, returns false instead of failing
+   */
+  static bool LoadImage(const std::string& path, Tensor& image);
+
+  /**
+   * @brief Writes a PNG or JPEG image, returns false instead of failing
+   */
+  static bool WriteImage(const std::string& path, Tensor& image);
+
+private:
+  /**
+   * @brief Copies a tile of an image into a sample, the outside is zero
+   */
+  void SetTile(unsigned int sample, Tensor& image, int tile_x, int tile_y);
+
+  NetGraph graph_;
+  InputLayer* input_layer_ = nullptr;
+  NetGraphNode* input_node_ = nullptr;
+  Dataset* dataset_;
+  Task task_;
+
+  Tensor data_tensor_;
+  Tensor helper_tensor_;
+  Tensor colorized_tensor_;
+  bool colorized_ = false;
+
+  bool complete_ = false;
+  bool parameters_loaded_ = false;
+};
+
+}
+
+#endif
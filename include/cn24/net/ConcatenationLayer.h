@@ -25,9 +25,40 @@ public:
   bool Connect (const std::vector< CombinedTensor* >& inputs,
                 const std::vector< CombinedTensor* >& outputs,
                 const NetStatus* status );
+  bool Reshape (const std::vector< CombinedTensor* >& inputs,
+                const std::vector< CombinedTensor* >& outputs,
+                const NetStatus* status );
   void FeedForward();
   void BackPropagate();
 
+  /**
+   * @brief Turns the inputs into views of the output, so that the
+   *   layers before write into the concatenation directly.
+   *
+   * This only works if each input part of the output is contiguous,
+   *  i.e. for a single sample, and the inputs are not used anywhere else.
+   *  The caller (NetGraph) has to ensure the latter.
+   *
+   * Samples are the outermost dimension, so with more than one sample the
+   *  maps of an input are strided in the output. Tensor views have no
+   *  sample stride, so this zero-copy path is effectively inference-only
+   *  (batch size 1). Training batches always copy.
+   *
+   * @returns True if the inputs now share the output's memory
+   */
+  bool UseViews();
+
+  /**
+   * @brief Returns true if the inputs' data currently lies inside the
+   *   output, so that FeedForward has nothing to copy
+   */
+  bool IsViewingData() const;
+  /**
+   * @brief Returns true if the inputs' deltas currently lie inside the
+   *   output delta, so that BackPropagate has nothing to copy
+   */
+  bool IsViewingDelta() const;
+
   std::string GetLayerDescription() { return "Concatenation Layer"; }
   void CreateBufferDescriptors(std::vector< NetGraphBuffer >& buffers) {
     NetGraphBuffer buffer;
@@ -55,6 +55,7 @@ public:
   bool CreateOutputs (const std::vector< CombinedTensor* >& inputs,
                       std::vector< CombinedTensor* >& outputs);
   bool Connect (const CombinedTensor* input, CombinedTensor* output);
+  bool Reshape (const CombinedTensor* input, CombinedTensor* output);
   void FeedForward();
   void BackPropagate();
   
@@ -71,7 +72,13 @@ public:
 	}
   
   bool IsGPUMemoryAware();
+  bool IsDeterministic() { return dropout_fraction_ == 0; }
 private:
+  /**
+   * @brief Sizes the buffers for the current input and output dimensions
+   */
+  void ResizeBuffers(const unsigned int samples);
+
   Tensor im2col_ff_buffer;
   Tensor sms_ff_buffer;
   Tensor sms2_bp_buffer;
@@ -50,6 +50,9 @@ public:
   bool Connect (const std::vector< CombinedTensor* >& inputs,
                 const std::vector< CombinedTensor* >& outputs,
                 const NetStatus* net );
+  bool ReshapeInput (const unsigned int batch_size,
+                     const unsigned int width, const unsigned int height,
+                     const std::vector< CombinedTensor* >& outputs);
   void FeedForward();
   void BackPropagate();
 
@@ -61,6 +64,7 @@ public:
   unsigned int GetBatchSize();
   unsigned int GetLabelWidth();
   unsigned int GetLabelHeight();
+  bool GetSampleKeys(std::vector<std::uint64_t>& keys);
 
   inline datum GetLossSamplingProbability() {
     return loss_sampling_p_;
@@ -112,6 +116,10 @@ private:
   // Metadata buffer
   DatasetMetadataPointer* metadata_buffer_ = nullptr;
 
+  // Identifies the samples of the current batch
+  std::vector<std::uint64_t> sample_keys_;
+  bool sample_keys_valid_ = false;
+
 
   // Augmentation settings
   datum jitter_;
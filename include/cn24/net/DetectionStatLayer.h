@@ -29,11 +29,20 @@ class DetectionStatLayer: public Layer, public StatLayer {
 public:
   struct Detection {
   public:
+    unsigned int c = 0;
     datum confidence = 0;
     datum tp = 0;
     datum fp = 0;
   };
 
+  /**
+   * @brief Number of score histogram bins per class. The bins of a class
+   *   cover [0, r), where r starts at 1 and doubles whenever a higher
+   *   score is seen (YOLO confidences can exceed 1). Detections are
+   *   ranked by bin, so the AP is exact up to ties within r/bins.
+   */
+  static const unsigned int score_bins = 4096;
+
   /**
 	* @brief Creates a DetectionStatLayer
 	*
@@ -44,6 +53,12 @@ public:
   void UpdateClassCount();
   void UpdateAll();
 
+  /**
+   * @brief Returns the AP of a class over all samples since the last
+   *   reset, or 0 if the class has no positive samples.
+   */
+  datum GetAveragePrecision(unsigned int c) const;
+
   /**
 	* @brief Prints the current statistics
 	*
@@ -86,9 +101,36 @@ protected:
   ClassManager* class_manager_ = nullptr;
   unsigned int last_seen_max_id_ = 0;
 
-  std::vector<Detection>* detections_ = nullptr;
+  /**
+   * @brief Matches the detections of one sample against its ground truth
+   *   and stores the results in sample_detections_ and sample_objectness_.
+   */
+  void EvaluateSample(unsigned int sample);
+
+  static unsigned int ScoreBin(datum score, datum score_range);
+
+  /**
+   * @brief Doubles the score range of a class until it includes the score,
+   *   merging pairs of neighboring bins each time.
+   */
+  void ExtendScoreRange(unsigned int c, datum score);
+
+  /**
+   * @brief Walks the histograms of a class from the highest score down and
+   *   calculates the AP and the F1 score at the lowest threshold.
+   */
+  void ClassStatistics(unsigned int c, datum& ap, datum& f1) const;
+
+  // Per-class score histograms of true and false positives
+  std::vector<unsigned long>* tp_histogram_ = nullptr;
+  std::vector<unsigned long>* fp_histogram_ = nullptr;
+  std::vector<datum> score_range_;
   unsigned int* positive_samples_ = nullptr;
 
+  // Per-sample results, merged into the histograms after each batch
+  std::vector<std::vector<Detection>> sample_detections_;
+  std::vector<Detection> sample_objectness_;
+
   datum objectness_tp_ = 0;
   datum objectness_fp_ = 0;
   datum objectness_positives_ = 0;
@@ -30,12 +30,14 @@ public:
   bool CreateOutputs (const std::vector< CombinedTensor* >& inputs,
                               std::vector< CombinedTensor* >& outputs);
   bool Connect (const CombinedTensor* input, CombinedTensor* output);
+  bool Reshape (const CombinedTensor* input, CombinedTensor* output);
   virtual void FeedForward();
   virtual void BackPropagate();
 
   virtual std::string GetLayerDescription() { return "Dropout Layer"; }
 
   virtual bool IsGPUMemoryAware() { return true; }
+  virtual bool IsDeterministic() { return false; }
 private:
   std::mt19937 rand_;
   datum dropout_fraction_;
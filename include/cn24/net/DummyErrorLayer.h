@@ -32,6 +32,9 @@ public:
 		third_ = inputs[2];
 		return true;
 	}
+  bool Reshape (const std::vector< CombinedTensor* >& inputs, const std::vector< CombinedTensor* >& outputs, const NetStatus* net ) {
+		return Connect(inputs, outputs, net);
+	}
   void FeedForward() { first_->delta.Clear(); }
   void BackPropagate() { }
 
@@ -36,6 +36,9 @@ public:
   bool Connect (const std::vector< CombinedTensor* >& inputs,
                 const std::vector< CombinedTensor* >& outputs,
                 const NetStatus* net );
+  bool Reshape (const std::vector< CombinedTensor* >& inputs,
+                const std::vector< CombinedTensor* >& outputs,
+                const NetStatus* net );
   void FeedForward();
   void BackPropagate(); 
   
@@ -0,0 +1,101 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file FusedElementwiseLayer.h
+ * @class FusedElementwiseLayer
+ * @brief Applies a chain of element-wise operations in a single pass
+ *
+ * NetGraph replaces chains of element-wise nodes with this layer, so that
+ * each element is read and written only once instead of once per node.
+ * The chain can start with the sum of two inputs, followed by any number of
+ * nonlinearities. Intermediate values are recomputed from the input during
+ * backpropagation instead of being stored.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_FUSEDELEMENTWISELAYER_H
+#define CONV_FUSEDELEMENTWISELAYER_H
+
+#include <string>
+#include <sstream>
+#include <vector>
+
+#include "Layer.h"
+
+namespace Conv {
+
+class FusedElementwiseLayer: public Layer {
+public:
+  enum Operation {
+    TANH,
+    SIGMOID,
+    RELU,
+    LEAKY_RELU
+  };
+
+  /**
+   * @brief Longest chain of operations a single layer can apply
+   */
+  static const unsigned int max_operations = 16;
+
+  /**
+   * @brief Creates a FusedElementwiseLayer
+   *
+   * @param sum_inputs If true, the layer takes two inputs and applies the
+   *   operations to their sum
+   * @param operations Operations in the order they are applied
+   */
+  FusedElementwiseLayer(bool sum_inputs, const std::vector<Operation>& operations);
+
+  /**
+   * @brief Finds the operation that a layer applies element by element
+   *
+   * @param layer Layer to check
+   * @param operation Set to the layer's operation if it has one
+   * @returns True if the layer can be fused
+   */
+  static bool GetOperation(Layer* layer, Operation& operation);
+
+  // Layer implementations
+  bool CreateOutputs (const std::vector< CombinedTensor* >& inputs,
+                      std::vector< CombinedTensor* >& outputs);
+  bool Connect (const std::vector< CombinedTensor* >& inputs,
+                const std::vector< CombinedTensor* >& outputs,
+                const NetStatus* status );
+  bool Reshape (const std::vector< CombinedTensor* >& inputs,
+                const std::vector< CombinedTensor* >& outputs,
+                const NetStatus* status );
+  void FeedForward();
+  void BackPropagate();
+
+  std::string GetLayerDescription() {
+    std::ostringstream ss;
+    ss << "Fused Elementwise Layer (" << (sum_inputs_ ? "Sum" : "Input");
+    for(Operation operation : operations_)
+      ss << ", " << OperationName(operation);
+    ss << ")";
+    return ss.str();
+  }
+  void CreateBufferDescriptors(std::vector< NetGraphBuffer >& buffers) {
+    NetGraphBuffer buffer;
+    buffer.description = "Output";
+    buffers.push_back(buffer);
+  };
+private:
+  static const char* OperationName(Operation operation);
+
+  bool sum_inputs_ = false;
+  std::vector<Operation> operations_;
+
+  CombinedTensor* input_a_ = nullptr;
+  CombinedTensor* input_b_ = nullptr;
+  CombinedTensor* output_ = nullptr;
+};
+
+}
+#endif
@@ -46,18 +46,35 @@ public:
 	*/
   InputLayer(Tensor& data, Tensor& label, Tensor& helper, Tensor& weight); 
 
+  /**
+	* @brief Resizes the user's Tensors and outputs them again
+	*
+	* Outputs with the same spatial size as the data follow its new size,
+	* the others only change their number of samples. The contents of the
+	* user's Tensors are lost.
+	*/
+
   // Layer implementations
   virtual bool CreateOutputs (const std::vector< CombinedTensor* >& inputs,
                               std::vector< CombinedTensor* >& outputs);
   virtual bool Connect (const std::vector< CombinedTensor* >& inputs,
                         const std::vector< CombinedTensor* >& outputs,
                         const NetStatus* net );
+  virtual bool ReshapeInput (const unsigned int batch_size,
+                             const unsigned int width, const unsigned int height,
+                             const std::vector< CombinedTensor* >& outputs);
   virtual void FeedForward() { }
   virtual void BackPropagate() { }
   
 	std::string GetLayerDescription() { return "Simple Input Layer"; }
 	void CreateBufferDescriptors(std::vector<NetGraphBuffer>& buffers);
 private:
+  // The user's Tensors that the outputs use
+  Tensor* data_source_ = nullptr;
+  Tensor* label_source_ = nullptr;
+  Tensor* helper_source_ = nullptr;
+  Tensor* weight_source_ = nullptr;
+
   CombinedTensor* data_ = nullptr;
   CombinedTensor* label_ = nullptr;
   CombinedTensor* helper_ = nullptr;
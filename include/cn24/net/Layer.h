@@ -60,7 +60,46 @@ public:
   virtual bool Connect (const std::vector<CombinedTensor*>& inputs,
                         const std::vector<CombinedTensor*>& outputs,
                         const NetStatus* status) = 0;
-                        
+
+  /**
+   * @brief Adapts the layer to inputs that changed their shape.
+   *
+   * Resizes the outputs in place and all buffers that depend on the input
+   * shape. The parameters keep their shape and values. The contents of the
+   * outputs are lost.
+   *
+   * @param inputs The inputs to the layer
+   * @param outputs The outputs to the layer, as created by CreateOutputs
+   * @returns False if the layer does not support reshaping or the new
+   *   shapes. Nothing is changed in that case.
+   */
+  virtual bool Reshape (const std::vector<CombinedTensor*>& inputs,
+                        const std::vector<CombinedTensor*>& outputs,
+                        const NetStatus* status) {
+    UNREFERENCED_PARAMETER(inputs);
+    UNREFERENCED_PARAMETER(outputs);
+    UNREFERENCED_PARAMETER(status);
+    return false;
+  }
+
+  /**
+   * @brief Changes the shape of an input layer's outputs, see Reshape.
+   *
+   * @param batch_size The new number of samples
+   * @param width The new width, zero keeps the current width
+   * @param height The new height, zero keeps the current height
+   * @param outputs The outputs to the layer, as created by CreateOutputs
+   */
+  virtual bool ReshapeInput (const unsigned int batch_size,
+                             const unsigned int width, const unsigned int height,
+                             const std::vector<CombinedTensor*>& outputs) {
+    UNREFERENCED_PARAMETER(batch_size);
+    UNREFERENCED_PARAMETER(width);
+    UNREFERENCED_PARAMETER(height);
+    UNREFERENCED_PARAMETER(outputs);
+    return false;
+  }
+
   /**
    * @brief Performs a forward pass
    */
@@ -126,6 +165,12 @@ public:
    */
   virtual bool IsDynamicTensorAware() { return false; }
 
+  /**
+   * @brief Returns false if the output is random during training, e.g.
+   *   because of dropout
+   */
+  virtual bool IsDeterministic() { return true; }
+
   /**
    * @brief Returs true if layer can (de)serialize on its own
    */
@@ -39,6 +39,7 @@ public:
   bool CreateOutputs (const std::vector< CombinedTensor* >& inputs,
                               std::vector< CombinedTensor* >& outputs);
   bool Connect(const CombinedTensor* input, CombinedTensor* output);
+  bool Reshape(const CombinedTensor* input, CombinedTensor* output);
   void FeedForward();
   void BackPropagate();
   
@@ -50,6 +51,29 @@ public:
   }
   
 private:
+  /**
+   * @brief Box filter along one axis using a running sum, so the cost per
+   *   element does not depend on the window size.
+   *
+   * Element i of the output is the sum of the input elements i - before
+   * to i + after, clipped to [0, count). Each element is a vector of width
+   * values, consecutive elements are stride values apart.
+   */
+  static void RunningSum(const datum* input, datum* output,
+                         const unsigned int count, const unsigned int stride, const unsigned int width,
+                         const int before, const int after);
+
+  /**
+   * @brief Sums the normalization window of every value of one sample.
+   *   If transposed, sums over all windows containing each value instead.
+   */
+  void WindowSums(const datum* input, datum* output, datum* row_buffer, bool transposed);
+
+  /**
+   * @brief Number of values in the window around index, clipped to count
+   */
+  unsigned int WindowSize(const unsigned int index, const unsigned int count) const;
+
   unsigned int size_;
   datum alpha_, beta_;
   NormalizationMethod normalization_method_;
@@ -61,6 +85,8 @@ private:
   
   // Buffers
   Tensor region_sums_;
+  Tensor scratch_;
+  Tensor coefficients_;
 };
 }
 
@@ -17,6 +17,8 @@
 
 #include <string>
 #include <sstream>
+#include <vector>
+#include <cstdint>
 
 #include "SimpleLayer.h"
 
@@ -39,6 +41,7 @@ public:
   // Implementations for SimpleLayer
   bool CreateOutputs (const std::vector< CombinedTensor* >& inputs, std::vector< CombinedTensor* >& outputs);
   bool Connect (const CombinedTensor* input, CombinedTensor* output);
+  bool Reshape (const CombinedTensor* input, CombinedTensor* output);
   void FeedForward();
   void BackPropagate();
   
@@ -67,8 +70,9 @@ private:
   unsigned int maps_ = 0;
   
   Tensor maximum_mask_;
-  Tensor maximum_ix_;
-  Tensor maximum_iy_;
+
+  // Position of each maximum within its input map, see TensorMath::MAXPOOL
+  std::vector<std::int32_t> maximum_index_;
 };
 
 }
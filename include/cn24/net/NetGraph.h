@@ -19,9 +19,14 @@
 #include "../util/CombinedTensor.h"
 #include "NetStatus.h"
 #include "../util/TensorViewer.h"
+#include "../util/FeatureCache.h"
+#include "../util/ParameterFile.h"
 
 #include "StatLayer.h"
 
+#include <cstdint>
+#include <map>
+#include <string>
 #include <vector>
 
 #define CN24_PAR_MAGIC 0xC240C240C240C240
@@ -59,14 +64,41 @@ public:
 	CombinedTensor* combined_tensor = nullptr;
 };
 
+/**
+ * @brief One node in a NetGraph's execution plan, with the tensors it
+ *   reads and writes.
+ */
+struct NetGraphPlanStep {
+	NetGraphNode* node = nullptr;
+	std::vector<CombinedTensor*> inputs;
+	std::vector<CombinedTensor*> outputs;
+	// True if any input wants gradients
+	bool backprop = false;
+};
+
 // Function pointers for callbacks
 typedef void (*NetGraphEventHandler)(NetGraph* graph, unsigned int event_type);
 
 class NetGraph : public NetStatus {
 public:
+	~NetGraph();
+
 	// Graph manipulation
 	void AddNode(NetGraphNode* node);
 	void Initialize();
+	/**
+	 * @brief Changes the batch size and the input size of an initialized graph
+	 *
+	 * The input nodes take the new shape and every other node adapts to
+	 * its inputs in the order of the forward plan. Parameters are kept, the
+	 * contents of all outputs are lost. If a layer does not support
+	 * reshaping or the new shape, the graph keeps its old shape.
+	 *
+	 * @param width The new input width, zero keeps the current width
+	 * @param height The new input height, zero keeps the current height
+	 * @returns False if the graph could not be reshaped
+	 */
+	bool Reshape(unsigned int batch_size, unsigned int width = 0, unsigned int height = 0);
 
 	// Node queries
 	inline std::vector<NetGraphNode*>& GetOutputNodes() { return output_nodes_; }
@@ -82,20 +114,110 @@ public:
 
 	// Network 
 	void FeedForward();
+	/**
+	 * @brief Runs the given nodes and the nodes they depend on that have
+	 *   not run yet. The plan for each set of nodes is compiled once.
+	 *
+	 * @param clear_flag If true, the given nodes run again even if they
+	 *   already ran. Their dependencies only run if they have not yet.
+	 */
 	void FeedForward(std::vector<NetGraphNode*>& nodes, bool clear_flag = true);
 	void BackPropagate();
+	/**
+	 * @brief Backpropagates the trained nodes among the given nodes and the
+	 *   nodes their gradients depend on, with the same flag semantics as
+	 *   FeedForward(nodes, clear_flag).
+	 */
 	void BackPropagate(std::vector<NetGraphNode*>& nodes, bool clear_flag = true);
 
 	// Parameter management
   void InitializeWeights(bool no_init = false);
   void GetParameters(std::vector<CombinedTensor*>& parameters);
-  void SerializeParameters(std::ostream& output);
-  void DeserializeParameters(std::istream& input);
+  /**
+   * @brief Gets the parameters as few large tensors, e.g. for an optimizer
+   *
+   * If the parameter arena is enabled, it replaces the parameters it holds.
+   */
+  void GetConsolidatedParameters(std::vector<CombinedTensor*>& parameters);
+  inline CombinedTensor* GetParameterArena() { return parameter_arena_; }
+  /**
+   * @brief Writes all parameters to a stream
+   *
+   * @param indexed Write the indexed format (see IndexedParameterFile)
+   *   instead of the sequential one
+   */
+  void SerializeParameters(std::ostream& output, bool indexed = false);
+  /**
+   * @brief Reads parameters in any of the formats from a stream
+   *
+   * @returns False if the stream broke off in the middle of a layer or
+   *   holds an invalid indexed file
+   */
+  bool DeserializeParameters(std::istream& input);
+  /**
+   * @brief Loads parameters from a file in any of the formats
+   *
+   * Indexed files are memory mapped and the parameters use the mapped
+   * memory directly. The mapping stays open until the next call or the
+   * destruction of the graph.
+   *
+   * @returns False if the file could not be read
+   */
+  bool LoadParameters(const std::string& path);
+  /**
+   * @brief Uses the parameters of another graph with the same nodes
+   *
+   * The parameters and their gradients become views into the source's
+   * tensors, only the outputs and the layers' buffers stay private. Graphs
+   * that share parameters can run FeedForward() in separate threads at the
+   * same time. Training any of them changes the parameters of all.
+   * Parameters that can change their size are copied instead.
+   *
+   * The source has to outlive this graph and must not load new parameters
+   * or move them into an arena while they are shared. With OpenCL, the
+   * graphs have to run in the same thread.
+   *
+   * @returns False if a node with parameters has no match of the same
+   *   shape in the source, nothing is shared in that case
+   */
+  bool ShareParameters(NetGraph& source);
 
 	// Output
 	void PrintGraph(std::ostream& graph_output);
   void SetLayerViewEnabled(bool enabled) { layerview_enabled_ = enabled; }
+  /**
+   * @brief Enables or disables fusing chains of element-wise nodes during
+   *   Initialize()
+   */
+  void SetFusionEnabled(bool enabled) { fusion_enabled_ = enabled; }
+  /**
+   * @brief Enables or disables letting concatenations and sums share the
+   *   memory of their inputs during Initialize() and Reshape()
+   */
+  void SetBufferSharingEnabled(bool enabled) { buffer_sharing_enabled_ = enabled; }
+  /**
+   * @brief Enables or disables moving all parameters into one contiguous
+   *   arena during Initialize()
+   *
+   * Parameters and their gradients become views into the arena. Parameters
+   * that can change their size stay where they are.
+   */
+  void SetParameterArenaEnabled(bool enabled) { parameter_arena_enabled_ = enabled; }
   void SetStatLayersEnabled(bool enabled);
+  /**
+   * @brief Caches the outputs of the frozen part of the net on disk
+   *
+   * Nodes that are not trained and only read the input or other such nodes
+   * form the frozen prefix. Once the features of every sample in a batch
+   * are cached, FeedForward() loads them instead of running the prefix.
+   * Samples are identified by the training layer, so augmented samples are
+   * never cached. The cache is dropped when the set of trained layers or
+   * the parameters change through this class. Parameters with a zero
+   * gradient are expected to stay the same during optimization.
+   *
+   * @param path Scratch file for the cache
+   */
+  void EnableFeatureCache(const std::string& path);
 	datum AggregateLoss();
 
 	// Events
@@ -111,11 +233,33 @@ public:
 
 	// Status
 	bool IsComplete() const;
+
+	/**
+	 * @brief Returns the nodes in the order FeedForward() runs them.
+	 *
+	 * The plan is compiled by Initialize().
+	 */
+	inline const std::vector<NetGraphPlanStep>& GetForwardPlan() const { return forward_plan_; }
 private:
-	void PrepareNode(NetGraphNode* node);
-	void FeedForward(NetGraphNode* node);
-	void BackPropagate(NetGraphNode* node);
+	void PrepareNode(const NetGraphPlanStep& step);
+	void FeedForward(const NetGraphPlanStep& step);
+	void BackPropagate(const NetGraphPlanStep& step);
+	bool NeedsBackPropagation(NetGraphNode* node) const;
+	bool UpdateTrainedNodes();
+	NetGraphPlanStep CreatePlanStep(NetGraphNode* node) const;
+	void CompilePlan();
+	void CompileBackwardPlan(std::vector<NetGraphNode*>& nodes, std::vector<NetGraphPlanStep>& plan);
+	void CompileFeaturePrefix();
+	bool FeedForwardCached();
 	void InitializeNode(NetGraphNode* node);
+	void FuseElementwise();
+	void ShareBuffers();
+	void UnshareBuffers();
+	bool ReshapeNode(const NetGraphPlanStep& step, unsigned int batch_size, unsigned int width, unsigned int height);
+	void ConsolidateParameters();
+	bool IsInParameterArena(CombinedTensor* parameters) const;
+	bool ApplyParameterFile(IndexedParameterFile& file, bool zero_copy);
+	void DetachParameters(IndexedParameterFile* file);
   void InitializeWeights(NetGraphNode* node, bool no_init = false);
 	std::vector<NetGraphNode*> nodes_;
 
@@ -126,8 +270,42 @@ private:
 	std::vector<NetGraphNode*> loss_nodes_;
 	std::vector<NetGraphNode*> training_nodes_;
 
+	// Execution plans, compiled once instead of searching the graph on
+	// every pass
+	std::vector<NetGraphPlanStep> forward_plan_;
+	std::vector<NetGraphPlanStep> backward_plan_;
+	std::vector<bool> backward_plan_starts_;
+	bool plan_valid_ = false;
+
+	// Plans for passes over some of the nodes, keyed by the requested nodes
+	std::map<std::vector<NetGraphNode*>, std::vector<NetGraphPlanStep>> partial_forward_plans_;
+	std::map<std::vector<NetGraphNode*>, std::vector<NetGraphPlanStep>> partial_backward_plans_;
+
+	// Frozen prefix of the forward plan and the cache for its outputs
+	FeatureCache* feature_cache_ = nullptr;
+	std::vector<bool> prefix_steps_;
+	std::vector<CombinedTensor*> prefix_outputs_;
+	Tensor prefix_features_;
+	std::vector<std::uint64_t> sample_keys_;
+
+	// Holds the data and gradients of all parameters that cannot change
+	// their size. Every parameter starts at a multiple of the alignment.
+	CombinedTensor* parameter_arena_ = nullptr;
+	static const std::size_t parameter_arena_alignment = 16;
+
+	// Mapped file that parameters loaded by LoadParameters() point into
+	IndexedParameterFile* parameter_file_ = nullptr;
+
 	int last_uid = -1;
   bool layerview_enabled_ = false;
+#ifdef BUILD_OPENCL
+  // The fused layer runs on the CPU only
+  bool fusion_enabled_ = false;
+#else
+  bool fusion_enabled_ = true;
+#endif
+  bool parameter_arena_enabled_ = false;
+  bool buffer_sharing_enabled_ = true;
   TensorViewer viewer;
 
 	// Event handlers
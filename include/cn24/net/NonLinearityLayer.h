@@ -51,6 +51,7 @@ public:
   bool CreateOutputs (const std::vector< CombinedTensor* >& inputs,
                               std::vector< CombinedTensor* >& outputs);
   bool Connect (const CombinedTensor* input, CombinedTensor* output);
+  bool Reshape (const CombinedTensor* input, CombinedTensor* output);
   virtual void FeedForward() = 0;
   virtual void BackPropagate() = 0;
 
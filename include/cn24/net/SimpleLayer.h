@@ -43,6 +43,22 @@ public:
    * @returns True if input and output nodes are correct
    */
   virtual bool Connect(const CombinedTensor* input, CombinedTensor* output) = 0;
+
+  bool Reshape(const std::vector<CombinedTensor*>& inputs,
+               const std::vector<CombinedTensor*>& outputs,
+               const NetStatus* status);
+
+  /**
+   * @brief Adapts the output and the layer's buffers to the input's new shape
+   *
+   * @returns False if the layer does not support reshaping, which is the
+   *   default, or the new shape
+   */
+  virtual bool Reshape(const CombinedTensor* input, CombinedTensor* output) {
+    UNREFERENCED_PARAMETER(input);
+    UNREFERENCED_PARAMETER(output);
+    return false;
+  }
 	// virtual std::string GetLayerDescription() { return "SimpleLayer"; }
 
 	virtual void CreateBufferDescriptors(std::vector<NetGraphBuffer>& buffers);
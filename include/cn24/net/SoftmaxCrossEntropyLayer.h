@@ -0,0 +1,74 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file SoftmaxCrossEntropyLayer.h
+ * @class SoftmaxCrossEntropyLayer
+ * @brief Softmax over the maps followed by cross-entropy loss, in one pass
+ *
+ * The layer takes the raw scores (logits) of the net, so the output node
+ * should not apply a softmax itself. Because the softmax is monotonic, the
+ * arg max of the net's output, and thus the predicted class, is the same.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_SOFTMAXCROSSENTROPYLAYER_H
+#define CONV_SOFTMAXCROSSENTROPYLAYER_H
+
+#include <string>
+#include <sstream>
+#include <vector>
+
+#include "Layer.h"
+#include "LossFunctionLayer.h"
+
+namespace Conv {
+
+class SoftmaxCrossEntropyLayer : public Layer, public LossFunctionLayer {
+public:
+  /**
+   * @brief Constructs a SoftmaxCrossEntropyLayer.
+   */
+  SoftmaxCrossEntropyLayer(const datum loss_weight = 1.0);
+
+  // Implementations for Layer
+  bool CreateOutputs (const std::vector< CombinedTensor* >& inputs,
+                      std::vector< CombinedTensor* >& outputs);
+  bool Connect (const std::vector< CombinedTensor* >& inputs,
+                const std::vector< CombinedTensor* >& outputs,
+                const NetStatus* net );
+  bool Reshape (const std::vector< CombinedTensor* >& inputs,
+                const std::vector< CombinedTensor* >& outputs,
+                const NetStatus* net );
+  void FeedForward();
+  void BackPropagate();
+
+  // Implementations for LossFunctionLayer
+  datum CalculateLossFunction();
+
+	std::string GetLayerDescription() {
+		std::ostringstream ss;
+		ss << "Softmax Cross-Entropy Loss Layer (Weight: " << loss_weight_ << ")";
+		return ss.str();
+	}
+private:
+  CombinedTensor* first_ = nullptr;
+  CombinedTensor* second_ = nullptr;
+  CombinedTensor* third_ = nullptr;
+
+	datum loss_weight_ = 1.0;
+
+  // Per-pixel maximum and sum of exponentials, one plane per sample
+  Tensor maximum_;
+  Tensor exp_sum_;
+  std::vector<long double> sample_loss_;
+  long double current_loss_ = 0;
+};
+
+}
+
+#endif
@@ -25,9 +25,23 @@ public:
   bool Connect (const std::vector< CombinedTensor* >& inputs,
                 const std::vector< CombinedTensor* >& outputs,
                 const NetStatus* status );
+  bool Reshape (const std::vector< CombinedTensor* >& inputs,
+                const std::vector< CombinedTensor* >& outputs,
+                const NetStatus* status );
   void FeedForward();
   void BackPropagate();
 
+  /**
+   * @brief Lets both inputs' deltas share the output delta instead of
+   *   receiving a copy of it during backpropagation.
+   *
+   * The inputs must not be used anywhere else, which the caller (NetGraph)
+   *  has to ensure.
+   *
+   * @returns True if the gradient is shared
+   */
+  bool ShareGradient();
+
   std::string GetLayerDescription() { return "Sum Layer"; }
   void CreateBufferDescriptors(std::vector< NetGraphBuffer >& buffers) {
     NetGraphBuffer buffer;
@@ -41,6 +55,8 @@ private:
   
   unsigned int maps_ = 0;
   unsigned int samples_ = 0;
+
+  bool IsSharingGradient() const;
 };
 
 }
@@ -43,6 +43,16 @@ public:
   unsigned int iterations = 500;
 };
 
+/**
+ * @brief Seconds spent in the phases of the training iterations
+ */
+struct TrainerPhaseTimes {
+  double load = 0.0;
+  double forward = 0.0;
+  double backward = 0.0;
+  double optimizer = 0.0;
+};
+
 class TrainerProgressUpdateHandler {
 public:
   virtual void OnTrainerProgressUpdate(datum progress) = 0;
@@ -109,13 +119,39 @@ public:
   inline void SetUpdateHandler(TrainerProgressUpdateHandler* update_handler) { this->update_handler = update_handler; }
 
   JSON& settings() { return settings_; }
+
+  /**
+   * @brief Gets the time spent in each phase of training since the last reset
+   */
+  const TrainerPhaseTimes& phase_times() const { return phase_times_; }
+  inline void ResetPhaseTimes() { phase_times_ = TrainerPhaseTimes(); }
 private:
-  void ApplyRegularizationAndScaling();
+  /**
+   * @brief Adds the current gradients to the accumulated gradients
+   *
+   * @param first_batch If true, the accumulated gradients are overwritten
+   */
+  void AccumulateGradients(bool first_batch);
+
+  /**
+   * @brief Turns the gradients into the parameter deltas for the optimizer
+   *
+   * @param accumulated If true, the accumulated gradients are added to the
+   *   current ones first
+   */
+  void ApplyRegularizationAndScaling(bool accumulated);
   void InitializeStats();
 
+  /**
+   * @brief Counts the outputs per batch, the graph may have been reshaped
+   *   to another batch size since the last call
+   */
+  void UpdateSampleCount();
+
   // References for easy access
   NetGraph& graph_;
   std::vector<CombinedTensor*> parameters_;
+  std::vector<CombinedTensor*> optimizer_parameters_;
   std::vector<Tensor*> accumulated_gradients_;
 
   // Optimizer
@@ -134,6 +170,7 @@ private:
   // State
   unsigned int epoch_ = 0;
   bool first_iteration = true;
+  TrainerPhaseTimes phase_times_;
 
   // Update handler
   TrainerProgressUpdateHandler* update_handler = nullptr;
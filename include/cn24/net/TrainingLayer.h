@@ -16,6 +16,9 @@
 #ifndef CONV_TRAININGLAYER_H
 #define CONV_TRAININGLAYER_H
 
+#include <cstdint>
+#include <vector>
+
 #include "../util/JSONParsing.h"
 
 namespace Conv {
@@ -73,6 +76,16 @@ public:
    * @brief Sets all the weights in the helper Tensor to zero
    */
   virtual void ForceWeightsZero() { LOGERROR << "Not implements!"; }
+
+  /**
+   * @brief Gets a key for each sample of the current batch
+   *
+   * Two samples with the same key have the same input data, so features
+   *  computed from them can be reused.
+   * @returns False if the samples cannot be identified, e.g. because they
+   *  were augmented randomly
+   */
+  virtual bool GetSampleKeys(std::vector<std::uint64_t>& keys) { UNREFERENCED_PARAMETER(keys); return false; }
 };
 
 }
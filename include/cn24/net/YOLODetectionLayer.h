@@ -18,6 +18,7 @@
 #include <string>
 
 #include "SimpleLayer.h"
+#include "../util/NonMaximumSuppression.h"
 
 namespace Conv {
 
@@ -49,6 +50,7 @@ private:
   unsigned int classes_ = 0;
 
   bool do_nms_ = true;
+  NonMaximumSuppression nms_;
   datum confidence_threshold_ = 0.2;
 
 };
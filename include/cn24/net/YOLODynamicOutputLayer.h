@@ -50,6 +50,12 @@ private:
   CombinedTensor* class_weights_;
   CombinedTensor* class_biases_;
 
+  // Weights are stored as [output map][input map], so every output is a
+  // dot product over contiguous memory and the whole batch maps to GEMM.
+  Tensor ones_;
+  Tensor class_ff_buffer_;
+  Tensor class_bp_buffer_;
+
   std::mt19937 rand_;
 
   unsigned int next_layer_gain_ = 0;
@@ -17,6 +17,7 @@
 
 #include <string>
 #include <sstream>
+#include <vector>
 
 #include "Layer.h"
 #include "LossFunctionLayer.h"
@@ -50,6 +51,17 @@ public:
 
 	bool IsDynamicTensorAware() { return true; }
 private:
+  /**
+   * @brief Writes the deltas of one sample and returns its loss.
+   */
+  double SampleLoss(unsigned int sample);
+
+  /**
+   * @brief Returns the cell containing the normalized coordinate x,
+   *   or -1 if it is outside of the image.
+   */
+  int CellForPosition(datum x, unsigned int cells) const;
+
   CombinedTensor* first_ = nullptr;
   CombinedTensor* second_ = nullptr;
   CombinedTensor* third_ = nullptr;
@@ -65,6 +77,12 @@ private:
 	datum loss_weight_ = 1.0;
 
 	long double current_loss_ = 0;
+
+  // Index of the ground truth box assigned to each cell and the box
+  // responsible for it, per sample, or -1
+  std::vector<int> cell_truth_;
+  std::vector<int> cell_responsible_;
+  std::vector<double> sample_loss_;
 };
 
 }
@@ -0,0 +1,111 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file BatchQueue.h
+ * @class BatchQueue
+ * @brief Thread safe queue that collects items into batches
+ *
+ * PopBatch returns as soon as a full batch is waiting or the oldest item
+ * has waited for the maximum wait time, whichever comes first. After
+ * Close(), Push and PopBatch fail and Drain returns what is left.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_BATCHQUEUE_H
+#define CONV_BATCHQUEUE_H
+
+#include <cstddef>
+#include <chrono>
+#include <deque>
+#include <utility>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+namespace Conv {
+
+template <typename T>
+class BatchQueue {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  explicit BatchQueue(std::chrono::milliseconds max_wait) : max_wait_(max_wait) {}
+
+  /**
+   * @brief Appends an item, false if the queue is closed
+   *
+   * @param arrival The item's deadline is counted from here
+   */
+  bool Push(const T& item, Clock::time_point arrival = Clock::now()) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(closed_)
+      return false;
+    items_.push_back(std::make_pair(item, arrival));
+    condition_.notify_all();
+    return true;
+  }
+
+  /**
+   * @brief Waits for a full batch or the oldest item's deadline and takes
+   *   up to batch_size items, false if the queue is closed
+   *
+   * The batch may be empty if several consumers wait for the same items.
+   */
+  bool PopBatch(std::vector<T>& batch, std::size_t batch_size) {
+    batch.clear();
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(lock, [this] { return !items_.empty() || closed_; });
+    if(closed_)
+      return false;
+
+    const Clock::time_point deadline = items_.front().second + max_wait_;
+    condition_.wait_until(lock, deadline, [this, batch_size] { return items_.size() >= batch_size || closed_; });
+    if(closed_)
+      return false;
+
+    while(!items_.empty() && batch.size() < batch_size) {
+      batch.push_back(items_.front().first);
+      items_.pop_front();
+    }
+    return true;
+  }
+
+  /**
+   * @brief Takes all remaining items
+   */
+  void Drain(std::vector<T>& items) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    items.clear();
+    for(const std::pair<T, Clock::time_point>& item : items_)
+      items.push_back(item.first);
+    items_.clear();
+  }
+
+  void Close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    condition_.notify_all();
+  }
+
+  bool IsClosed() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return closed_;
+  }
+
+private:
+  std::chrono::milliseconds max_wait_;
+  std::deque<std::pair<T, Clock::time_point>> items_;
+  bool closed_ = false;
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+};
+
+}
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file BoundedQueue.h
+ * @class BoundedQueue
+ * @brief Thread safe queue with a maximum size, connects pipeline stages
+ *
+ * Push blocks while the queue is full, so a fast stage cannot run ahead of
+ * a slow one and fill up the memory. After Close(), Pop returns the
+ * remaining items and then false.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_BOUNDEDQUEUE_H
+#define CONV_BOUNDEDQUEUE_H
+
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+namespace Conv {
+
+template <typename T>
+class BoundedQueue {
+public:
+  explicit BoundedQueue(std::size_t capacity) : capacity_(capacity > 0 ? capacity : 1) {}
+
+  /**
+   * @brief Waits for space and appends an item, false if the queue is closed
+   */
+  bool Push(const T& item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [this] { return items_.size() < capacity_ || closed_; });
+    if(closed_)
+      return false;
+    items_.push_back(item);
+    not_empty_.notify_one();
+    return true;
+  }
+
+  /**
+   * @brief Waits for an item, false if the queue is closed and empty
+   */
+  bool Pop(T& item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this] { return !items_.empty() || closed_; });
+    if(items_.empty())
+      return false;
+    item = items_.front();
+    items_.pop_front();
+    not_full_.notify_one();
+    return true;
+  }
+
+  void Close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    not_empty_.notify_all();
+    not_full_.notify_all();
+  }
+
+private:
+  std::size_t capacity_;
+  std::deque<T> items_;
+  bool closed_ = false;
+
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+};
+
+}
+
+#endif
@@ -44,6 +44,15 @@ public:
     data (samples, width, height, maps),
     delta (samples, width, height, maps), metadata(metadata), is_dynamic(is_dynamic) {}
 
+  /**
+   * @brief Resizes both Tensors with data loss.
+   */
+  void Resize (const std::size_t samples, const std::size_t width = 1,
+               const std::size_t height = 1, const std::size_t maps = 1) {
+    data.Resize (samples, width, height, maps);
+    delta.Resize (samples, width, height, maps);
+  }
+
 
   Tensor data;
   Tensor delta;
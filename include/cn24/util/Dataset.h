@@ -43,6 +43,7 @@ class Dataset
 {
 public:
   explicit Dataset(ClassManager* class_manager) : class_manager_(class_manager) {};
+  virtual ~Dataset() {};
 	/**
 	 * @brief Gets the name of the dataset
 	 */
@@ -168,8 +169,14 @@ enum DatasetLoadSelection {
 
 class TensorStreamPatchDataset : public Dataset {
  public:
-	 TensorStreamPatchDataset(std::istream& training_stream,
-		 std::istream& testing_stream,
+	/**
+	 * @brief Loads alternating image and label Tensors from TensorStream
+	 *   files in either format (see TensorFile). Empty paths are skipped.
+	 *
+	 * @param try_mmap Set to false to read the Tensors instead of mapping them
+	 */
+	 TensorStreamPatchDataset(const std::string& training_file,
+		 const std::string& testing_file,
 		 unsigned int classes,
 		 std::vector<std::string> class_names,
 		 std::vector<unsigned int> class_colors,
@@ -177,7 +184,7 @@ class TensorStreamPatchDataset : public Dataset {
 		 unsigned int patchsize_x,
 		 unsigned int patchsize_y, ClassManager* class_manager,
 		 dataset_localized_error_function error_function = DefaultLocalizedErrorFunction,
-    int training_fd = 0, int testing_fd = 0);
+    bool try_mmap = true);
  
   // Dataset implementations
   virtual Task GetTask() const;
@@ -270,6 +277,13 @@ public:
 		return false; };
 
   static TensorStreamDataset* CreateFromConfiguration(std::istream& file, bool dont_load = false, DatasetLoadSelection selection = LOAD_BOTH, ClassManager* class_manager = nullptr);
+
+  /**
+   * @brief Registers the classes of the configuration file in their order.
+   *   The label maps are in this order, so the class ids only match them if
+   *   the ClassManager was empty before.
+   */
+  void RegisterClasses(ClassManager* class_manager) const;
   
 private:
   // Stored data
@@ -0,0 +1,78 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file FeatureCache.h
+ * @class FeatureCache
+ * @brief Stores compressed feature Tensors on disk, one record per key
+ *
+ * Records are appended to a scratch file and memory mapped again when they
+ * are loaded. The file is deleted together with the cache.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_FEATURECACHE_H
+#define CONV_FEATURECACHE_H
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+
+#include "Tensor.h"
+
+namespace Conv {
+
+class FeatureCache {
+public:
+  /**
+   * @brief Creates an empty cache backed by the given file
+   *
+   * @param path Scratch file, overwritten if it exists
+   */
+  explicit FeatureCache(const std::string& path);
+  ~FeatureCache();
+
+  /**
+   * @brief Returns true if there is a record for the key
+   */
+  bool Contains(const std::uint64_t key) const { return offsets_.count(key) > 0; }
+
+  /**
+   * @brief Stores a record, the key must not be in the cache yet
+   */
+  void Store(const std::uint64_t key, Tensor& features);
+
+  /**
+   * @brief Loads a record into a Tensor of the same size
+   *
+   * @returns False if there is no record for the key or its size differs
+   */
+  bool Load(const std::uint64_t key, Tensor& features);
+
+  /**
+   * @brief Removes all records
+   */
+  void Clear();
+
+  std::size_t GetRecordCount() const { return offsets_.size(); }
+  std::uint64_t GetLength() const { return length_; }
+
+private:
+  void Open();
+
+  std::string path_;
+  std::fstream file_;
+  int file_descriptor_ = 0;
+
+  std::map<std::uint64_t, std::uint64_t> offsets_;
+  std::uint64_t length_ = 0;
+};
+
+}
+
+#endif
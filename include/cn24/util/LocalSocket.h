@@ -0,0 +1,76 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file LocalSocket.h
+ * @class LocalSocket
+ * @brief Blocking Unix domain stream socket used by the inference tools
+ *
+ * Messages are newline terminated text lines, optionally followed by a
+ * binary payload whose length is given in the line. Only supported on
+ * POSIX systems, everywhere else all operations fail.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_LOCALSOCKET_H
+#define CONV_LOCALSOCKET_H
+
+#include <cstddef>
+#include <string>
+
+namespace Conv {
+
+class LocalSocket {
+public:
+  LocalSocket() {}
+  explicit LocalSocket(int descriptor) : descriptor_(descriptor) {}
+  ~LocalSocket() { Close(); }
+
+  LocalSocket(const LocalSocket&) = delete;
+  LocalSocket& operator=(const LocalSocket&) = delete;
+
+  /**
+   * @brief Creates a listening socket, replacing a stale socket file
+   */
+  bool Listen(const std::string& path, int backlog = 64);
+
+  /**
+   * @brief Waits for a connection, returns its descriptor or -1
+   */
+  int Accept();
+
+  bool Connect(const std::string& path);
+  void Close();
+  /**
+   * @brief Makes a blocked Accept or Read on another thread fail. The
+   *   descriptor stays valid until Close, so this is safe to call while
+   *   the other thread still uses it.
+   */
+  void Shutdown();
+
+  bool IsOpen() const { return descriptor_ >= 0; }
+
+  /**
+   * @brief Reads a line without the newline, false on error or end of stream
+   */
+  bool ReadLine(std::string& line);
+  bool Read(void* buffer, std::size_t length);
+
+  bool WriteLine(const std::string& line);
+  bool Write(const void* buffer, std::size_t length);
+
+private:
+  int descriptor_ = -1;
+  std::string path_;
+
+  // Bytes read past the end of the last line
+  std::string buffer_;
+};
+
+}
+
+#endif
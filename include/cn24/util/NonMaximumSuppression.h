@@ -0,0 +1,119 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file NonMaximumSuppression.h
+ * @class NonMaximumSuppression
+ * @brief Per-class non-maximum suppression using a spatial grid of boxes
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_NONMAXIMUMSUPPRESSION_H
+#define CONV_NONMAXIMUMSUPPRESSION_H
+
+#include <vector>
+#include <string>
+
+#include "Config.h"
+#include "BoundingBox.h"
+#include "JSONParsing.h"
+
+namespace Conv {
+
+/**
+ * @brief Buckets a subset of boxes by their center into a regular grid.
+ *
+ * Queries return every box that could intersect the query box, so
+ * overlap computations are restricted to nearby candidates.
+ */
+class BoxGrid {
+public:
+  BoxGrid(const std::vector<BoundingBox>& boxes, const std::vector<unsigned int>& indices);
+
+  /**
+   * @brief Calls f(index) for every box that may intersect the query box.
+   *
+   * Each candidate is reported exactly once. Stops early if f returns false.
+   */
+  template <typename F> void ForEachCandidate(const BoundingBox& query, F f) const {
+    if(resolution_ == 0)
+      return;
+    const datum reach_x = (query.w + max_w_) / (datum)2.0;
+    const datum reach_y = (query.h + max_h_) / (datum)2.0;
+    const unsigned int x0 = CellX(query.x - reach_x), x1 = CellX(query.x + reach_x);
+    const unsigned int y0 = CellY(query.y - reach_y), y1 = CellY(query.y + reach_y);
+    for(unsigned int cy = y0; cy <= y1; cy++) {
+      for(unsigned int cx = x0; cx <= x1; cx++) {
+        for(unsigned int index : cells_[cy * resolution_ + cx]) {
+          if(!f(index))
+            return;
+        }
+      }
+    }
+  }
+
+private:
+  unsigned int CellX(datum x) const;
+  unsigned int CellY(datum y) const;
+
+  std::vector<std::vector<unsigned int>> cells_;
+  unsigned int resolution_ = 0;
+  datum min_x_ = 0, min_y_ = 0;
+  datum cell_w_ = 1, cell_h_ = 1;
+  datum max_w_ = 0, max_h_ = 0;
+};
+
+class NonMaximumSuppression {
+public:
+  enum Method {
+    // Remove boxes overlapping a higher scoring box of the same class
+    NMS_HARD,
+    // Decay scores by (1 - IoU) above the threshold (Bodla et al.)
+    NMS_SOFT_LINEAR,
+    // Decay scores by exp(-IoU^2 / sigma)
+    NMS_SOFT_GAUSSIAN
+  };
+
+  NonMaximumSuppression() {}
+
+  /**
+   * @brief Reads nms_method ("hard", "soft_linear", "soft_gaussian"),
+   *   nms_threshold, nms_sigma, nms_min_score and nms_top_k.
+   */
+  explicit NonMaximumSuppression(JSON configuration);
+
+  /**
+   * @brief Suppresses boxes in place. Boxes are only compared against
+   *   boxes of the same class. The result is sorted by ascending score.
+   *
+   * This is thread-safe, so callers can process samples in parallel.
+   */
+  void Apply(std::vector<BoundingBox>& boxes) const;
+
+  /**
+   * @brief Returns the indices of the boxes grouped by class, each group
+   *   sorted by descending score.
+   */
+  static void GroupByClass(const std::vector<BoundingBox>& boxes,
+                           std::vector<std::vector<unsigned int>>& groups);
+
+  Method method = NMS_HARD;
+  datum threshold = 0.5;
+  datum sigma = 0.5;
+  datum min_score = 0.001;
+  unsigned int top_k = 0;
+
+private:
+  void SuppressHard(std::vector<BoundingBox>& boxes, const std::vector<unsigned int>& group,
+                    std::vector<bool>& keep) const;
+  void SuppressSoft(std::vector<BoundingBox>& boxes, const std::vector<unsigned int>& group,
+                    std::vector<bool>& keep) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,129 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file ParameterFile.h
+ * @class IndexedParameterFile
+ * @brief Reads and writes the indexed parameter file format
+ *
+ * The file starts with a directory of all parameter sets: node name,
+ * layer metadata and the offset and shape of each tensor. The tensors
+ * follow as raw data, each starting at a multiple of the page size. An
+ * opened file is memory mapped, so tensors can use the file's memory
+ * directly instead of copying it.
+ *
+ * Layout: magic, version, file length, set count, directory length (all
+ * uint64_t), then for each set the name and metadata (uint32_t length + bytes), the
+ * tensor count (uint32_t) and per tensor its offset, samples, width,
+ * height and maps (uint64_t).
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_PARAMETERFILE_H
+#define CONV_PARAMETERFILE_H
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Tensor.h"
+
+#define CN24_PARIDX_MAGIC 0xC242C242C242C242
+#define CN24_PARIDX_VERSION 1
+
+namespace Conv {
+
+/**
+ * @brief A named set of parameter tensors, as stored for one node
+ */
+struct ParameterSet {
+  std::string name;
+  std::string metadata;
+  std::vector<Tensor*> tensors;
+};
+
+class IndexedParameterFile {
+public:
+  /**
+   * @brief Alignment of the tensor data in the file
+   */
+  static const std::uint64_t alignment = 4096;
+
+  /**
+   * @brief Writes parameter sets in the indexed format
+   */
+  static bool Write(std::ostream& output, const std::vector<ParameterSet>& parameter_sets);
+
+  /**
+   * @brief Memory maps a file. Writes to the tensors only change private
+   *   copies of the pages, never the file.
+   */
+  explicit IndexedParameterFile(const std::string& path);
+
+  /**
+   * @brief Reads a file from a stream into memory
+   *
+   * @param input Stream positioned right after the magic number
+   */
+  explicit IndexedParameterFile(std::istream& input);
+
+  bool IsValid() const { return valid_; }
+
+  unsigned int GetSetCount() const { return (unsigned int)sets_.size(); }
+  const std::string& GetName(unsigned int set) const { return sets_[set].name; }
+  const std::string& GetMetadata(unsigned int set) const { return sets_[set].metadata; }
+  unsigned int GetTensorCount(unsigned int set) const { return (unsigned int)sets_[set].tensors.size(); }
+
+  /**
+   * @brief Finds a parameter set by name
+   *
+   * @returns The set's index or -1 if there is none
+   */
+  int Find(const std::string& name) const;
+
+  /**
+   * @brief Makes a Tensor use the file's memory for one of the tensors
+   *
+   * @returns False if the Tensor could not view the memory, e.g. with OpenCL
+   */
+  bool View(unsigned int set, unsigned int tensor, Tensor& target);
+
+  /**
+   * @brief Copies one of the tensors into a Tensor, resizing it
+   */
+  void Copy(unsigned int set, unsigned int tensor, Tensor& target) const;
+
+  /**
+   * @brief Returns true if the memory belongs to this file
+   */
+  bool Contains(const datum* memory) const;
+
+private:
+  struct TensorEntry {
+    std::uint64_t offset;
+    std::uint64_t samples, width, height, maps;
+  };
+  struct SetEntry {
+    std::string name;
+    std::string metadata;
+    std::vector<TensorEntry> tensors;
+  };
+
+  void ParseDirectory();
+
+  // The whole file, mapped or read
+  Tensor file_;
+  std::vector<SetEntry> sets_;
+  std::map<std::string, unsigned int> set_index_;
+  bool valid_ = false;
+};
+
+}
+
+#endif
@@ -0,0 +1,111 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file PredictionDump.h
+ * @brief Binary log of per-sample network predictions (e.g. for novelty detection)
+ *
+ * File layout (all integers are uint64_t):
+ *  1. Magic number, format version, flags
+ *  2. Width, height and maps of a single row
+ *  3. Class count, followed by (id, name length, name) per class
+ *  4. Segment count, followed by (name length, name) per segment
+ *  5. Rows: segment index, sample index, score (float32) and the payload.
+ *     The payload is either the raw float32 data or a serialized
+ *     CompressedTensor if PREDICTIONDUMP_COMPRESSED is set.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_PREDICTIONDUMP_H
+#define CONV_PREDICTIONDUMP_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include "Config.h"
+#include "Log.h"
+#include "Tensor.h"
+#include "CompressedTensor.h"
+#include "ClassManager.h"
+
+#define CN24_PDUMP_MAGIC 0xC24DC24DC24DC24D
+#define CN24_PDUMP_VERSION 1
+#define PREDICTIONDUMP_COMPRESSED 1
+
+namespace Conv {
+
+class PredictionDumpWriter {
+public:
+  /**
+   * @brief Opens the file and writes the header.
+   *
+   * @param path Output file name
+   * @param prediction Tensor with the shape of the predictions, only its size is used
+   * @param class_manager Class names to store in the header (may be null)
+   * @param segment_names Names of the segments that rows can refer to
+   * @param compress Use run length compression for the row payloads
+   */
+  PredictionDumpWriter(const std::string& path, const Tensor& prediction,
+                       const ClassManager* class_manager,
+                       const std::vector<std::string>& segment_names,
+                       bool compress = false);
+  ~PredictionDumpWriter();
+
+  /**
+   * @brief Appends a single sample of the prediction Tensor as a row.
+   */
+  void WriteRow(unsigned int segment, unsigned int sample_in_segment, datum score,
+                const Tensor& prediction, unsigned int sample);
+
+  void Close();
+  bool good() const { return output_.good(); }
+
+private:
+  std::ofstream output_;
+  Tensor row_tensor_;
+  CompressedTensor compressed_row_;
+  bool compress_ = false;
+  std::size_t rows_ = 0;
+};
+
+class PredictionDumpReader {
+public:
+  explicit PredictionDumpReader(const std::string& path);
+
+  /**
+   * @brief Reads the next row into the Tensor (resized to 1 sample).
+   *
+   * @returns False at the end of the file
+   */
+  bool ReadRow(unsigned int& segment, unsigned int& sample_in_segment, datum& score, Tensor& row);
+
+  bool good() const { return good_; }
+  bool compressed() const { return compress_; }
+  std::size_t width() const { return width_; }
+  std::size_t height() const { return height_; }
+  std::size_t maps() const { return maps_; }
+
+  const std::vector<std::pair<unsigned int, std::string>>& class_names() const { return class_names_; }
+  const std::vector<std::string>& segment_names() const { return segment_names_; }
+
+private:
+  std::ifstream input_;
+  CompressedTensor compressed_row_;
+  bool good_ = false;
+  bool compress_ = false;
+  std::size_t width_ = 0;
+  std::size_t height_ = 0;
+  std::size_t maps_ = 0;
+
+  std::vector<std::pair<unsigned int, std::string>> class_names_;
+  std::vector<std::string> segment_names_;
+};
+
+}
+
+#endif
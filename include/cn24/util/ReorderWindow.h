@@ -0,0 +1,80 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file ReorderWindow.h
+ * @class ReorderWindow
+ * @brief Thread safe buffer that hands out items in the order of their
+ *   indices, no matter in which order they are finished
+ *
+ * Workers reserve an index before they start working on it. Reserve blocks
+ * while the index is more than the capacity ahead of the next item to be
+ * taken, so a slow item cannot let the others fill up the memory. Indices
+ * must be reserved in ascending order, e.g. from an atomic counter.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_REORDERWINDOW_H
+#define CONV_REORDERWINDOW_H
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+
+namespace Conv {
+
+template <typename T>
+class ReorderWindow {
+public:
+  explicit ReorderWindow(std::size_t capacity) : capacity_(capacity > 0 ? capacity : 1) {}
+
+  /**
+   * @brief Waits until the index fits into the window
+   */
+  void Reserve(std::size_t index) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    window_moved_.wait(lock, [this, index] { return index < next_ + capacity_; });
+  }
+
+  /**
+   * @brief Stores the finished item of a reserved index
+   */
+  void Put(std::size_t index, const T& item) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    items_[index] = item;
+    if(index == next_)
+      item_ready_.notify_all();
+  }
+
+  /**
+   * @brief Waits for the item with the next index and moves the window
+   */
+  T Take() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    item_ready_.wait(lock, [this] { return items_.count(next_) > 0; });
+    typename std::map<std::size_t, T>::iterator it = items_.find(next_);
+    T item = it->second;
+    items_.erase(it);
+    next_++;
+    window_moved_.notify_all();
+    return item;
+  }
+
+private:
+  std::size_t capacity_;
+  std::size_t next_ = 0;
+  std::map<std::size_t, T> items_;
+
+  std::mutex mutex_;
+  std::condition_variable window_moved_;
+  std::condition_variable item_ready_;
+};
+
+}
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file SyntheticDataset.h
+ * @class SyntheticDataset
+ * @brief Dataset of generated images, kept in memory
+ *
+ * Every sample shows a few filled rectangles on a noisy background, one
+ * color per class. Depending on the task, the labels are the per-pixel
+ * classes, the class of the single rectangle or its bounding boxes. The
+ * samples only depend on the descriptor, so the same seed always gives the
+ * same dataset. No files are read, which makes this dataset useful for
+ * benchmarks and tests.
+ *
+ * Descriptor: {"special": "synthetic", "task": "segmentation" |
+ * "classification" | "detection", "width", "height", "input_maps",
+ * "classes", "training_samples", "testing_samples", "max_objects", "seed"}
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_SYNTHETICDATASET_H
+#define CONV_SYNTHETICDATASET_H
+
+#include <string>
+#include <vector>
+#include "JSONParsing.h"
+
+#include "Dataset.h"
+
+namespace Conv {
+class SyntheticDataset : public Dataset {
+public:
+  explicit SyntheticDataset(ClassManager* class_manager) : Dataset(class_manager) {};
+  ~SyntheticDataset() {};
+  virtual std::string GetName() const { return name_; }
+  virtual Task GetTask() const { return task_; };
+  virtual Method GetMethod() const { return FCN; }
+  virtual unsigned int GetWidth() const { return width_; };
+  virtual unsigned int GetHeight() const { return height_; };
+  virtual unsigned int GetInputMaps() const { return input_maps_; };
+  virtual unsigned int GetLabelMaps() const { return label_maps_; };
+  virtual unsigned int GetTrainingSamples() const { return training_samples_; };
+  virtual unsigned int GetTestingSamples() const { return testing_samples_; };
+  virtual bool SupportsTesting() const { return testing_samples_ > 0; };
+  virtual bool GetTrainingSample(Tensor& data_tensor, Tensor& label_tensor, Tensor& helper_tensor, Tensor& weight_tensor, unsigned int sample, unsigned int index);
+  virtual bool GetTestingSample(Tensor& data_tensor, Tensor& label_tensor,Tensor& helper_tensor, Tensor& weight_tensor,  unsigned int sample, unsigned int index);
+  virtual bool GetTrainingMetadata(DatasetMetadataPointer* metadata_array, unsigned int sample, unsigned int index);
+  virtual bool GetTestingMetadata(DatasetMetadataPointer* metadata_array, unsigned int sample, unsigned int index);
+
+  void Load(JSON descriptor);
+
+private:
+  bool GetSample(Tensor& data_tensor, Tensor& label_tensor, Tensor& helper_tensor, Tensor& weight_tensor,
+                 unsigned int sample, unsigned int index);
+
+  std::string name_ = "Synthetic dataset";
+  Task task_ = SEMANTIC_SEGMENTATION;
+
+  unsigned int width_ = 0;
+  unsigned int height_ = 0;
+  unsigned int input_maps_ = 0;
+  unsigned int label_maps_ = 0;
+  unsigned int training_samples_ = 0;
+  unsigned int testing_samples_ = 0;
+
+  // Training samples first, then testing samples
+  Tensor data_;
+  Tensor labels_;
+  std::vector<std::vector<BoundingBox>> boxes_;
+};
+}
+
+#endif
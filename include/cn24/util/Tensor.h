@@ -99,6 +99,21 @@ public:
    */
   void Shadow (Tensor& tensor);
 
+  /**
+   * @brief Uses a contiguous part of another Tensor's memory
+   *
+   * Like Shadow, but the view starts at an element offset into the other
+   *  Tensor and may have a different shape. Writes to the view go directly
+   *  into the other Tensor, so no copy is needed to move data between them.
+   *
+   * @param tensor Tensor to view into
+   * @param offset Element offset of the view's first element
+   * @returns True if the view fits into the other Tensor and was created
+   */
+  bool View (Tensor& tensor, const std::size_t offset,
+             const std::size_t samples, const std::size_t width = 1,
+             const std::size_t height = 1, const std::size_t maps = 1);
+
   /**
    * @brief Resizes the Tensor with data loss.
    */
@@ -110,7 +125,8 @@ public:
   /**
    * @brief Extends the Tensor to hold more samples without data loss
    *
-   * This is an expensive operation!
+   * New samples are cleared. The allocation grows geometrically, so
+   * repeated extensions only reallocate occasionally.
    * @param samples
    */
   void Extend (const std::size_t samples);
@@ -166,6 +182,18 @@ public:
    * @param fd File descriptor for the SAME file as input's underlying
    */
   void Deserialize (std::istream& input, bool head_only = false, bool try_mmap = false, int fd = 0);
+
+  /**
+   * @brief Memory maps part of a file as the Tensor's content.
+   *
+   * The mapping is private, writing to the Tensor does not change the file.
+   * @param fd File descriptor of the file
+   * @param offset Byte offset of the first element in the file
+   * @returns False if the platform does not support it or mapping failed
+   */
+  bool MapFile (int fd, const std::size_t offset, const std::size_t samples,
+                const std::size_t width = 1, const std::size_t height = 1,
+                const std::size_t maps = 1);
   
   /**
    * @brief Loads a file and resizes the Tensor to match its contents
@@ -317,6 +345,9 @@ public:
   inline std::size_t elements() const {
     return elements_;
   }
+  inline bool is_shadow() const {
+    return is_shadow_;
+  }
 
 private:
   // Pointer to the actual data
@@ -330,6 +361,9 @@ private:
   std::size_t height_ = 0;
   std::size_t width_ = 0;
   std::size_t elements_ = 0;
+
+  // Number of elements in the allocation, may exceed elements_ after Extend
+  std::size_t capacity_ = 0;
   
 public:
   /**
@@ -0,0 +1,126 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file TensorFile.h
+ * @class TensorFile
+ * @brief Reads Tensor files and float TensorStreams in both formats
+ *
+ * Files in the aligned format start with a header that records the format
+ * version, element type and memory layout, the alignment and the offset of
+ * the directory of all tensors. Each tensor's data starts at a multiple of
+ * the alignment, so it can be memory mapped without copying and without
+ * reading the rest of the file.
+ *
+ * Header: magic (uint64_t), version, element type, layout, reserved
+ * (uint32_t), alignment, tensor count, directory offset (uint64_t).
+ * Directory: offset, samples, width, height, maps (uint64_t) per tensor.
+ *
+ * Files in the old format are sequences of serialized Tensors. Opening one
+ * scans the Tensor headers once to build the same directory.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_TENSORFILE_H
+#define CONV_TENSORFILE_H
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Tensor.h"
+
+#define CN24_TENSORFILE_MAGIC 0xC243C243C243C243
+#define CN24_TENSORFILE_VERSION 1
+#define CN24_TENSORFILE_DTYPE_FLOAT32 1
+// Samples, maps, rows, columns, see Tensor.h
+#define CN24_TENSORFILE_LAYOUT_SMHW 1
+
+namespace Conv {
+
+struct TensorFileEntry {
+  std::uint64_t offset;
+  std::uint64_t samples, width, height, maps;
+};
+
+class TensorFile {
+public:
+  /**
+   * @brief Alignment of the tensor data written by TensorFileWriter
+   */
+  static const std::uint64_t alignment = 4096;
+
+  /**
+   * @brief Opens a file and reads its directory
+   */
+  explicit TensorFile(const std::string& path);
+  ~TensorFile();
+
+  bool IsValid() const { return valid_; }
+
+  /**
+   * @brief Returns true if the file is in the aligned format
+   */
+  bool IsAligned() const { return aligned_; }
+
+  unsigned int GetTensorCount() const { return (unsigned int)entries_.size(); }
+  const TensorFileEntry& GetEntry(unsigned int index) const { return entries_[index]; }
+
+  /**
+   * @brief Loads a tensor, memory mapping it if possible
+   *
+   * Mapped Tensors are private copies, writing to them does not change
+   * the file. They stay valid after the TensorFile is destroyed.
+   *
+   * @param try_mmap Set to false to always read the data
+   */
+  bool Load(unsigned int index, Tensor& target, bool try_mmap = true);
+
+private:
+  bool ReadDirectory();
+  bool ScanLegacy();
+
+  std::ifstream input_;
+  int file_descriptor_ = 0;
+  std::vector<TensorFileEntry> entries_;
+  bool valid_ = false;
+  bool aligned_ = false;
+};
+
+/**
+ * @brief Writes Tensors to a stream in the aligned format
+ *
+ * The stream has to be seekable because Finish() completes the header.
+ *  The header and all offsets in it are counted from the beginning of the
+ *  stream, so the writer has to start at position 0.
+ */
+class TensorFileWriter {
+public:
+  explicit TensorFileWriter(std::ostream& output);
+
+  bool Write(Tensor& tensor);
+
+  /**
+   * @brief Writes the directory, the file is incomplete without it
+   *
+   * @returns False if writing failed or the writer did not start at the
+   *   beginning of the stream
+   */
+  bool Finish();
+
+private:
+  std::ostream& output_;
+  bool at_start_ = false;
+  std::uint64_t position_ = 0;
+  std::vector<TensorFileEntry> entries_;
+};
+
+}
+
+#endif
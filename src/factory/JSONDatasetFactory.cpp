@@ -7,12 +7,28 @@
 
 #include "Dataset.h"
 #include "MNISTDataset.h"
+#include "SyntheticDataset.h"
 
 #include "JSONDatasetFactory.h"
 
 namespace Conv {
 Dataset* JSONDatasetFactory::ConstructDataset(JSON descriptor, ClassManager* class_manager) {
-  if(descriptor.count("task") == 1) {
+  // Special datasets may have a task, too
+  if(descriptor.count("special") == 1) {
+    std::string special_dataset = descriptor["special"];
+    if(special_dataset.compare("MNIST") == 0) {
+      MNISTDataset* mnist_dataset = new MNISTDataset(class_manager);
+      mnist_dataset->Load(descriptor);
+      return mnist_dataset;
+    } else if(special_dataset.compare("synthetic") == 0) {
+      SyntheticDataset* synthetic_dataset = new SyntheticDataset(class_manager);
+      synthetic_dataset->Load(descriptor);
+      return synthetic_dataset;
+    } else {
+      FATAL("Unknown special dataset: " << special_dataset);
+      return nullptr;
+    }
+  } else if(descriptor.count("task") == 1) {
     std::string task = descriptor["task"];
     if(task.compare("segmentation") == 0) {
       JSONSegmentationDataset* segmentation_dataset = new JSONSegmentationDataset(class_manager);
@@ -29,16 +45,6 @@ Dataset* JSONDatasetFactory::ConstructDataset(JSON descriptor, ClassManager* cla
       FATAL("Invalid task: " << task);
       return nullptr;
     }
-  } else if(descriptor.count("special") == 1) {
-    std::string special_dataset = descriptor["special"];
-    if(special_dataset.compare("MNIST") == 0) {
-      MNISTDataset* mnist_dataset = new MNISTDataset(class_manager);
-      mnist_dataset->Load(descriptor);
-      return mnist_dataset;
-    } else {
-      FATAL("Unknown special dataset: " << special_dataset);
-      return nullptr;
-    }
   } else {
     FATAL("Not a valid dataset (no task or special dataset)");
     return nullptr;
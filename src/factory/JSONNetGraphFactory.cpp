@@ -13,6 +13,7 @@
 #include "../net/DummyErrorLayer.h"
 #include "../net/ErrorLayer.h"
 #include "../net/YOLOLossLayer.h"
+#include "../net/SoftmaxCrossEntropyLayer.h"
 #include "../net/YOLODynamicOutputLayer.h"
 
 #include "NetGraph.h"
@@ -202,6 +203,13 @@ bool JSONNetGraphFactory::AddLayers(NetGraph &graph, ClassManager* class_manager
         error_node->input_connections.push_back(NetGraphConnection(dataset_input_node, 3, false));
         error_node->unique_name = "loss_" + output_node_name;
         graph.AddNode(error_node);
+      } else if (error_layer.compare("softmax_cross_entropy") == 0) {
+        SoftmaxCrossEntropyLayer *error_layer = new SoftmaxCrossEntropyLayer();
+        NetGraphNode *error_node = new NetGraphNode(error_layer, NetGraphConnection(output_node, 0, true));
+        error_node->input_connections.push_back(NetGraphConnection(dataset_input_node, 1, false));
+        error_node->input_connections.push_back(NetGraphConnection(dataset_input_node, 3, false));
+        error_node->unique_name = "loss_" + output_node_name;
+        graph.AddNode(error_node);
       } else if (error_layer.compare("yolo") == 0) {
         if(net_json_.count("yolo_configuration") != 1 || !net_json_["yolo_configuration"].is_object()) {
           LOGERROR << "Missing YOLO configuration!";
@@ -225,6 +233,14 @@ bool JSONNetGraphFactory::AddLayers(NetGraph &graph, ClassManager* class_manager
     }
   }
 
+  // Element-wise chains are fused unless the net asks otherwise
+  if(net_json_.count("fuse_elementwise") == 1 && net_json_["fuse_elementwise"].is_boolean())
+    graph.SetFusionEnabled(net_json_["fuse_elementwise"]);
+
+  // Parameters are only moved into an arena if the net asks for it
+  if(net_json_.count("parameter_arena") == 1 && net_json_["parameter_arena"].is_boolean())
+    graph.SetParameterArenaEnabled(net_json_["parameter_arena"]);
+
   graph.Initialize();
   return graph.IsComplete();
 }
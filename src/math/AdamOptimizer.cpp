@@ -31,23 +31,33 @@ void AdamOptimizer::Step(std::vector<Tensor> &buffers, CombinedTensor* parameter
 
   // Do not use the reported iteration, it doesn't reset!
   const float actual_iteration = iterations_since_reset_ + 1;
-  Tensor& first_moment = buffers[0];
-  Tensor& second_moment = buffers[1];
 
+  // The bias corrections and the choice of update only depend on the
+  // iteration, so they are the same for every element
+  const datum first_correction = actual_iteration > 500 ? (Conv::datum)1.0 :
+    (Conv::datum)1.0 - (Conv::datum)pow(beta1_, actual_iteration);
+  const datum second_correction = actual_iteration > 50000 ? (Conv::datum)1.0 :
+    (Conv::datum)1.0 - (Conv::datum)pow(beta2_, actual_iteration);
+  const bool use_moments = actual_iteration > 2;
+  const datum beta1 = beta1_, beta2 = beta2_, epsilon = epsilon_;
 
+  datum* first_moment = buffers[0].data_ptr();
+  datum* second_moment = buffers[1].data_ptr();
+  datum* data = parameters->data.data_ptr();
+  const datum* delta = parameters->delta.data_ptr_const();
+
+  // Split by elements, so that one large tensor uses all threads
+#pragma omp parallel for default(shared)
   for(std::size_t p = 0; p < parameters->data.elements(); p++) {
-    const datum g_t = parameters->delta(p);
-    const datum m_t = beta1_ * first_moment(p) + ((Conv::datum)1.0 - beta1_) * g_t;
-    const datum v_t = beta2_ * second_moment(p) + ((Conv::datum)1.0 - beta2_) * g_t * g_t;
+    const datum g_t = delta[p];
+    const datum m_t = beta1 * first_moment[p] + ((Conv::datum)1.0 - beta1) * g_t;
+    const datum v_t = beta2 * second_moment[p] + ((Conv::datum)1.0 - beta2) * g_t * g_t;
+
+    const datum m_hat_t = m_t / first_correction;
+    const datum v_hat_t = v_t / second_correction;
 
-    const datum m_hat_t = actual_iteration > 500 ? m_t : m_t / ((Conv::datum)1.0 - (Conv::datum)pow(beta1_, actual_iteration));
-    const datum v_hat_t = actual_iteration > 50000 ? v_t : v_t / ((Conv::datum)1.0 - (Conv::datum)pow(beta2_, actual_iteration));
+    data[p] -= use_moments ? current_step_size * (m_hat_t / (sqrtf(v_hat_t) + epsilon)) : current_step_size * g_t;
 
-    if(actual_iteration > 2) {
-      parameters->data[p] = parameters->data(p) - current_step_size * (m_hat_t / (sqrtf(v_hat_t) + epsilon_));
-    } else {
-      parameters->data[p] = parameters->data(p) - current_step_size * g_t;
-    }
     // Save moments
     first_moment[p] = m_t;
     second_moment[p] = v_t;
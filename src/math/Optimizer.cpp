@@ -83,7 +83,8 @@ void Optimizer::Step(const std::vector<CombinedTensor *> &parameters, unsigned i
   }
 #endif
 
-#pragma omp parallel for default(shared)
+  // The inner steps are parallel over the elements. Splitting the work by
+  // tensor balances badly when one tensor holds most of the parameters.
   for(unsigned int p = 0; p < parameters.size(); p++) {
     // Call inner step
     Step(buffers_[p], parameters[p], iteration);
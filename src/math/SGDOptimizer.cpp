@@ -22,11 +22,18 @@ void SGDOptimizer::Step(std::vector<Tensor> &buffers, CombinedTensor* parameters
   const datum current_learning_rate =
       learning_rate_ * (datum)pow(1.0 + learning_rate_gamma_ * (datum)iteration, learning_rate_exponent_);
 
-  Tensor& momentum_buffer = buffers[0];
+  const datum momentum = momentum_;
+
+  datum* momentum_buffer = buffers[0].data_ptr();
+  datum* data = parameters->data.data_ptr();
+  const datum* delta = parameters->delta.data_ptr_const();
+
+  // Split by elements, so that one large tensor uses all threads
+#pragma omp parallel for default(shared)
   for(std::size_t p = 0; p < parameters->data.elements(); p++) {
-    const datum last_step = momentum_buffer(p);
-    const datum this_step = current_learning_rate * parameters->delta(p) + momentum_ * last_step;
-    parameters->data[p] -= this_step;
+    const datum last_step = momentum_buffer[p];
+    const datum this_step = current_learning_rate * delta[p] + momentum * last_step;
+    data[p] -= this_step;
     momentum_buffer[p] = this_step;
   }
 }
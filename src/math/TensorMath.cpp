@@ -9,6 +9,7 @@
 #include "CLHelper.h"
 
 #include <cstring>
+#include <limits>
 
 #include "TensorMath.h"
 
@@ -620,4 +621,101 @@ void TensorMath::ADD(const Tensor& source_a, const Tensor& source_b, Tensor& tar
 }
 
 
+namespace {
+// Pools one map, row by row. For every row of the window the loop over
+// the output columns is innermost, so it runs along memory and can be
+// vectorised. The window dimensions are compile time constants in the
+// specialised instances below.
+inline void MaxPoolMap(const datum* source, datum* target, std::int32_t* argmax,
+  const int source_width, const int target_width, const int target_height,
+  const int region_width, const int region_height, const int stride_width, const int stride_height) {
+  for(int target_y = 0; target_y < target_height; target_y++) {
+    datum* target_row = target + target_y * target_width;
+    std::int32_t* argmax_row = argmax + target_y * target_width;
+    for(int target_x = 0; target_x < target_width; target_x++) {
+      target_row[target_x] = std::numeric_limits<datum>::lowest();
+      argmax_row[target_x] = target_y * stride_height * source_width + target_x * stride_width;
+    }
+
+    for(int ry = 0; ry < region_height; ry++) {
+      const int source_y = target_y * stride_height + ry;
+      const datum* source_row = source + source_y * source_width;
+      for(int rx = 0; rx < region_width; rx++) {
+        for(int target_x = 0; target_x < target_width; target_x++) {
+          const int source_x = target_x * stride_width + rx;
+          const datum value = source_row[source_x];
+          const bool greater = value > target_row[target_x];
+          target_row[target_x] = greater ? value : target_row[target_x];
+          argmax_row[target_x] = greater ? (std::int32_t)(source_y * source_width + source_x) : argmax_row[target_x];
+        }
+      }
+    }
+  }
+}
+
+template <int RW, int RH, int SW, int SH>
+void MaxPoolMapFixed(const datum* source, datum* target, std::int32_t* argmax,
+  const int source_width, const int target_width, const int target_height) {
+  MaxPoolMap(source, target, argmax, source_width, target_width, target_height, RW, RH, SW, SH);
+}
+}
+
+void TensorMath::MAXPOOL(const Tensor& source, Tensor& target, std::int32_t* argmax, const int region_width, const int region_height, const int stride_width, const int stride_height)
+{
+#ifdef BUILD_OPENCL
+  ((Tensor&)source).MoveToCPU();
+  target.MoveToCPU(true);
+#endif
+  const int source_width = (int)source.width();
+  const int target_width = (int)target.width();
+  const int target_height = (int)target.height();
+  const int source_plane = source_width * (int)source.height();
+  const int target_plane = target_width * target_height;
+  const int planes = (int)(target.maps() * target.samples());
+
+  const bool is_2x2_2 = region_width == 2 && region_height == 2 && stride_width == 2 && stride_height == 2;
+  const bool is_3x3_2 = region_width == 3 && region_height == 3 && stride_width == 2 && stride_height == 2;
+
+#pragma omp parallel for default(shared)
+  for(int plane = 0; plane < planes; plane++) {
+    const datum* src = source.data_ptr_const() + (std::size_t)plane * source_plane;
+    datum* tgt = target.data_ptr() + (std::size_t)plane * target_plane;
+    std::int32_t* arg = argmax + (std::size_t)plane * target_plane;
+    if(is_2x2_2)
+      MaxPoolMapFixed<2, 2, 2, 2>(src, tgt, arg, source_width, target_width, target_height);
+    else if(is_3x3_2)
+      MaxPoolMapFixed<3, 3, 2, 2>(src, tgt, arg, source_width, target_width, target_height);
+    else
+      MaxPoolMap(src, tgt, arg, source_width, target_width, target_height,
+                 region_width, region_height, stride_width, stride_height);
+  }
+
+  target.hint_ignore_content_ = false;
+}
+
+void TensorMath::MAXPOOLBACKWARD(Tensor& source_delta, const Tensor& target_delta, const std::int32_t* argmax)
+{
+#ifdef BUILD_OPENCL
+  source_delta.MoveToCPU(true);
+  ((Tensor&)target_delta).MoveToCPU();
+#endif
+  const int source_plane = (int)(source_delta.width() * source_delta.height());
+  const int target_plane = (int)(target_delta.width() * target_delta.height());
+  const int planes = (int)(target_delta.maps() * target_delta.samples());
+
+  // Each map is handled by one thread, so overlapping windows can simply
+  // accumulate
+#pragma omp parallel for default(shared)
+  for(int plane = 0; plane < planes; plane++) {
+    datum* src = source_delta.data_ptr() + (std::size_t)plane * source_plane;
+    const datum* tgt = target_delta.data_ptr_const() + (std::size_t)plane * target_plane;
+    const std::int32_t* arg = argmax + (std::size_t)plane * target_plane;
+    std::memset(src, 0, sizeof(datum) * source_plane);
+    for(int e = 0; e < target_plane; e++)
+      src[arg[e]] += tgt[e];
+  }
+
+  source_delta.hint_ignore_content_ = false;
+}
+
 }
@@ -9,6 +9,7 @@
 #include "Log.h"
 #include "CLHelper.h"
 #include "AdvancedMaxPoolingLayer.h"
+#include "TensorMath.h"
 #include "ConfigParsing.h"
 
 #ifdef BUILD_OPENCL
@@ -102,12 +103,31 @@ bool AdvancedMaxPoolingLayer::Connect (const CombinedTensor* input,
 
   maps_ = input->data.maps();
 
+#ifdef BUILD_OPENCL_MAX
   maximum_mask_.Resize (input->data.samples(), output_width_,
 			output_height_, maps_);
+#else
+  maximum_index_.resize (input->data.samples() * output_width_ *
+                         output_height_ * maps_);
+#endif
 
   return true;
 }
 
+bool AdvancedMaxPoolingLayer::Reshape (const CombinedTensor* input,
+                                       CombinedTensor* output) {
+  const int output_width = ((int)input->data.width() - (int)region_width_ ) / (int)stride_width_ + 1;
+  const int output_height = ((int)input->data.height() - (int)region_height_) / (int)stride_height_ + 1;
+  if (output_width <= 0 || output_height <= 0) {
+    LOGERROR << "Unsupported input dimensions " << input->data;
+    return false;
+  }
+
+  output->Resize (input->data.samples(), output_width, output_height,
+                  input->data.maps());
+  return Connect (input, output);
+}
+
 void AdvancedMaxPoolingLayer::FeedForward() {
 #ifdef BUILD_OPENCL_MAX
   input_->data.MoveToGPU();
@@ -147,38 +167,9 @@ void AdvancedMaxPoolingLayer::FeedForward() {
 #endif
 
 #else
-#pragma omp parallel for default(shared)
-  for (std::size_t sample = 0; sample < input_->data.samples(); sample++) {
-    for (unsigned int map = 0; map < maps_; map++) {
-      for (unsigned int ox = 0; ox < output_width_; ox++) {
-        for (unsigned int oy = 0; oy < output_height_; oy++) {
-          // Find maximum in region
-          datum maximum = std::numeric_limits<datum>::lowest();
-          unsigned int mix = 0;
-          unsigned int miy = 0;
-          for (unsigned int iy = oy * stride_height_;
-                iy < (oy * stride_height_) + region_height_; iy++) {
-            for (unsigned int ix = ox * stride_width_;
-                ix < (ox * stride_width_) + region_width_; ix++) {
-              const datum ival =
-                *input_->data.data_ptr_const (ix, iy, map, sample);
-              if (ival > maximum) {
-                maximum = ival;
-                mix = ix;
-                miy = iy;
-              }
-            }
-          }
-          
-          // Found maximum, save
-          *maximum_mask_.data_ptr(ox, oy, map, sample) = input_width_ * miy + mix;
-          
-          // Feed forward
-          *output_->data.data_ptr(ox, oy, map, sample) = maximum;
-        }
-      }
-    }
-  }
+  TensorMath::MAXPOOL(input_->data, output_->data, &maximum_index_[0],
+                      (int)region_width_, (int)region_height_,
+                      (int)stride_width_, (int)stride_height_);
 #endif
 }
 
@@ -221,35 +212,7 @@ void AdvancedMaxPoolingLayer::BackPropagate() {
 #endif
 
 #else
-  
-#define MP_HELPER_MIN(X, Y) (((X) < (Y)) ? (X) : (Y))
-  
-#pragma omp parallel for default(shared)
-  for(std::size_t sample = 0; sample < input_->data.samples(); sample++) {
-    for (unsigned int map = 0; map < maps_; map++) {
-      for (unsigned int ix = 0; ix < input_width_; ix++) {
-        for(unsigned int iy = 0; iy < input_height_; iy++) {
-          const unsigned int mask_index = ix + input_width_ * iy;
-          const unsigned int oxstart = (ix < region_width_) ? 
-            0 : (ix - region_width_) / stride_width_+ 1;
-          const unsigned int oxend = MP_HELPER_MIN(ix / stride_width_ + 1, output_width_);
-          
-          const unsigned int oystart = (iy < region_height_) ? 
-            0 : (iy - region_height_) / stride_height_ + 1;
-          const unsigned int oyend = MP_HELPER_MIN(iy / stride_height_ + 1, output_height_);
-          
-          datum sum = 0.0;
-          for (unsigned int oy = oystart; oy < oyend; oy++) {
-            for (unsigned int ox = oxstart; ox < oxend; ox++) {
-              if(*maximum_mask_.data_ptr_const(ox, oy, map, sample) == mask_index)
-                sum += *output_->delta.data_ptr_const(ox, oy, map, sample);
-            }
-          }
-          *(input_->delta.data_ptr(ix, iy, map, sample)) = sum;
-        }
-      }
-    }
-  }
+  TensorMath::MAXPOOLBACKWARD(input_->delta, output_->delta, &maximum_index_[0]);
 #endif
 }
 
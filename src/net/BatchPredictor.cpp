@@ -0,0 +1,421 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+
+#include "Log.h"
+#include "PNGUtil.h"
+#include "JPGUtil.h"
+
+#include "BatchPredictor.h"
+
+namespace Conv {
+
+static bool HasSuffix(const std::string& text, const std::string& suffix) {
+  return text.length() >= suffix.length() && text.compare(text.length() - suffix.length(), suffix.length(), suffix) == 0;
+}
+
+BatchPredictor::BatchPredictor(JSONNetGraphFactory* factory, Dataset* dataset, ClassManager* class_manager,
+  unsigned int batch_size, unsigned int width, unsigned int height) : dataset_(dataset) {
+  task_ = dataset->GetTask();
+  if(batch_size == 0)
+    batch_size = 1;
+
+  // Datasets without data don't know their input maps, assume RGB images
+  const unsigned int maps = dataset->GetInputMaps() > 0 ? dataset->GetInputMaps() : 3;
+
+  if(task_ == SEMANTIC_SEGMENTATION) {
+    width = ((width + stride - 1) / stride) * stride;
+    height = ((height + stride - 1) / stride) * stride;
+    if(width == 0 || height == 0)
+      FATAL("Segmentation needs a maximum image size!");
+    data_tensor_.Resize(batch_size, width, height, maps);
+    helper_tensor_.Resize(batch_size, width, height, 2);
+    data_tensor_.Clear();
+    helper_tensor_.Clear();
+    input_layer_ = new InputLayer(data_tensor_, helper_tensor_);
+  } else {
+    data_tensor_.Resize(batch_size, dataset->GetWidth(), dataset->GetHeight(), maps);
+    data_tensor_.Clear();
+    input_layer_ = new InputLayer(data_tensor_);
+  }
+
+  input_node_ = new NetGraphNode(input_layer_);
+  input_node_->is_input = true;
+  graph_.AddNode(input_node_);
+
+  complete_ = factory->AddLayers(graph_, class_manager);
+  if(!complete_) {
+    LOGERROR << "Failed completeness check, inspect model!";
+    return;
+  }
+
+  graph_.Initialize();
+  graph_.SetIsTesting(true);
+}
+
+BatchPredictor::~BatchPredictor() {
+  delete input_node_;
+  delete input_layer_;
+}
+
+bool BatchPredictor::LoadParameters(const std::string& path) {
+  if(!complete_)
+    return false;
+  parameters_loaded_ = graph_.LoadParameters(path);
+  return parameters_loaded_;
+}
+
+bool BatchPredictor::ShareParameters(BatchPredictor& source) {
+  if(!complete_ || !source.IsReady() || source.task_ != task_)
+    return false;
+  parameters_loaded_ = graph_.ShareParameters(source.graph_);
+  return parameters_loaded_;
+}
+
+bool BatchPredictor::Reshape(unsigned int batch_size, unsigned int width, unsigned int height) {
+  if(!complete_ || batch_size == 0)
+    return false;
+
+  if(task_ == SEMANTIC_SEGMENTATION) {
+    width = ((width + stride - 1) / stride) * stride;
+    height = ((height + stride - 1) / stride) * stride;
+    if(width == 0 || height == 0)
+      return false;
+  } else {
+    // The input size is fixed by the dataset
+    width = 0;
+    height = 0;
+  }
+
+  // The input layer resizes our Tensors, they only need to be cleared
+  if(!graph_.Reshape(batch_size, width, height))
+    return false;
+
+  data_tensor_.Clear();
+  if(task_ == SEMANTIC_SEGMENTATION)
+    helper_tensor_.Clear();
+  colorized_ = false;
+  return true;
+}
+
+bool BatchPredictor::SetSample(unsigned int sample, Tensor& image) {
+  if(sample >= data_tensor_.samples() || image.maps() != data_tensor_.maps() || image.elements() == 0)
+    return false;
+
+#ifdef BUILD_OPENCL
+  data_tensor_.MoveToCPU();
+  image.MoveToCPU();
+#endif
+
+  if(task_ == SEMANTIC_SEGMENTATION) {
+    const unsigned int original_width = image.width();
+    const unsigned int original_height = image.height();
+    if(original_width > data_tensor_.width() || original_height > data_tensor_.height())
+      return false;
+
+#ifdef BUILD_OPENCL
+    helper_tensor_.MoveToCPU();
+#endif
+    // The padding stays zero, like the spatial prior outside of the image
+    ClearSample(sample);
+    Tensor::CopySample(image, 0, data_tensor_, sample);
+    for(unsigned int y = 0; y < original_height; y++) {
+      for(unsigned int x = 0; x < original_width; x++) {
+        *helper_tensor_.data_ptr(x, y, 0, sample) = ((datum) x) / ((datum) original_width - 1);
+        *helper_tensor_.data_ptr(x, y, 1, sample) = ((datum) y) / ((datum) original_height - 1);
+      }
+    }
+  } else {
+    Tensor::CopySample(image, 0, data_tensor_, sample, false, true);
+
+    // Map pixel values to [-1,1]
+    const std::size_t sample_elements = data_tensor_.width() * data_tensor_.height() * data_tensor_.maps();
+    datum* sample_data = data_tensor_.data_ptr(0, 0, 0, sample);
+    for(std::size_t e = 0; e < sample_elements; e++)
+      sample_data[e] = sample_data[e] * 2.0f - 1.0f;
+  }
+  return true;
+}
+
+void BatchPredictor::ClearSample(unsigned int sample) {
+#ifdef BUILD_OPENCL
+  data_tensor_.MoveToCPU();
+#endif
+  const std::size_t sample_elements = data_tensor_.width() * data_tensor_.height() * data_tensor_.maps();
+  std::fill(data_tensor_.data_ptr(0, 0, 0, sample), data_tensor_.data_ptr(0, 0, 0, sample) + sample_elements, 0);
+
+  if(task_ == SEMANTIC_SEGMENTATION) {
+#ifdef BUILD_OPENCL
+    helper_tensor_.MoveToCPU();
+#endif
+    const std::size_t helper_elements = helper_tensor_.width() * helper_tensor_.height() * helper_tensor_.maps();
+    std::fill(helper_tensor_.data_ptr(0, 0, 0, sample), helper_tensor_.data_ptr(0, 0, 0, sample) + helper_elements, 0);
+  }
+}
+
+void BatchPredictor::Predict() {
+  graph_.FeedForward();
+  colorized_ = false;
+}
+
+void BatchPredictor::GetDetections(unsigned int sample, unsigned int original_width, unsigned int original_height,
+  std::vector<BoundingBox>& boxes) {
+  boxes.clear();
+  CombinedTensor* output = graph_.GetDefaultOutputNode()->output_buffers[0].combined_tensor;
+  if(task_ != DETECTION || output->metadata == nullptr || sample >= output->data.samples())
+    return;
+
+  std::vector<BoundingBox>* sample_boxes = (std::vector<BoundingBox>*)output->metadata[sample];
+  for(BoundingBox box : *sample_boxes) {
+    box.x *= (datum)original_width;
+    box.y *= (datum)original_height;
+    box.w *= (datum)original_width;
+    box.h *= (datum)original_height;
+    boxes.push_back(box);
+  }
+}
+
+unsigned int BatchPredictor::GetClass(unsigned int sample, datum& score) {
+  Tensor& output = graph_.GetDefaultOutputNode()->output_buffers[0].combined_tensor->data;
+#ifdef BUILD_OPENCL
+  output.MoveToCPU();
+#endif
+  const std::size_t sample_elements = output.width() * output.height() * output.maps();
+  const datum* scores = output.data_ptr_const(0, 0, 0, sample);
+  unsigned int best_class = 0;
+  for(unsigned int c = 1; c < sample_elements; c++) {
+    if(scores[c] > scores[best_class])
+      best_class = c;
+  }
+  score = scores[best_class];
+  return best_class;
+}
+
+void BatchPredictor::GetSegmentation(unsigned int sample, unsigned int original_width, unsigned int original_height,
+  Tensor& image) {
+  Tensor& output = graph_.GetDefaultOutputNode()->output_buffers[0].combined_tensor->data;
+
+  // Colorize the whole batch once
+  if(!colorized_) {
+    colorized_tensor_.Resize(output.samples(), output.width(), output.height(), 3);
+    dataset_->Colorize(output, colorized_tensor_);
+    colorized_ = true;
+  }
+
+  if(original_width > colorized_tensor_.width())
+    original_width = colorized_tensor_.width();
+  if(original_height > colorized_tensor_.height())
+    original_height = colorized_tensor_.height();
+
+  image.Resize(1, original_width, original_height, 3);
+  for(unsigned int m = 0; m < 3; m++)
+    for(unsigned int y = 0; y < original_height; y++)
+      for(unsigned int x = 0; x < original_width; x++)
+        *image.data_ptr(x, y, m, 0) = *colorized_tensor_.data_ptr_const(x, y, m, sample);
+}
+
+void BatchPredictor::SetTile(unsigned int sample, Tensor& image, int tile_x, int tile_y) {
+  ClearSample(sample);
+#ifdef BUILD_OPENCL
+  image.MoveToCPU();
+#endif
+
+  // The spatial prior is relative to the whole image
+  const int image_width = (int)image.width(), image_height = (int)image.height();
+  for(int y = 0; y < (int)data_tensor_.height(); y++) {
+    const int image_y = tile_y + y;
+    if(image_y < 0 || image_y >= image_height)
+      continue;
+    for(int x = 0; x < (int)data_tensor_.width(); x++) {
+      const int image_x = tile_x + x;
+      if(image_x < 0 || image_x >= image_width)
+        continue;
+      for(unsigned int m = 0; m < data_tensor_.maps(); m++)
+        *data_tensor_.data_ptr(x, y, m, sample) = *image.data_ptr_const(image_x, image_y, m, 0);
+      *helper_tensor_.data_ptr(x, y, 0, sample) = ((datum) image_x) / ((datum) image_width - 1);
+      *helper_tensor_.data_ptr(x, y, 1, sample) = ((datum) image_y) / ((datum) image_height - 1);
+    }
+  }
+}
+
+bool BatchPredictor::PredictTiled(Tensor& image, Tensor& output, unsigned int overlap) {
+  if(task_ != SEMANTIC_SEGMENTATION || image.maps() != data_tensor_.maps() || image.elements() == 0)
+    return false;
+
+  // Tiles have to start on the network's downsampling grid, or pooling
+  // would see different windows than in the whole image. The tile size is
+  // already a multiple of the stride.
+  overlap = ((overlap + stride - 1) / stride) * stride;
+  const unsigned int tile_width = data_tensor_.width(), tile_height = data_tensor_.height();
+  if(2 * overlap >= tile_width || 2 * overlap >= tile_height) {
+    LOGERROR << "Overlap of " << overlap << " is too large for " << tile_width << "x" << tile_height << " tiles";
+    return false;
+  }
+
+  Tensor& net_output = graph_.GetDefaultOutputNode()->output_buffers[0].combined_tensor->data;
+  if(net_output.width() != tile_width || net_output.height() != tile_height) {
+    LOGERROR << "Tiled prediction needs the network output at input resolution";
+    return false;
+  }
+
+  // Only the inner part of each tile is needed to cover the image
+  const unsigned int image_width = image.width(), image_height = image.height();
+  const unsigned int step_x = tile_width - 2 * overlap, step_y = tile_height - 2 * overlap;
+  std::vector<std::pair<int, int>> tiles;
+  for(unsigned int tile_y = 0; tile_y < image_height; tile_y += step_y)
+    for(unsigned int tile_x = 0; tile_x < image_width; tile_x += step_x)
+      tiles.push_back(std::make_pair((int)tile_x - (int)overlap, (int)tile_y - (int)overlap));
+
+  // Outputs in the outer half of the overlap see the tile's padding and are
+  // ignored, the inner half is blended linearly with the neighboring tile
+  const unsigned int ignored = overlap / 2, blended = overlap - ignored;
+  auto border_weight = [ignored, blended](unsigned int distance) {
+    if(distance < ignored)
+      return (datum)0;
+    return blended > 0 ? (datum)std::min(distance - ignored + 1, blended) / (datum)blended : (datum)1;
+  };
+  std::vector<datum> weight_x(tile_width), weight_y(tile_height);
+  for(unsigned int x = 0; x < tile_width; x++)
+    weight_x[x] = border_weight(std::min(x, tile_width - 1 - x));
+  for(unsigned int y = 0; y < tile_height; y++)
+    weight_y[y] = border_weight(std::min(y, tile_height - 1 - y));
+
+  output.Resize(1, image_width, image_height, net_output.maps());
+  output.Clear();
+  Tensor weight_sum(1, image_width, image_height, 1);
+  weight_sum.Clear();
+
+  for(unsigned int first_tile = 0; first_tile < tiles.size(); first_tile += GetBatchSize()) {
+    const unsigned int tile_count = std::min(GetBatchSize(), (unsigned int)tiles.size() - first_tile);
+    for(unsigned int sample = 0; sample < GetBatchSize(); sample++) {
+      if(sample < tile_count)
+        SetTile(sample, image, tiles[first_tile + sample].first, tiles[first_tile + sample].second);
+      else
+        ClearSample(sample);
+    }
+
+    Predict();
+#ifdef BUILD_OPENCL
+    net_output.MoveToCPU();
+#endif
+
+    for(unsigned int sample = 0; sample < tile_count; sample++) {
+      const int tile_x = tiles[first_tile + sample].first, tile_y = tiles[first_tile + sample].second;
+#pragma omp parallel for default(shared)
+      for(int y = 0; y < (int)tile_height; y++) {
+        const int image_y = tile_y + y;
+        if(image_y < 0 || image_y >= (int)image_height)
+          continue;
+        for(int x = 0; x < (int)tile_width; x++) {
+          const int image_x = tile_x + x;
+          if(image_x < 0 || image_x >= (int)image_width)
+            continue;
+          const datum weight = weight_x[x] * weight_y[y];
+          for(unsigned int m = 0; m < net_output.maps(); m++)
+            *output.data_ptr(image_x, image_y, m, 0) += weight * *net_output.data_ptr_const(x, y, m, sample);
+          *weight_sum.data_ptr(image_x, image_y, 0, 0) += weight;
+        }
+      }
+    }
+  }
+
+#pragma omp parallel for default(shared)
+  for(int y = 0; y < (int)image_height; y++) {
+    for(unsigned int x = 0; x < image_width; x++) {
+      const datum weight = *weight_sum.data_ptr_const(x, y, 0, 0);
+      for(unsigned int m = 0; m < output.maps(); m++)
+        *output.data_ptr(x, y, m, 0) /= weight;
+    }
+  }
+  return true;
+}
+
+unsigned int BatchPredictor::EstimateReceptiveField() {
+  if(task_ != SEMANTIC_SEGMENTATION)
+    return 0;
+
+  Tensor& net_output = graph_.GetDefaultOutputNode()->output_buffers[0].combined_tensor->data;
+  for(unsigned int sample = 0; sample < GetBatchSize(); sample++)
+    ClearSample(sample);
+  Predict();
+#ifdef BUILD_OPENCL
+  net_output.MoveToCPU();
+#endif
+  Tensor blank_output(1, net_output.width(), net_output.height(), net_output.maps());
+  Tensor::CopySample(net_output, 0, blank_output, 0);
+
+  // Change the center pixel and find the outputs that change with it
+  const unsigned int center_x = data_tensor_.width() / 2, center_y = data_tensor_.height() / 2;
+  for(unsigned int m = 0; m < data_tensor_.maps(); m++)
+    *data_tensor_.data_ptr(center_x, center_y, m, 0) = 1.0;
+  Predict();
+#ifdef BUILD_OPENCL
+  net_output.MoveToCPU();
+#endif
+
+  const unsigned int scale_x = (data_tensor_.width() + net_output.width() - 1) / net_output.width();
+  const unsigned int scale_y = (data_tensor_.height() + net_output.height() - 1) / net_output.height();
+  unsigned int radius = 0;
+  for(unsigned int y = 0; y < net_output.height(); y++) {
+    for(unsigned int x = 0; x < net_output.width(); x++) {
+      for(unsigned int m = 0; m < net_output.maps(); m++) {
+        if(*net_output.data_ptr_const(x, y, m, 0) != *blank_output.data_ptr_const(x, y, m, 0)) {
+          const unsigned int distance_x = (unsigned int)std::abs((int)(x * scale_x) - (int)center_x);
+          const unsigned int distance_y = (unsigned int)std::abs((int)(y * scale_y) - (int)center_y);
+          radius = std::max(radius, std::max(distance_x, distance_y));
+          break;
+        }
+      }
+    }
+  }
+
+  ClearSample(0);
+  return radius;
+}
+
+bool BatchPredictor::LoadImage(const std::string& path, Tensor& image) {
+#ifdef BUILD_PNG
+  if(HasSuffix(path, "png") || HasSuffix(path, "PNG")) {
+    std::ifstream input_image_file(path, std::ios::in | std::ios::binary);
+    if(!input_image_file.good())
+      return false;
+    return PNGUtil::LoadFromStream(input_image_file, image);
+  }
+#endif
+#ifdef BUILD_JPG
+  if(HasSuffix(path, "jpg") || HasSuffix(path, "jpeg") || HasSuffix(path, "JPG") || HasSuffix(path, "JPEG")) {
+    std::ifstream input_image_file(path, std::ios::in | std::ios::binary);
+    if(!input_image_file.good())
+      return false;
+    return JPGUtil::LoadFromFile(path, image);
+  }
+#endif
+  LOGERROR << "Unsupported image format: " << path;
+  return false;
+}
+
+bool BatchPredictor::WriteImage(const std::string& path, Tensor& image) {
+#ifdef BUILD_PNG
+  if(HasSuffix(path, "png") || HasSuffix(path, "PNG")) {
+    std::ofstream output_image_file(path, std::ios::out | std::ios::binary);
+    if(!output_image_file.good())
+      return false;
+    return PNGUtil::WriteToStream(output_image_file, image);
+  }
+#endif
+#ifdef BUILD_JPG
+  if(HasSuffix(path, "jpg") || HasSuffix(path, "jpeg") || HasSuffix(path, "JPG") || HasSuffix(path, "JPEG"))
+    return JPGUtil::WriteToFile(path, image);
+#endif
+  LOGERROR << "Unsupported image format: " << path;
+  return false;
+}
+
+}
@@ -229,6 +229,13 @@ bool BinaryStatLayer::Connect ( const std::vector< CombinedTensor* >& inputs, co
   return valid;
 }
 
+bool BinaryStatLayer::Reshape ( const std::vector< CombinedTensor* >& inputs,
+                                const std::vector< CombinedTensor* >& outputs,
+                                const NetStatus* net ) {
+  std::vector<CombinedTensor*> no_outputs;
+  return CreateOutputs ( inputs, no_outputs ) && Connect ( inputs, outputs, net );
+}
+
 void BinaryStatLayer::FeedForward() {
   if ( disabled_ )
     return;
@@ -95,7 +95,35 @@ bool ConcatenationLayer::Connect (const std::vector< CombinedTensor* >& inputs,
   return true;
 }
 
+bool ConcatenationLayer::Reshape (const std::vector< CombinedTensor* >& inputs,
+                           const std::vector< CombinedTensor* >& outputs,
+                           const NetStatus* status ) {
+  if(inputs.size() != 2 || outputs.size() != 1) {
+    LOGERROR << "Needs two inputs and one output!";
+    return false;
+  }
+
+  CombinedTensor* input_a = inputs[0];
+  CombinedTensor* input_b = inputs[1];
+
+  if(input_a->data.samples() != input_b->data.samples() ||
+    input_a->data.width() != input_b->data.width() ||
+    input_a->data.height() != input_b->data.height()) {
+    LOGERROR << "Dimensions don't match!";
+    return false;
+  }
+
+  // NetGraph turns the inputs into views again if possible
+  outputs[0]->Resize(input_a->data.samples(), input_a->data.width(),
+    input_a->data.height(), input_a->data.maps() + input_b->data.maps());
+  return Connect(inputs, outputs, status);
+}
+
 void ConcatenationLayer::FeedForward() {
+  // Nothing to copy if the inputs were written into the output directly
+  if(IsViewingData())
+    return;
+
 #pragma omp parallel for default(shared)
   for(unsigned int s = 0; s < samples_; s++) {
     for(unsigned int m = 0; m < maps_a_; m++)
@@ -107,6 +135,9 @@ void ConcatenationLayer::FeedForward() {
 }
 
 void ConcatenationLayer::BackPropagate() {
+  if(IsViewingDelta())
+    return;
+
 #pragma omp parallel for default(shared)
   for(unsigned int s = 0; s < samples_; s++) {
     for(unsigned int m = 0; m < maps_a_; m++)
@@ -117,4 +148,43 @@ void ConcatenationLayer::BackPropagate() {
   }
 }
 
+bool ConcatenationLayer::UseViews() {
+  // Samples are the outermost dimension, so the maps of one input are
+  // only contiguous in the output if there is a single sample
+  if(samples_ != 1 || input_a_->is_dynamic || input_b_->is_dynamic || output_->is_dynamic)
+    return false;
+
+  // Don't take the memory of a Tensor that already uses someone else's
+  if(input_a_->data.is_shadow() || input_b_->data.is_shadow()
+    || input_a_->delta.is_shadow() || input_b_->delta.is_shadow())
+    return false;
+
+  const std::size_t offset_b = output_->data.Offset(0, 0, maps_a_, 0);
+  const std::size_t width = output_->data.width(), height = output_->data.height();
+  if(input_a_->data.width() != width || input_a_->data.height() != height
+    || input_b_->data.width() != width || input_b_->data.height() != height)
+    return false;
+
+  // The views keep the inputs' shapes
+  bool success = input_a_->data.View(output_->data, 0, 1, width, height, maps_a_);
+  success &= input_b_->data.View(output_->data, offset_b, 1, width, height, maps_b_);
+  success &= input_a_->delta.View(output_->delta, 0, 1, width, height, maps_a_);
+  success &= input_b_->delta.View(output_->delta, offset_b, 1, width, height, maps_b_);
+
+  return success;
+}
+
+bool ConcatenationLayer::IsViewingData() const {
+  // Checked every time because the inputs may have been resized since
+  return samples_ == 1 && input_a_->data.samples() == 1 && output_->data.samples() == 1 &&
+    input_a_->data.data_ptr_const() == output_->data.data_ptr_const() &&
+    input_b_->data.data_ptr_const() == output_->data.data_ptr_const(0, 0, maps_a_, 0);
+}
+
+bool ConcatenationLayer::IsViewingDelta() const {
+  return samples_ == 1 && input_a_->delta.samples() == 1 && output_->delta.samples() == 1 &&
+    input_a_->delta.data_ptr_const() == output_->delta.data_ptr_const() &&
+    input_b_->delta.data_ptr_const() == output_->delta.data_ptr_const(0, 0, maps_a_, 0);
+}
+
 }
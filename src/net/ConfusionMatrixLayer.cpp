@@ -196,6 +196,13 @@ bool ConfusionMatrixLayer::Connect
   return valid;
 }
 
+bool ConfusionMatrixLayer::Reshape ( const std::vector< CombinedTensor* >& inputs,
+                                     const std::vector< CombinedTensor* >& outputs,
+                                     const NetStatus* net ) {
+  std::vector<CombinedTensor*> no_outputs;
+  return CreateOutputs ( inputs, no_outputs ) && Connect ( inputs, outputs, net );
+}
+
 void ConfusionMatrixLayer::FeedForward() {
   if ( disabled_ )
     return;
@@ -192,23 +192,7 @@ bool ConvolutionLayer::Connect (const CombinedTensor* input,
 
   LOGDEBUG << "Local learning rate is now " << local_lr_;
   
-  // Create im2col output buffer
-  im2col_ff_buffer.Resize (kernel_width_ * kernel_height_ * input_maps_, output_width_,
-                           output_height_, input->data.samples());
-  
-  sms_ff_buffer.Resize(output_maps_, output_width_, output_height_, input->data.samples());
-  
-  sms2_bp_buffer.Resize(output_maps_, output_width_, output_height_, input->data.samples());
-
-  bp_deltax_buffer.Resize (kernel_width_ * kernel_height_ * input_maps_, output_width_,
-                           output_height_, input->data.samples());
-
-  // This is faster than adding manually...
-  ones_.Resize (1, output_width_ * output_height_ * input->data.samples());
-
-  for (unsigned int i = 0; i < ones_.elements(); i++) {
-    ones_[i] = 1;
-  }
+  ResizeBuffers(input->data.samples());
 
   // Create kernels
   weights_ = new CombinedTensor (output_maps_, kernel_width_, kernel_height_, input_maps_ / group_);
@@ -218,9 +202,6 @@ bool ConvolutionLayer::Connect (const CombinedTensor* input,
   // is not called. Random memory junk may work but is certainly not optimal.
   bias_->data.Clear();
   weights_->data.Clear();
-  
-  // Initialize the dropout mask tensor
-  dropout_mask_.Resize(input->data.samples(),output_maps_);
 
   // Tell the net about our parameters
   parameters_.push_back (weights_);
@@ -229,6 +210,56 @@ bool ConvolutionLayer::Connect (const CombinedTensor* input,
   return true;
 }
 
+bool ConvolutionLayer::Reshape (const CombinedTensor* input,
+                                CombinedTensor* output) {
+  // The kernels are made for this number of maps
+  if (input->data.maps() != input_maps_) {
+    LOGERROR << "Cannot change the number of input maps from " << input_maps_ << " to " << input->data.maps();
+    return false;
+  }
+
+  const int output_width = ((int)pad_width_ + (int)pad_width_ + (int)input->data.width() - (int)kernel_width_) / (int)stride_width_ + 1;
+  const int output_height = ((int)pad_height_ + (int)pad_height_ + (int)input->data.height() - (int)kernel_height_) / (int)stride_height_ + 1;
+
+  if (output_width <= 0 || output_height <= 0) {
+    LOGERROR << "Unsupported input dimensions " << input->data;
+    return false;
+  }
+
+  output->Resize (input->data.samples(), output_width, output_height, output_maps_);
+
+  input_width_ = input->data.width();
+  input_height_ = input->data.height();
+  output_width_ = output_width;
+  output_height_ = output_height;
+
+  ResizeBuffers(input->data.samples());
+  return true;
+}
+
+void ConvolutionLayer::ResizeBuffers(const unsigned int samples) {
+  // Create im2col output buffer
+  im2col_ff_buffer.Resize (kernel_width_ * kernel_height_ * input_maps_, output_width_,
+                           output_height_, samples);
+  
+  sms_ff_buffer.Resize(output_maps_, output_width_, output_height_, samples);
+  
+  sms2_bp_buffer.Resize(output_maps_, output_width_, output_height_, samples);
+
+  bp_deltax_buffer.Resize (kernel_width_ * kernel_height_ * input_maps_, output_width_,
+                           output_height_, samples);
+
+  // This is faster than adding manually...
+  ones_.Resize (1, output_width_ * output_height_ * samples);
+
+  for (unsigned int i = 0; i < ones_.elements(); i++) {
+    ones_[i] = 1;
+  }
+
+  // Initialize the dropout mask tensor
+  dropout_mask_.Resize(samples, output_maps_);
+}
+
 void ConvolutionLayer::FeedForward() {
   const datum p = net_->IsTesting() ? 0.0 : dropout_fraction_;
   const datum w = net_->IsTesting() ? (1.0 - dropout_fraction_) : 1.0;
@@ -230,6 +230,37 @@ bool DatasetInputLayer::Connect (const std::vector< CombinedTensor* >& inputs,
   return valid;
 }
 
+bool DatasetInputLayer::ReshapeInput (const unsigned int batch_size,
+                                      const unsigned int width, const unsigned int height,
+                                      const std::vector< CombinedTensor* >& outputs) {
+  if (outputs.size() != 4 || outputs[0] != data_output_) {
+    LOGERROR << "Can only reshape the outputs created by this layer!";
+    return false;
+  }
+
+  // The samples are loaded in the dataset's size
+  if ((width > 0 && width != data_output_->data.width()) ||
+      (height > 0 && height != data_output_->data.height())) {
+    LOGERROR << "Cannot change the size of dataset images to " << width << "x" << height;
+    return false;
+  }
+
+  // The metadata buffers are shared with the layers that read them
+  if (testing_dataset_->GetTask() == DETECTION) {
+    LOGERROR << "Cannot change the batch size of detection datasets";
+    return false;
+  }
+
+  for (CombinedTensor* output : outputs)
+    output->Resize(batch_size, output->data.width(), output->data.height(), output->data.maps());
+
+  batch_size_ = batch_size;
+  if (do_augmentation_)
+    preaug_data_buffer_.Resize(data_output_->data);
+
+  return true;
+}
+
 void DatasetInputLayer::SelectAndLoadSamples() {
 #ifdef BUILD_OPENCL
   data_output_->data.MoveToCPU (true);
@@ -241,6 +272,10 @@ void DatasetInputLayer::SelectAndLoadSamples() {
   std::uniform_real_distribution<datum> jitter_dist(- jitter_, jitter_);
   std::bernoulli_distribution binary_dist;
 
+  // Augmented samples are different every time
+  sample_keys_valid_ = testing_ || !do_augmentation_;
+  sample_keys_.resize(batch_size_);
+
   for(unsigned int sample = 0; sample < batch_size_; sample++) {
     std::uniform_real_distribution<datum> exposure_dist(1.0, binary_dist(generator_) ? exposure_ : (datum)1.0 / exposure_);
     std::uniform_real_distribution<datum> saturation_dist(1.0, binary_dist(generator_) ? saturation_ : (datum) 1.0 / saturation_);
@@ -280,6 +315,14 @@ void DatasetInputLayer::SelectAndLoadSamples() {
       selected_element = element_dist(generator_);
     }
 
+    // Key: testing flag, index of the dataset and element
+    const std::size_t dataset_index = std::find(datasets_.begin(), datasets_.end(), dataset) - datasets_.begin();
+    if(dataset_index < datasets_.size()) {
+      sample_keys_[sample] = ((std::uint64_t)testing_ << 63) | ((std::uint64_t)dataset_index << 40) | selected_element;
+    } else {
+      sample_keys_valid_ = false;
+    }
+
     // Generate scaling and transpose data
     const datum left_border = jitter_dist(generator_);
     const datum right_border = (datum)1.0 + jitter_dist(generator_);
@@ -544,6 +587,14 @@ unsigned int DatasetInputLayer::GetSamplesInTrainingSet() {
   return samples;
 }
 
+bool DatasetInputLayer::GetSampleKeys(std::vector<std::uint64_t>& keys) {
+  if(!sample_keys_valid_)
+    return false;
+
+  keys = sample_keys_;
+  return true;
+}
+
 void DatasetInputLayer::SetTestingMode (bool testing) {
   if (testing != testing_) {
     if (testing) {
@@ -6,6 +6,7 @@
  */
 
 #include <algorithm>
+#include <cmath>
 #include <vector>
 #include <cn24/util/BoundingBox.h>
 #include <sstream>
@@ -13,6 +14,7 @@
 #include "Log.h"
 #include "Init.h"
 #include "StatAggregator.h"
+#include "NonMaximumSuppression.h"
 
 #include "DetectionStatLayer.h"
 
@@ -77,22 +79,126 @@ DetectionStatLayer::DetectionStatLayer (ClassManager* class_manager)
 }
 
 void DetectionStatLayer::UpdateClassCount() {
-  if(last_seen_max_id_ != class_manager_->GetMaxClassId() || detections_ == nullptr) {
+  if(last_seen_max_id_ != class_manager_->GetMaxClassId() || tp_histogram_ == nullptr) {
     unsigned int max_id = class_manager_->GetMaxClassId();
 
-    if(detections_ != nullptr)
-      delete[] detections_;
+    if(tp_histogram_ != nullptr)
+      delete[] tp_histogram_;
+    if(fp_histogram_ != nullptr)
+      delete[] fp_histogram_;
     if(positive_samples_ != nullptr)
       delete[] positive_samples_;
 
-    detections_ = new std::vector<Detection>[max_id + 1];
+    tp_histogram_ = new std::vector<unsigned long>[max_id + 1];
+    fp_histogram_ = new std::vector<unsigned long>[max_id + 1];
     positive_samples_ = new unsigned int[max_id + 1];
+    score_range_.resize(max_id + 1);
     last_seen_max_id_ = max_id;
 
+    for (unsigned int c = 0; c <= max_id; c++) {
+      tp_histogram_[c].resize(score_bins);
+      fp_histogram_[c].resize(score_bins);
+    }
+
     Reset();
   }
 }
 
+unsigned int DetectionStatLayer::ScoreBin(datum score, datum score_range) {
+  if(!(score > 0))
+    return 0;
+  const datum bin = score * (datum)score_bins / score_range;
+  return bin < (datum)score_bins ? (unsigned int)bin : score_bins - 1;
+}
+
+void DetectionStatLayer::ExtendScoreRange(unsigned int c, datum score) {
+  // Infinite scores end up in the top bin
+  while(std::isfinite(score) && score >= score_range_[c]) {
+    std::vector<unsigned long>& tp_histogram = tp_histogram_[c];
+    std::vector<unsigned long>& fp_histogram = fp_histogram_[c];
+    for (unsigned int bin = 0; bin < score_bins / 2; bin++) {
+      tp_histogram[bin] = tp_histogram[2 * bin] + tp_histogram[2 * bin + 1];
+      fp_histogram[bin] = fp_histogram[2 * bin] + fp_histogram[2 * bin + 1];
+    }
+    std::fill(tp_histogram.begin() + score_bins / 2, tp_histogram.end(), 0);
+    std::fill(fp_histogram.begin() + score_bins / 2, fp_histogram.end(), 0);
+    score_range_[c] *= (datum)2.0;
+  }
+}
+
+void DetectionStatLayer::ClassStatistics(unsigned int c, datum& ap, datum& f1) const {
+  ap = 0;
+  f1 = 0;
+
+  // For AP calculation
+  datum fp_sum = 0;
+  datum tp_sum = 0;
+  std::vector<datum> detection_recall;
+  std::vector<datum> detection_precision;
+
+  // Initialize AP calculation
+  detection_precision.push_back((datum) 0);
+  detection_recall.push_back((datum) 0);
+
+  // Calculate TPR and FPR, walking the histogram from the highest score
+  // down. All detections in one bin are treated as tied.
+  for (int bin = (int)score_bins - 1; bin >= 0; bin--) {
+    if((tp_histogram_[c][bin] + fp_histogram_[c][bin]) == 0)
+      continue;
+    tp_sum += (datum)tp_histogram_[c][bin];
+    fp_sum += (datum)fp_histogram_[c][bin];
+
+    // Save results for AP calculation
+    detection_precision.push_back(tp_sum / (fp_sum + tp_sum));
+    detection_recall.push_back(tp_sum / (datum) positive_samples_[c]);
+  }
+
+  if ((fp_sum + tp_sum) > 0) {
+    const datum class_precision = (tp_sum / (fp_sum + tp_sum));
+    const datum class_recall = (tp_sum / (datum) positive_samples_[c]);
+
+    if((class_precision + class_recall) > 0)
+      f1 = (datum) (2.0 * class_precision * class_recall / (class_precision + class_recall));
+  }
+
+  // Calculate AP
+  detection_precision.push_back((datum) 0);
+  detection_recall.push_back((datum) 1);
+
+  for (int i = (int) detection_precision.size() - 2; i >= 0; --i) {
+    detection_precision[i] = std::max(detection_precision[i], detection_precision[i + 1]);
+  }
+
+  std::stringstream ss; ss << "[";
+  for (int i = 0; i < (int) detection_precision.size(); i++) {
+    ss << "(" << detection_precision[i] << "," << detection_recall[i] << ")";
+    if(i < ((int) detection_precision.size() - 1)) {
+      ss << ",";
+    }
+  }
+  ss << "]";
+  LOGDEBUG << ss.str();
+
+  std::vector<int> different_indices;
+  for (int i = 1; i < (int) detection_recall.size(); i++) {
+    if (detection_recall[i] != detection_recall[i - 1])
+      different_indices.push_back(i);
+  }
+
+  for (int i = 0; i < (int) different_indices.size(); i++) {
+    ap += (detection_recall[different_indices[i]] - detection_recall[different_indices[i] - 1]) *
+          detection_precision[different_indices[i]];
+  }
+}
+
+datum DetectionStatLayer::GetAveragePrecision(unsigned int c) const {
+  if(c > last_seen_max_id_ || positive_samples_[c] == 0)
+    return 0;
+  datum ap, f1;
+  ClassStatistics(c, ap, f1);
+  return ap;
+}
+
 void DetectionStatLayer::UpdateAll() {
   // Global metrics
   datum global_ap = 0;
@@ -101,8 +207,14 @@ void DetectionStatLayer::UpdateAll() {
   datum sampled_classes = 0;
   for(ClassManager::const_iterator it = class_manager_->begin(); it != class_manager_->end(); it++) {
     unsigned int c = it->second.id;
+    unsigned long total_tp = 0, total_fp = 0;
+    for (unsigned int bin = 0; bin < score_bins; bin++) {
+      total_tp += tp_histogram_[c][bin];
+      total_fp += fp_histogram_[c][bin];
+    }
+
     // Skip empty classes
-    if(detections_[c].size() == 0) {
+    if((total_tp + total_fp) == 0) {
       if(positive_samples_[c] == 0) {
         continue;
       } else {
@@ -116,71 +228,10 @@ void DetectionStatLayer::UpdateAll() {
       LOGDEBUG << "AP class " << it->first << ": 0, only false positives present (not counting)";
       // sampled_classes += (datum) 1.0; do not count classes that are not present in the dataset
     } else {
-
-      // Sort vector
-      std::sort(detections_[c].begin(), detections_[c].end(),
-                [](Detection &d1, Detection &d2) { return d1.confidence > d2.confidence; });
-
-      // For AP calculation
-      datum fp_sum = 0;
-      datum tp_sum = 0;
-      std::vector<datum> detection_recall;
-      std::vector<datum> detection_precision;
-
-      // Initialize AP calculation
-      detection_precision.push_back((datum) 0);
-      detection_recall.push_back((datum) 0);
-
-      // Calculate TPR and FPR
-      for (unsigned int d = 0; d < detections_[c].size(); d++) {
-        tp_sum += detections_[c][d].tp;
-        fp_sum += detections_[c][d].fp;
-
-        // Save results for AP calculation
-        detection_precision.push_back(tp_sum / (fp_sum + tp_sum));
-        detection_recall.push_back(tp_sum / (datum) positive_samples_[c]);
-      }
-
-      if ((fp_sum + tp_sum) > 0) {
-        const datum class_precision = (tp_sum / (fp_sum + tp_sum));
-        const datum class_recall = (tp_sum / (datum) positive_samples_[c]);
-
-        const datum class_f1 = (const datum) (2.0 * class_precision * class_recall / (class_precision + class_recall));
-        if((class_precision + class_recall) > 0)
-          global_f1_ += class_f1;
-      }
-
+      datum ap, f1;
+      ClassStatistics(c, ap, f1);
+      global_f1_ += f1;
       sampled_classes += (datum) 1.0;
-
-      // Calculate AP
-      detection_precision.push_back((datum) 0);
-      detection_recall.push_back((datum) 1);
-
-      for (int i = (int) detection_precision.size() - 2; i >= 0; --i) {
-        detection_precision[i] = std::max(detection_precision[i], detection_precision[i + 1]);
-      }
-
-      std::stringstream ss; ss << "[";
-      for (int i = 0; i < (int) detection_precision.size(); i++) {
-        ss << "(" << detection_precision[i] << "," << detection_recall[i] << ")";
-        if(i < ((int) detection_precision.size() - 1)) {
-          ss << ",";
-        }
-      }
-      ss << "]";
-      LOGDEBUG << ss.str();
-
-      std::vector<int> different_indices;
-      for (int i = 1; i < (int) detection_recall.size(); i++) {
-        if (detection_recall[i] != detection_recall[i - 1])
-          different_indices.push_back(i);
-      }
-
-      datum ap = 0;
-      for (int i = 0; i < (int) different_indices.size(); i++) {
-        ap += (detection_recall[different_indices[i]] - detection_recall[different_indices[i] - 1]) *
-              detection_precision[different_indices[i]];
-      }
       LOGDEBUG << "AP class " << it->first << ": " << ap * 100.0;
       global_ap += ap;
     }
@@ -268,120 +319,150 @@ void DetectionStatLayer::FeedForward() {
 
   UpdateClassCount();
 
-  for (unsigned int sample = 0; sample < first_->data.samples(); sample++) {
+  const unsigned int samples = (unsigned int)first_->data.samples();
+
+  // Check the weights before going parallel, FATAL cannot be raised
+  // from inside the parallel loop
+  for (unsigned int sample = 0; sample < samples; sample++) {
     datum sample_weight = *(third_->data.data_ptr(0, 0, 0, sample));
-    if(sample_weight == 0) {
-      continue;
-    } else if(sample_weight != 1) {
+    if(sample_weight != 0 && sample_weight != 1) {
       FATAL("Unsupported sample weight: " << sample_weight);
     }
-    std::vector<BoundingBox> *sample_detected_boxes = (std::vector<BoundingBox> *) first_->metadata[sample];
-    std::vector<BoundingBox> *sample_truth_boxes = (std::vector<BoundingBox> *) second_->metadata[sample];
+  }
 
-    // Per-class stats
-    for(ClassManager::const_iterator it = class_manager_->begin(); it != class_manager_->end(); it++) {
-      unsigned int c = it->second.id;
-      // Loop over all detected boxes
-      for(unsigned int b = 0; b < sample_detected_boxes->size(); b++) {
-        if((*sample_detected_boxes)[b].c != c)
-          continue;
-
-        Detection detection;
-        detection.confidence = (*sample_detected_boxes)[b].score;
-
-        // Assign ground truth box
-        datum maximum_overlap = (datum) -1;
-        int best_truth_box = -1;
-
-        for (unsigned int t = 0; t < sample_truth_boxes->size(); t++) {
-          if((*sample_truth_boxes)[t].c != c)
-            continue;
-
-          // Compute overlap
-          datum overlap = (*sample_detected_boxes)[b].IntersectionOverUnion(&((*sample_truth_boxes)[t]));
-          if(overlap > maximum_overlap) {
-            best_truth_box = t;
-            maximum_overlap = overlap;
-          }
-        }
-
-        if(maximum_overlap > 0.5 && best_truth_box >= 0) { // Second part shouldn't be necessary, but who knows
-          if((*sample_truth_boxes)[best_truth_box].flag2) // Difficult box, ignore completely
-            continue;
-
-          if(!(*sample_truth_boxes)[best_truth_box].flag1) {
-            detection.tp = 1.0;
-            (*sample_truth_boxes)[best_truth_box].flag1 = true;
-          } else {
-            // Double detection -> false positive
-            detection.fp = 1.0;
-          }
-        } else {
-          // No box found or box too small
-          detection.fp = 1.0;
-        }
-
-        detections_[c].push_back(detection);
-      }
+  sample_detections_.resize(samples);
+  sample_objectness_.assign(samples, Detection());
+
+#pragma omp parallel for default(shared)
+  for (unsigned int sample = 0; sample < samples; sample++) {
+    sample_detections_[sample].clear();
+    if(*(third_->data.data_ptr(0, 0, 0, sample)) == 0)
+      continue;
+    EvaluateSample(sample);
+  }
+
+  // Merge the per-sample results into the histograms
+  for (unsigned int sample = 0; sample < samples; sample++) {
+    if(*(third_->data.data_ptr(0, 0, 0, sample)) == 0)
+      continue;
+
+    for (const Detection& detection : sample_detections_[sample]) {
+      if(detection.c > last_seen_max_id_)
+        continue;
+      ExtendScoreRange(detection.c, detection.confidence);
+      const unsigned int bin = ScoreBin(detection.confidence, score_range_[detection.c]);
+      tp_histogram_[detection.c][bin] += (unsigned long)detection.tp;
+      fp_histogram_[detection.c][bin] += (unsigned long)detection.fp;
     }
 
-    // Reset box flags
-    for (unsigned int t = 0; t < sample_truth_boxes->size(); t++) {
-      (*sample_truth_boxes)[t].flag1 = false;
+    objectness_tp_ += sample_objectness_[sample].tp;
+    objectness_fp_ += sample_objectness_[sample].fp;
 
-      // Count positive samples (ignore difficult boxes)
+    // Count positive samples (ignore difficult boxes)
+    std::vector<BoundingBox> *sample_truth_boxes = (std::vector<BoundingBox> *) second_->metadata[sample];
+    for (unsigned int t = 0; t < sample_truth_boxes->size(); t++) {
       if(!(*sample_truth_boxes)[t].flag2) {
-        positive_samples_[(*sample_truth_boxes)[t].c]++;
+        if((*sample_truth_boxes)[t].c <= last_seen_max_id_)
+          positive_samples_[(*sample_truth_boxes)[t].c]++;
         objectness_positives_++;
       }
     }
+  }
+}
 
-    // Objectness stats
-
-    // Loop over all detected boxes
-    for(unsigned int b = 0; b < sample_detected_boxes->size(); b++) {
-      Detection detection;
-
-      // Assign ground truth box
-      datum maximum_overlap = (datum) -1;
-      int best_truth_box = -1;
-
-      for (unsigned int t = 0; t < sample_truth_boxes->size(); t++) {
-        // Compute overlap
-        datum overlap = (*sample_detected_boxes)[b].IntersectionOverUnion(&((*sample_truth_boxes)[t]));
-        if(overlap > maximum_overlap) {
-          best_truth_box = t;
-          maximum_overlap = overlap;
-        }
+void DetectionStatLayer::EvaluateSample(unsigned int sample) {
+  std::vector<BoundingBox> *sample_detected_boxes = (std::vector<BoundingBox> *) first_->metadata[sample];
+  std::vector<BoundingBox> *sample_truth_boxes = (std::vector<BoundingBox> *) second_->metadata[sample];
+  std::vector<Detection>& detections = sample_detections_[sample];
+  Detection& objectness = sample_objectness_[sample];
+
+  // Bucket the ground truth boxes by class and position
+  std::vector<std::vector<unsigned int>> truth_groups;
+  NonMaximumSuppression::GroupByClass(*sample_truth_boxes, truth_groups);
+  std::vector<BoxGrid> truth_grids;
+  for (unsigned int g = 0; g < truth_groups.size(); g++)
+    truth_grids.emplace_back(*sample_truth_boxes, truth_groups[g]);
+
+  std::vector<unsigned int> all_truth(sample_truth_boxes->size());
+  for (unsigned int t = 0; t < sample_truth_boxes->size(); t++)
+    all_truth[t] = t;
+  BoxGrid objectness_grid(*sample_truth_boxes, all_truth);
+
+  // Boxes that don't intersect have zero overlap and can never pass the
+  // threshold, so only the grid candidates need to be considered. Ties go
+  // to the first truth box.
+  auto best_match = [&](BoundingBox& box, const BoxGrid& grid, datum& maximum_overlap) -> int {
+    int best_truth_box = -1;
+    maximum_overlap = 0;
+    grid.ForEachCandidate(box, [&](unsigned int t) -> bool {
+      datum overlap = box.IntersectionOverUnion(&((*sample_truth_boxes)[t]));
+      if(overlap > maximum_overlap || (overlap == maximum_overlap && (int)t < best_truth_box)) {
+        best_truth_box = (int)t;
+        maximum_overlap = overlap;
       }
+      return true;
+    });
+    return best_truth_box;
+  };
+
+  // Per-class stats
+  std::vector<bool> matched(sample_truth_boxes->size(), false);
+  for(unsigned int b = 0; b < sample_detected_boxes->size(); b++) {
+    BoundingBox& box = (*sample_detected_boxes)[b];
+    Detection detection;
+    detection.c = box.c;
+    detection.confidence = box.score;
+
+    datum maximum_overlap = 0;
+    int best_truth_box = -1;
+    for (unsigned int g = 0; g < truth_groups.size(); g++) {
+      if((*sample_truth_boxes)[truth_groups[g][0]].c == box.c) {
+        best_truth_box = best_match(box, truth_grids[g], maximum_overlap);
+        break;
+      }
+    }
 
-      if(maximum_overlap > 0.5 && best_truth_box >= 0) { // Second part shouldn't be necessary, but who knows
-        if((*sample_truth_boxes)[best_truth_box].flag2) // Difficult box, ignore completely
-          continue;
-
-        if(!(*sample_truth_boxes)[best_truth_box].flag1) {
-          detection.tp = 1.0;
-          (*sample_truth_boxes)[best_truth_box].flag1 = true;
-        } else {
-          // Double detection -> false positive
-          detection.fp = 1.0;
-        }
+    if(maximum_overlap > 0.5 && best_truth_box >= 0) {
+      if((*sample_truth_boxes)[best_truth_box].flag2) // Difficult box, ignore completely
+        continue;
+
+      if(!matched[best_truth_box]) {
+        detection.tp = 1.0;
+        matched[best_truth_box] = true;
       } else {
-        // No box found or box too small
+        // Double detection -> false positive
         detection.fp = 1.0;
       }
-
-      objectness_fp_ += detection.fp;
-      objectness_tp_ += detection.tp;
+    } else {
+      // No box found or box too small
+      detection.fp = 1.0;
     }
 
-    // Reset box flags (again)
-    for (unsigned int t = 0; t < sample_truth_boxes->size(); t++) {
-      (*sample_truth_boxes)[t].flag1 = false;
-    }
+    detections.push_back(detection);
   }
 
+  // Objectness stats
+  matched.assign(sample_truth_boxes->size(), false);
+  for(unsigned int b = 0; b < sample_detected_boxes->size(); b++) {
+    datum maximum_overlap = 0;
+    int best_truth_box = best_match((*sample_detected_boxes)[b], objectness_grid, maximum_overlap);
+
+    if(maximum_overlap > 0.5 && best_truth_box >= 0) {
+      if((*sample_truth_boxes)[best_truth_box].flag2) // Difficult box, ignore completely
+        continue;
 
+      if(!matched[best_truth_box]) {
+        objectness.tp += 1.0;
+        matched[best_truth_box] = true;
+      } else {
+        // Double detection -> false positive
+        objectness.fp += 1.0;
+      }
+    } else {
+      // No box found or box too small
+      objectness.fp += 1.0;
+    }
+  }
 }
 
 void DetectionStatLayer::BackPropagate() {
@@ -390,8 +471,10 @@ void DetectionStatLayer::BackPropagate() {
 
 void DetectionStatLayer::Reset() {
   for (unsigned int c = 0; c <= last_seen_max_id_; c++) {
-    detections_[c].clear();
+    std::fill(tp_histogram_[c].begin(), tp_histogram_[c].end(), 0);
+    std::fill(fp_histogram_[c].begin(), fp_histogram_[c].end(), 0);
     positive_samples_[c] = 0;
+    score_range_[c] = 1;
   }
   objectness_tp_ = 0;
   objectness_fp_ = 0;
@@ -83,6 +83,13 @@ bool DropoutLayer::Connect (const CombinedTensor* input,
   return valid;
 }
 
+bool DropoutLayer::Reshape (const CombinedTensor* input,
+                            CombinedTensor* output) {
+  output->Resize (input->data.samples(), input->data.width(),
+                  input->data.height(), input->data.maps());
+  return Connect (input, output);
+}
+
 void DropoutLayer::FeedForward() {
   if(!net_->IsTesting() || net_->IsGradientTesting()) {
     if(net_->IsGradientTesting())
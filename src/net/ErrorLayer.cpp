@@ -89,6 +89,14 @@ bool ErrorLayer::Connect ( const std::vector< CombinedTensor* >& inputs,
   return valid;
 }
 
+bool ErrorLayer::Reshape ( const std::vector< CombinedTensor* >& inputs,
+                           const std::vector< CombinedTensor* >& outputs,
+                           const NetStatus* net ) {
+  // There are no outputs, the inputs are validated like during initialization
+  std::vector<CombinedTensor*> no_outputs;
+  return CreateOutputs ( inputs, no_outputs ) && Connect ( inputs, outputs, net );
+}
+
 void ErrorLayer::FeedForward() {
   // We write the deltas at this point, because
   // CalculateLossFunction() is called before BackPropagate().
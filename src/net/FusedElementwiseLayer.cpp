@@ -0,0 +1,202 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cmath>
+
+#include "NonLinearityLayer.h"
+#include "FusedElementwiseLayer.h"
+
+namespace Conv {
+
+namespace {
+// The expressions are the same as in ActivationFunctions.cpp, so a fused
+// chain computes exactly what the separate layers would
+inline datum Forward(const FusedElementwiseLayer::Operation operation, const datum x) {
+  switch(operation) {
+    case FusedElementwiseLayer::TANH:
+      return 1.0 - 2.0 / (std::exp(2.0 * x) + 1.0);
+    case FusedElementwiseLayer::SIGMOID:
+      return 1.0 / (1.0 + std::exp(-(double)x));
+    case FusedElementwiseLayer::RELU:
+      return x > 0 ? x : 0;
+    case FusedElementwiseLayer::LEAKY_RELU:
+      return x > 0 ? x : 0.1 * x;
+  }
+  return x;
+}
+
+// Multiplies the delta with the derivative, given the operation's input x
+// and output y
+inline datum Backward(const FusedElementwiseLayer::Operation operation, const datum x,
+  const datum y, const datum delta) {
+  switch(operation) {
+    case FusedElementwiseLayer::TANH:
+      return (datum) (delta * (1.0 - y * y));
+    case FusedElementwiseLayer::SIGMOID:
+      return (datum) (delta * y * (1.0 - y));
+    case FusedElementwiseLayer::RELU:
+      return x > 0 ? delta : 0;
+    case FusedElementwiseLayer::LEAKY_RELU:
+      return x > 0 ? delta : ((datum)0.1) * delta;
+  }
+  return delta;
+}
+}
+
+FusedElementwiseLayer::FusedElementwiseLayer(bool sum_inputs, const std::vector<Operation>& operations)
+  : Layer(JSON::object()), sum_inputs_(sum_inputs), operations_(operations) {
+  if(operations_.size() > max_operations)
+    FATAL("Too many operations: " << operations_.size());
+  LOGDEBUG << "Instance created.";
+}
+
+bool FusedElementwiseLayer::GetOperation(Layer* layer, Operation& operation) {
+  if(dynamic_cast<TanhLayer*>(layer) != nullptr)
+    operation = TANH;
+  else if(dynamic_cast<SigmoidLayer*>(layer) != nullptr)
+    operation = SIGMOID;
+  else if(dynamic_cast<ReLULayer*>(layer) != nullptr)
+    operation = RELU;
+  else if(dynamic_cast<LeakyReLULayer*>(layer) != nullptr)
+    operation = LEAKY_RELU;
+  else
+    return false;
+
+  return true;
+}
+
+const char* FusedElementwiseLayer::OperationName(Operation operation) {
+  switch(operation) {
+    case TANH:
+      return "Tanh";
+    case SIGMOID:
+      return "Sigmoid";
+    case RELU:
+      return "ReLU";
+    case LEAKY_RELU:
+      return "LeakyReLU";
+  }
+  return "Unknown";
+}
+
+bool FusedElementwiseLayer::CreateOutputs (const std::vector< CombinedTensor* >& inputs,
+                                 std::vector< CombinedTensor* >& outputs) {
+  if(inputs.size() != (sum_inputs_ ? 2 : 1)) {
+    LOGERROR << "Wrong number of inputs!";
+    return false;
+  }
+
+  CombinedTensor* input = inputs[0];
+  if(input == nullptr) {
+    LOGERROR << "Null pointer supplied";
+    return false;
+  }
+
+  CombinedTensor* output = new CombinedTensor(input->data.samples(), input->data.width(),
+    input->data.height(), input->data.maps());
+
+  outputs.push_back(output);
+  return true;
+}
+
+bool FusedElementwiseLayer::Connect (const std::vector< CombinedTensor* >& inputs,
+                           const std::vector< CombinedTensor* >& outputs,
+                           const NetStatus* status ) {
+  UNREFERENCED_PARAMETER(status);
+  if(inputs.size() != (sum_inputs_ ? 2 : 1)) {
+    LOGERROR << "Wrong number of inputs!";
+    return false;
+  }
+
+  if(outputs.size() != 1) {
+    LOGERROR << "Needs exactly one output!";
+    return false;
+  }
+
+  for(CombinedTensor* input : inputs) {
+    if(input == nullptr || outputs[0] == nullptr) {
+      LOGERROR << "Null pointer supplied";
+      return false;
+    }
+
+    if(input->data.elements() != outputs[0]->data.elements()) {
+      LOGERROR << "Wrong output dimensions!";
+      return false;
+    }
+  }
+
+  input_a_ = inputs[0];
+  input_b_ = sum_inputs_ ? inputs[1] : nullptr;
+  output_ = outputs[0];
+
+  return true;
+}
+
+bool FusedElementwiseLayer::Reshape (const std::vector< CombinedTensor* >& inputs,
+                           const std::vector< CombinedTensor* >& outputs,
+                           const NetStatus* status ) {
+  if(inputs.size() != (sum_inputs_ ? 2 : 1) || outputs.size() != 1) {
+    LOGERROR << "Wrong number of inputs or outputs!";
+    return false;
+  }
+
+  CombinedTensor* input = inputs[0];
+  if(sum_inputs_ && inputs[1]->data.elements() != input->data.elements()) {
+    LOGERROR << "Dimensions don't match!";
+    return false;
+  }
+
+  outputs[0]->Resize(input->data.samples(), input->data.width(),
+    input->data.height(), input->data.maps());
+  return Connect(inputs, outputs, status);
+}
+
+void FusedElementwiseLayer::FeedForward() {
+  const datum* input_a = input_a_->data.data_ptr_const();
+  const datum* input_b = sum_inputs_ ? input_b_->data.data_ptr_const() : nullptr;
+  datum* output = output_->data.data_ptr();
+  const Operation* operations = operations_.data();
+  const unsigned int operation_count = (unsigned int)operations_.size();
+
+#pragma omp parallel for default(shared)
+  for (std::size_t element = 0; element < output_->data.elements(); element++) {
+    datum value = sum_inputs_ ? input_a[element] + input_b[element] : input_a[element];
+    for (unsigned int o = 0; o < operation_count; o++)
+      value = Forward(operations[o], value);
+    output[element] = value;
+  }
+}
+
+void FusedElementwiseLayer::BackPropagate() {
+  const datum* input_a = input_a_->data.data_ptr_const();
+  const datum* input_b = sum_inputs_ ? input_b_->data.data_ptr_const() : nullptr;
+  const datum* output_delta = output_->delta.data_ptr_const();
+  datum* input_a_delta = input_a_->delta.data_ptr();
+  datum* input_b_delta = sum_inputs_ ? input_b_->delta.data_ptr() : nullptr;
+  const Operation* operations = operations_.data();
+  const unsigned int operation_count = (unsigned int)operations_.size();
+
+#pragma omp parallel for default(shared)
+  for (std::size_t element = 0; element < output_->data.elements(); element++) {
+    // Recompute the intermediate values instead of reading them from memory
+    datum values[max_operations + 1];
+    values[0] = sum_inputs_ ? input_a[element] + input_b[element] : input_a[element];
+    for (unsigned int o = 0; o < operation_count; o++)
+      values[o + 1] = Forward(operations[o], values[o]);
+
+    datum delta = output_delta[element];
+    for (unsigned int o = operation_count; o > 0; o--)
+      delta = Backward(operations[o - 1], values[o - 1], values[o], delta);
+
+    // The gradient of a sum is the same for both summands
+    input_a_delta[element] = delta;
+    if (sum_inputs_)
+      input_b_delta[element] = delta;
+  }
+}
+
+}
@@ -93,6 +93,26 @@ bool GradientAccumulationLayer::Connect (const std::vector< CombinedTensor* >& i
   return true;
 }
 
+bool GradientAccumulationLayer::Reshape (const std::vector< CombinedTensor* >& inputs,
+                           const std::vector< CombinedTensor* >& outputs,
+                           const NetStatus* status ) {
+  UNREFERENCED_PARAMETER(status);
+  if(inputs.size() != 1 || outputs.size() != output_count_) {
+    LOGERROR << "Wrong number of inputs or outputs!";
+    return false;
+  }
+
+  CombinedTensor* input = inputs[0];
+  for(CombinedTensor* output : outputs) {
+    output->delta.Resize(input->data);
+    output->data.Shadow(input->data);
+  }
+
+  samples_ = input->data.samples();
+  elements_per_sample_ = input->data.width() * input->data.height() * input->data.maps();
+  return true;
+}
+
 void GradientAccumulationLayer::FeedForward() {
   // Nothing to do here because of the shadowing
 }
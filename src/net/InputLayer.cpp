@@ -32,6 +32,8 @@ InputLayer::InputLayer ( Tensor& data ) : InputLayer ( data,
   // Save some memory...
   data_->data.Shadow ( data );
   helper_->data.Shadow ( helper );
+  data_source_ = &data;
+  helper_source_ = &helper;
 
   LOGDEBUG << "Instance created.";
 }
@@ -72,6 +74,10 @@ InputLayer::InputLayer ( Tensor& data, Tensor& label, Tensor& helper,
   label_->data.Shadow ( label );
   helper_->data.Shadow ( helper );
   weight_->data.Shadow ( weight );
+  data_source_ = &data;
+  label_source_ = &label;
+  helper_source_ = &helper;
+  weight_source_ = &weight;
 
   LOGDEBUG << "Instance created.";
 }
@@ -162,6 +168,39 @@ bool InputLayer::CreateOutputs ( const std::vector< CombinedTensor* >& inputs,
   return true;
 }
 
+bool InputLayer::ReshapeInput ( const unsigned int batch_size,
+                                const unsigned int width, const unsigned int height,
+                                const std::vector< CombinedTensor* >& outputs ) {
+  if ( outputs.size() != 4 || outputs[0] != data_ || outputs[2] != helper_ ) {
+    LOGERROR << "Can only reshape the outputs created by this layer!";
+    return false;
+  }
+
+  const std::size_t old_width = data_->data.width();
+  const std::size_t old_height = data_->data.height();
+  const std::size_t new_width = width > 0 ? width : old_width;
+  const std::size_t new_height = height > 0 ? height : old_height;
+
+  Tensor* sources[] = { data_source_, label_source_, helper_source_, weight_source_ };
+  for ( unsigned int b = 0; b < outputs.size(); b++ ) {
+    CombinedTensor* output = outputs[b];
+    const bool spatial = output->data.width() == old_width && output->data.height() == old_height;
+    const std::size_t output_width = spatial ? new_width : output->data.width();
+    const std::size_t output_height = spatial ? new_height : output->data.height();
+    const std::size_t maps = output->data.maps();
+
+    output->delta.Resize ( batch_size, output_width, output_height, maps );
+    if ( sources[b] != nullptr ) {
+      sources[b]->Resize ( batch_size, output_width, output_height, maps );
+      output->data.Shadow ( *sources[b] );
+    } else {
+      output->data.Resize ( batch_size, output_width, output_height, maps );
+    }
+  }
+
+  return true;
+}
+
 void InputLayer::CreateBufferDescriptors(std::vector<NetGraphBuffer>& buffers) {
 	NetGraphBuffer data_buffer;
 	NetGraphBuffer label_buffer;
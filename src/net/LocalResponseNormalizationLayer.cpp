@@ -6,10 +6,11 @@
  */  
 #include <limits>
 #include <cmath>
+#include <algorithm>
+#include <vector>
 
 #include "Log.h"
 #include "LocalResponseNormalizationLayer.h"
-#include "TensorMath.h"
 
 namespace Conv {
 
@@ -32,6 +33,15 @@ LocalResponseNormalizationLayer::
   JSON_TRY_DATUM(beta_, descriptor, "beta", 0.75);
   normalization_method_ = ACROSS_CHANNELS;
 
+  if(descriptor.count("method") == 1 && descriptor["method"].is_string()) {
+    std::string method = descriptor["method"];
+    if(method.compare("within") == 0) {
+      normalization_method_ = WITHIN_CHANNELS;
+    } else if(method.compare("across") != 0) {
+      FATAL("Unknown normalization method: " << method);
+    }
+  }
+
   LOGDEBUG << "Instance created, size: " << size_ << ", alpha: " << alpha_ 
   << ", beta: " << beta_ << ", method: " << ((normalization_method_ == ACROSS_CHANNELS) ? "across" : "within");
 
@@ -82,124 +92,150 @@ bool LocalResponseNormalizationLayer::
   maps_ = input->data.maps();
   
   
-  // Resize region sum buffer
+  // Resize region sum and scratch buffers
   region_sums_.Resize(input->data.samples(), input_width_, input_height_, maps_);
+  scratch_.Resize(input->data.samples(), input_width_, input_height_, maps_);
+  coefficients_.Resize(input->data.samples(), input_width_, input_height_, maps_);
   
   return true;
 }
 
-void LocalResponseNormalizationLayer::FeedForward() {
+bool LocalResponseNormalizationLayer::
+  Reshape(const CombinedTensor* input, CombinedTensor* output) {
+  output->Resize(input->data.samples(), input->data.width(),
+    input->data.height(), input->data.maps());
+  return Connect(input, output);
+}
+
+void LocalResponseNormalizationLayer::RunningSum(const datum* input, datum* output,
+  const unsigned int count, const unsigned int stride, const unsigned int width,
+  const int before, const int after) {
+  // Window for the first element
+  for(unsigned int k = 0; k < width; k++)
+    output[k] = 0;
+  for(int j = 0; j <= after && j < (int)count; j++) {
+    const datum* in = input + j * stride;
+    for(unsigned int k = 0; k < width; k++)
+      output[k] += in[k];
+  }
+
+  // Slide the window, adding the element entering and removing the one leaving
+  for(int i = 1; i < (int)count; i++) {
+    const datum* previous = output + (i - 1) * stride;
+    datum* out = output + i * stride;
+    const datum* entering = (i + after) < (int)count ? input + (i + after) * stride : nullptr;
+    const datum* leaving = (i - before - 1) >= 0 ? input + (i - before - 1) * stride : nullptr;
+    if(entering != nullptr && leaving != nullptr) {
+      for(unsigned int k = 0; k < width; k++)
+        out[k] = previous[k] + entering[k] - leaving[k];
+    } else if(entering != nullptr) {
+      for(unsigned int k = 0; k < width; k++)
+        out[k] = previous[k] + entering[k];
+    } else if(leaving != nullptr) {
+      for(unsigned int k = 0; k < width; k++)
+        out[k] = previous[k] - leaving[k];
+    } else {
+      for(unsigned int k = 0; k < width; k++)
+        out[k] = previous[k];
+    }
+  }
+}
+
+unsigned int LocalResponseNormalizationLayer::WindowSize(const unsigned int index, const unsigned int count) const {
   const int sub = (size_-1)/2;
   const int add = (size_)/2;
+  const int first = ((int)index - sub) > 0 ? (int)index - sub : 0;
+  const int last = ((int)index + add) < (int)count ? (int)index + add : (int)count - 1;
+  return (unsigned int)(last - first + 1);
+}
+
+void LocalResponseNormalizationLayer::WindowSums(const datum* input, datum* output, datum* row_buffer, bool transposed) {
+  // The backward pass sums over all windows containing a pixel, which is
+  // the same box filter mirrored
+  const int before = transposed ? (size_)/2 : (size_-1)/2;
+  const int after = transposed ? (size_-1)/2 : (size_)/2;
+  const unsigned int plane = input_width_ * input_height_;
+
+  if(normalization_method_ == WITHIN_CHANNELS) {
+    for(unsigned int map = 0; map < maps_; map++) {
+      // Along y, vectorised across x, then along x within each row
+      RunningSum(input + map * plane, output + map * plane, input_height_, input_width_, input_width_, before, after);
+      for(unsigned int y = 0; y < input_height_; y++) {
+        datum* row = output + map * plane + y * input_width_;
+        std::copy(row, row + input_width_, row_buffer);
+        RunningSum(row_buffer, row, input_width_, 1, 1, before, after);
+      }
+    }
+  } else {
+    // Across maps, vectorised over each whole plane
+    RunningSum(input, output, maps_, plane, plane, before, after);
+  }
+}
+
+void LocalResponseNormalizationLayer::FeedForward() {
+  const unsigned int plane = input_width_ * input_height_;
   #pragma omp parallel for default(shared)
   for(unsigned int sample = 0; sample < input_->data.samples(); sample++) {
-    if(normalization_method_ == WITHIN_CHANNELS) {
-      for(unsigned int map = 0; map < maps_; map++) {
-        for(unsigned int y = 0; y < input_height_; y++) {
-          for(unsigned int x = 0; x < input_height_; x++) {
-            datum region_sum = 0;
-            int region_size = 0;
-            for(int iy = (((int)y-sub) > 0 ? (int)y-sub : 0); (iy < (int)input_height_) && (iy <= ((int)y+add)); iy++) {
-              for(int ix = (((int)x-sub) > 0 ? (int)x-sub : 0); (ix < (int)input_width_) && (ix <= ((int)x+add)); ix++) {
-                const datum input_value = (*input_->data.data_ptr_const((const size_t)ix,(const size_t)iy,map,sample));
-                region_sum += input_value * input_value;
-                region_size++;
-              }
-            }
-            
-            (*region_sums_.data_ptr(x,y,map,sample)) = region_sum;
-            datum divisor = (datum)pow(1.0 + ((alpha_/((datum)region_size))*region_sum), beta_);
-            (*output_->data.data_ptr(x,y,map,sample)) = (*input_->data.data_ptr_const(x,y,map,sample)) / divisor;
-          }
-        }
-      }
-    } else if(normalization_method_ == ACROSS_CHANNELS) {
-      for(unsigned int map = 0; map < maps_; map++) {
-        for(unsigned int y = 0; y < input_height_; y++) {
-          for(unsigned int x = 0; x < input_height_; x++) {
-            datum region_sum = 0;
-            unsigned int region_size = 0;
-            for(int imap = (((int)map-sub) > 0 ? (int)map-sub : 0); (imap < (int)maps_) && (imap <= ((int)map+add)); imap++) {
-              const datum input_value = (*input_->data.data_ptr_const(x,y,(const size_t)imap,sample));
-              region_sum += input_value * input_value;
-              region_size++;
-            }
-            
-            (*region_sums_.data_ptr(x,y,map,sample)) = region_sum;
-            datum divisor = (datum)pow(1.0 + ((alpha_/((datum)region_size))*region_sum), beta_);
-            (*output_->data.data_ptr(x,y,map,sample)) = (*input_->data.data_ptr_const(x,y,map,sample)) / divisor;
-          }
+    const datum* input = input_->data.data_ptr_const(0, 0, 0, sample);
+    datum* output = output_->data.data_ptr(0, 0, 0, sample);
+    datum* region_sums = region_sums_.data_ptr(0, 0, 0, sample);
+    datum* squares = scratch_.data_ptr(0, 0, 0, sample);
+    std::vector<datum> row_buffer(input_width_);
+
+    for(unsigned int e = 0; e < plane * maps_; e++)
+      squares[e] = input[e] * input[e];
+    WindowSums(squares, region_sums, &row_buffer[0], false);
+
+    for(unsigned int map = 0; map < maps_; map++) {
+      for(unsigned int y = 0; y < input_height_; y++) {
+        const unsigned int row = map * plane + y * input_width_;
+        for(unsigned int x = 0; x < input_width_; x++) {
+          const unsigned int region_size = normalization_method_ == WITHIN_CHANNELS ?
+            WindowSize(x, input_width_) * WindowSize(y, input_height_) : WindowSize(map, maps_);
+          const datum divisor = (datum)pow(1.0 + ((alpha_/((datum)region_size))*region_sums[row + x]), beta_);
+          output[row + x] = input[row + x] / divisor;
         }
       }
-    } else {
-      FATAL("Unknown normalization method");
     }
   }
 }
 
 void LocalResponseNormalizationLayer::BackPropagate() {
-  TensorMath::SETSAMPLE(input_->delta, -1, 0);
-  
-  
-  const int sub = (size_-1)/2;
-  const int add = (size_)/2;
+  const unsigned int plane = input_width_ * input_height_;
   #pragma omp parallel for default(shared)
   for(unsigned int sample = 0; sample < input_->data.samples(); sample++) {
-    if(normalization_method_ == WITHIN_CHANNELS) {
-      for(unsigned int map = 0; map < maps_; map++) {
-        for(unsigned int y = 0; y < input_height_; y++) {
-          for(unsigned int x = 0; x < input_height_; x++) {
-            datum region_sum = (*region_sums_.data_ptr_const(x,y,map,sample));
-            unsigned int region_size = 0;
-            for(int iy = (((int)y-sub) > 0 ? (int)y-sub : 0); (iy < (int)input_height_) && (iy <= ((int)y+add)); iy++) {
-              for(int ix = (((int)x-sub) > 0 ? (int)x-sub : 0); (ix < (int)input_width_) && (ix <= ((int)x+add)); ix++) {
-                region_size++;
-              }
-            }
-            
-            datum divisor = (datum)pow(1.0 + ((alpha_/((datum)region_size))*region_sum), beta_);
-            datum divisor2 = divisor * divisor;
-            const datum xi = *input_->data.data_ptr_const(x,y,map,sample);
-            const datum dxi = *output_->delta.data_ptr_const(x,y,map,sample);
-            
-            for(int iy = (((int)y-sub) > 0 ? (int)y-sub : 0); (iy < (int)input_height_) && (iy <= ((int)y+add)); iy++) {
-              for(int ix = (((int)x-sub) > 0 ? (int)x-sub : 0); (ix < (int)input_width_) && (ix <= ((int)x+add)); ix++) {
-                const datum xj = *input_->data.data_ptr_const((const size_t)ix,(const size_t)iy,map,sample);
-                (*input_->delta.data_ptr((const size_t)ix,(const size_t)iy,map,sample)) -= (dxi * xi * (datum)2.0 * beta_ * (alpha_ / (datum)region_size) * xj *
-                  (datum)pow((datum)1.0 + (alpha_ / (datum)region_size) * region_sum, beta_ - (datum)1.0)) / divisor2;
-              }
-            }
-            (*input_->delta.data_ptr(x,y,map,sample)) += dxi / divisor;
-          }
-        }
-      }
-    } else if(normalization_method_ == ACROSS_CHANNELS) {
-      for(unsigned int map = 0; map < maps_; map++) {
-        for(unsigned int y = 0; y < input_height_; y++) {
-          for(unsigned int x = 0; x < input_height_; x++) {
-            datum region_sum = (*region_sums_.data_ptr_const(x,y,map,sample));
-            unsigned int region_size = 0;
-            for(int imap = (((int)map-sub) > 0 ? (int)map-sub : 0); (imap < (int)maps_) && (imap <= ((int)map+add)); imap++) {
-              region_size++;
-            }
-            
-            datum divisor = (datum)pow(1.0 + ((alpha_/((datum)region_size))*region_sum), beta_);
-            datum divisor2 = divisor * divisor;
-            const datum xi = *input_->data.data_ptr_const(x,y,map,sample);
-            const datum dxi = *output_->delta.data_ptr_const(x,y,map,sample);
-            
-            for(int imap = (((int)map-sub) > 0 ? (int)map-sub : 0); (imap < (int)maps_) && (imap <= ((int)map+add)); imap++) {
-                const datum xj = *input_->data.data_ptr_const(x,y,(const size_t)imap,sample);
-                (*input_->delta.data_ptr(x,y,(const size_t)imap,sample)) -= (dxi * xi * (datum)2.0 * beta_ * (alpha_ / (datum)region_size) * xj *
-                  (datum)pow((datum)1.0 + (alpha_ / (datum)region_size) * region_sum, beta_ - (datum)1.0)) / divisor2;
-            }
-            (*input_->delta.data_ptr(x,y,map,sample)) += dxi / divisor;
-          }
+    const datum* input = input_->data.data_ptr_const(0, 0, 0, sample);
+    const datum* output_delta = output_->delta.data_ptr_const(0, 0, 0, sample);
+    const datum* region_sums = region_sums_.data_ptr_const(0, 0, 0, sample);
+    datum* input_delta = input_->delta.data_ptr(0, 0, 0, sample);
+    datum* coefficients = coefficients_.data_ptr(0, 0, 0, sample);
+    datum* gathered = scratch_.data_ptr(0, 0, 0, sample);
+    std::vector<datum> row_buffer(input_width_);
+
+    // With t_i = 1 + (alpha/n_i) * S_i, every output i contributes
+    // -dy_i * x_i * 2 * beta * (alpha/n_i) * t_i^(-beta-1) * x_j
+    // to the gradient of each x_j in its window.
+    for(unsigned int map = 0; map < maps_; map++) {
+      for(unsigned int y = 0; y < input_height_; y++) {
+        const unsigned int row = map * plane + y * input_width_;
+        for(unsigned int x = 0; x < input_width_; x++) {
+          const unsigned int region_size = normalization_method_ == WITHIN_CHANNELS ?
+            WindowSize(x, input_width_) * WindowSize(y, input_height_) : WindowSize(map, maps_);
+          const datum scale = alpha_ / (datum)region_size;
+          const datum t = (datum)1.0 + scale * region_sums[row + x];
+          const datum divisor = (datum)pow(t, beta_);
+          const datum dxi = output_delta[row + x];
+          coefficients[row + x] = dxi * input[row + x] * (datum)2.0 * beta_ * scale / (divisor * t);
+          input_delta[row + x] = dxi / divisor;
         }
       }
-    } else {
-      FATAL("Unknown normalization method");
     }
+
+    // Gather the coefficients of all windows containing each pixel
+    WindowSums(coefficients, gathered, &row_buffer[0], true);
+
+    for(unsigned int e = 0; e < plane * maps_; e++)
+      input_delta[e] -= gathered[e] * input[e];
   }
 }
 
@@ -9,6 +9,7 @@
 #include "Log.h"
 #include "CLHelper.h"
 #include "MaxPoolingLayer.h"
+#include "TensorMath.h"
 #include "ConfigParsing.h"
 
 #ifdef BUILD_OPENCL
@@ -98,16 +99,26 @@ bool MaxPoolingLayer::Connect (const CombinedTensor* input,
   maximum_mask_.Resize (input->data.samples(), input_width_,
 			input_height_, maps_);
 #else
-  // Create maximum Tensor
-  maximum_ix_.Resize (input->data.samples(), output_width_,
-                      output_height_, maps_);
-  maximum_iy_.Resize (input->data.samples(), output_width_,
-                      output_height_, maps_);
+  maximum_index_.resize (input->data.samples() * output_width_ *
+                         output_height_ * maps_);
 #endif
 
   return true;
 }
 
+bool MaxPoolingLayer::Reshape (const CombinedTensor* input,
+                               CombinedTensor* output) {
+  if ( (input->data.width() % region_width_) != 0 ||
+       (input->data.height() % region_height_) != 0) {
+    LOGERROR << "Input dimensions not divisible by region dimensions: " << input->data;
+    return false;
+  }
+
+  output->Resize (input->data.samples(), input->data.width() / region_width_,
+                  input->data.height() / region_height_, input->data.maps());
+  return Connect (input, output);
+}
+
 void MaxPoolingLayer::FeedForward() {
 #ifdef BUILD_OPENCL_MAX
   input_->data.MoveToGPU();
@@ -145,41 +156,9 @@ void MaxPoolingLayer::FeedForward() {
 #endif
 
 #else
-#pragma omp parallel for default(shared)
-  for (std::size_t sample = 0; sample < input_->data.samples(); sample++) {
-    for (unsigned int map = 0; map < maps_; map++) {
-      for (unsigned int ox = 0; ox < output_width_; ox++) {
-        for (unsigned int oy = 0; oy < output_height_; oy++) {
-          // Find maximum in region
-          datum maximum = std::numeric_limits<datum>::lowest();
-          unsigned int mix = 0;
-          unsigned int miy = 0;
-          for (unsigned int ix = ox * region_width_;
-               ix < (ox + 1) * region_width_; ix++) {
-            for (unsigned int iy = oy * region_height_;
-                 iy < (oy + 1) *region_height_; iy++) {
-              const datum ival =
-                *input_->data.data_ptr_const (ix, iy, map, sample);
-              if (ival > maximum) {
-                maximum = ival;
-                mix = ix;
-                miy = iy;
-		// mix = ox * region_width_;
-		// miy = oy * region_height_;
-              }
-            }
-          }
-          
-          // Found maximum, save
-          *maximum_ix_.data_ptr(ox, oy, map, sample) = mix;
-          *maximum_iy_.data_ptr(ox, oy, map, sample) = miy;
-          
-          // Feed forward
-          *output_->data.data_ptr(ox, oy, map, sample) = maximum;
-        }
-      }
-    }
-  }
+  TensorMath::MAXPOOL(input_->data, output_->data, &maximum_index_[0],
+                      (int)region_width_, (int)region_height_,
+                      (int)region_width_, (int)region_height_);
 #endif
 }
 
@@ -220,24 +199,7 @@ void MaxPoolingLayer::BackPropagate() {
 #endif
 
 #else
-  input_->delta.Clear();
-  
-#pragma omp parallel for default(shared)
-  for(std::size_t sample = 0; sample < input_->data.samples(); sample++) {
-    for (unsigned int map = 0; map < maps_; map++) {
-      for (unsigned int ox = 0; ox < output_width_; ox++) {
-        for (unsigned int oy = 0; oy < output_height_; oy++) {
-          unsigned int ix = *maximum_ix_.data_ptr_const(ox, oy, map, sample);
-          unsigned int iy = *maximum_iy_.data_ptr_const(ox, oy, map, sample);
-          *(input_->delta.data_ptr(ix, iy, map, sample)) = 
-             *output_->delta.data_ptr_const(ox, oy, map, sample);
-        }
-      }
-    }
-  }
-  
-  return;
-  
+  TensorMath::MAXPOOLBACKWARD(input_->delta, output_->delta, &maximum_index_[0]);
 #endif
 }
 
@@ -7,11 +7,19 @@
 
 #include <sstream>
 #include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <set>
 
 #include "Log.h"
 #include "LossFunctionLayer.h"
 #include "TrainingLayer.h"
 #include "GradientAccumulationLayer.h"
+#include "ConcatenationLayer.h"
+#include "FusedElementwiseLayer.h"
+#include "SumLayer.h"
 #include "StatLayer.h"
 
 #include "NetGraph.h"
@@ -21,6 +29,12 @@
 
 namespace Conv {
 
+NetGraph::~NetGraph() {
+  delete feature_cache_;
+  delete parameter_arena_;
+  delete parameter_file_;
+}
+
 void NetGraph::AddNode(NetGraphNode* node) {
 	// Validate node
 	if (node == nullptr)
@@ -42,6 +56,7 @@ void NetGraph::AddNode(NetGraphNode* node) {
 
 	// Add node to list
 	nodes_.push_back(node);
+	plan_valid_ = false;
 
 	// Add node to registries
 	if (node->is_input)
@@ -256,6 +271,252 @@ void NetGraph::Initialize() {
 		InitializeNode(node);
 	}
 
+  if (fusion_enabled_)
+    FuseElementwise();
+
+  if (buffer_sharing_enabled_)
+    ShareBuffers();
+#ifdef BUILD_OPENCL
+  if (parameter_arena_enabled_) {
+    LOGWARN << "The parameter arena is not supported with OpenCL";
+    parameter_arena_enabled_ = false;
+  }
+#endif
+  if (parameter_arena_enabled_)
+    ConsolidateParameters();
+  CompilePlan();
+}
+
+void NetGraph::FuseElementwise() {
+  // Returns the only node reading the node's output, if there is one
+  auto single_consumer = [&](NetGraphNode* node) -> NetGraphNode* {
+    NetGraphNode* consumer = nullptr;
+    for (NetGraphNode* other : nodes_) {
+      for (const NetGraphConnection& connection : other->input_connections) {
+        if (connection.node == node) {
+          if (consumer != nullptr || !connection.backprop)
+            return nullptr;
+          consumer = other;
+        }
+      }
+    }
+    return consumer;
+  };
+
+  // A chain starts with a sum or a nonlinearity and continues with
+  // nonlinearities, each being the only consumer of the previous node
+  auto can_start = [&](NetGraphNode* node) {
+    FusedElementwiseLayer::Operation operation;
+    if (node->output_buffers.size() != 1 || node->output_buffers[0].combined_tensor->is_dynamic)
+      return false;
+    if (node->input_connections.size() == 1)
+      return FusedElementwiseLayer::GetOperation(node->layer, operation);
+    // The deltas of a sum's inputs may already share its gradient
+    return node->input_connections.size() == 2 && dynamic_cast<SumLayer*>(node->layer) != nullptr
+      && !node->input_connections[0].node->output_buffers[node->input_connections[0].buffer].combined_tensor->delta.is_shadow()
+      && !node->input_connections[1].node->output_buffers[node->input_connections[1].buffer].combined_tensor->delta.is_shadow();
+  };
+  auto next_in_chain = [&](NetGraphNode* node) -> NetGraphNode* {
+    FusedElementwiseLayer::Operation operation;
+    if (node->is_output)
+      return nullptr;
+    NetGraphNode* consumer = single_consumer(node);
+    if (consumer == nullptr || consumer->input_connections.size() != 1 || !can_start(consumer)
+      || !FusedElementwiseLayer::GetOperation(consumer->layer, operation))
+      return nullptr;
+    return consumer;
+  };
+
+  std::vector<NetGraphNode*> nodes(nodes_);
+  for (NetGraphNode* head : nodes) {
+    if (std::find(nodes_.begin(), nodes_.end(), head) == nodes_.end() || !can_start(head))
+      continue;
+
+    // Only start at the beginning of a chain
+    NetGraphNode* predecessor = head->input_connections[0].node;
+    if (head->input_connections.size() == 1 && can_start(predecessor) && next_in_chain(predecessor) == head)
+      continue;
+
+    bool sum_inputs = head->input_connections.size() == 2;
+    std::vector<NetGraphNode*> chain = {head};
+    std::vector<FusedElementwiseLayer::Operation> operations;
+    FusedElementwiseLayer::Operation operation;
+    if (!sum_inputs && FusedElementwiseLayer::GetOperation(head->layer, operation))
+      operations.push_back(operation);
+
+    NetGraphNode* next = next_in_chain(head);
+    while (next != nullptr && operations.size() < FusedElementwiseLayer::max_operations) {
+      FusedElementwiseLayer::GetOperation(next->layer, operation);
+      operations.push_back(operation);
+      chain.push_back(next);
+      next = next_in_chain(next);
+    }
+
+    if (chain.size() < 2)
+      continue;
+
+    // Build the fused node in place of the chain. It writes directly into
+    // the last node's output buffer.
+    NetGraphNode* tail = chain.back();
+    FusedElementwiseLayer* fused_layer = new FusedElementwiseLayer(sum_inputs, operations);
+    NetGraphNode* fused_node = new NetGraphNode(fused_layer);
+    fused_node->input_connections = head->input_connections;
+    fused_node->backprop_connections = tail->backprop_connections;
+    fused_node->output_buffers = tail->output_buffers;
+    fused_node->unique_name = tail->unique_name;
+    fused_node->is_output = tail->is_output;
+
+    std::vector<CombinedTensor*> input_tensors;
+    for (NetGraphConnection& connection : head->input_connections)
+      input_tensors.push_back(connection.node->output_buffers[connection.buffer].combined_tensor);
+    std::vector<CombinedTensor*> output_tensors = {tail->output_buffers[0].combined_tensor};
+    if (!fused_layer->Connect(input_tensors, output_tensors, this))
+      FATAL("Fused layer will not connect: " << fused_layer->GetLayerDescription());
+    fused_node->initialized = true;
+
+    // Redirect the connections to and from the chain
+    for (NetGraphConnection& connection : head->input_connections) {
+      for (NetGraphBackpropConnection& backprop_connection : connection.node->backprop_connections) {
+        if (backprop_connection.node == head)
+          backprop_connection.node = fused_node;
+      }
+    }
+    for (NetGraphNode* node : nodes_) {
+      for (NetGraphConnection& connection : node->input_connections) {
+        if (connection.node == tail)
+          connection.node = fused_node;
+      }
+    }
+    std::replace(output_nodes_.begin(), output_nodes_.end(), tail, fused_node);
+
+    std::ostringstream fused_names;
+    for (NetGraphNode* node : chain) {
+      fused_names << (node == head ? "" : ", ") << node->unique_name;
+      // The buffers inside the chain are not needed anymore
+      if (node != tail)
+        delete node->output_buffers[0].combined_tensor;
+    }
+
+    *std::find(nodes_.begin(), nodes_.end(), head) = fused_node;
+    nodes_.erase(std::remove_if(nodes_.begin(), nodes_.end(), [&](NetGraphNode* node) {
+      return std::find(chain.begin(), chain.end(), node) != chain.end();
+    }), nodes_.end());
+
+    LOGINFO << "Fused nodes " << fused_names.str() << " into " << fused_layer->GetLayerDescription();
+  }
+}
+
+void NetGraph::ShareBuffers() {
+  // A buffer that feeds only one node can be taken over by that node
+  auto is_exclusive = [&](const NetGraphConnection& connection) {
+    unsigned int consumers = 0;
+    for (NetGraphNode* node : nodes_) {
+      for (const NetGraphConnection& other : node->input_connections) {
+        if (other.node == connection.node && other.buffer == connection.buffer)
+          consumers++;
+      }
+    }
+    return consumers == 1 && connection.backprop;
+  };
+
+  for (NetGraphNode* node : nodes_) {
+    if (node->input_connections.size() != 2 || !is_exclusive(node->input_connections[0])
+      || !is_exclusive(node->input_connections[1]))
+      continue;
+
+    ConcatenationLayer* concatenation_layer = dynamic_cast<ConcatenationLayer*>(node->layer);
+    if (concatenation_layer != nullptr && concatenation_layer->UseViews()) {
+      LOGDEBUG << "Node \"" << node->unique_name << "\" concatenates in place";
+    }
+
+    SumLayer* sum_layer = dynamic_cast<SumLayer*>(node->layer);
+    if (sum_layer != nullptr && sum_layer->ShareGradient()) {
+      LOGDEBUG << "Node \"" << node->unique_name << "\" shares its gradient";
+    }
+  }
+}
+
+void NetGraph::UnshareBuffers() {
+  // Gives the tensors that ShareBuffers() may have let into another node's
+  // memory their own memory again, so that each can be resized on its own
+  auto detach = [](Tensor& tensor) {
+    if (!tensor.is_shadow())
+      return;
+    const std::size_t samples = tensor.samples(), width = tensor.width(), height = tensor.height(), maps = tensor.maps();
+    tensor.DeleteIfPossible();
+    tensor.Resize(samples, width, height, maps);
+  };
+
+  for (NetGraphNode* node : nodes_) {
+    if (dynamic_cast<ConcatenationLayer*>(node->layer) == nullptr && dynamic_cast<SumLayer*>(node->layer) == nullptr)
+      continue;
+    for (const NetGraphConnection& connection : node->input_connections) {
+      if (!connection.backprop)
+        continue;
+      CombinedTensor* input = connection.node->output_buffers[connection.buffer].combined_tensor;
+      detach(input->data);
+      detach(input->delta);
+    }
+  }
+}
+
+bool NetGraph::Reshape(unsigned int batch_size, unsigned int width, unsigned int height) {
+  if (batch_size == 0) {
+    LOGERROR << "Batch size needs to be at least 1!";
+    return false;
+  }
+  if (!plan_valid_)
+    CompilePlan();
+
+  // Remember the input shapes in case the new shape has to be undone
+  std::map<NetGraphNode*, std::vector<unsigned int>> old_shapes;
+  for (NetGraphNode* node : input_nodes_) {
+    const Tensor& data = node->output_buffers[0].combined_tensor->data;
+    old_shapes[node] = {(unsigned int)data.samples(), (unsigned int)data.width(), (unsigned int)data.height()};
+  }
+
+  UnshareBuffers();
+
+  std::size_t failed_step = forward_plan_.size();
+  for (std::size_t s = 0; s < forward_plan_.size(); s++) {
+    if (!ReshapeNode(forward_plan_[s], batch_size, width, height)) {
+      failed_step = s;
+      break;
+    }
+  }
+
+  const bool success = failed_step == forward_plan_.size();
+  if (!success) {
+    NetGraphNode* failed_node = forward_plan_[failed_step].node;
+    LOGERROR << "Node \"" << failed_node->unique_name << "\" cannot be reshaped: " << failed_node->layer->GetLayerDescription();
+
+    // The failed node has not changed anything, so reshaping the nodes
+    // before it to the old input shapes restores the graph
+    for (std::size_t s = 0; s < failed_step; s++) {
+      const NetGraphPlanStep& step = forward_plan_[s];
+      std::vector<unsigned int> shape = step.node->is_input ? old_shapes[step.node] : std::vector<unsigned int>(3, 0);
+      if (!ReshapeNode(step, shape[0], shape[1], shape[2]))
+        FATAL("Cannot restore the shape of node \"" << step.node->unique_name << "\"");
+    }
+  }
+
+  if (buffer_sharing_enabled_)
+    ShareBuffers();
+
+  // The plan keeps the same tensors, but the frozen prefix and its cached
+  // features depend on their shapes
+  CompilePlan();
+
+  if (success) {
+    LOGDEBUG << "Reshaped graph to batch size " << batch_size << ", input size " << width << "x" << height;
+  }
+  return success;
+}
+
+bool NetGraph::ReshapeNode(const NetGraphPlanStep& step, unsigned int batch_size, unsigned int width, unsigned int height) {
+  if (step.node->is_input)
+    return step.node->layer->ReshapeInput(batch_size, width, height, step.outputs);
+  return step.node->layer->Reshape(step.inputs, step.outputs, this);
 }
 
 void NetGraph::InitializeNode(NetGraphNode* node) {
@@ -304,103 +565,356 @@ void NetGraph::InitializeNode(NetGraphNode* node) {
 }
 
 void NetGraph::FeedForward() {
+  if (!plan_valid_)
+    CompilePlan();
+
   OnBeforeFeedForward();
-	FeedForward(nodes_, true);
+  if (feature_cache_ == nullptr || !FeedForwardCached()) {
+    for (const NetGraphPlanStep& step : forward_plan_)
+      FeedForward(step);
+  }
+
+  // Partial passes after this one only run the nodes they are asked to
+  for (NetGraphNode* node : nodes_)
+    node->flag_ff_visited = true;
 	OnAfterFeedForward();
 }
 
-void NetGraph::FeedForward(std::vector<NetGraphNode*>& nodes, bool clear_flag) {
-	if (clear_flag)
-		for (NetGraphNode* node : nodes)
-			node->flag_ff_visited = false;
+bool NetGraph::FeedForwardCached() {
+  UpdateTrainedNodes();
+  if (prefix_outputs_.size() == 0 || training_nodes_.size() == 0)
+    return false;
+
+  TrainingLayer* training_layer = dynamic_cast<TrainingLayer*>(training_nodes_[0]->layer);
+  if (!training_layer->GetSampleKeys(sample_keys_))
+    return false;
+  for (CombinedTensor* output : prefix_outputs_) {
+    if (output->data.samples() != sample_keys_.size())
+      return false;
+  }
+
+  // Only skip the prefix if the whole batch is cached
+  bool cached = true;
+  for (std::uint64_t key : sample_keys_)
+    cached &= feature_cache_->Contains(key);
+
+  for (unsigned int sample = 0; cached && sample < sample_keys_.size(); sample++) {
+    if (!feature_cache_->Load(sample_keys_[sample], prefix_features_)) {
+      cached = false;
+      break;
+    }
+    const datum* features = prefix_features_.data_ptr_const();
+    for (CombinedTensor* output : prefix_outputs_) {
+      const std::size_t sample_elements = output->data.elements() / output->data.samples();
+      std::memcpy(output->data.data_ptr(0, 0, 0, sample), features, sample_elements * sizeof(datum));
+      features += sample_elements;
+    }
+  }
+
+  for (unsigned int s = 0; s < forward_plan_.size(); s++) {
+    if (!cached || !prefix_steps_[s])
+      FeedForward(forward_plan_[s]);
+  }
 
-	for (NetGraphNode* node : nodes)
-		FeedForward(node);
+  if (!cached) {
+    for (unsigned int sample = 0; sample < sample_keys_.size(); sample++) {
+      if (feature_cache_->Contains(sample_keys_[sample]))
+        continue;
+      datum* features = prefix_features_.data_ptr();
+      for (CombinedTensor* output : prefix_outputs_) {
+        const std::size_t sample_elements = output->data.elements() / output->data.samples();
+        std::memcpy(features, output->data.data_ptr_const(0, 0, 0, sample), sample_elements * sizeof(datum));
+        features += sample_elements;
+      }
+      feature_cache_->Store(sample_keys_[sample], prefix_features_);
+    }
+  }
+  return true;
 }
 
-void NetGraph::FeedForward(NetGraphNode* node) {
-	if (!node->flag_ff_visited) {
-		// Make sure all input nodes have valid outputs
-		for (NetGraphConnection connection : node->input_connections)
-			FeedForward(connection.node);
+void NetGraph::FeedForward(std::vector<NetGraphNode*>& nodes, bool clear_flag) {
+  if (!plan_valid_)
+    CompilePlan();
+
+  std::vector<NetGraphPlanStep>& plan = partial_forward_plans_[nodes];
+  if (plan.size() == 0) {
+    // Run the part of the plan that the requested nodes depend on. Going
+    // through the plan backwards, a node is needed if a needed node reads it.
+    std::set<NetGraphNode*> needed(nodes.begin(), nodes.end());
+    for (auto step = forward_plan_.rbegin(); step != forward_plan_.rend(); step++) {
+      if (needed.count(step->node) > 0)
+        for (NetGraphConnection& connection : step->node->input_connections)
+          needed.insert(connection.node);
+    }
+    for (const NetGraphPlanStep& step : forward_plan_) {
+      if (needed.count(step.node) > 0)
+        plan.push_back(step);
+    }
+  }
+
+  // Only the requested nodes are run again, dependencies that were already
+  // visited keep their outputs
+  if (clear_flag)
+    for (NetGraphNode* node : nodes)
+      node->flag_ff_visited = false;
+
+  for (const NetGraphPlanStep& step : plan) {
+    if (!step.node->flag_ff_visited) {
+      FeedForward(step);
+      step.node->flag_ff_visited = true;
+    }
+  }
+}
 
-		PrepareNode(node);
+void NetGraph::FeedForward(const NetGraphPlanStep& step) {
+  NetGraphNode* node = step.node;
+  PrepareNode(step);
 #ifdef LAYERTIME
-    auto t_begin = std::chrono::system_clock::now();
+  auto t_begin = std::chrono::system_clock::now();
 #endif
 
-		// Call the Layer::FeedForward method and set the visited flag
-		node->layer->FeedForward();
-    if(layerview_enabled_)
-      for(NetGraphBuffer buffer: node->output_buffers) {
-				for(unsigned int sample = 0; sample < buffer.combined_tensor->data.samples() && sample < 4; sample++) {
-					for(unsigned int map = 0; map < 1; map++) {
-        //for(unsigned int sample = 0; sample < buffer.combined_tensor->data.samples(); sample++) {
-        //  for(unsigned int map = 0; map < buffer.combined_tensor->data.maps(); map++) {
-            std::stringstream ss;
-            ss << node->unique_name << ": " << node->layer->GetLayerDescription() << ", buffer " << buffer.description;
-  #ifdef BUILD_OPENCL
-            buffer.combined_tensor->data.MoveToCPU();
-  #endif
-            viewer.show(&(buffer.combined_tensor->data), ss.str(), false, map, sample);
-          }
+  // Call the Layer::FeedForward method
+  node->layer->FeedForward();
+  if(layerview_enabled_)
+    for(NetGraphBuffer buffer: node->output_buffers) {
+      for(unsigned int sample = 0; sample < buffer.combined_tensor->data.samples() && sample < 4; sample++) {
+        for(unsigned int map = 0; map < 1; map++) {
+      //for(unsigned int sample = 0; sample < buffer.combined_tensor->data.samples(); sample++) {
+      //  for(unsigned int map = 0; map < buffer.combined_tensor->data.maps(); map++) {
+          std::stringstream ss;
+          ss << node->unique_name << ": " << node->layer->GetLayerDescription() << ", buffer " << buffer.description;
+#ifdef BUILD_OPENCL
+          buffer.combined_tensor->data.MoveToCPU();
+#endif
+          viewer.show(&(buffer.combined_tensor->data), ss.str(), false, map, sample);
         }
       }
-    
-		node->flag_ff_visited = true;
+    }
 
 #ifdef LAYERTIME
-    auto t_end = std::chrono::system_clock::now();
-    std::chrono::duration<double> pass_duration = t_end - t_begin;
-    LOGINFO << "FeedFwd Layer " << node->unique_name << " (" << node->layer->GetLayerDescription() << ") time:\t" << pass_duration.count() << "s";
+  auto t_end = std::chrono::system_clock::now();
+  std::chrono::duration<double> pass_duration = t_end - t_begin;
+  LOGINFO << "FeedFwd Layer " << node->unique_name << " (" << node->layer->GetLayerDescription() << ") time:\t" << pass_duration.count() << "s";
 #endif
-	}
 }
 
 void NetGraph::BackPropagate() {
+  if (!plan_valid_)
+    CompilePlan();
+
+  UpdateTrainedNodes();
+
 	OnBeforeBackPropagate();
-	BackPropagate(nodes_, true);
+  for (NetGraphNode* node : nodes_)
+    node->flag_bp_visited = false;
+  for (const NetGraphPlanStep& step : backward_plan_) {
+    BackPropagate(step);
+    step.node->flag_bp_visited = true;
+  }
 	OnAfterBackPropagate();
 }
 
 void NetGraph::BackPropagate(std::vector<NetGraphNode*>& nodes, bool clear_flag) {
-	if (clear_flag)
-		for (NetGraphNode* node : nodes)
-			node->flag_bp_visited = false;
-
-	for (NetGraphNode* node : nodes) {
-		// Check if layer actually needs backprop
-		if(node->layer->local_lr_ > 0 && node->layer->parameters_.size() > 0)
-      BackPropagate(node);
-	}
-}
+  if (!plan_valid_)
+    CompilePlan();
 
-void NetGraph::BackPropagate(NetGraphNode* node) {
-	if (!node->flag_bp_visited) {
-		// Make sure all source nodes have valid gradients
-		for (NetGraphBackpropConnection backprop_connection : node->backprop_connections)
-			BackPropagate(backprop_connection.node);
+  // Drops the cached partial plans if the trained layers changed
+  UpdateTrainedNodes();
+
+  std::vector<NetGraphPlanStep>& plan = partial_backward_plans_[nodes];
+  if (plan.size() == 0)
+    CompileBackwardPlan(nodes, plan);
 
-		bool do_backprop = false;
-		for (NetGraphConnection connection : node->input_connections)
-			do_backprop |= connection.backprop;
+  if (clear_flag)
+    for (NetGraphNode* node : nodes)
+      node->flag_bp_visited = false;
 
+  for (const NetGraphPlanStep& step : plan) {
+    if (!step.node->flag_bp_visited) {
+      BackPropagate(step);
+      step.node->flag_bp_visited = true;
+    }
+  }
+}
+
+void NetGraph::BackPropagate(const NetGraphPlanStep& step) {
+  NetGraphNode* node = step.node;
 #ifdef LAYERTIME
-    auto t_begin = std::chrono::system_clock::now();
+  auto t_begin = std::chrono::system_clock::now();
 #endif
 
-		PrepareNode(node);
-		node->layer->SetBackpropagationEnabled(do_backprop);
-		// Call the Layer::FeedForward method and set the visited flag
-		node->layer->BackPropagate();
-		node->flag_bp_visited = true;
+  PrepareNode(step);
+  node->layer->SetBackpropagationEnabled(step.backprop);
+  // Call the Layer::BackPropagate method
+  node->layer->BackPropagate();
 
 #ifdef LAYERTIME
-    auto t_end = std::chrono::system_clock::now();
-    std::chrono::duration<double> pass_duration = t_end - t_begin;
-    LOGINFO << "BackProp Layer " << node->unique_name << " (" << node->layer->GetLayerDescription() << ") time:\t" << pass_duration.count() << "s";
+  auto t_end = std::chrono::system_clock::now();
+  std::chrono::duration<double> pass_duration = t_end - t_begin;
+  LOGINFO << "BackProp Layer " << node->unique_name << " (" << node->layer->GetLayerDescription() << ") time:\t" << pass_duration.count() << "s";
+#endif
+}
+
+bool NetGraph::NeedsBackPropagation(NetGraphNode* node) const {
+  return node->layer->local_lr_ > 0 && node->layer->parameters_.size() > 0;
+}
+
+bool NetGraph::UpdateTrainedNodes() {
+  // The backward plan and the frozen prefix depend on which layers are
+  // trained, which can change at any time through their local learning rate
+  bool changed = backward_plan_starts_.size() != nodes_.size();
+  backward_plan_starts_.resize(nodes_.size());
+  for (unsigned int n = 0; n < nodes_.size(); n++) {
+    const bool start = NeedsBackPropagation(nodes_[n]);
+    changed |= backward_plan_starts_[n] != start;
+    backward_plan_starts_[n] = start;
+  }
+
+  if (changed) {
+    CompileBackwardPlan(nodes_, backward_plan_);
+    partial_backward_plans_.clear();
+    CompileFeaturePrefix();
+  }
+  return changed;
+}
+
+NetGraphPlanStep NetGraph::CreatePlanStep(NetGraphNode* node) const {
+  NetGraphPlanStep step;
+  step.node = node;
+  for (const NetGraphConnection& connection : node->input_connections) {
+    step.inputs.push_back(connection.node->output_buffers[connection.buffer].combined_tensor);
+    step.backprop |= connection.backprop;
+  }
+  for (const NetGraphBuffer& buffer : node->output_buffers)
+    step.outputs.push_back(buffer.combined_tensor);
+  return step;
+}
+
+void NetGraph::CompilePlan() {
+  // The order is the same as that of a depth-first search from every node
+  // in turn, which is how the graph used to be run
+  forward_plan_.clear();
+  std::set<NetGraphNode*> visited;
+  std::function<void(NetGraphNode*)> visit = [&](NetGraphNode* node) {
+    if (!visited.insert(node).second)
+      return;
+    for (NetGraphConnection& connection : node->input_connections)
+      visit(connection.node);
+    forward_plan_.push_back(CreatePlanStep(node));
+  };
+  for (NetGraphNode* node : nodes_)
+    visit(node);
+
+  // Compiled on the next pass
+  partial_forward_plans_.clear();
+  partial_backward_plans_.clear();
+  backward_plan_.clear();
+  backward_plan_starts_.clear();
+  prefix_steps_.clear();
+  prefix_outputs_.clear();
+  plan_valid_ = true;
+}
+
+void NetGraph::CompileBackwardPlan(std::vector<NetGraphNode*>& nodes, std::vector<NetGraphPlanStep>& plan) {
+  // A node's gradient is complete once all nodes that read its outputs
+  // have been backpropagated
+  plan.clear();
+  std::set<NetGraphNode*> visited;
+  std::function<void(NetGraphNode*)> visit = [&](NetGraphNode* node) {
+    if (!visited.insert(node).second)
+      return;
+    for (NetGraphBackpropConnection& backprop_connection : node->backprop_connections)
+      visit(backprop_connection.node);
+    plan.push_back(CreatePlanStep(node));
+  };
+  for (NetGraphNode* node : nodes) {
+    // Check if layer actually needs backprop
+    if (NeedsBackPropagation(node))
+      visit(node);
+  }
+
+  // Nodes outside of the plan have no trained layers upstream, so their
+  // gradients are not needed. This stops the backward pass at the frozen
+  // part of the net.
+  for (NetGraphPlanStep& step : plan) {
+    step.backprop = false;
+    for (const NetGraphConnection& connection : step.node->input_connections)
+      step.backprop |= connection.backprop && visited.count(connection.node) > 0;
+  }
+}
+
+void NetGraph::CompileFeaturePrefix() {
+  prefix_steps_.assign(forward_plan_.size(), false);
+  prefix_outputs_.clear();
+  if (feature_cache_ == nullptr)
+    return;
+  feature_cache_->Clear();
+
+  // A node is in the frozen prefix if it is not trained, computes the same
+  // output for the same input every time and only reads the input node or
+  // other nodes in the prefix
+  std::set<NetGraphNode*> prefix;
+  bool has_parameters = false;
+  for (unsigned int s = 0; s < forward_plan_.size(); s++) {
+    NetGraphNode* node = forward_plan_[s].node;
+    Layer* layer = node->layer;
+    bool frozen = !node->is_input && node->input_connections.size() > 0 && !NeedsBackPropagation(node) &&
+      layer->IsDeterministic() && dynamic_cast<StatLayer*>(layer) == nullptr &&
+      dynamic_cast<LossFunctionLayer*>(layer) == nullptr && dynamic_cast<TrainingLayer*>(layer) == nullptr;
+    for (const NetGraphConnection& connection : node->input_connections)
+      frozen &= connection.node->is_input || prefix.count(connection.node) > 0;
+    for (CombinedTensor* output : forward_plan_[s].outputs)
+      frozen &= !output->is_dynamic;
+
+    if (frozen) {
+      prefix.insert(node);
+      prefix_steps_[s] = true;
+      has_parameters |= layer->parameters_.size() > 0;
+    }
+  }
+
+  // Cache the prefix outputs that are read by the rest of the net
+  std::size_t sample_elements = 0;
+  for (unsigned int s = 0; s < forward_plan_.size(); s++) {
+    if (!prefix_steps_[s])
+      continue;
+    NetGraphNode* node = forward_plan_[s].node;
+    for (unsigned int b = 0; b < node->output_buffers.size(); b++) {
+      bool needed = node->is_output;
+      for (NetGraphNode* other_node : nodes_) {
+        for (const NetGraphConnection& connection : other_node->input_connections)
+          needed |= connection.node == node && connection.buffer == b && prefix.count(other_node) == 0;
+      }
+      CombinedTensor* output = node->output_buffers[b].combined_tensor;
+      if (needed && std::find(prefix_outputs_.begin(), prefix_outputs_.end(), output) == prefix_outputs_.end()) {
+        prefix_outputs_.push_back(output);
+        sample_elements += output->data.elements() / output->data.samples();
+      }
+    }
+  }
+
+  // Without parameters, loading the features is not worth it
+  if (!has_parameters || prefix_outputs_.size() == 0) {
+    prefix_steps_.assign(forward_plan_.size(), false);
+    prefix_outputs_.clear();
+    return;
+  }
+
+  prefix_features_.Resize(1, sample_elements, 1, 1);
+  LOGINFO << "Caching the outputs of " << prefix.size() << " frozen nodes, " << sample_elements << " values per sample";
+}
+
+void NetGraph::EnableFeatureCache(const std::string& path) {
+#ifdef BUILD_OPENCL
+  UNREFERENCED_PARAMETER(path);
+  LOGWARN << "The feature cache is not supported with OpenCL";
+#else
+  delete feature_cache_;
+  feature_cache_ = new FeatureCache(path);
+
+  // Look for the frozen prefix on the next pass
+  backward_plan_starts_.clear();
 #endif
-	}
 }
 
 void NetGraph::GetParameters (std::vector< CombinedTensor* >& parameters) {
@@ -412,7 +926,128 @@ void NetGraph::GetParameters (std::vector< CombinedTensor* >& parameters) {
   }
 }
 
-void NetGraph::SerializeParameters(std::ostream& output) {
+void NetGraph::GetConsolidatedParameters(std::vector<CombinedTensor*>& parameters) {
+  if (!parameter_arena_enabled_) {
+    GetParameters(parameters);
+    return;
+  }
+
+  // Parameters can leave the arena, e.g. when deserialization resizes them
+  ConsolidateParameters();
+
+  std::vector<CombinedTensor*> all_parameters;
+  GetParameters(all_parameters);
+  if (parameter_arena_ != nullptr)
+    parameters.push_back(parameter_arena_);
+  for (CombinedTensor* layer_parameters : all_parameters) {
+    if (!IsInParameterArena(layer_parameters))
+      parameters.push_back(layer_parameters);
+  }
+}
+
+void NetGraph::ConsolidateParameters() {
+  std::vector<CombinedTensor*> all_parameters;
+  GetParameters(all_parameters);
+
+  bool consolidated = parameter_arena_ != nullptr;
+  for (CombinedTensor* layer_parameters : all_parameters)
+    consolidated &= layer_parameters->is_dynamic || IsInParameterArena(layer_parameters);
+  if (consolidated)
+    return;
+
+  std::vector<CombinedTensor*> arena_parameters;
+  std::vector<std::size_t> offsets;
+  std::size_t elements = 0;
+  for (CombinedTensor* layer_parameters : all_parameters) {
+    if (layer_parameters->is_dynamic)
+      continue;
+    arena_parameters.push_back(layer_parameters);
+    offsets.push_back(elements);
+    const std::size_t padding = parameter_arena_alignment - 1;
+    elements += ((layer_parameters->data.elements() + padding) / parameter_arena_alignment) * parameter_arena_alignment;
+  }
+
+  if (elements == 0)
+    return;
+
+  // The parameters may still be views into the old arena, so it is
+  // deleted last
+  CombinedTensor* arena = new CombinedTensor(1, elements, 1, 1);
+  arena->data.Clear();
+  arena->delta.Clear();
+  for (unsigned int p = 0; p < arena_parameters.size(); p++) {
+    Tensor& data = arena_parameters[p]->data;
+    Tensor& delta = arena_parameters[p]->delta;
+    std::memcpy(arena->data.data_ptr() + offsets[p], data.data_ptr_const(), data.elements() * sizeof(datum));
+    std::memcpy(arena->delta.data_ptr() + offsets[p], delta.data_ptr_const(), delta.elements() * sizeof(datum));
+    data.View(arena->data, offsets[p], data.samples(), data.width(), data.height(), data.maps());
+    delta.View(arena->delta, offsets[p], delta.samples(), delta.width(), delta.height(), delta.maps());
+  }
+
+  delete parameter_arena_;
+  parameter_arena_ = arena;
+  LOGDEBUG << "Moved " << arena_parameters.size() << " parameter sets into an arena of " << elements << " elements";
+}
+
+bool NetGraph::IsInParameterArena(CombinedTensor* parameters) const {
+  if (parameter_arena_ == nullptr)
+    return false;
+
+  const datum* data_begin = parameter_arena_->data.data_ptr_const();
+  const datum* delta_begin = parameter_arena_->delta.data_ptr_const();
+  const std::size_t elements = parameter_arena_->data.elements();
+  return parameters->data.is_shadow() && parameters->delta.is_shadow() &&
+    parameters->data.data_ptr_const() >= data_begin &&
+    parameters->data.data_ptr_const() + parameters->data.elements() <= data_begin + elements &&
+    parameters->delta.data_ptr_const() >= delta_begin &&
+    parameters->delta.data_ptr_const() + parameters->delta.elements() <= delta_begin + elements;
+}
+
+void NetGraph::SerializeParameters(std::ostream& output, bool indexed) {
+  if (indexed) {
+    std::vector<ParameterSet> parameter_sets;
+    std::vector<Tensor*> temporary_tensors;
+    for (NetGraphNode* node : nodes_) {
+      Layer* layer = node->layer;
+      if (layer->parameters().size() == 0)
+        continue;
+
+      ParameterSet parameter_set;
+      parameter_set.name = node->unique_name;
+      if (layer->IsSerializationAware()) {
+        // Capture the layer's own format and split it into metadata and tensors
+        std::stringstream layer_stream;
+        if (!layer->Serialize(layer_stream)) {
+          LOGERROR << "Could not serialize " << node->unique_name;
+          continue;
+        }
+        unsigned int metadata_length = 0;
+        unsigned int parameter_set_size = 0;
+        layer_stream.read((char*)&metadata_length, sizeof(unsigned int) / sizeof(char));
+        parameter_set.metadata.resize(metadata_length);
+        layer_stream.read(&parameter_set.metadata[0], metadata_length);
+        layer_stream.read((char*)&parameter_set_size, sizeof(unsigned int) / sizeof(char));
+        for (unsigned int p = 0; p < parameter_set_size; p++) {
+          Tensor* tensor = new Tensor();
+          tensor->Deserialize(layer_stream);
+          temporary_tensors.push_back(tensor);
+          parameter_set.tensors.push_back(tensor);
+        }
+      } else {
+        for (unsigned int p = 0; p < layer->parameters().size(); p++)
+          parameter_set.tensors.push_back(&(layer->parameters()[p]->data));
+      }
+      parameter_sets.push_back(parameter_set);
+    }
+
+    if (!IndexedParameterFile::Write(output, parameter_sets))
+      LOGERROR << "Could not write indexed parameter file";
+
+    for (Tensor* tensor : temporary_tensors)
+      delete tensor;
+    return;
+  }
+
 	uint64_t magic = CN24_PAREX_MAGIC;
 	output.write((char*)&magic, sizeof(uint64_t)/sizeof(char));
     
@@ -451,7 +1086,11 @@ void NetGraph::SerializeParameters(std::ostream& output) {
 	}
 }
 
-void NetGraph::DeserializeParameters(std::istream& input) {
+bool NetGraph::DeserializeParameters(std::istream& input) {
+  // Cached features were computed with the old parameters
+  if (feature_cache_ != nullptr)
+    feature_cache_->Clear();
+
   // Check for right magic number
 	uint64_t magic = 0;
 	input.read((char*)&magic, sizeof(uint64_t)/sizeof(char));
@@ -555,7 +1194,9 @@ void NetGraph::DeserializeParameters(std::istream& input) {
 						bool success = layer->Deserialize(metadata_length, metadata_cstr, parameter_set_size, input);
 						if(!success) {
 							LOGERROR << "Error when deserializing " << node_name << ", lost the stream";
-							return;
+							delete[] node_name_cstr;
+							delete[] metadata_cstr;
+							return false;
 						}
 					} else {
 						// Read parameters
@@ -594,10 +1235,201 @@ void NetGraph::DeserializeParameters(std::istream& input) {
 
 			delete[] node_name_cstr;
 		}
+	} else if(magic == CN24_PARIDX_MAGIC) {
+		IndexedParameterFile file(input);
+		if (!file.IsValid()) {
+			LOGERROR << "Could not read indexed parameter file";
+			return false;
+		}
+		ApplyParameterFile(file, false);
 	} else {
     FATAL("Wrong magic at start of stream!");
   }
 
+	return true;
+}
+
+bool NetGraph::LoadParameters(const std::string& path) {
+  std::ifstream input(path, std::ios::in | std::ios::binary);
+  if (!input.good()) {
+    LOGERROR << "Cannot open " << path;
+    return false;
+  }
+
+  uint64_t magic = 0;
+  input.read((char*)&magic, sizeof(uint64_t)/sizeof(char));
+  if (magic == CN24_PAR_MAGIC || magic == CN24_PAREX_MAGIC) {
+    // Sequential formats are read as a stream
+    input.seekg(0, std::ios::beg);
+    return DeserializeParameters(input);
+  } else if (magic != CN24_PARIDX_MAGIC) {
+    LOGERROR << path << " is not a parameter file";
+    return false;
+  }
+  input.close();
+
+  IndexedParameterFile* file = new IndexedParameterFile(path);
+  if (!file->IsValid()) {
+    delete file;
+    LOGERROR << "Could not read indexed parameter file " << path;
+    return false;
+  }
+
+  const bool viewed = ApplyParameterFile(*file, true);
+
+  // Parameters of nodes that were not in the new file still point into
+  // the old one
+  DetachParameters(parameter_file_);
+  delete parameter_file_;
+  parameter_file_ = nullptr;
+
+  if (viewed)
+    parameter_file_ = file;
+  else
+    delete file;
+  return true;
+}
+
+bool NetGraph::ApplyParameterFile(IndexedParameterFile& file, bool zero_copy) {
+  // Cached features were computed with the old parameters
+  if (feature_cache_ != nullptr)
+    feature_cache_->Clear();
+
+  std::map<std::string, NetGraphNode*> nodes_by_name;
+  for (NetGraphNode* node : nodes_)
+    nodes_by_name[node->unique_name] = node;
+
+  bool viewed = false;
+  for (unsigned int s = 0; s < file.GetSetCount(); s++) {
+    const std::string& node_name = file.GetName(s);
+    const unsigned int parameter_set_size = file.GetTensorCount(s);
+
+    std::map<std::string, NetGraphNode*>::iterator node_it = nodes_by_name.find(node_name);
+    if (node_it == nodes_by_name.end()) {
+      if (node_name.compare(0, 2, "__") == 0) {
+        LOGDEBUG << "Skipping metadata segment " << node_name;
+      } else {
+        LOGWARN << "Could not find node \"" << node_name << "\"";
+      }
+      continue;
+    }
+
+    NetGraphNode* node = node_it->second;
+    Layer* layer = node->layer;
+    if (layer->parameters().size() != parameter_set_size) {
+      LOGERROR << "Node name matches, but parameter set size does not";
+      continue;
+    }
+
+    if (layer->IsSerializationAware()) {
+      // The layer reads its own format
+      std::stringstream layer_stream;
+      for (unsigned int p = 0; p < parameter_set_size; p++) {
+        Tensor tensor;
+        file.Copy(s, p, tensor);
+        tensor.Serialize(layer_stream);
+      }
+      const std::string& metadata = file.GetMetadata(s);
+      if (!layer->Deserialize(metadata.length(), metadata.c_str(), parameter_set_size, layer_stream))
+        LOGERROR << "Error when deserializing " << node_name;
+      continue;
+    }
+
+    for (unsigned int p = 0; p < parameter_set_size; p++) {
+      Tensor& data = layer->parameters()[p]->data;
+      unsigned int elements_before = data.elements();
+      // Views are not possible with OpenCL
+      if (zero_copy && file.View(s, p, data))
+        viewed = true;
+      else
+        file.Copy(s, p, data);
+      unsigned int elements_after = data.elements();
+      LOGDEBUG << "Loaded parameters for node \"" << node->unique_name << "\" parameter set " << p << ": " << data;
+      if (elements_before != elements_after) {
+        LOGERROR << "Deserialization changed layer parameter count!";
+      }
+    }
+  }
+  return viewed;
+}
+
+void NetGraph::DetachParameters(IndexedParameterFile* file) {
+  if (file == nullptr)
+    return;
+
+  std::vector<CombinedTensor*> parameters;
+  GetParameters(parameters);
+  for (CombinedTensor* layer_parameters : parameters) {
+    Tensor& data = layer_parameters->data;
+    if (!data.is_shadow() || !file->Contains(data.data_ptr_const()))
+      continue;
+
+    Tensor copy(data, true);
+    data.DeleteIfPossible();
+    data.Resize(copy);
+    Tensor::Copy(copy, data);
+  }
+}
+
+bool NetGraph::ShareParameters(NetGraph& source) {
+  if (&source == this)
+    return true;
+
+  std::map<std::string, NetGraphNode*> source_nodes;
+  for (NetGraphNode* node : source.nodes_)
+    source_nodes[node->unique_name] = node;
+
+  // Check all nodes first so that a mismatch doesn't leave the graph half
+  // shared
+  std::vector<CombinedTensor*> parameters, shared_parameters;
+  for (NetGraphNode* node : nodes_) {
+    const std::vector<CombinedTensor*>& layer_parameters = node->layer->parameters();
+    if (layer_parameters.size() == 0)
+      continue;
+
+    std::map<std::string, NetGraphNode*>::iterator node_it = source_nodes.find(node->unique_name);
+    if (node_it == source_nodes.end() || node_it->second->layer->parameters().size() != layer_parameters.size()) {
+      LOGERROR << "Node \"" << node->unique_name << "\" has no matching parameters in the source graph";
+      return false;
+    }
+
+    for (unsigned int p = 0; p < layer_parameters.size(); p++) {
+      const Tensor& data = layer_parameters[p]->data;
+      const Tensor& shared_data = node_it->second->layer->parameters()[p]->data;
+      if (data.samples() != shared_data.samples() || data.width() != shared_data.width() ||
+          data.height() != shared_data.height() || data.maps() != shared_data.maps()) {
+        LOGERROR << "Parameter set " << p << " of node \"" << node->unique_name << "\" has a different shape: "
+          << data << " vs. " << shared_data;
+        return false;
+      }
+      parameters.push_back(layer_parameters[p]);
+      shared_parameters.push_back(node_it->second->layer->parameters()[p]);
+    }
+  }
+
+  // Copied parameters must not be written into a mapped file
+  DetachParameters(parameter_file_);
+  for (unsigned int p = 0; p < parameters.size(); p++) {
+    if (parameters[p]->is_dynamic || shared_parameters[p]->is_dynamic) {
+      Tensor::Copy(shared_parameters[p]->data, parameters[p]->data);
+      continue;
+    }
+    parameters[p]->data.Shadow(shared_parameters[p]->data);
+    parameters[p]->delta.Shadow(shared_parameters[p]->delta);
+  }
+
+  // Our own copies of the parameters are not used anymore
+  delete parameter_arena_;
+  parameter_arena_ = nullptr;
+  parameter_arena_enabled_ = false;
+  delete parameter_file_;
+  parameter_file_ = nullptr;
+
+  if (feature_cache_ != nullptr)
+    feature_cache_->Clear();
+
+  LOGDEBUG << "Sharing " << parameters.size() << " parameter sets";
+  return true;
 }
 
 void NetGraph::InitializeWeights(bool no_init) {
@@ -609,6 +1441,9 @@ void NetGraph::InitializeWeights(bool no_init) {
 
 	for (NetGraphNode* node : nodes_)
 		node->flag_bp_visited = false;
+
+	if (feature_cache_ != nullptr)
+		feature_cache_->Clear();
 }
 
 void NetGraph::InitializeWeights(NetGraphNode* node, bool no_init) {
@@ -624,19 +1459,20 @@ void NetGraph::InitializeWeights(NetGraphNode* node, bool no_init) {
 	}
 }
 
-void NetGraph::PrepareNode(NetGraphNode* node) {
+void NetGraph::PrepareNode(const NetGraphPlanStep& step) {
 #ifdef BUILD_OPENCL
+	NetGraphNode* node = step.node;
 	if (!node->layer->IsGPUMemoryAware()) {
 #ifdef LAYERTIME
 		auto t_begin = std::chrono::system_clock::now();
 #endif
-		for (NetGraphConnection connection : node->input_connections) {
-			connection.node->output_buffers[connection.buffer].combined_tensor->data.MoveToCPU();
-			connection.node->output_buffers[connection.buffer].combined_tensor->delta.MoveToCPU();
+		for (CombinedTensor* input : step.inputs) {
+			input->data.MoveToCPU();
+			input->delta.MoveToCPU();
 		}
-		for (NetGraphBuffer& buffer : node->output_buffers) {
-			buffer.combined_tensor->data.MoveToCPU();
-			buffer.combined_tensor->delta.MoveToCPU();
+		for (CombinedTensor* output : step.outputs) {
+			output->data.MoveToCPU();
+			output->delta.MoveToCPU();
 		}
 #ifdef LAYERTIME
 		auto t_end = std::chrono::system_clock::now();
@@ -645,7 +1481,7 @@ void NetGraph::PrepareNode(NetGraphNode* node) {
 #endif
 	}
 #else
-  UNREFERENCED_PARAMETER(node);
+  UNREFERENCED_PARAMETER(step);
 #endif
 }
 
@@ -53,6 +53,13 @@ bool NonLinearityLayer::Connect (const CombinedTensor* input,
   return valid;
 }
 
+bool NonLinearityLayer::Reshape (const CombinedTensor* input,
+                                 CombinedTensor* output) {
+  output->Resize (input->data.samples(), input->data.width(),
+                  input->data.height(), input->data.maps());
+  return Connect (input, output);
+}
+
 
 
 }
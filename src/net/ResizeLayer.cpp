@@ -83,6 +83,13 @@ bool ResizeLayer::Connect (const CombinedTensor* input,
   return true;
 }
 
+bool ResizeLayer::Reshape (const CombinedTensor* input,
+                           CombinedTensor* output) {
+  output->Resize (input->data.samples(), input->data.width() + borderx_,
+                  input->data.height() + bordery_, input->data.maps());
+  return Connect (input, output);
+}
+
 void ResizeLayer::FeedForward() {
 #ifdef BUILD_OPENCL
   output_->data.MoveToCPU(true);
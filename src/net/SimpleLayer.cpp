@@ -45,6 +45,18 @@ bool SimpleLayer::Connect (const std::vector< CombinedTensor* >& inputs,
   return true;
 }
 
+bool SimpleLayer::Reshape (const std::vector< CombinedTensor* >& inputs,
+                           const std::vector< CombinedTensor* >& outputs,
+                           const NetStatus* net ){
+  UNREFERENCED_PARAMETER(net);
+  if(inputs.size() != 1 || outputs.size() != 1 || inputs[0] != input_ || outputs[0] != output_) {
+    LOGERROR << "Can only reshape the connected input and output";
+    return false;
+  }
+
+  return Reshape(input_, output_);
+}
+
 void SimpleLayer::CreateBufferDescriptors(std::vector<NetGraphBuffer>& buffers) {
 	NetGraphBuffer buffer;
 	buffer.description = "Output";
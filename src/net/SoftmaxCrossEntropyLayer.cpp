@@ -0,0 +1,204 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+#include <cmath>
+
+#include "Log.h"
+#include "CombinedTensor.h"
+
+#include "SoftmaxCrossEntropyLayer.h"
+
+namespace Conv {
+
+SoftmaxCrossEntropyLayer::SoftmaxCrossEntropyLayer(const datum loss_weight)
+ : Layer(JSON::object()), loss_weight_(loss_weight) {
+  LOGDEBUG << "Instance created.";
+}
+
+bool SoftmaxCrossEntropyLayer::CreateOutputs ( const std::vector< CombinedTensor* >& inputs,
+                                 std::vector< CombinedTensor* >& outputs ) {
+  UNREFERENCED_PARAMETER(outputs);
+  // Validate input node count
+  if ( inputs.size() != 3 ) {
+    LOGERROR << "Need exactly 3 inputs to calculate loss function!";
+    return false;
+  }
+
+  CombinedTensor* first = inputs[0];
+  CombinedTensor* second = inputs[1];
+  CombinedTensor* third = inputs[2];
+
+  // Check for null pointers
+  if ( first == nullptr || second == nullptr || third == nullptr ) {
+    LOGERROR << "Null pointer node supplied";
+    return false;
+  }
+
+  if ( first->data.samples() != second->data.samples() ) {
+    LOGERROR << "Inputs need the same number of samples!";
+    return false;
+  }
+
+  if ( first->data.elements() != second->data.elements() ) {
+    LOGERROR << "Inputs need the same number of elements!";
+    LOGERROR << " Net input: " << first->data;
+    LOGERROR << " Label input: " << second->data;
+    return false;
+  }
+
+  if ( first->data.samples() != third->data.samples() ) {
+    LOGERROR << "Inputs need the same number of samples!";
+    return false;
+  }
+
+  if ( first->data.maps() < 2 ) {
+    LOGERROR << "Softmax needs at least two maps!";
+    return false;
+  }
+
+  // Needs no outputs
+  return true;
+}
+
+bool SoftmaxCrossEntropyLayer::Connect ( const std::vector< CombinedTensor* >& inputs,
+                           const std::vector< CombinedTensor* >& outputs,
+                           const NetStatus* net ) {
+  UNREFERENCED_PARAMETER(net);
+  // Needs exactly three inputs to calculate the loss
+  if ( inputs.size() != 3 )
+    return false;
+
+  CombinedTensor* first = inputs[0];
+  CombinedTensor* second = inputs[1];
+  CombinedTensor* third = inputs[2];
+  bool valid = first != nullptr && second != nullptr && third != nullptr &&
+               first->data.samples() == second->data.samples() &&
+               first->data.elements() == second->data.elements() &&
+               first->data.samples() == third->data.samples() &&
+               first->data.maps() > 1 &&
+               outputs.size() == 0;
+
+  if ( valid ) {
+    first_ = first;
+    second_ = second;
+    third_ = third;
+
+    maximum_.Resize(first->data.samples(), first->data.width(), first->data.height(), 1);
+    exp_sum_.Resize(first->data.samples(), first->data.width(), first->data.height(), 1);
+  }
+
+  return valid;
+}
+
+bool SoftmaxCrossEntropyLayer::Reshape ( const std::vector< CombinedTensor* >& inputs,
+                                         const std::vector< CombinedTensor* >& outputs,
+                                         const NetStatus* net ) {
+  std::vector<CombinedTensor*> no_outputs;
+  return CreateOutputs ( inputs, no_outputs ) && Connect ( inputs, outputs, net );
+}
+
+void SoftmaxCrossEntropyLayer::FeedForward() {
+  const unsigned int samples = (unsigned int)first_->data.samples();
+  const unsigned int maps = (unsigned int)first_->data.maps();
+  const unsigned int plane = (unsigned int)(first_->data.width() * first_->data.height());
+
+  // We write the deltas at this point, because
+  // CalculateLossFunction() is called before BackPropagate().
+  sample_loss_.assign(samples, 0);
+
+#pragma omp parallel for default(shared)
+  for ( unsigned int sample = 0; sample < samples; sample++ ) {
+    const datum* scores = first_->data.data_ptr_const(0, 0, 0, sample);
+    const datum* labels = second_->data.data_ptr_const(0, 0, 0, sample);
+    datum* delta = first_->delta.data_ptr(0, 0, 0, sample);
+#ifdef ERROR_LAYER_IGNORE_WEIGHTS
+    const datum* weights = nullptr;
+#else
+    const datum* weights = third_->data.data_ptr_const(0, 0, 0, sample);
+#endif
+    datum* maximum = maximum_.data_ptr(0, 0, 0, sample);
+    datum* exp_sum = exp_sum_.data_ptr(0, 0, 0, sample);
+
+    // All loops run over the pixels of one map innermost, so they follow
+    // memory and vectorise
+    for ( unsigned int p = 0; p < plane; p++ )
+      maximum[p] = scores[p];
+    for ( unsigned int map = 1; map < maps; map++ ) {
+      const datum* map_scores = scores + map * plane;
+      for ( unsigned int p = 0; p < plane; p++ )
+        maximum[p] = map_scores[p] > maximum[p] ? map_scores[p] : maximum[p];
+    }
+
+    for ( unsigned int p = 0; p < plane; p++ )
+      exp_sum[p] = 0;
+    for ( unsigned int map = 0; map < maps; map++ ) {
+      const datum* map_scores = scores + map * plane;
+      datum* map_delta = delta + map * plane;
+      for ( unsigned int p = 0; p < plane; p++ ) {
+        // Keep exp(x - max) in the delta for now
+        map_delta[p] = std::exp(map_scores[p] - maximum[p]);
+        exp_sum[p] += map_delta[p];
+      }
+    }
+
+    // log p_c = x_c - max - log(sum). With t the labels, the loss is
+    // -sum_c t_c log p_c and its gradient is p_c * sum(t) - t_c.
+    for ( unsigned int p = 0; p < plane; p++ )
+      exp_sum[p] = std::log(exp_sum[p]);
+
+    long double loss = 0;
+    for ( unsigned int map = 0; map < maps; map++ ) {
+      const datum* map_scores = scores + map * plane;
+      const datum* map_labels = labels + map * plane;
+      datum* map_delta = delta + map * plane;
+      datum map_loss = 0;
+      for ( unsigned int p = 0; p < plane; p++ ) {
+        const datum weight = (weights != nullptr ? weights[p] : (datum)1.0) * loss_weight_;
+        const datum log_probability = map_scores[p] - maximum[p] - exp_sum[p];
+        map_loss -= weight * map_labels[p] * log_probability;
+        // The delta now becomes weight * p_c
+        map_delta[p] = weight * map_delta[p] * std::exp(-exp_sum[p]);
+      }
+      loss += map_loss;
+    }
+
+    // Finish the gradient: weight * (p_c * sum(t) - t_c), reusing the
+    // maximum buffer for sum(t)
+    for ( unsigned int p = 0; p < plane; p++ )
+      maximum[p] = 0;
+    for ( unsigned int map = 0; map < maps; map++ ) {
+      const datum* map_labels = labels + map * plane;
+      for ( unsigned int p = 0; p < plane; p++ )
+        maximum[p] += map_labels[p];
+    }
+    for ( unsigned int map = 0; map < maps; map++ ) {
+      const datum* map_labels = labels + map * plane;
+      datum* map_delta = delta + map * plane;
+      for ( unsigned int p = 0; p < plane; p++ ) {
+        const datum weight = (weights != nullptr ? weights[p] : (datum)1.0) * loss_weight_;
+        map_delta[p] = map_delta[p] * maximum[p] - weight * map_labels[p];
+      }
+    }
+
+    sample_loss_[sample] = loss;
+  }
+
+  // Summed in sample order so the loss does not depend on the schedule
+  current_loss_ = 0;
+  for ( unsigned int sample = 0; sample < samples; sample++ )
+    current_loss_ += sample_loss_[sample];
+}
+
+void SoftmaxCrossEntropyLayer::BackPropagate() {
+  // The deltas are already written in to the input CombinedTensors, so
+  // there is nothing to do now.
+}
+
+datum SoftmaxCrossEntropyLayer::CalculateLossFunction() {
+  return (datum)current_loss_;
+}
+
+}
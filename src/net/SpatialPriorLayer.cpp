@@ -57,6 +57,13 @@ bool SpatialPriorLayer::Connect ( const CombinedTensor* input,
   return true;
 }
 
+bool SpatialPriorLayer::Reshape ( const CombinedTensor* input,
+                                  CombinedTensor* output ) {
+  output->Resize ( input->data.samples(), input->data.width(),
+                   input->data.height(), input->data.maps() + 2 );
+  return Connect ( input, output );
+}
+
 void SpatialPriorLayer::FeedForward() {
   output_->data.Clear ( 1.0 );
   
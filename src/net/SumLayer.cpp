@@ -87,7 +87,7 @@ bool SumLayer::Connect (const std::vector< CombinedTensor* >& inputs,
   }
   
   if((output->data.elements() != input_a->data.elements())
-    && (output_->data.elements() != input_b->data.elements())) {
+    && (output->data.elements() != input_b->data.elements())) {
     LOGERROR << "Wrong output dimensions!";
     return false;
   }
@@ -102,15 +102,72 @@ bool SumLayer::Connect (const std::vector< CombinedTensor* >& inputs,
   return true;
 }
 
+bool SumLayer::Reshape (const std::vector< CombinedTensor* >& inputs,
+                           const std::vector< CombinedTensor* >& outputs,
+                           const NetStatus* status ) {
+  if(inputs.size() != 2 || outputs.size() != 1) {
+    LOGERROR << "Needs two inputs and one output!";
+    return false;
+  }
+
+  CombinedTensor* input_a = inputs[0];
+  CombinedTensor* input_b = inputs[1];
+
+  if(input_a->data.samples() != input_b->data.samples() ||
+    input_a->data.width() != input_b->data.width() ||
+    input_a->data.height() != input_b->data.height() ||
+    input_a->data.maps() != input_b->data.maps()) {
+    LOGERROR << "Dimensions don't match!";
+    return false;
+  }
+
+  // NetGraph lets the inputs share the gradient again if possible
+  outputs[0]->Resize(input_a->data.samples(), input_a->data.width(),
+    input_a->data.height(), input_a->data.maps());
+  return Connect(inputs, outputs, status);
+}
+
 void SumLayer::FeedForward() {
   TensorMath::ADD(input_a_->data, input_b_->data, output_->data);
 }
 
 void SumLayer::BackPropagate() {
+  // The gradient of a sum is the same for both summands
+  if(IsSharingGradient())
+    return;
+
+#pragma omp parallel for default(shared)
   for(unsigned int sample = 0; sample < samples_; sample++) {
     Tensor::CopySample(output_->delta, sample, input_a_->delta, sample);
     Tensor::CopySample(output_->delta, sample, input_b_->delta, sample);
   }
 }
 
+bool SumLayer::ShareGradient() {
+  if(input_a_->is_dynamic || input_b_->is_dynamic || output_->is_dynamic)
+    return false;
+
+  // Don't take the memory of a Tensor that already uses someone else's
+  if(input_a_->delta.is_shadow() || input_b_->delta.is_shadow())
+    return false;
+
+  for(CombinedTensor* input : {input_a_, input_b_}) {
+    if(input->delta.width() != output_->delta.width() || input->delta.height() != output_->delta.height()
+      || input->delta.elements() != output_->delta.elements())
+      return false;
+  }
+
+  input_a_->delta.Shadow(output_->delta);
+  input_b_->delta.Shadow(output_->delta);
+  return true;
+}
+
+bool SumLayer::IsSharingGradient() const {
+  // Checked every time because the inputs may have been resized since
+  return input_a_->delta.data_ptr_const() == output_->delta.data_ptr_const() &&
+    input_b_->delta.data_ptr_const() == output_->delta.data_ptr_const() &&
+    input_a_->delta.elements() == output_->delta.elements() &&
+    input_b_->delta.elements() == output_->delta.elements();
+}
+
 }
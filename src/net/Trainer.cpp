@@ -105,6 +105,7 @@ Trainer::Trainer(Conv::NetGraph& graph, JSON settings) :
 
   // Ask the Net for parameters
   graph_.GetParameters(parameters_);
+  graph_.GetConsolidatedParameters(optimizer_parameters_);
   LOGDEBUG << "Optimizing " << parameters_.size() << " sets of parameters.";
 
   // Set default optimizer to be SGDOptimizer
@@ -131,8 +132,7 @@ Trainer::Trainer(Conv::NetGraph& graph, JSON settings) :
   weight_count_ = w;
 
   first_training_layer_ = dynamic_cast<TrainingLayer*>(graph_.GetTrainingNodes()[0]->layer);
-  sample_count_ = first_training_layer_->GetLabelWidth() * first_training_layer_->GetLabelHeight()
-  * first_training_layer_->GetBatchSize();
+  UpdateSampleCount();
 
   // Insert defaults
   if(!settings_.count("testing_ratio")) settings_["testing_ratio"] = 1.0;
@@ -144,6 +144,10 @@ Trainer::Trainer(Conv::NetGraph& graph, JSON settings) :
   if(!settings_.count("epoch_iterations")) settings_["epoch_iterations"] = 500;
   if(!settings_.count("enable_stats_during_training")) settings_["enable_stats_during_training"] = true;
 
+  // Cache the features of the frozen layers
+  if(settings_.count("feature_cache") == 1 && settings_["feature_cache"].is_string())
+    graph_.EnableFeatureCache(settings_["feature_cache"]);
+
   InitializeStats();
 }
 
@@ -162,6 +166,10 @@ void Trainer::UpdateParameterSizes() {
     }
   }
 
+  // The optimizer works on the parameter arena if there is one
+  optimizer_parameters_.clear();
+  graph_.GetConsolidatedParameters(optimizer_parameters_);
+
   if(w != weight_count_) {
     LOGDEBUG << "Weight count changed from " << weight_count_ << " to " << w;
     weight_count_ = w;
@@ -190,9 +198,15 @@ void Trainer::Train (unsigned int epochs, bool do_snapshots) {
   graph_.SetStatLayersEnabled(true);
 }
 
+void Trainer::UpdateSampleCount() {
+  sample_count_ = first_training_layer_->GetLabelWidth() * first_training_layer_->GetLabelHeight()
+  * first_training_layer_->GetBatchSize();
+}
+
 void Trainer::Test() {
   // Update hardcoded stats
   System::stat_aggregator->hardcoded_stats_.weights = weight_count_;
+  UpdateSampleCount();
 
 	datum aggregate_loss = 0.0;
 	datum* loss_sums = new datum[graph_.GetLossNodes().size()];
@@ -261,6 +275,7 @@ void Trainer::Test() {
 void Trainer::Epoch() {
   // Update hardcoded epoch stat
   System::stat_aggregator->hardcoded_stats_.epoch = epoch_;
+  UpdateSampleCount();
 
 	datum aggregate_loss = 0.0;
 	datum* loss_sums = new datum[graph_.GetLossNodes().size()];
@@ -284,25 +299,27 @@ void Trainer::Epoch() {
            ", bsize: " << first_training_layer_->GetBatchSize() * (unsigned int)settings_["batch_size_sequential"]
           << ", " << optimizer_->GetStatusDescription(epoch_ * iterations) << std::endl << std::flush;
 
+  // Progress is informational output, too
+  const bool show_progress = System::log_level >= 2;
+
   for (unsigned int i = 0; i < iterations; i++) {
-    if ( (50 * i / iterations) > fiftieth) {
+    if (show_progress && (50 * i / iterations) > fiftieth) {
       fiftieth = 50 * i / iterations;
       std::cout << "." << std::flush;
     }
 
-    if ( (10 * i / iterations) > tenth) {
+    if (show_progress && (10 * i / iterations) > tenth) {
       tenth = 10 * i / iterations;
       std::cout << tenth << "0%" << std::flush;
     }
     aggregate_loss = 0.0;
 
-    // Reset gradients
-    for (unsigned int np = 0; np < accumulated_gradients_.size(); np++)
-      accumulated_gradients_[np]->Clear();
-
-    for (unsigned int b = 0; b < (unsigned int)settings_["batch_size_sequential"]; b++) {
+    const unsigned int batch_size_sequential = settings_["batch_size_sequential"];
+    for (unsigned int b = 0; b < batch_size_sequential; b++) {
       // Load data and feed forward
+      auto t_load = std::chrono::steady_clock::now();
       first_training_layer_->SelectAndLoadSamples();
+      auto t_forward = std::chrono::steady_clock::now();
       graph_.FeedForward();
       UpdateParameterSizes();
 
@@ -315,30 +332,26 @@ void Trainer::Epoch() {
 			}
 
       // Backpropagate errors
+      auto t_backward = std::chrono::steady_clock::now();
       graph_.BackPropagate();
 
-      unsigned int np = 0;
+      // The gradients of the last batch are added during regularization
+      if (b + 1 < batch_size_sequential)
+        AccumulateGradients(b == 0);
+      auto t_end = std::chrono::steady_clock::now();
 
-      // Accumulate gradients
-      for (unsigned int l = 0; l < graph_.GetNodes().size(); l++) {
-				Layer* const layer = graph_.GetNodes()[l]->layer;
-        for (unsigned int p = 0; p < layer->parameters().size(); p++) {
-          Tensor& gradients = layer->parameters() [p]->delta;
-#ifdef BUILD_OPENCL
-          gradients.MoveToCPU();
-#endif
-          for (unsigned int e = 0; e < gradients.elements(); e++) {
-            (* (accumulated_gradients_[np])) [e] += gradients[e];
-          }
-          np++;
-        }
-      }
+      phase_times_.load += std::chrono::duration<double>(t_forward - t_load).count();
+      phase_times_.forward += std::chrono::duration<double>(t_backward - t_forward).count();
+      phase_times_.backward += std::chrono::duration<double>(t_end - t_backward).count();
     }
+    auto t_optimizer = std::chrono::steady_clock::now();
+
     // Apply regularization and local scaling
-    ApplyRegularizationAndScaling();
+    ApplyRegularizationAndScaling(batch_size_sequential > 1);
 
     // Run the optimizer for a step
-    optimizer_->Step(parameters_, epoch_ * iterations + i);
+    optimizer_->Step(optimizer_parameters_, epoch_ * iterations + i);
+    phase_times_.optimizer += std::chrono::duration<double>(std::chrono::steady_clock::now() - t_optimizer).count();
 
     // Batch/Iteration done
     if (System::stat_aggregator->state_ == StatAggregator::RECORDING)
@@ -376,16 +389,52 @@ void Trainer::Epoch() {
   epoch_++;
 }
 
-void Trainer::ApplyRegularizationAndScaling() {
+void Trainer::AccumulateGradients(bool first_batch) {
+  unsigned int np = 0;
+
+  for (unsigned int l = 0; l < graph_.GetNodes().size(); l++) {
+    Layer* const layer = graph_.GetNodes()[l]->layer;
+    // Frozen layers are not backpropagated, their gradients are cleared
+    // in ApplyRegularizationAndScaling()
+    if (layer->local_lr_ == 0) {
+      np += layer->parameters().size();
+      continue;
+    }
+    for (unsigned int p = 0; p < layer->parameters().size(); p++) {
+      Tensor& gradients = layer->parameters() [p]->delta;
+#ifdef BUILD_OPENCL
+      gradients.MoveToCPU();
+#endif
+      const datum* gradient = gradients.data_ptr_const();
+      datum* accumulated_gradient = accumulated_gradients_[np]->data_ptr();
+
+      // Copying the first gradient saves clearing the buffer
+      if (first_batch) {
+#pragma omp parallel for default(shared)
+        for (std::size_t e = 0; e < gradients.elements(); e++)
+          accumulated_gradient[e] = gradient[e];
+      } else {
+#pragma omp parallel for default(shared)
+        for (std::size_t e = 0; e < gradients.elements(); e++)
+          accumulated_gradient[e] += gradient[e];
+      }
+      np++;
+    }
+  }
+}
+
+void Trainer::ApplyRegularizationAndScaling(bool accumulated) {
   unsigned int dp = 0;
 
-  datum _cached_batch_size_sequential = settings_["batch_size_sequential"];
-  datum _cached_l1_coefficient = settings_["l1"];
-  datum _cached_l2_coefficient = settings_["l2"];
+  const datum l1_coefficient = settings_["l1"];
+  const datum l2_coefficient = settings_["l2"];
+  const datum batch_size_sequential = settings_["batch_size_sequential"];
+  const datum batch_size_loss_scaling_factor = ((datum) 1.0) /
+    (((datum) (sample_count_ * batch_size_sequential)) * first_training_layer_->GetLossSamplingProbability());
 
 	for (unsigned int l = 0; l < graph_.GetNodes().size(); l++) {
 		Layer* const layer = graph_.GetNodes()[l]->layer;
-    datum local_learning_rate = layer->local_lr_;
+    const datum local_learning_rate = layer->local_lr_;
 
     if(local_learning_rate == 0) {
       for (unsigned int p = 0; p < layer->parameters().size(); p++) {
@@ -398,29 +447,31 @@ void Trainer::ApplyRegularizationAndScaling() {
         CombinedTensor *const current_layer_parameters = layer->parameters_[p];
   #ifdef BUILD_OPENCL
         current_layer_parameters->data.MoveToCPU();
-        current_layer_parameters->delta.MoveToCPU(true);
+        current_layer_parameters->delta.MoveToCPU();
   #endif
+        const datum* weights = current_layer_parameters->data.data_ptr_const();
+        const datum* accumulated_gradient = accumulated ? accumulated_gradients_[dp]->data_ptr_const() : nullptr;
+        datum* delta = current_layer_parameters->delta.data_ptr();
 
-        for (unsigned int w = 0; w < current_layer_parameters->data.elements(); w++) {
-          const datum weight = current_layer_parameters->data(w);
+        // Adds the last batch's gradient, then turns it into the partial
+        // derivative in place
+#pragma omp parallel for default(shared)
+        for (std::size_t w = 0; w < current_layer_parameters->data.elements(); w++) {
+          const datum weight = weights[w];
 
           // Gradients w.r.t. the weight
           const datum l1_gradient = (weight > 0) - (weight < 0);
           const datum l2_gradient = weight;
-          const datum loss_gradient = (*accumulated_gradients_[dp])[w];
+          const datum loss_gradient = accumulated ? accumulated_gradient[w] + delta[w] : delta[w];
 
-          const datum batch_size_loss_scaling_factor = ((datum) 1.0) /
-                                                       (((datum) (sample_count_ * _cached_batch_size_sequential)) *
-                                                        first_training_layer_->GetLossSamplingProbability());
           const datum partial_derivative =
               // Average of gradient over minibatch
               local_learning_rate * (loss_gradient * batch_size_loss_scaling_factor) +
               // Regularization
-              local_learning_rate * (_cached_l2_coefficient * l2_gradient + _cached_l1_coefficient * l1_gradient);
-
+              local_learning_rate * (l2_coefficient * l2_gradient + l1_coefficient * l1_gradient);
 
           // Save partial derivative
-          current_layer_parameters->delta[w] = partial_derivative;
+          delta[w] = partial_derivative;
         }
         dp++;
       }
@@ -87,6 +87,13 @@ bool UpscaleLayer::Connect ( const CombinedTensor* input,
   return true;
 }
 
+bool UpscaleLayer::Reshape ( const CombinedTensor* input,
+                             CombinedTensor* output ) {
+  output->Resize ( input->data.samples(), input->data.width() * region_width_,
+                   input->data.height() * region_height_, input->data.maps() );
+  return Connect ( input, output );
+}
+
 void UpscaleLayer::FeedForward() {
  TensorMath::UP(input_->data, output_->data, region_width_, region_height_, 1.0f);
 }
@@ -44,6 +44,8 @@ YOLODetectionLayer::YOLODetectionLayer(JSON configuration): SimpleLayer(configur
   if(yolo_configuration.count("confidence_threshold") == 1 && yolo_configuration["confidence_threshold"].is_number()) {
     confidence_threshold_ = yolo_configuration["confidence_threshold"];
   }
+
+  nms_ = NonMaximumSuppression(yolo_configuration);
 }
   
 bool YOLODetectionLayer::CreateOutputs (
@@ -130,6 +132,7 @@ void YOLODetectionLayer::FeedForward() {
     classes_ = classes;
   }
 
+#pragma omp parallel for default(shared)
   for (unsigned int sample = 0; sample < input_->data.samples(); sample++ ) {
     // Clear output vector
     std::vector<BoundingBox>* sample_boxes = (std::vector<BoundingBox>*)output_->metadata[sample];
@@ -197,25 +200,8 @@ void YOLODetectionLayer::FeedForward() {
     }
 
     // Do non-maximum suppression
-    if(sample_boxes->size() > 1) {
-
-      if(do_nms_) {
-        std::sort(sample_boxes->begin(), sample_boxes->end(), BoundingBox::CompareScore);
-        for (unsigned int b1 = 0; b1 < (sample_boxes->size() - 1); b1++) {
-          BoundingBox &box1 = (*sample_boxes)[b1];
-          for (unsigned int b2 = b1 + 1; b2 < sample_boxes->size(); b2++) {
-            BoundingBox &box2 = (*sample_boxes)[b2];
-            if (box2.c == box1.c && box2.score > box1.score) {
-              if (box1.IntersectionOverUnion(&box2) > (datum) 0.5)
-                box1.score = (datum) 0;
-            }
-          }
-        }
-
-        sample_boxes->erase(std::remove_if(sample_boxes->begin(), sample_boxes->end(),
-                                           [](BoundingBox &box1) { return box1.score == (datum) 0; }),
-                            sample_boxes->end());
-      }
+    if(do_nms_ && sample_boxes->size() > 1) {
+      nms_.Apply(*sample_boxes);
     }
   }
 
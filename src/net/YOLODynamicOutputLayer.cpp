@@ -6,7 +6,9 @@
  */
 
 #include <algorithm>
+#include <cstring>
 
+#include "TensorMath.h"
 #include "YOLODynamicOutputLayer.h"
 
 namespace Conv {
@@ -51,12 +53,19 @@ void YOLODynamicOutputLayer::UpdateTensorSizes(bool no_init) {
     output_->delta.Resize(input_->data.samples(), 1, 1, output_maps);
   }
 
+  if(class_ff_buffer_.maps() != class_maps) {
+    class_ff_buffer_.Resize(input_->data.samples(), 1, 1, class_maps);
+    class_bp_buffer_.Resize(input_->data.samples(), 1, 1, class_maps);
+  }
+
   if(class_weights_->data.samples() != class_maps) {
     unsigned int old_class_maps = class_weights_->data.samples();
     if(class_maps < old_class_maps) {
       FATAL("This can never happen!");
     }
 
+    // Class maps are ordered by class id, so new classes append rows.
+    // Extend keeps the existing rows and only reallocates occasionally.
     class_weights_->data.Extend(class_maps);
     class_weights_->delta.Extend(class_maps);
     class_biases_->data.Extend(class_maps);
@@ -102,6 +111,10 @@ bool YOLODynamicOutputLayer::Connect(const CombinedTensor *input, CombinedTensor
   class_biases_ = new CombinedTensor(horizontal_cells_ * vertical_cells_ * (class_manager_->GetMaxClassId() + 1), 1, 1, 1);
   class_biases_->is_dynamic = true;
 
+  ones_.Resize(1, input->data.samples());
+  for (unsigned int i = 0; i < ones_.elements(); i++) {
+    ones_[i] = 1;
+  }
 
   parameters_.push_back(box_weights_);
   parameters_.push_back(box_biases_);
@@ -147,41 +160,40 @@ void YOLODynamicOutputLayer::FeedForward() {
   UpdateTensorSizes();
 
   const unsigned int class_offset = vertical_cells_ * horizontal_cells_ * boxes_per_cell_ * 5;
+  const unsigned int samples = input_->data.samples();
   const unsigned int input_maps = input_->data.maps();
   const unsigned int box_output_maps = vertical_cells_ * horizontal_cells_ * boxes_per_cell_ * 5;
   const unsigned int class_output_maps = vertical_cells_ * horizontal_cells_ * (class_manager_->GetMaxClassId() + 1);
-
-  for (unsigned int sample = 0; sample < input_->data.samples(); sample++) {
-    const datum* input_ptr = input_->data.data_ptr_const(0,0,0,sample);
-    datum* output_ptr = output_->data.data_ptr(0,0,0,sample);
-
-    // Box weights
-    for (unsigned int m = 0; m < box_output_maps; m++) {
-      datum sum = 0;
-      for (unsigned int i = 0; i < input_maps; i++) {
-        sum += input_ptr[i] * *(box_weights_->data.data_ptr_const(0, 0, i, m));
-      }
-      output_ptr[m] = sum;
-    }
-
-    // Class weights
-    for (unsigned int m = 0; m < class_output_maps; m++) {
-      datum sum = 0;
-      for (unsigned int i = 0; i < input_maps; i++) {
-        sum += input_ptr[i] * *(class_weights_->data.data_ptr_const(0, 0, i, m));
-      }
-      output_ptr[m + class_offset] = sum;
-    }
-
-    // Box biases
-    for (unsigned int m = 0; m < box_biases_->data.samples(); m++) {
-      output_ptr[m] += box_biases_->data.data_ptr_const()[m];
-    }
-
-    // Class biases
-    for (unsigned int m = 0; m < class_biases_->data.samples(); m++) {
-      output_ptr[m + class_offset] += class_biases_->data.data_ptr_const()[m];
-    }
+  const unsigned int output_maps = box_output_maps + class_output_maps;
+
+  output_->data.hint_ignore_content_ = true;
+  class_ff_buffer_.hint_ignore_content_ = true;
+
+  // Box biases, then box weights
+  TensorMath::GEMM(true, false, false, samples, box_output_maps, 1,
+                   1.0, ones_, 0, 1, box_biases_->data, 0, box_output_maps,
+                   0.0, output_->data, 0, output_maps);
+  TensorMath::GEMM(true, false, true, samples, box_output_maps, input_maps,
+                   1.0, input_->data, 0, input_maps, box_weights_->data, 0, input_maps,
+                   1.0, output_->data, 0, output_maps);
+
+  // Class biases, then class weights
+  TensorMath::GEMM(true, false, false, samples, class_output_maps, 1,
+                   1.0, ones_, 0, 1, class_biases_->data, 0, class_output_maps,
+                   0.0, class_ff_buffer_, 0, class_output_maps);
+  TensorMath::GEMM(true, false, true, samples, class_output_maps, input_maps,
+                   1.0, input_->data, 0, input_maps, class_weights_->data, 0, input_maps,
+                   1.0, class_ff_buffer_, 0, class_output_maps);
+
+#ifdef BUILD_OPENCL
+  output_->data.MoveToCPU();
+  class_ff_buffer_.MoveToCPU();
+#endif
+
+  // Class outputs follow the box outputs in every sample
+  for (unsigned int sample = 0; sample < samples; sample++) {
+    std::memcpy(output_->data.data_ptr(0, 0, class_offset, sample), class_ff_buffer_.data_ptr_const(0, 0, 0, sample),
+                class_output_maps * sizeof(datum));
   }
 }
 
@@ -216,58 +228,54 @@ void YOLODynamicOutputLayer::OnLayerConnect(const std::vector<Layer *> next_laye
 
 void YOLODynamicOutputLayer::BackPropagate() {
   const unsigned int class_offset = vertical_cells_ * horizontal_cells_ * boxes_per_cell_ * 5;
+  const unsigned int samples = input_->data.samples();
   const unsigned int input_maps = input_->data.maps();
   const unsigned int box_output_maps = vertical_cells_ * horizontal_cells_ * boxes_per_cell_ * 5;
   const unsigned int class_output_maps = vertical_cells_ * horizontal_cells_ * (class_manager_->GetMaxClassId() + 1);
+  const unsigned int output_maps = box_output_maps + class_output_maps;
 
-  box_weights_->delta.Clear();
-  box_biases_->delta.Clear();
-  class_weights_->delta.Clear();
-  class_biases_->delta.Clear();
-
-  for (unsigned int sample = 0; sample < input_->data.samples(); sample++) {
-    const datum *input_data_ptr = input_->data.data_ptr_const(0, 0, 0, sample);
-    datum *input_delta_ptr = input_->delta.data_ptr(0, 0, 0, sample);
-    const datum *output_delta_ptr = output_->delta.data_ptr_const(0, 0, 0, sample);
-
-    // Weight gradients
-    // Box weights
-    for (unsigned int m = 0; m < box_output_maps; m++) {
-      for (unsigned int i = 0; i < input_maps; i++) {
-        *box_weights_->delta.data_ptr(0, 0, i, m) += (output_delta_ptr[m] * input_data_ptr[i]);
-      }
-    }
-    // Class weights
-    for (unsigned int m = 0; m < class_output_maps; m++) {
-      for (unsigned int i = 0; i < input_maps; i++) {
-        *class_weights_->delta.data_ptr(0, 0, i, m) += (output_delta_ptr[m + class_offset] * input_data_ptr[i]);
-      }
-    }
-    // Box biases
-    for (unsigned int m = 0; m < box_output_maps; m++) {
-      box_biases_->delta.data_ptr()[m] += output_delta_ptr[m];
-    }
-    // Class biases
-    for (unsigned int m = 0; m < class_output_maps; m++) {
-      class_biases_->delta.data_ptr()[m] += output_delta_ptr[m + class_offset];
-    }
-
-    // Input gradients
-    for(unsigned int i = 0; i < input_maps; i++) {
-      datum delta = 0;
-      // Box weights
-      for (unsigned int m = 0; m < box_output_maps; m++) {
-        delta += output_delta_ptr[m] * *(box_weights_->data.data_ptr(0, 0, i, m));
-      }
-      // Class weights
-      for (unsigned int m = 0; m < class_output_maps; m++) {
-        delta += output_delta_ptr[m + class_offset] * *(class_weights_->data.data_ptr(0, 0, i, m));
-      }
-      input_delta_ptr[i] = delta;
-    }
+#ifdef BUILD_OPENCL
+  output_->delta.MoveToCPU();
+  class_bp_buffer_.MoveToCPU(true);
+#endif
 
+  // Gather class deltas into a contiguous matrix
+  for (unsigned int sample = 0; sample < samples; sample++) {
+    std::memcpy(class_bp_buffer_.data_ptr(0, 0, 0, sample), output_->delta.data_ptr_const(0, 0, class_offset, sample),
+                class_output_maps * sizeof(datum));
   }
 
+  box_weights_->delta.hint_ignore_content_ = true;
+  box_biases_->delta.hint_ignore_content_ = true;
+  class_weights_->delta.hint_ignore_content_ = true;
+  class_biases_->delta.hint_ignore_content_ = true;
+
+  // Weight gradients
+  TensorMath::GEMM(true, true, false, box_output_maps, input_maps, samples,
+                   1.0, output_->delta, 0, output_maps, input_->data, 0, input_maps,
+                   0.0, box_weights_->delta, 0, input_maps);
+  TensorMath::GEMM(true, true, false, class_output_maps, input_maps, samples,
+                   1.0, class_bp_buffer_, 0, class_output_maps, input_->data, 0, input_maps,
+                   0.0, class_weights_->delta, 0, input_maps);
+
+  // Bias gradients
+  TensorMath::GEMM(true, false, false, 1, box_output_maps, samples,
+                   1.0, ones_, 0, samples, output_->delta, 0, output_maps,
+                   0.0, box_biases_->delta, 0, box_output_maps);
+  TensorMath::GEMM(true, false, false, 1, class_output_maps, samples,
+                   1.0, ones_, 0, samples, class_bp_buffer_, 0, class_output_maps,
+                   0.0, class_biases_->delta, 0, class_output_maps);
+
+  // Input gradients
+  if (backprop_enabled_) {
+    input_->delta.hint_ignore_content_ = true;
+    TensorMath::GEMM(true, false, false, samples, input_maps, box_output_maps,
+                     1.0, output_->delta, 0, output_maps, box_weights_->data, 0, input_maps,
+                     0.0, input_->delta, 0, input_maps);
+    TensorMath::GEMM(true, false, false, samples, input_maps, class_output_maps,
+                     1.0, class_bp_buffer_, 0, class_output_maps, class_weights_->data, 0, input_maps,
+                     1.0, input_->delta, 0, input_maps);
+  }
 }
 
 bool YOLODynamicOutputLayer::Deserialize(unsigned int metadata_length, const char* metadata,
@@ -312,9 +320,9 @@ bool YOLODynamicOutputLayer::Deserialize(unsigned int metadata_length, const cha
       unsigned int class_original_offset = class_original_id * (horizontal_cells_) * (vertical_cells_);
       for (unsigned int cell = 0; cell < (horizontal_cells_ * vertical_cells_); cell++) {
         class_biases_->data[class_new_offset + cell] = temp_class_biases(class_original_offset + cell);
-        for (unsigned int i = 0; i < input_->data.maps(); i++) {
-          *(class_weights_->data.data_ptr(0, 0, i, class_new_offset + cell)) = *(temp_class_weights.data_ptr_const(0, 0, i, class_original_offset + cell));
-        }
+        std::memcpy(class_weights_->data.data_ptr(0, 0, 0, class_new_offset + cell),
+                    temp_class_weights.data_ptr_const(0, 0, 0, class_original_offset + cell),
+                    input_->data.maps() * sizeof(datum));
       }
     }
     return true;
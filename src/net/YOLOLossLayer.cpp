@@ -5,6 +5,7 @@
  * For licensing information, see the LICENSE file included with this project.
  */
 #include <cmath>
+#include <vector>
 #include <cn24/util/BoundingBox.h>
 
 #include "Log.h"
@@ -103,136 +104,178 @@ void YOLOLossLayer::FeedForward() {
   unsigned int maps_per_cell = total_maps / (horizontal_cells_ * vertical_cells_);
   classes_ = maps_per_cell - (5 * boxes_per_cell_);
 
+  const unsigned int samples = (unsigned int)first_->data.samples();
+  const unsigned int cells = horizontal_cells_ * vertical_cells_;
+
   // We write the deltas at this point, because
   // CalculateLossFunction() is called before BackPropagate().
-  //pragma omp parallel for default(shared)
   first_->delta.Clear((datum)0);
-  current_loss_ = 0;
 
-  for (unsigned int sample = 0; sample < first_->data.samples(); sample++ ) {
+  // Check the weights before going parallel, FATAL cannot be raised
+  // from inside the parallel loop
+  for (unsigned int sample = 0; sample < samples; sample++) {
     datum sample_weight = *(third_->data.data_ptr(0, 0, 0, sample));
-    if(sample_weight == 0) {
-      continue;
-    } else if(sample_weight != 1) {
+    if(sample_weight != 0 && sample_weight != 1) {
       FATAL("Unsupported sample weight: " << sample_weight);
     }
-    std::vector<BoundingBox>* truth_boxes = (std::vector<BoundingBox>*)second_->metadata[sample];
-
-    // Prepare indices into the prediction array
-    unsigned int sample_index = (unsigned int)(sample * first_->data.maps());
-    unsigned int class_index = sample_index + (vertical_cells_ * horizontal_cells_ * boxes_per_cell_ * 5);
-    unsigned int confidence_index = sample_index;
-    unsigned int coords_index = sample_index;
-
-    // Loop over all cells
-    for (unsigned int vcell = 0; vcell < vertical_cells_; vcell++) {
-      for (unsigned int hcell = 0; hcell < horizontal_cells_; hcell++) {
-        unsigned int cell_id = vcell * horizontal_cells_ + hcell;
-        const datum box_xmin = ((datum)hcell) / (datum)horizontal_cells_;
-        const datum box_ymin = ((datum)vcell) / (datum)vertical_cells_;
-        const datum box_xmax = ((datum)(hcell + 1)) / (datum)horizontal_cells_;
-        const datum box_ymax = ((datum)(vcell+ 1)) / (datum)vertical_cells_;
-
-        // Find matching ground truth box
-        BoundingBox* truth_box = nullptr;
-        bool found_box = false;
-        for(unsigned int t = 0; t < truth_boxes->size(); t++) {
-          BoundingBox* tbox = &((*truth_boxes)[t]);
-          if(tbox->x >= box_xmin && tbox->x < box_xmax
-          && tbox->y >= box_ymin && tbox->y < box_ymax) {
-            truth_box = tbox;
-            found_box = true;
-            break;
-          }
-        };
-
-        datum best_iou = 0;
-        int responsible_box = -1; // So that no possible index is equal to responsible_box when it is not overwritten
-
-        // Loop over all possible boxes to find "responsible" box
-        if(found_box) {
-          for (unsigned int b = 0; b < boxes_per_cell_; b++) {
-            unsigned int box_coords_index = coords_index + 5 * (boxes_per_cell_ * cell_id + b);
-
-            // Calculate in-image coordinates
-            const datum x = box_xmin + (first_->data.data_ptr_const()[box_coords_index] / (datum) horizontal_cells_);
-            const datum y = box_ymin + (first_->data.data_ptr_const()[box_coords_index + 1] / (datum) vertical_cells_);
-            const datum w = first_->data.data_ptr_const()[box_coords_index + 2] *
-                            first_->data.data_ptr_const()[box_coords_index + 2];
-            const datum h = first_->data.data_ptr_const()[box_coords_index + 3] *
-                            first_->data.data_ptr_const()[box_coords_index + 3];
-
-            // Calculate actual IOU
-            BoundingBox box(x, y, w, h);
-            datum actual_iou = box.IntersectionOverUnion(truth_box);
-
-            if (actual_iou > best_iou) {
-              responsible_box = b;
-              best_iou = actual_iou;
-            }
-          }
-
-          // Loop over all classes to assign loss for each
-          for (unsigned int c = 0; c < classes_; c++) {
-            unsigned int cell_class_index = class_index + (horizontal_cells_ * vertical_cells_ * c) + cell_id;
-            const datum predicted_class_prob = first_->data.data_ptr_const()[cell_class_index];
-
-            const datum class_delta = predicted_class_prob - (truth_box->c == c ? (datum)1.0 : (datum)0.0);
-            first_->delta[cell_class_index] = (datum)2.0 * class_delta;
-            current_loss_ += (class_delta * class_delta);
-          }
-        }
-
-        // Loop over all boxes to calculate loss
-        for (unsigned int b = 0; b < boxes_per_cell_; b++) {
-          // Box predicted iou is needed for both cases
-          unsigned int box_confidence_index = confidence_index + (cell_id * boxes_per_cell_ + b) * 5 + 4;
-          const datum box_confidence = first_->data.data_ptr_const()[box_confidence_index];
-
-          if(((int)b) == responsible_box) {
-            // Box b is "responsible" for the detection
-            unsigned int box_coords_index = coords_index + 5 * (boxes_per_cell_ * cell_id + b);
-
-            // Calculate in-image coordinates
-            const datum x = box_xmin + (first_->data.data_ptr_const()[box_coords_index] / (datum) horizontal_cells_);
-            const datum y = box_ymin + (first_->data.data_ptr_const()[box_coords_index + 1] / (datum) vertical_cells_);
-            const datum w = first_->data.data_ptr_const()[box_coords_index + 2];
-            const datum h = first_->data.data_ptr_const()[box_coords_index + 3];
-
-            // Calculate actual IOU
-            BoundingBox box(x, y, w * w, h * h);
-            datum actual_iou = box.IntersectionOverUnion(truth_box);
-
-            // Loss: Box coordinates
-            const datum xcoord_delta = (x - truth_box->x) * (datum)horizontal_cells_;
-            const datum ycoord_delta = (y - truth_box->y) * (datum)vertical_cells_;
-            first_->delta.data_ptr()[box_coords_index] = scale_coord_ * (datum)2.0 * xcoord_delta;
-            first_->delta.data_ptr()[box_coords_index + 1] = scale_coord_ * (datum)2.0 * ycoord_delta;
-            current_loss_ += (datum)(scale_coord_ * xcoord_delta * xcoord_delta) + (datum)(scale_coord_ * ycoord_delta * ycoord_delta);
-
-            // Loss: Box size
-            const datum w_delta = w - std::sqrt(truth_box->w);
-            const datum h_delta = h - std::sqrt(truth_box->h);
-            first_->delta.data_ptr()[box_coords_index + 2] = scale_coord_ * (datum)2.0 * w_delta;
-            first_->delta.data_ptr()[box_coords_index + 3] = scale_coord_ * (datum)2.0 * h_delta;
-            current_loss_ += (datum)(scale_coord_ * w_delta * w_delta) + (datum)(scale_coord_ * h_delta * h_delta);
-
-            // Loss: Predicted confidence
-            const datum conf_delta = box_confidence - actual_iou;
-            current_loss_ += (datum)(conf_delta * conf_delta);
-            first_->delta.data_ptr()[box_confidence_index] = (datum)2.0 * conf_delta;
-          } else {
-            // Box b is not "responsible" for the ground truth
-
-            // Loss: Box confidence
-            first_->delta.data_ptr()[box_confidence_index] = scale_noobj_* ((datum)2.0 * box_confidence);
-            current_loss_ += (datum)(scale_noobj_ * box_confidence * box_confidence);
-          }
-        }
+  }
+
+  // Per-batch scratch space, reused across iterations
+  cell_truth_.assign(samples * cells, -1);
+  cell_responsible_.assign(samples * cells, -1);
+  sample_loss_.assign(samples, 0);
+
+#pragma omp parallel for default(shared)
+  for (unsigned int sample = 0; sample < samples; sample++) {
+    if(*(third_->data.data_ptr(0, 0, 0, sample)) == 0)
+      continue;
+    sample_loss_[sample] = SampleLoss(sample);
+  }
+
+  // Summed in sample order so the loss does not depend on the schedule
+  current_loss_ = 0;
+  for (unsigned int sample = 0; sample < samples; sample++)
+    current_loss_ += sample_loss_[sample];
+}
+
+int YOLOLossLayer::CellForPosition(datum x, unsigned int cells) const {
+  if(!(x >= 0))
+    return -1;
+  int cell = (int)(x * (datum)cells);
+
+  // Correct rounding so that the cell matches the interval test
+  // xmin <= x < xmax exactly
+  if(cell > 0 && x < ((datum)cell) / (datum)cells)
+    cell--;
+  else if(x >= ((datum)(cell + 1)) / (datum)cells)
+    cell++;
+
+  return cell < (int)cells ? cell : -1;
+}
 
+double YOLOLossLayer::SampleLoss(unsigned int sample) {
+  const unsigned int cells = horizontal_cells_ * vertical_cells_;
+  const unsigned int boxes = cells * boxes_per_cell_;
+  const datum* input = first_->data.data_ptr_const(0, 0, 0, sample);
+  datum* delta = first_->delta.data_ptr(0, 0, 0, sample);
+  const datum* class_input = input + 5 * boxes;
+  datum* class_delta = delta + 5 * boxes;
+  int* cell_truth = &cell_truth_[sample * cells];
+  int* cell_responsible = &cell_responsible_[sample * cells];
+
+  std::vector<BoundingBox>* truth_boxes = (std::vector<BoundingBox>*)second_->metadata[sample];
+
+  // Bucket the ground truth into cells. The first box in a cell is the one
+  // it is trained on.
+  for (unsigned int t = 0; t < truth_boxes->size(); t++) {
+    const BoundingBox& tbox = (*truth_boxes)[t];
+    const int hcell = CellForPosition(tbox.x, horizontal_cells_);
+    const int vcell = CellForPosition(tbox.y, vertical_cells_);
+    if(hcell < 0 || vcell < 0)
+      continue;
+    const unsigned int cell_id = (unsigned int)vcell * horizontal_cells_ + (unsigned int)hcell;
+    if(cell_truth[cell_id] == -1)
+      cell_truth[cell_id] = (int)t;
+  }
+
+  double loss = 0;
+
+  // Find the "responsible" box for every cell with a ground truth box
+  for (unsigned int cell_id = 0; cell_id < cells; cell_id++) {
+    if(cell_truth[cell_id] == -1)
+      continue;
+    BoundingBox* truth_box = &((*truth_boxes)[cell_truth[cell_id]]);
+    const datum box_xmin = ((datum)(cell_id % horizontal_cells_)) / (datum)horizontal_cells_;
+    const datum box_ymin = ((datum)(cell_id / horizontal_cells_)) / (datum)vertical_cells_;
+
+    datum best_iou = 0;
+    for (unsigned int b = 0; b < boxes_per_cell_; b++) {
+      const datum* coords = input + 5 * (boxes_per_cell_ * cell_id + b);
+
+      // Calculate in-image coordinates
+      BoundingBox box(box_xmin + (coords[0] / (datum)horizontal_cells_),
+                      box_ymin + (coords[1] / (datum)vertical_cells_),
+                      coords[2] * coords[2], coords[3] * coords[3]);
+      const datum actual_iou = box.IntersectionOverUnion(truth_box);
+
+      if (actual_iou > best_iou) {
+        cell_responsible[cell_id] = (int)b;
+        best_iou = actual_iou;
       }
     }
   }
+
+  // Loss: Class probabilities. Each class is a contiguous plane over the
+  // cells, so this runs along memory and is masked by the cell assignment.
+  for (unsigned int c = 0; c < classes_; c++) {
+    const datum* class_plane = class_input + c * cells;
+    datum* class_delta_plane = class_delta + c * cells;
+    datum class_loss = 0;
+    for (unsigned int cell_id = 0; cell_id < cells; cell_id++) {
+      const int t = cell_truth[cell_id];
+      const datum has_truth = t != -1 ? (datum)1.0 : (datum)0.0;
+      const datum target = (t != -1 && (*truth_boxes)[t].c == c) ? (datum)1.0 : (datum)0.0;
+      const datum diff = has_truth * (class_plane[cell_id] - target);
+      class_delta_plane[cell_id] = (datum)2.0 * diff;
+      class_loss += diff * diff;
+    }
+    loss += class_loss;
+  }
+
+  // Loss: Confidence of boxes that are not responsible for a detection
+  datum noobj_loss = 0;
+  for (unsigned int box_id = 0; box_id < boxes; box_id++) {
+    const datum box_confidence = input[5 * box_id + 4];
+    const datum not_responsible =
+      cell_responsible[box_id / boxes_per_cell_] != (int)(box_id % boxes_per_cell_) ? (datum)1.0 : (datum)0.0;
+    delta[5 * box_id + 4] = not_responsible * scale_noobj_ * ((datum)2.0 * box_confidence);
+    noobj_loss += not_responsible * box_confidence * box_confidence;
+  }
+  loss += (double)(scale_noobj_ * noobj_loss);
+
+  // Loss: Coordinates and confidence of the responsible boxes
+  for (unsigned int cell_id = 0; cell_id < cells; cell_id++) {
+    const int b = cell_responsible[cell_id];
+    if(b == -1)
+      continue;
+    BoundingBox* truth_box = &((*truth_boxes)[cell_truth[cell_id]]);
+    const datum box_xmin = ((datum)(cell_id % horizontal_cells_)) / (datum)horizontal_cells_;
+    const datum box_ymin = ((datum)(cell_id / horizontal_cells_)) / (datum)vertical_cells_;
+    const unsigned int box_coords_index = 5 * (boxes_per_cell_ * cell_id + (unsigned int)b);
+    const datum* coords = input + box_coords_index;
+    datum* coords_delta = delta + box_coords_index;
+
+    // Calculate in-image coordinates
+    const datum x = box_xmin + (coords[0] / (datum) horizontal_cells_);
+    const datum y = box_ymin + (coords[1] / (datum) vertical_cells_);
+    const datum w = coords[2];
+    const datum h = coords[3];
+
+    // Calculate actual IOU
+    BoundingBox box(x, y, w * w, h * h);
+    datum actual_iou = box.IntersectionOverUnion(truth_box);
+
+    // Loss: Box coordinates
+    const datum xcoord_delta = (x - truth_box->x) * (datum)horizontal_cells_;
+    const datum ycoord_delta = (y - truth_box->y) * (datum)vertical_cells_;
+    coords_delta[0] = scale_coord_ * (datum)2.0 * xcoord_delta;
+    coords_delta[1] = scale_coord_ * (datum)2.0 * ycoord_delta;
+    loss += (datum)(scale_coord_ * xcoord_delta * xcoord_delta) + (datum)(scale_coord_ * ycoord_delta * ycoord_delta);
+
+    // Loss: Box size
+    const datum w_delta = w - std::sqrt(truth_box->w);
+    const datum h_delta = h - std::sqrt(truth_box->h);
+    coords_delta[2] = scale_coord_ * (datum)2.0 * w_delta;
+    coords_delta[3] = scale_coord_ * (datum)2.0 * h_delta;
+    loss += (datum)(scale_coord_ * w_delta * w_delta) + (datum)(scale_coord_ * h_delta * h_delta);
+
+    // Loss: Predicted confidence
+    const datum conf_delta = coords[4] - actual_iou;
+    loss += (datum)(conf_delta * conf_delta);
+    coords_delta[4] = (datum)2.0 * conf_delta;
+  }
+
+  return loss;
 }
 
 void YOLOLossLayer::BackPropagate() {
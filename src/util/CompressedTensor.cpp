@@ -173,7 +173,8 @@ void CompressedTensor::DeleteIfPossible() {
   if ( compressed_data_ptr_ != nullptr ) {
 #ifdef BUILD_POSIX
     if(mmapped_) {
-      munmap((void*)original_mmap_, compressed_length_);
+      // The mapping starts at the beginning of the page
+      munmap((void*)original_mmap_, compressed_length_ + (compressed_data_ptr_ - (char*)original_mmap_));
       original_mmap_ = nullptr;
       mmapped_ = false;
     } else {
@@ -0,0 +1,103 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cstdio>
+
+#ifdef BUILD_POSIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "Log.h"
+#include "CompressedTensor.h"
+
+#include "FeatureCache.h"
+
+namespace Conv {
+
+FeatureCache::FeatureCache(const std::string& path) : path_(path) {
+  Open();
+  LOGDEBUG << "Instance created.";
+}
+
+FeatureCache::~FeatureCache() {
+  file_.close();
+#ifdef BUILD_POSIX
+  if(file_descriptor_ > 0)
+    close(file_descriptor_);
+#endif
+  std::remove(path_.c_str());
+}
+
+void FeatureCache::Open() {
+  file_.open(path_, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+  if(!file_.good()) {
+    FATAL("Cannot open feature cache file: " << path_);
+  }
+
+#ifdef BUILD_POSIX
+  // Records are mapped through a separate read-only descriptor
+  file_descriptor_ = open(path_.c_str(), O_RDONLY);
+  if(file_descriptor_ < 0) {
+    FATAL("Cannot open feature cache file: " << path_);
+  }
+#endif
+}
+
+void FeatureCache::Store(const std::uint64_t key, Tensor& features) {
+  if(Contains(key)) {
+    LOGERROR << "Feature cache already contains key " << key;
+    return;
+  }
+
+  CompressedTensor compressed;
+  compressed.Compress(features);
+
+  file_.seekp(length_);
+  compressed.Serialize(file_);
+  // Flush so that the record can be mapped right away
+  file_.flush();
+  if(!file_.good()) {
+    FATAL("Cannot write to feature cache file: " << path_);
+  }
+
+  offsets_[key] = length_;
+  length_ = (std::uint64_t)file_.tellp();
+}
+
+bool FeatureCache::Load(const std::uint64_t key, Tensor& features) {
+  std::map<std::uint64_t, std::uint64_t>::const_iterator offset = offsets_.find(key);
+  if(offset == offsets_.end())
+    return false;
+
+  CompressedTensor compressed;
+  file_.seekg(offset->second);
+  compressed.Deserialize(file_, false, true, file_descriptor_);
+  if(compressed.elements() != features.elements()) {
+    LOGERROR << "Cached features for key " << key << " have the wrong size";
+    return false;
+  }
+
+  compressed.Decompress(features, features.data_ptr());
+  return true;
+}
+
+void FeatureCache::Clear() {
+  if(offsets_.size() > 0) {
+    LOGDEBUG << "Dropping " << offsets_.size() << " cached records";
+  }
+
+  file_.close();
+#ifdef BUILD_POSIX
+  close(file_descriptor_);
+#endif
+  offsets_.clear();
+  length_ = 0;
+  Open();
+}
+
+}
@@ -6,48 +6,32 @@
  */
 
 #include <iostream>
-#include <fstream>
-
-#ifdef BUILD_POSIX
-#include <fcntl.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#endif
 
+#include "TensorFile.h"
 #include "FloatTensorStream.h"
 
 namespace Conv {
   
 unsigned int FloatTensorStream::LoadFile(std::string path)
 {
-  std::ifstream input_stream(path, std::ios::binary | std::ios::in);
-  if(!input_stream.good()) {
-    FATAL("Cannot open file: " << path);
-  }
-#ifdef BUILD_POSIX
-  int input_fd = open(path.c_str(), O_RDONLY);
-  if(input_fd < 0) {
+  // Both formats are mapped, aligned files without copying
+  TensorFile file(path);
+  if(!file.IsValid()) {
     FATAL("Cannot open file: " << path);
   }
-#endif
 
   // Go through file
   std::cout << std::endl << std::flush;
   
-  while (!input_stream.eof()) {
+  for (unsigned int t = 0; t < file.GetTensorCount(); t++) {
     Tensor* tensor = new Tensor();
-#ifdef BUILD_POSIX
-    tensor->Deserialize (input_stream, false, true, input_fd);
-#else
-    tensor->Deserialize (input_stream, false);
-#endif
-
-    if (tensor->elements() == 0)
+    if (!file.Load(t, *tensor) || tensor->elements() == 0) {
+      delete tensor;
       break;
+    }
 
     tensors_.push_back(tensor);
     std::cout << "." << std::flush;
-    input_stream.peek();
   }
   return 0;
 }
@@ -0,0 +1,185 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cstring>
+
+#ifdef BUILD_POSIX
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "Config.h"
+#include "Log.h"
+
+#include "LocalSocket.h"
+
+namespace Conv {
+
+#ifdef BUILD_POSIX
+
+static bool MakeAddress(const std::string& path, sockaddr_un& address) {
+  std::memset(&address, 0, sizeof(sockaddr_un));
+  address.sun_family = AF_UNIX;
+  if(path.length() >= sizeof(address.sun_path)) {
+    LOGERROR << "Socket path too long: " << path;
+    return false;
+  }
+  std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  return true;
+}
+
+bool LocalSocket::Listen(const std::string& path, int backlog) {
+  sockaddr_un address;
+  if(!MakeAddress(path, address))
+    return false;
+
+  descriptor_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(descriptor_ < 0) {
+    LOGERROR << "Cannot create socket: " << errno;
+    return false;
+  }
+
+  unlink(path.c_str());
+  if(bind(descriptor_, (sockaddr*)&address, sizeof(sockaddr_un)) != 0 || listen(descriptor_, backlog) != 0) {
+    LOGERROR << "Cannot listen on " << path << ": " << errno;
+    Close();
+    return false;
+  }
+  path_ = path;
+  return true;
+}
+
+int LocalSocket::Accept() {
+  while(true) {
+    int connection = accept(descriptor_, nullptr, nullptr);
+    if(connection >= 0 || errno != EINTR)
+      return connection;
+  }
+}
+
+bool LocalSocket::Connect(const std::string& path) {
+  sockaddr_un address;
+  if(!MakeAddress(path, address))
+    return false;
+
+  descriptor_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(descriptor_ < 0) {
+    LOGERROR << "Cannot create socket: " << errno;
+    return false;
+  }
+
+  if(connect(descriptor_, (sockaddr*)&address, sizeof(sockaddr_un)) != 0) {
+    LOGERROR << "Cannot connect to " << path << ": " << errno;
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void LocalSocket::Close() {
+  if(descriptor_ >= 0) {
+    close(descriptor_);
+    descriptor_ = -1;
+  }
+  if(path_.length() > 0) {
+    unlink(path_.c_str());
+    path_.clear();
+  }
+}
+
+void LocalSocket::Shutdown() {
+  if(descriptor_ >= 0)
+    shutdown(descriptor_, SHUT_RDWR);
+}
+
+bool LocalSocket::ReadLine(std::string& line) {
+  std::size_t newline;
+  while((newline = buffer_.find('\n')) == std::string::npos) {
+    char chunk[4096];
+    ssize_t received = recv(descriptor_, chunk, sizeof(chunk), 0);
+    if(received < 0 && errno == EINTR)
+      continue;
+    if(received <= 0)
+      return false;
+    buffer_.append(chunk, (std::size_t)received);
+  }
+  line = buffer_.substr(0, newline);
+  buffer_.erase(0, newline + 1);
+  return true;
+}
+
+bool LocalSocket::Read(void* buffer, std::size_t length) {
+  // Use up the bytes read with the last line first
+  const std::size_t buffered = length < buffer_.length() ? length : buffer_.length();
+  std::memcpy(buffer, buffer_.data(), buffered);
+  buffer_.erase(0, buffered);
+
+  char* position = (char*)buffer + buffered;
+  length -= buffered;
+  while(length > 0) {
+    ssize_t received = recv(descriptor_, position, length, 0);
+    if(received < 0 && errno == EINTR)
+      continue;
+    if(received <= 0)
+      return false;
+    position += received;
+    length -= (std::size_t)received;
+  }
+  return true;
+}
+
+bool LocalSocket::Write(const void* buffer, std::size_t length) {
+  const char* position = (const char*)buffer;
+  while(length > 0) {
+    // Don't raise SIGPIPE when the other side is gone
+#ifdef BUILD_LINUX
+    ssize_t sent = send(descriptor_, position, length, MSG_NOSIGNAL);
+#else
+    ssize_t sent = send(descriptor_, position, length, 0);
+#endif
+    if(sent < 0 && errno == EINTR)
+      continue;
+    if(sent <= 0)
+      return false;
+    position += sent;
+    length -= (std::size_t)sent;
+  }
+  return true;
+}
+
+#else
+
+bool LocalSocket::Listen(const std::string& path, int backlog) {
+  UNREFERENCED_PARAMETER(backlog);
+  LOGERROR << "Cannot listen on " << path << ", local sockets are not supported on this platform";
+  return false;
+}
+
+int LocalSocket::Accept() { return -1; }
+
+bool LocalSocket::Connect(const std::string& path) {
+  LOGERROR << "Cannot connect to " << path << ", local sockets are not supported on this platform";
+  return false;
+}
+
+void LocalSocket::Close() {}
+void LocalSocket::Shutdown() {}
+bool LocalSocket::ReadLine(std::string& line) { UNREFERENCED_PARAMETER(line); return false; }
+bool LocalSocket::Read(void* buffer, std::size_t length) { UNREFERENCED_PARAMETER(buffer); UNREFERENCED_PARAMETER(length); return false; }
+bool LocalSocket::Write(const void* buffer, std::size_t length) { UNREFERENCED_PARAMETER(buffer); UNREFERENCED_PARAMETER(length); return false; }
+
+#endif
+
+bool LocalSocket::WriteLine(const std::string& line) {
+  const std::string terminated = line + "\n";
+  return Write(terminated.c_str(), terminated.length());
+}
+
+}
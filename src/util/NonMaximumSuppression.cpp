@@ -0,0 +1,200 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <utility>
+
+#include "Log.h"
+#include "NonMaximumSuppression.h"
+
+namespace Conv {
+
+BoxGrid::BoxGrid(const std::vector<BoundingBox>& boxes, const std::vector<unsigned int>& indices) {
+  if(indices.size() == 0)
+    return;
+
+  datum max_x = boxes[indices[0]].x, max_y = boxes[indices[0]].y;
+  min_x_ = max_x; min_y_ = max_y;
+  for(unsigned int index : indices) {
+    const BoundingBox& box = boxes[index];
+    min_x_ = std::min(min_x_, box.x); max_x = std::max(max_x, box.x);
+    min_y_ = std::min(min_y_, box.y); max_y = std::max(max_y, box.y);
+    max_w_ = std::max(max_w_, box.w); max_h_ = std::max(max_h_, box.h);
+  }
+
+  // About two boxes per cell on average
+  resolution_ = (unsigned int)std::sqrt((double)indices.size() / 2.0);
+  resolution_ = std::max(1u, std::min(64u, resolution_));
+
+  cell_w_ = (max_x - min_x_) / (datum)resolution_;
+  cell_h_ = (max_y - min_y_) / (datum)resolution_;
+  if(!(cell_w_ > 0)) cell_w_ = 1;
+  if(!(cell_h_ > 0)) cell_h_ = 1;
+
+  cells_.resize(resolution_ * resolution_);
+  for(unsigned int index : indices) {
+    const BoundingBox& box = boxes[index];
+    cells_[CellY(box.y) * resolution_ + CellX(box.x)].push_back(index);
+  }
+}
+
+unsigned int BoxGrid::CellX(datum x) const {
+  const datum cell = (x - min_x_) / cell_w_;
+  if(!(cell > 0))
+    return 0;
+  return cell >= (datum)resolution_ ? resolution_ - 1 : (unsigned int)cell;
+}
+
+unsigned int BoxGrid::CellY(datum y) const {
+  const datum cell = (y - min_y_) / cell_h_;
+  if(!(cell > 0))
+    return 0;
+  return cell >= (datum)resolution_ ? resolution_ - 1 : (unsigned int)cell;
+}
+
+NonMaximumSuppression::NonMaximumSuppression(JSON configuration) {
+  if(configuration.count("nms_method") == 1 && configuration["nms_method"].is_string()) {
+    std::string method_str = configuration["nms_method"];
+    if(method_str.compare("hard") == 0) {
+      method = NMS_HARD;
+    } else if(method_str.compare("soft_linear") == 0) {
+      method = NMS_SOFT_LINEAR;
+    } else if(method_str.compare("soft_gaussian") == 0) {
+      method = NMS_SOFT_GAUSSIAN;
+    } else {
+      FATAL("Unknown NMS method: " << method_str);
+    }
+  }
+
+  JSON_TRY_DATUM(threshold, configuration, "nms_threshold", 0.5);
+  JSON_TRY_DATUM(sigma, configuration, "nms_sigma", 0.5);
+  JSON_TRY_DATUM(min_score, configuration, "nms_min_score", 0.001);
+  JSON_TRY_INT(top_k, configuration, "nms_top_k", 0);
+}
+
+void NonMaximumSuppression::GroupByClass(const std::vector<BoundingBox>& boxes,
+                                         std::vector<std::vector<unsigned int>>& groups) {
+  groups.clear();
+  std::vector<unsigned int> order(boxes.size());
+  for(unsigned int b = 0; b < boxes.size(); b++)
+    order[b] = b;
+
+  std::sort(order.begin(), order.end(), [&boxes](unsigned int b1, unsigned int b2) {
+    return boxes[b1].c == boxes[b2].c ? boxes[b1].score > boxes[b2].score : boxes[b1].c < boxes[b2].c;
+  });
+
+  for(unsigned int b = 0; b < order.size(); b++) {
+    if(b == 0 || boxes[order[b]].c != boxes[order[b - 1]].c)
+      groups.push_back({});
+    groups.back().push_back(order[b]);
+  }
+}
+
+void NonMaximumSuppression::Apply(std::vector<BoundingBox>& boxes) const {
+  std::vector<std::vector<unsigned int>> groups;
+  GroupByClass(boxes, groups);
+
+  std::vector<bool> keep(boxes.size(), false);
+  for(std::vector<unsigned int>& group : groups) {
+    if(method == NMS_HARD)
+      SuppressHard(boxes, group, keep);
+    else
+      SuppressSoft(boxes, group, keep);
+  }
+
+  std::vector<BoundingBox> kept_boxes;
+  for(unsigned int b = 0; b < boxes.size(); b++) {
+    if(keep[b])
+      kept_boxes.push_back(boxes[b]);
+  }
+  std::sort(kept_boxes.begin(), kept_boxes.end(), BoundingBox::CompareScore);
+  boxes.swap(kept_boxes);
+}
+
+void NonMaximumSuppression::SuppressHard(std::vector<BoundingBox>& boxes, const std::vector<unsigned int>& group,
+                                         std::vector<bool>& keep) const {
+  BoxGrid grid(boxes, group);
+  unsigned int kept = 0;
+
+  // The group is sorted by descending score
+  for(unsigned int index : group) {
+    BoundingBox& box = boxes[index];
+    if(box.score == (datum)0)
+      continue;
+
+    // A box is removed if any higher scoring box overlaps it, whether
+    // that box is suppressed itself or not
+    bool suppressed = false;
+    grid.ForEachCandidate(box, [&](unsigned int other_index) -> bool {
+      BoundingBox& other = boxes[other_index];
+      if(other.score > box.score && box.IntersectionOverUnion(&other) > threshold) {
+        suppressed = true;
+        return false;
+      }
+      return true;
+    });
+
+    if(!suppressed && (top_k == 0 || kept < top_k)) {
+      keep[index] = true;
+      kept++;
+    }
+  }
+}
+
+void NonMaximumSuppression::SuppressSoft(std::vector<BoundingBox>& boxes, const std::vector<unsigned int>& group,
+                                         std::vector<bool>& keep) const {
+  BoxGrid grid(boxes, group);
+  std::vector<bool> finished(boxes.size(), false);
+  unsigned int kept = 0;
+
+  // Scores only ever decrease, so stale queue entries can be skipped lazily
+  std::priority_queue<std::pair<datum, unsigned int>> queue;
+  for(unsigned int index : group)
+    queue.push({boxes[index].score, index});
+
+  while(!queue.empty()) {
+    std::pair<datum, unsigned int> entry = queue.top();
+    queue.pop();
+    const unsigned int index = entry.second;
+    if(finished[index] || entry.first != boxes[index].score)
+      continue;
+
+    // Every remaining box scores lower than this one
+    if(entry.first < min_score)
+      break;
+
+    finished[index] = true;
+    keep[index] = true;
+    kept++;
+    if(top_k > 0 && kept >= top_k)
+      break;
+
+    BoundingBox& box = boxes[index];
+    grid.ForEachCandidate(box, [&](unsigned int other_index) -> bool {
+      if(finished[other_index])
+        return true;
+      BoundingBox& other = boxes[other_index];
+      const datum iou = box.IntersectionOverUnion(&other);
+      datum weight = 1;
+      if(method == NMS_SOFT_LINEAR) {
+        if(iou > threshold)
+          weight = (datum)1.0 - iou;
+      } else if(iou > 0) {
+        weight = (datum)std::exp(-(iou * iou) / sigma);
+      }
+      if(weight < (datum)1.0) {
+        other.score *= weight;
+        queue.push({other.score, other_index});
+      }
+      return true;
+    });
+  }
+}
+
+}
@@ -0,0 +1,270 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cstring>
+#include <fstream>
+
+#ifdef BUILD_POSIX
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+#include "Log.h"
+
+#include "ParameterFile.h"
+
+namespace Conv {
+
+// Magic, version, file length, set count and directory length
+static const std::uint64_t header_length = 5 * sizeof(std::uint64_t);
+static const std::uint64_t tensor_entry_length = 5 * sizeof(std::uint64_t);
+
+static std::uint64_t AlignOffset(const std::uint64_t offset) {
+  const std::uint64_t alignment = IndexedParameterFile::alignment;
+  return ((offset + alignment - 1) / alignment) * alignment;
+}
+
+static void WritePadding(std::ostream& output, std::uint64_t length) {
+  static const char zeros[IndexedParameterFile::alignment] = {0};
+  while(length > 0) {
+    const std::uint64_t chunk = length < IndexedParameterFile::alignment ? length : IndexedParameterFile::alignment;
+    output.write(zeros, chunk);
+    length -= chunk;
+  }
+}
+
+static void WriteString(std::ostream& output, const std::string& text) {
+  const std::uint32_t length = (std::uint32_t)text.length();
+  output.write((const char*)&length, sizeof(std::uint32_t));
+  output.write(text.c_str(), length);
+}
+
+bool IndexedParameterFile::Write(std::ostream& output, const std::vector<ParameterSet>& parameter_sets) {
+  // Calculate the directory's length to find the first data offset
+  std::uint64_t directory_length = 0;
+  for(const ParameterSet& parameter_set : parameter_sets) {
+    directory_length += 3 * sizeof(std::uint32_t) + parameter_set.name.length() + parameter_set.metadata.length();
+    directory_length += parameter_set.tensors.size() * tensor_entry_length;
+  }
+
+  std::uint64_t file_length = AlignOffset(header_length + directory_length);
+  std::vector<std::uint64_t> offsets;
+  for(const ParameterSet& parameter_set : parameter_sets) {
+    for(Tensor* tensor : parameter_set.tensors) {
+      offsets.push_back(file_length);
+      file_length = AlignOffset(file_length + tensor->elements() * sizeof(datum));
+    }
+  }
+
+  const std::uint64_t magic = CN24_PARIDX_MAGIC;
+  const std::uint64_t version = CN24_PARIDX_VERSION;
+  const std::uint64_t set_count = parameter_sets.size();
+  output.write((const char*)&magic, sizeof(std::uint64_t));
+  output.write((const char*)&version, sizeof(std::uint64_t));
+  output.write((const char*)&file_length, sizeof(std::uint64_t));
+  output.write((const char*)&set_count, sizeof(std::uint64_t));
+  output.write((const char*)&directory_length, sizeof(std::uint64_t));
+
+  // Write directory
+  unsigned int t = 0;
+  for(const ParameterSet& parameter_set : parameter_sets) {
+    WriteString(output, parameter_set.name);
+    WriteString(output, parameter_set.metadata);
+    const std::uint32_t tensor_count = (std::uint32_t)parameter_set.tensors.size();
+    output.write((const char*)&tensor_count, sizeof(std::uint32_t));
+    for(Tensor* tensor : parameter_set.tensors) {
+      const std::uint64_t entry[] = {offsets[t++], tensor->samples(), tensor->width(), tensor->height(), tensor->maps()};
+      output.write((const char*)entry, tensor_entry_length);
+    }
+  }
+
+  // Write data
+  std::uint64_t position = header_length + directory_length;
+  t = 0;
+  for(const ParameterSet& parameter_set : parameter_sets) {
+    for(Tensor* tensor : parameter_set.tensors) {
+      WritePadding(output, offsets[t++] - position);
+#ifdef BUILD_OPENCL
+      tensor->MoveToCPU();
+#endif
+      output.write((const char*)tensor->data_ptr_const(), tensor->elements() * sizeof(datum));
+      position = offsets[t - 1] + tensor->elements() * sizeof(datum);
+    }
+  }
+  WritePadding(output, file_length - position);
+
+  return output.good();
+}
+
+IndexedParameterFile::IndexedParameterFile(const std::string& path) {
+#ifdef BUILD_POSIX
+  int input_fd = open(path.c_str(), O_RDONLY);
+  if(input_fd < 0) {
+    LOGERROR << "Cannot open file: " << path;
+    return;
+  }
+
+  struct stat file_stat;
+  if(fstat(input_fd, &file_stat) != 0 || (std::uint64_t)file_stat.st_size < header_length
+    || file_stat.st_size % sizeof(datum) != 0) {
+    LOGERROR << "Not an indexed parameter file: " << path;
+    close(input_fd);
+    return;
+  }
+  const std::size_t length = (std::size_t)file_stat.st_size;
+
+  // Private mapping: parameters can be trained without touching the file
+#if defined(BUILD_LINUX)
+  void* target_mmap = mmap64(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, input_fd, 0);
+#elif defined(BUILD_OSX)
+  void* target_mmap = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, input_fd, 0);
+#endif
+  close(input_fd);
+
+  if(target_mmap == MAP_FAILED) {
+    LOGERROR << "Memory map failed: " << errno;
+    return;
+  }
+
+  file_.Resize(length / sizeof(datum), 1, 1, 1, (datum*)target_mmap, true);
+  file_.original_mmap_ = target_mmap;
+#else
+  std::ifstream input(path, std::ios::in | std::ios::binary | std::ios::ate);
+  if(!input.good()) {
+    LOGERROR << "Cannot open file: " << path;
+    return;
+  }
+  const std::size_t length = input.tellg();
+  if(length < header_length || length % sizeof(datum) != 0) {
+    LOGERROR << "Not an indexed parameter file: " << path;
+    return;
+  }
+  input.seekg(0, std::ios::beg);
+  file_.Resize(length / sizeof(datum));
+  input.read((char*)file_.data_ptr(), length);
+#endif
+  ParseDirectory();
+}
+
+IndexedParameterFile::IndexedParameterFile(std::istream& input) {
+  std::uint64_t header[3] = {CN24_PARIDX_MAGIC, 0, 0};
+  input.read((char*)&header[1], 2 * sizeof(std::uint64_t));
+  const std::uint64_t length = header[2];
+  if(!input.good() || length < header_length || length % sizeof(datum) != 0) {
+    LOGERROR << "Not an indexed parameter file";
+    return;
+  }
+
+  file_.Resize(length / sizeof(datum));
+  std::memcpy(file_.data_ptr(), header, sizeof(header));
+  input.read((char*)file_.data_ptr() + sizeof(header), length - sizeof(header));
+  if(!input.good()) {
+    LOGERROR << "Indexed parameter file is truncated";
+    return;
+  }
+  ParseDirectory();
+}
+
+void IndexedParameterFile::ParseDirectory() {
+  const char* bytes = (const char*)file_.data_ptr_const();
+  const std::uint64_t length = file_.elements() * sizeof(datum);
+  const std::uint64_t* header = (const std::uint64_t*)bytes;
+
+  if(header[0] != CN24_PARIDX_MAGIC) {
+    LOGERROR << "Not an indexed parameter file";
+    return;
+  }
+  if(header[1] != CN24_PARIDX_VERSION) {
+    LOGERROR << "Unsupported indexed parameter file version: " << header[1];
+    return;
+  }
+  if(header[2] > length || header_length + header[4] > length
+    || header[3] > header[4] / (3 * sizeof(std::uint32_t))) {
+    LOGERROR << "Indexed parameter file is truncated";
+    return;
+  }
+
+  const char* position = bytes + header_length;
+  const char* directory_end = position + header[4];
+  auto read_uint32 = [&](std::uint32_t& value) {
+    if(position + sizeof(std::uint32_t) > directory_end)
+      return false;
+    std::memcpy(&value, position, sizeof(std::uint32_t));
+    position += sizeof(std::uint32_t);
+    return true;
+  };
+  auto read_string = [&](std::string& text) {
+    std::uint32_t text_length = 0;
+    if(!read_uint32(text_length) || position + text_length > directory_end)
+      return false;
+    text.assign(position, text_length);
+    position += text_length;
+    return true;
+  };
+
+  sets_.resize(header[3]);
+  for(unsigned int s = 0; s < sets_.size(); s++) {
+    SetEntry& set = sets_[s];
+    std::uint32_t tensor_count = 0;
+    if(!read_string(set.name) || !read_string(set.metadata) || !read_uint32(tensor_count)
+      || position + tensor_count * tensor_entry_length > directory_end) {
+      LOGERROR << "Indexed parameter file has a broken directory";
+      sets_.clear();
+      return;
+    }
+
+    set.tensors.resize(tensor_count);
+    for(unsigned int t = 0; t < tensor_count; t++) {
+      TensorEntry& entry = set.tensors[t];
+      std::memcpy(&entry, position, tensor_entry_length);
+      position += tensor_entry_length;
+
+      const std::uint64_t elements = entry.samples * entry.width * entry.height * entry.maps;
+      if(entry.offset % sizeof(datum) != 0 || entry.offset + elements * sizeof(datum) > length) {
+        LOGERROR << "Tensor " << t << " of " << set.name << " is outside of the file";
+        sets_.clear();
+        return;
+      }
+    }
+    set_index_[set.name] = s;
+  }
+
+  valid_ = true;
+}
+
+int IndexedParameterFile::Find(const std::string& name) const {
+  std::map<std::string, unsigned int>::const_iterator set = set_index_.find(name);
+  if(set == set_index_.end())
+    return -1;
+  return (int)set->second;
+}
+
+bool IndexedParameterFile::View(unsigned int set, unsigned int tensor, Tensor& target) {
+  const TensorEntry& entry = sets_[set].tensors[tensor];
+  if(entry.samples * entry.width * entry.height * entry.maps == 0)
+    return false;
+  return target.View(file_, entry.offset / sizeof(datum), entry.samples, entry.width, entry.height, entry.maps);
+}
+
+void IndexedParameterFile::Copy(unsigned int set, unsigned int tensor, Tensor& target) const {
+  const TensorEntry& entry = sets_[set].tensors[tensor];
+#ifdef BUILD_OPENCL
+  target.MoveToCPU(true);
+#endif
+  target.Resize(entry.samples, entry.width, entry.height, entry.maps);
+  std::memcpy(target.data_ptr(), (const char*)file_.data_ptr_const() + entry.offset, target.elements() * sizeof(datum));
+}
+
+bool IndexedParameterFile::Contains(const datum* memory) const {
+  return memory >= file_.data_ptr_const() && memory < file_.data_ptr_const() + file_.elements();
+}
+
+}
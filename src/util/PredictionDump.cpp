@@ -0,0 +1,187 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cstdint>
+#include <cstring>
+
+#include "PredictionDump.h"
+
+namespace Conv {
+
+namespace {
+inline void WriteUInt64(std::ostream& output, uint64_t value) {
+  output.write((const char*)&value, sizeof(uint64_t) / sizeof(char));
+}
+
+inline uint64_t ReadUInt64(std::istream& input) {
+  uint64_t value = 0;
+  input.read((char*)&value, sizeof(uint64_t) / sizeof(char));
+  return value;
+}
+
+inline void WriteString(std::ostream& output, const std::string& value) {
+  WriteUInt64(output, value.length());
+  output.write(value.c_str(), value.length());
+}
+
+inline std::string ReadString(std::istream& input) {
+  uint64_t length = ReadUInt64(input);
+  std::string value(length, '\0');
+  if(length > 0)
+    input.read(&value[0], length);
+  return value;
+}
+}
+
+PredictionDumpWriter::PredictionDumpWriter(const std::string& path, const Tensor& prediction,
+                                           const ClassManager* class_manager,
+                                           const std::vector<std::string>& segment_names,
+                                           bool compress) :
+  output_(path, std::ios::out | std::ios::binary), compress_(compress) {
+  if(!output_.good()) {
+    LOGERROR << "Cannot open " << path << " for writing!";
+    return;
+  }
+
+  row_tensor_.Resize(1, prediction.width(), prediction.height(), prediction.maps());
+
+  WriteUInt64(output_, CN24_PDUMP_MAGIC);
+  WriteUInt64(output_, CN24_PDUMP_VERSION);
+  WriteUInt64(output_, compress_ ? PREDICTIONDUMP_COMPRESSED : 0);
+  WriteUInt64(output_, prediction.width());
+  WriteUInt64(output_, prediction.height());
+  WriteUInt64(output_, prediction.maps());
+
+  // Class names
+  std::vector<std::pair<std::string, ClassManager::Info>> classes;
+  if(class_manager != nullptr && class_manager->GetClassCount() > 0) {
+    for(unsigned int c = 0; c <= class_manager->GetMaxClassId(); c++) {
+      std::pair<std::string, ClassManager::Info> info = class_manager->GetClassInfoById(c);
+      if(info.second.id != UNKNOWN_CLASS)
+        classes.push_back(info);
+    }
+  }
+  WriteUInt64(output_, classes.size());
+  for(std::pair<std::string, ClassManager::Info>& info : classes) {
+    WriteUInt64(output_, info.second.id);
+    WriteString(output_, info.first);
+  }
+
+  // Segment names
+  WriteUInt64(output_, segment_names.size());
+  for(const std::string& segment_name : segment_names) {
+    WriteString(output_, segment_name);
+  }
+}
+
+PredictionDumpWriter::~PredictionDumpWriter() {
+  Close();
+}
+
+void PredictionDumpWriter::WriteRow(unsigned int segment, unsigned int sample_in_segment, datum score,
+                                    const Tensor& prediction, unsigned int sample) {
+  if(!output_.is_open())
+    return;
+
+  const std::size_t row_elements = row_tensor_.elements();
+  if(prediction.width() != row_tensor_.width() || prediction.height() != row_tensor_.height() ||
+     prediction.maps() != row_tensor_.maps() || sample >= prediction.samples()) {
+    FATAL("Prediction shape does not match dump header!");
+  }
+
+  WriteUInt64(output_, segment);
+  WriteUInt64(output_, sample_in_segment);
+  float score_f = (float)score;
+  output_.write((const char*)&score_f, sizeof(float) / sizeof(char));
+
+  const datum* sample_ptr = prediction.data_ptr_const(0, 0, 0, sample);
+  if(compress_) {
+    std::memcpy(row_tensor_.data_ptr(), sample_ptr, row_elements * sizeof(datum));
+    compressed_row_.Compress(row_tensor_);
+    compressed_row_.Serialize(output_);
+  } else {
+    output_.write((const char*)sample_ptr, (row_elements * sizeof(datum)) / sizeof(char));
+  }
+  rows_++;
+}
+
+void PredictionDumpWriter::Close() {
+  if(output_.is_open()) {
+    output_.close();
+    LOGDEBUG << "Wrote " << rows_ << " rows" << (compress_ ? " (compressed)" : "");
+  }
+}
+
+PredictionDumpReader::PredictionDumpReader(const std::string& path) :
+  input_(path, std::ios::in | std::ios::binary) {
+  if(!input_.good()) {
+    LOGERROR << "Cannot open " << path << " for reading!";
+    return;
+  }
+
+  uint64_t magic = ReadUInt64(input_);
+  if(magic != CN24_PDUMP_MAGIC) {
+    LOGERROR << path << " is not a prediction dump!";
+    return;
+  }
+
+  uint64_t version = ReadUInt64(input_);
+  if(version > CN24_PDUMP_VERSION) {
+    LOGERROR << "Unsupported prediction dump version: " << version;
+    return;
+  }
+
+  uint64_t flags = ReadUInt64(input_);
+  compress_ = (flags & PREDICTIONDUMP_COMPRESSED) != 0;
+  width_ = ReadUInt64(input_);
+  height_ = ReadUInt64(input_);
+  maps_ = ReadUInt64(input_);
+
+  uint64_t class_count = ReadUInt64(input_);
+  for(uint64_t c = 0; c < class_count; c++) {
+    unsigned int id = (unsigned int)ReadUInt64(input_);
+    class_names_.push_back({id, ReadString(input_)});
+  }
+
+  uint64_t segment_count = ReadUInt64(input_);
+  for(uint64_t s = 0; s < segment_count; s++) {
+    segment_names_.push_back(ReadString(input_));
+  }
+
+  good_ = input_.good();
+}
+
+bool PredictionDumpReader::ReadRow(unsigned int& segment, unsigned int& sample_in_segment, datum& score, Tensor& row) {
+  if(!good_)
+    return false;
+
+  input_.peek();
+  if(input_.eof())
+    return false;
+
+  segment = (unsigned int)ReadUInt64(input_);
+  sample_in_segment = (unsigned int)ReadUInt64(input_);
+  float score_f = 0;
+  input_.read((char*)&score_f, sizeof(float) / sizeof(char));
+  score = (datum)score_f;
+
+  if(compress_) {
+    compressed_row_.Deserialize(input_);
+    compressed_row_.Decompress(row);
+  } else {
+    row.Resize(1, width_, height_, maps_);
+    input_.read((char*)row.data_ptr(), (row.elements() * sizeof(datum)) / sizeof(char));
+  }
+
+  if(!input_.good()) {
+    good_ = false;
+    return false;
+  }
+  return true;
+}
+
+}
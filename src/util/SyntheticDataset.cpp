@@ -0,0 +1,198 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <random>
+#include <algorithm>
+
+#include "Log.h"
+#include "SyntheticDataset.h"
+
+namespace Conv {
+
+void SyntheticDataset::Load(JSON descriptor) {
+  std::string task = "segmentation";
+  if(descriptor.count("task") == 1 && descriptor["task"].is_string())
+    task = descriptor["task"];
+  if(task.compare("segmentation") == 0)
+    task_ = SEMANTIC_SEGMENTATION;
+  else if(task.compare("classification") == 0)
+    task_ = CLASSIFICATION;
+  else if(task.compare("detection") == 0)
+    task_ = DETECTION;
+  else
+    FATAL("Invalid task: " << task);
+
+  unsigned int classes, max_objects, seed;
+  JSON_TRY_INT(width_, descriptor, "width", 64);
+  JSON_TRY_INT(height_, descriptor, "height", 64);
+  JSON_TRY_INT(input_maps_, descriptor, "input_maps", 3);
+  JSON_TRY_INT(classes, descriptor, "classes", 3);
+  JSON_TRY_INT(training_samples_, descriptor, "training_samples", 256);
+  JSON_TRY_INT(testing_samples_, descriptor, "testing_samples", 32);
+  JSON_TRY_INT(max_objects, descriptor, "max_objects", 3);
+  JSON_TRY_INT(seed, descriptor, "seed", 0);
+  if(descriptor.count("name") == 1 && descriptor["name"].is_string())
+    name_ = descriptor["name"];
+
+  if(width_ < 4 || height_ < 4 || input_maps_ == 0 || classes == 0 || max_objects == 0 || training_samples_ == 0) {
+    FATAL("Invalid synthetic dataset: " << descriptor.dump());
+  }
+
+  // Segmentation uses the first class as background, except for binary
+  // labels. Objects are drawn from the other classes.
+  const bool binary = task_ == SEMANTIC_SEGMENTATION && classes == 1;
+  const unsigned int first_object_class = (task_ == SEMANTIC_SEGMENTATION && !binary) ? 1 : 0;
+  if(first_object_class >= classes) {
+    FATAL("Segmentation needs at least one class besides the background");
+  }
+
+  std::vector<unsigned int> class_ids;
+  for(unsigned int c = 0; c < classes; c++) {
+    const unsigned int color = (((c * 97 + 50) % 256) << 16) | (((c * 59 + 170) % 256) << 8) | ((c * 23 + 90) % 256);
+    const std::string class_name = (first_object_class == 1 && c == 0) ? "background" : "class" + std::to_string(c);
+    class_manager_->RegisterClassByName(class_name, color, 1.0);
+    class_ids.push_back(class_manager_->GetClassIdByName(class_name));
+  }
+
+  switch(task_) {
+    case SEMANTIC_SEGMENTATION:
+      label_maps_ = binary ? 1 : class_manager_->GetMaxClassId() + 1;
+      break;
+    case CLASSIFICATION:
+      label_maps_ = class_manager_->GetMaxClassId() + 1;
+      break;
+    case DETECTION:
+      label_maps_ = 0;
+      break;
+  }
+
+  const unsigned int samples = training_samples_ + testing_samples_;
+  data_.Resize(samples, width_, height_, input_maps_);
+  if(task_ == SEMANTIC_SEGMENTATION)
+    labels_.Resize(samples, width_, height_, label_maps_);
+  else if(task_ == CLASSIFICATION)
+    labels_.Resize(samples, 1, 1, label_maps_);
+  boxes_.assign(samples, std::vector<BoundingBox>());
+
+  std::mt19937 generator(seed);
+  std::uniform_real_distribution<datum> noise(0, 0.2);
+  std::uniform_real_distribution<datum> size(0.15, 0.5);
+  std::uniform_real_distribution<datum> unit(0, 1);
+  std::uniform_int_distribution<unsigned int> object_class(first_object_class, classes - 1);
+  std::uniform_int_distribution<unsigned int> object_count(1, max_objects);
+
+  for(unsigned int s = 0; s < samples; s++) {
+    for(unsigned int y = 0; y < height_; y++) {
+      for(unsigned int x = 0; x < width_; x++) {
+        for(unsigned int m = 0; m < input_maps_; m++)
+          *data_.data_ptr(x, y, m, s) = noise(generator);
+      }
+    }
+
+    if(task_ == SEMANTIC_SEGMENTATION) {
+      labels_.Clear(binary ? -1 : 0, s);
+      if(!binary) {
+        for(unsigned int y = 0; y < height_; y++) {
+          for(unsigned int x = 0; x < width_; x++)
+            *labels_.data_ptr(x, y, class_ids[0], s) = 1;
+        }
+      }
+    } else if(task_ == CLASSIFICATION) {
+      labels_.Clear(0, s);
+    }
+
+    const unsigned int objects = task_ == CLASSIFICATION ? 1 : object_count(generator);
+    for(unsigned int o = 0; o < objects; o++) {
+      const unsigned int c = object_class(generator);
+      const datum w = size(generator), h = size(generator);
+      const datum cx = w / 2 + (1 - w) * unit(generator), cy = h / 2 + (1 - h) * unit(generator);
+
+      const unsigned int x0 = (unsigned int)((cx - w / 2) * width_), x1 = std::min(width_, (unsigned int)((cx + w / 2) * width_));
+      const unsigned int y0 = (unsigned int)((cy - h / 2) * height_), y1 = std::min(height_, (unsigned int)((cy + h / 2) * height_));
+
+      const unsigned int color = class_manager_->GetClassInfoById(class_ids[c]).second.color;
+      for(unsigned int y = y0; y < y1; y++) {
+        for(unsigned int x = x0; x < x1; x++) {
+          for(unsigned int m = 0; m < input_maps_; m++)
+            *data_.data_ptr(x, y, m, s) = DATUM_FROM_UCHAR((color >> (8 * (2 - m % 3))) & 0xFF);
+
+          if(task_ == SEMANTIC_SEGMENTATION) {
+            if(binary) {
+              *labels_.data_ptr(x, y, 0, s) = 1;
+            } else {
+              for(unsigned int l = 0; l < label_maps_; l++)
+                *labels_.data_ptr(x, y, l, s) = 0;
+              *labels_.data_ptr(x, y, class_ids[c], s) = 1;
+            }
+          }
+        }
+      }
+
+      if(task_ == CLASSIFICATION) {
+        *labels_.data_ptr(0, 0, class_ids[c], s) = 1;
+      } else if(task_ == DETECTION) {
+        BoundingBox box(cx, cy, w, h);
+        box.c = class_ids[c];
+        boxes_[s].push_back(box);
+      }
+    }
+  }
+
+  LOGDEBUG << "Generated " << training_samples_ << " training and " << testing_samples_ << " testing samples";
+}
+
+bool SyntheticDataset::GetSample(Tensor &data_tensor, Tensor &label_tensor, Tensor &helper_tensor,
+                                 Tensor &weight_tensor, unsigned int sample, unsigned int index) {
+  bool success = Tensor::CopySample(data_, index, data_tensor, sample);
+  if(task_ != DETECTION)
+    success &= Tensor::CopySample(labels_, index, label_tensor, sample);
+
+  // Write spatial prior data to helper tensor
+  if(task_ == SEMANTIC_SEGMENTATION) {
+    for (unsigned int y = 0; y < height_; y++) {
+      for (unsigned int x = 0; x < width_; x++) {
+        *helper_tensor.data_ptr(x, y, 0, sample) = ((datum)x) / ((datum)width_ - 1);
+        *helper_tensor.data_ptr(x, y, 1, sample) = ((datum)y) / ((datum)height_ - 1);
+      }
+    }
+  }
+
+  weight_tensor.Clear(1.0, sample);
+  return success;
+}
+
+bool SyntheticDataset::GetTrainingSample(Tensor &data_tensor, Tensor &label_tensor, Tensor &helper_tensor,
+                                         Tensor &weight_tensor, unsigned int sample, unsigned int index) {
+  if(index >= training_samples_)
+    return false;
+  return GetSample(data_tensor, label_tensor, helper_tensor, weight_tensor, sample, index);
+}
+
+bool SyntheticDataset::GetTestingSample(Tensor &data_tensor, Tensor &label_tensor, Tensor &helper_tensor,
+                                        Tensor &weight_tensor, unsigned int sample, unsigned int index) {
+  if(index >= testing_samples_)
+    return false;
+  return GetSample(data_tensor, label_tensor, helper_tensor, weight_tensor, sample, training_samples_ + index);
+}
+
+bool SyntheticDataset::GetTrainingMetadata(DatasetMetadataPointer *metadata_array, unsigned int sample,
+                                           unsigned int index) {
+  if(task_ != DETECTION || index >= training_samples_)
+    return false;
+  metadata_array[sample] = &(boxes_[index]);
+  return true;
+}
+
+bool SyntheticDataset::GetTestingMetadata(DatasetMetadataPointer *metadata_array, unsigned int sample,
+                                          unsigned int index) {
+  if(task_ != DETECTION || index >= testing_samples_)
+    return false;
+  metadata_array[sample] = &(boxes_[training_samples_ + index]);
+  return true;
+}
+
+}
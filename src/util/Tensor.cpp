@@ -30,6 +30,7 @@
 #include "Config.h"
 #include "Log.h"
 #include "Tensor.h"
+#include "TensorFile.h"
 #include "CLHelper.h"
 
 namespace Conv {
@@ -73,6 +74,7 @@ Tensor::Tensor ( Tensor && tensor ) {
   width_ = tensor.width_;
   height_ = tensor.height_;
   elements_ = tensor.elements_;
+  capacity_ = tensor.capacity_;
 
   tensor.data_ptr_ = nullptr;
   tensor.DeleteIfPossible();
@@ -128,6 +130,40 @@ void Tensor::Shadow ( Tensor& tensor ) {
 #endif
 }
 
+bool Tensor::View ( Tensor& tensor, const std::size_t offset,
+                    const std::size_t samples, const std::size_t width,
+                    const std::size_t height, const std::size_t maps ) {
+#ifdef BUILD_OPENCL
+  // A view would need its own sub-buffer on the device
+  UNREFERENCED_PARAMETER(tensor);
+  UNREFERENCED_PARAMETER(offset);
+  UNREFERENCED_PARAMETER(samples);
+  UNREFERENCED_PARAMETER(width);
+  UNREFERENCED_PARAMETER(height);
+  UNREFERENCED_PARAMETER(maps);
+  return false;
+#else
+  const std::size_t elements = samples * width * height * maps;
+  if ( tensor.data_ptr_ == nullptr || offset + elements > tensor.elements_ ) {
+    LOGERROR << "View doesn't fit into " << tensor;
+    return false;
+  }
+
+  DeleteIfPossible();
+
+  data_ptr_ = tensor.data_ptr_ + offset;
+  samples_ = samples;
+  maps_ = maps;
+  width_ = width;
+  height_ = height;
+  elements_ = elements;
+
+  is_shadow_ = true;
+  shadow_target_ = &tensor;
+  return true;
+#endif
+}
+
 
 void Tensor::Resize ( const std::size_t samples, const std::size_t width,
                       const std::size_t height, const std::size_t maps, datum* const preallocated_memory, bool mmapped, bool dont_delete) {
@@ -147,6 +183,8 @@ void Tensor::Resize ( const std::size_t samples, const std::size_t width,
     return;
 
   if(preallocated_memory != nullptr) {
+    if(preallocated_memory != data_ptr_)
+      capacity_ = elements;
     data_ptr_ = preallocated_memory;
     mmapped_ = mmapped;
   } else {
@@ -156,6 +194,7 @@ void Tensor::Resize ( const std::size_t samples, const std::size_t width,
 #else
     data_ptr_ = new datum[elements];
 #endif
+    capacity_ = elements;
   }
 
   // Save configuration
@@ -173,25 +212,49 @@ void Tensor::Extend(const std::size_t samples) {
   }
 
 #ifdef BUILD_OPENCL
-  MoveToCPU(true);
+  MoveToCPU();
+  if ( cl_data_ptr_ != 0 ) {
+    // The GPU buffer is recreated with the new size on the next upload
+    clReleaseMemObject ( (cl_mem)cl_data_ptr_ );
+    cl_data_ptr_ = 0;
+  }
 #endif
 
-  // Make backup
-  Tensor temp_tensor;
-  temp_tensor.Resize(*this);
-  if(!Tensor::Copy(*this, temp_tensor)) {
-    FATAL("Failed to backup Tensor before extension!")
-  }
+  const std::size_t sample_elements = width_ * height_ * maps_;
+  const std::size_t elements = samples * sample_elements;
 
-  Resize(samples, width_, height_, maps_);
-  Clear();
+  if(is_shadow_ || mmapped_ || elements > capacity_) {
+    // Grow geometrically so that repeated extensions stay cheap
+    std::size_t capacity = 2 * samples_ * sample_elements;
+    if(capacity < elements)
+      capacity = elements;
 
-  // Restore data
-  for(unsigned int s = 0; s < temp_tensor.samples(); s++) {
-    if(!Tensor::CopySample(temp_tensor, s, *this, s)) {
-      FATAL("Failed to restore Tensor after extension!");
-    }
+#ifdef BLAS_MKL
+    datum* new_data_ptr = ( datum* ) MKL_malloc ( capacity * sizeof ( datum ) / sizeof ( char ), 32 );
+#else
+    datum* new_data_ptr = new datum[capacity];
+#endif
+    if(elements_ > 0)
+      std::memcpy(new_data_ptr, data_ptr_, elements_ * sizeof(datum));
+
+    const std::size_t old_elements = elements_;
+    const std::size_t width = width_, height = height_, maps = maps_;
+    DeleteIfPossible();
+
+    data_ptr_ = new_data_ptr;
+    capacity_ = capacity;
+    width_ = width;
+    height_ = height;
+    maps_ = maps;
+    elements_ = old_elements;
   }
+
+  // Clear new samples
+  for(std::size_t element = elements_; element < elements; element++)
+    data_ptr_[element] = 0;
+
+  samples_ = samples;
+  elements_ = elements;
 }
 void Tensor::Resize ( const Tensor& tensor ) {
   Resize ( tensor.samples(), tensor.width(), tensor.height(), tensor.maps() );
@@ -317,35 +380,59 @@ void Tensor::Deserialize ( std::istream& input , bool head_only, bool try_mmap,
 
   if ( elements > 0 && !head_only ) {
 #ifdef BUILD_POSIX
-    if(try_mmap && fd != 0) {
-      // Get page size
-      long int page_size = sysconf(_SC_PAGESIZE);
-      long int current_position = input.tellg();
-      long int offset_in_page = current_position % page_size;
-#ifdef BUILD_LINUX
-      void* target_mmap = mmap64(NULL,((elements* sizeof(datum)) / sizeof(char)) + offset_in_page, PROT_READ, MAP_PRIVATE, fd, current_position - offset_in_page);
-#elif defined(BUILD_OSX)
-      // OS X is 64-bit by default
-      void* target_mmap = mmap(NULL,((elements* sizeof(datum)) / sizeof(char)) + offset_in_page, PROT_READ, MAP_PRIVATE, fd, current_position - offset_in_page);
-#endif
-      if(target_mmap == MAP_FAILED) {
-        LOGERROR << "Memory map failed: " << errno;
-      }
-      original_mmap_ = target_mmap;
-      
-      target_mmap = (void*)(((long)target_mmap) + offset_in_page);
-      Resize(samples, width, height, maps, (datum*)target_mmap, true);
+    if(try_mmap && fd != 0 && MapFile(fd, input.tellg(), samples, width, height, maps)) {
       input.seekg(( elements * sizeof ( datum ) ) / sizeof ( char ) , std::ios::cur);
-    } else
+    } else {
+      if(try_mmap && fd != 0)
+        Resize ( samples, width, height, maps );
 #endif
       input.read ( ( char* ) data_ptr_, ( elements * sizeof ( datum ) )
                   / sizeof ( char ) );
+#ifdef BUILD_POSIX
+    }
+#endif
   }
   else if(head_only)
     input.seekg(( elements * sizeof ( datum ) ) / sizeof ( char ) , std::ios::cur);
       
 }
 
+bool Tensor::MapFile ( int fd, const std::size_t offset, const std::size_t samples,
+                       const std::size_t width, const std::size_t height, const std::size_t maps ) {
+#ifdef BUILD_POSIX
+  const std::size_t elements = samples * maps * width * height;
+  if ( elements == 0 )
+    return false;
+
+  // The mapping has to start at the beginning of a page
+  long int page_size = sysconf(_SC_PAGESIZE);
+  long int offset_in_page = offset % page_size;
+#ifdef BUILD_LINUX
+  void* target_mmap = mmap64(NULL,((elements* sizeof(datum)) / sizeof(char)) + offset_in_page, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, offset - offset_in_page);
+#elif defined(BUILD_OSX)
+  // OS X is 64-bit by default
+  void* target_mmap = mmap(NULL,((elements* sizeof(datum)) / sizeof(char)) + offset_in_page, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, offset - offset_in_page);
+#endif
+  if(target_mmap == MAP_FAILED) {
+    LOGERROR << "Memory map failed: " << errno;
+    return false;
+  }
+
+  DeleteIfPossible();
+  Resize(samples, width, height, maps, (datum*)(((char*)target_mmap) + offset_in_page), true);
+  original_mmap_ = target_mmap;
+  return true;
+#else
+  UNREFERENCED_PARAMETER(fd);
+  UNREFERENCED_PARAMETER(offset);
+  UNREFERENCED_PARAMETER(samples);
+  UNREFERENCED_PARAMETER(width);
+  UNREFERENCED_PARAMETER(height);
+  UNREFERENCED_PARAMETER(maps);
+  return false;
+#endif
+}
+
 bool Tensor::Copy (const Tensor& source, Tensor& target) {
   if(source.elements() != target.elements()) {
     return false;
@@ -480,7 +567,8 @@ void Tensor::DeleteIfPossible() {
     if ( !is_shadow_ ) {
 #ifdef BUILD_POSIX
       if(mmapped_) {
-        munmap((void*)original_mmap_, (elements_ * sizeof(datum)) / sizeof(char));
+        // The mapping starts at the beginning of the page
+        munmap((void*)original_mmap_, (elements_ * sizeof(datum)) / sizeof(char) + ((char*)data_ptr_ - (char*)original_mmap_));
         original_mmap_ = nullptr;
         mmapped_ = false;
       } else {
@@ -501,6 +589,12 @@ void Tensor::DeleteIfPossible() {
       
       cl_gpu_ = false;
 #endif
+    } else {
+#ifdef BUILD_OPENCL
+      // The device buffer belongs to the shadowed Tensor
+      cl_data_ptr_ = 0;
+      cl_gpu_ = false;
+#endif
     }
 
     data_ptr_ = nullptr;
@@ -511,6 +605,7 @@ void Tensor::DeleteIfPossible() {
   height_ = 0;
   maps_ = 0;
   elements_ = 0;
+  capacity_ = 0;
   is_shadow_ = false;
   shadow_target_ = nullptr;
 }
@@ -702,13 +797,12 @@ void Tensor::LoadFromFile ( const std::string& filename ) {
 
 #endif
 
-  if ( filename.compare ( filename.length() - 3, 3, "Tensor" ) == 0 ) {
-    std::ifstream input_image_file ( filename, std::ios::in | std::ios::binary );
+  if ( filename.length() >= 6 && filename.compare ( filename.length() - 6, 6, "Tensor" ) == 0 ) {
+    TensorFile tensor_file ( filename );
 
-    if ( !input_image_file.good() )
+    if ( !tensor_file.IsValid() || tensor_file.GetTensorCount() == 0 || !tensor_file.Load ( 0, *this ) )
       FATAL ( "Cannot load " << filename );
 
-    Deserialize ( input_image_file );
     return;
   }
 
@@ -745,13 +839,22 @@ void Tensor::WriteToFile ( const std::string& filename ) {
 
 #endif
 
-  if ( filename.compare ( filename.length() - 3, 3, "Tensor" ) == 0 ) {
+  if ( filename.length() >= 6 && filename.compare ( filename.length() - 6, 6, "Tensor" ) == 0 ) {
+    if ( mmapped_ ) {
+      // The file could be the one this Tensor is mapped from
+      Tensor copy ( *this, true );
+      copy.WriteToFile ( filename );
+      return;
+    }
+
     std::ofstream output_image_file ( filename, std::ios::out | std::ios::binary );
 
     if ( !output_image_file.good() )
       FATAL ( "Cannot write " << filename );
 
-    Serialize ( output_image_file );
+    TensorFileWriter writer ( output_image_file );
+    if ( !writer.Write ( *this ) || !writer.Finish() )
+      FATAL ( "Cannot write " << filename );
     return;
   }
 
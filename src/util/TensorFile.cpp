@@ -0,0 +1,202 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#ifdef BUILD_POSIX
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Log.h"
+
+#include "TensorFile.h"
+
+namespace Conv {
+
+// Magic, four uint32_t fields, alignment, tensor count, directory offset
+static const std::uint64_t header_length = 6 * sizeof(std::uint64_t);
+static const std::uint64_t count_position = 4 * sizeof(std::uint64_t);
+
+TensorFile::TensorFile(const std::string& path) {
+  input_.open(path, std::ios::in | std::ios::binary);
+  if(!input_.good()) {
+    LOGERROR << "Cannot open file: " << path;
+    return;
+  }
+#ifdef BUILD_POSIX
+  file_descriptor_ = open(path.c_str(), O_RDONLY);
+  if(file_descriptor_ < 0) {
+    LOGERROR << "Cannot open file: " << path;
+    file_descriptor_ = 0;
+    return;
+  }
+#endif
+
+  std::uint64_t magic = 0;
+  input_.read((char*)&magic, sizeof(std::uint64_t));
+  aligned_ = input_.good() && magic == CN24_TENSORFILE_MAGIC;
+  input_.clear();
+  valid_ = aligned_ ? ReadDirectory() : ScanLegacy();
+  if(!valid_)
+    LOGERROR << "Cannot read tensors from " << path;
+}
+
+TensorFile::~TensorFile() {
+#ifdef BUILD_POSIX
+  // Mappings stay valid after the descriptor is closed
+  if(file_descriptor_ > 0)
+    close(file_descriptor_);
+#endif
+}
+
+bool TensorFile::ReadDirectory() {
+  std::uint32_t version = 0, dtype = 0, layout = 0, reserved = 0;
+  std::uint64_t file_alignment = 0, tensor_count = 0, directory_offset = 0;
+  input_.read((char*)&version, sizeof(std::uint32_t));
+  input_.read((char*)&dtype, sizeof(std::uint32_t));
+  input_.read((char*)&layout, sizeof(std::uint32_t));
+  input_.read((char*)&reserved, sizeof(std::uint32_t));
+  input_.read((char*)&file_alignment, sizeof(std::uint64_t));
+  input_.read((char*)&tensor_count, sizeof(std::uint64_t));
+  input_.read((char*)&directory_offset, sizeof(std::uint64_t));
+  if(!input_.good())
+    return false;
+
+  if(version != CN24_TENSORFILE_VERSION) {
+    LOGERROR << "Unsupported tensor file version: " << version;
+    return false;
+  }
+  if(dtype != CN24_TENSORFILE_DTYPE_FLOAT32 || sizeof(datum) != 4 || layout != CN24_TENSORFILE_LAYOUT_SMHW) {
+    LOGERROR << "Unsupported element type " << dtype << " or layout " << layout;
+    return false;
+  }
+
+  input_.seekg(0, std::ios::end);
+  const std::uint64_t length = input_.tellg();
+  if(directory_offset < header_length || directory_offset + tensor_count * sizeof(TensorFileEntry) > length) {
+    LOGERROR << "Tensor file is incomplete";
+    return false;
+  }
+
+  entries_.resize(tensor_count);
+  input_.seekg(directory_offset, std::ios::beg);
+  if(tensor_count > 0)
+    input_.read((char*)&entries_[0], tensor_count * sizeof(TensorFileEntry));
+  if(!input_.good())
+    return false;
+
+  for(const TensorFileEntry& entry : entries_) {
+    if(entry.offset + entry.samples * entry.width * entry.height * entry.maps * sizeof(datum) > length) {
+      LOGERROR << "Tensor is outside of the file";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TensorFile::ScanLegacy() {
+  input_.seekg(0, std::ios::end);
+  const std::uint64_t length = input_.tellg();
+  input_.seekg(0, std::ios::beg);
+
+  // Skip over the data, only the Tensor headers are read
+  while(!input_.eof()) {
+    TensorFileEntry entry;
+    input_.read((char*)&entry.samples, sizeof(std::uint64_t));
+    input_.read((char*)&entry.width, sizeof(std::uint64_t));
+    input_.read((char*)&entry.height, sizeof(std::uint64_t));
+    input_.read((char*)&entry.maps, sizeof(std::uint64_t));
+    if(!input_.good())
+      break;
+
+    const std::uint64_t elements = entry.samples * entry.width * entry.height * entry.maps;
+    if(elements == 0)
+      break;
+
+    entry.offset = input_.tellg();
+    if(entry.offset + elements * sizeof(datum) > length) {
+      LOGERROR << "Tensor " << entries_.size() << " is truncated";
+      return false;
+    }
+    entries_.push_back(entry);
+    input_.seekg(elements * sizeof(datum), std::ios::cur);
+    input_.peek();
+  }
+  return true;
+}
+
+bool TensorFile::Load(unsigned int index, Tensor& target, bool try_mmap) {
+  if(index >= entries_.size())
+    return false;
+
+  const TensorFileEntry& entry = entries_[index];
+  if(try_mmap && file_descriptor_ > 0 &&
+    target.MapFile(file_descriptor_, entry.offset, entry.samples, entry.width, entry.height, entry.maps))
+    return true;
+
+#ifdef BUILD_OPENCL
+  target.MoveToCPU(true);
+#endif
+  target.Resize(entry.samples, entry.width, entry.height, entry.maps);
+  input_.clear();
+  input_.seekg(entry.offset, std::ios::beg);
+  input_.read((char*)target.data_ptr(), target.elements() * sizeof(datum));
+  return input_.good();
+}
+
+TensorFileWriter::TensorFileWriter(std::ostream& output) : output_(output) {
+  // The reader expects the header at the beginning of the file
+  at_start_ = output_.tellp() == std::streampos(0);
+  if(!at_start_) {
+    LOGERROR << "Tensor files have to be written from the beginning of the stream";
+  }
+
+  const std::uint64_t magic = CN24_TENSORFILE_MAGIC;
+  const std::uint32_t fields[] = {CN24_TENSORFILE_VERSION, CN24_TENSORFILE_DTYPE_FLOAT32, CN24_TENSORFILE_LAYOUT_SMHW, 0};
+  const std::uint64_t file_alignment = TensorFile::alignment;
+  // Tensor count and directory offset are written by Finish()
+  const std::uint64_t placeholders[] = {0, 0};
+  output_.write((const char*)&magic, sizeof(std::uint64_t));
+  output_.write((const char*)fields, sizeof(fields));
+  output_.write((const char*)&file_alignment, sizeof(std::uint64_t));
+  output_.write((const char*)placeholders, sizeof(placeholders));
+  position_ = header_length;
+}
+
+bool TensorFileWriter::Write(Tensor& tensor) {
+  static const char zeros[TensorFile::alignment] = {0};
+  const std::uint64_t padding = (TensorFile::alignment - (position_ % TensorFile::alignment)) % TensorFile::alignment;
+  output_.write(zeros, padding);
+  position_ += padding;
+
+  TensorFileEntry entry = {position_, tensor.samples(), tensor.width(), tensor.height(), tensor.maps()};
+  entries_.push_back(entry);
+
+#ifdef BUILD_OPENCL
+  tensor.MoveToCPU();
+#endif
+  output_.write((const char*)tensor.data_ptr_const(), tensor.elements() * sizeof(datum));
+  position_ += tensor.elements() * sizeof(datum);
+  return output_.good();
+}
+
+bool TensorFileWriter::Finish() {
+  if(!at_start_)
+    return false;
+
+  const std::uint64_t directory[] = {entries_.size(), position_};
+  if(entries_.size() > 0)
+    output_.write((const char*)&entries_[0], entries_.size() * sizeof(TensorFileEntry));
+
+  output_.seekp(count_position, std::ios::beg);
+  output_.write((const char*)directory, sizeof(directory));
+  output_.seekp(0, std::ios::end);
+  return output_.good();
+}
+
+}
@@ -270,6 +270,11 @@ bool TensorStreamDataset::GetTestingSample (Tensor& data_tensor, Tensor& label_t
   } else return false;
 }
 
+void TensorStreamDataset::RegisterClasses (ClassManager* class_manager) const {
+  for (unsigned int c = 0; c < classes_; c++)
+    class_manager->RegisterClassByName (class_names_[c], class_colors_[c], class_weights_[c]);
+}
+
 TensorStreamDataset* TensorStreamDataset::CreateFromConfiguration (std::istream& file , bool dont_load, DatasetLoadSelection selection, ClassManager* class_manager) {
   unsigned int classes = 0;
   std::vector<std::string> class_names;
@@ -5,12 +5,6 @@
  * For licensing information, see the LICENSE file included with this project.
  */
 
-#ifdef BUILD_POSIX
-#include <fcntl.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#endif
-
 #include <fstream>
 #include <cstdlib>
 #include <cstring>
@@ -19,6 +13,7 @@
 #include "Config.h"
 #include "Dataset.h"
 #include "Init.h"
+#include "TensorFile.h"
 
 #include "KITTIData.h"
 #include "TensorViewer.h"
@@ -32,8 +27,8 @@ datum DefaultLocalizedErrorFunction (unsigned int x, unsigned int y, unsigned in
   UNREFERENCED_PARAMETER(h);
   return 1;
 }
-TensorStreamPatchDataset::TensorStreamPatchDataset(std::istream& training_stream,
-		std::istream& testing_stream,
+TensorStreamPatchDataset::TensorStreamPatchDataset(const std::string& training_file,
+		const std::string& testing_file,
 		unsigned int classes,
 		std::vector< std::string > class_names,
 		std::vector<unsigned int> class_colors,
@@ -41,7 +36,7 @@ TensorStreamPatchDataset::TensorStreamPatchDataset(std::istream& training_stream
 		unsigned int patchsize_x,
 		unsigned int patchsize_y, ClassManager* class_manager,
 		dataset_localized_error_function error_function,
-    int training_fd, int testing_fd ) : Dataset(class_manager),
+    bool try_mmap ) : Dataset(class_manager),
   patchsize_x_(patchsize_x), patchsize_y_(patchsize_y),
 	class_names_(class_names), class_colors_(class_colors),
 	class_weights_(class_weights),
@@ -54,19 +49,23 @@ TensorStreamPatchDataset::TensorStreamPatchDataset(std::istream& training_stream
 		FATAL("Class count does not match class information count!");
 	}
 
-	// Count tensors
-	Tensor tensor;
-
-	while (!training_stream.eof()) {
-		tensor.Deserialize(training_stream, true);
-
-		if (tensor.elements() == 0)
-			break;
-
-		// LOGDEBUG << "Tensor " << tensor_count_training_ << ": " << tensor;
-		tensor_count_training_++;
-
-		training_stream.peek();
+	// Both formats are read through TensorFile, which only reads the
+	// directory (or scans the Tensor headers of old files) at this point
+	TensorFile* training_tensors = nullptr;
+	TensorFile* testing_tensors = nullptr;
+	if (training_file.length() > 0) {
+		training_tensors = new TensorFile(training_file);
+		if (!training_tensors->IsValid()) {
+			FATAL("Failed to load " << training_file << "!");
+		}
+		tensor_count_training_ = training_tensors->GetTensorCount();
+	}
+	if (testing_file.length() > 0) {
+		testing_tensors = new TensorFile(testing_file);
+		if (!testing_tensors->IsValid()) {
+			FATAL("Failed to load " << testing_file << "!");
+		}
+		tensor_count_testing_ = testing_tensors->GetTensorCount();
 	}
 
 	LOGDEBUG << tensor_count_training_ / 2 << " training tensors";
@@ -76,18 +75,6 @@ TensorStreamPatchDataset::TensorStreamPatchDataset(std::istream& training_stream
 		FATAL("Odd training tensor count!");
 	}
 
-	while (!testing_stream.eof()) {
-		tensor.Deserialize(testing_stream, true);
-
-		if (tensor.elements() == 0)
-			break;
-
-		// LOGDEBUG << "Tensor " << tensor_count_testing_ << ": " << tensor;
-		tensor_count_testing_++;
-
-		testing_stream.peek();
-	}
-
 	LOGDEBUG << tensor_count_testing_ / 2 << " testing tensors";
 
 	if (tensor_count_testing_ & 1) {
@@ -96,12 +83,6 @@ TensorStreamPatchDataset::TensorStreamPatchDataset(std::istream& training_stream
 
 	tensors_ = (tensor_count_testing_ + tensor_count_training_) / 2;
 
-	// Reset streams
-	training_stream.clear();
-	testing_stream.clear();
-	training_stream.seekg(0, std::ios::beg);
-	testing_stream.seekg(0, std::ios::beg);
-
 	// Allocate arrays that depend on the tensor count
 	if (tensors_ > 0) {
 		data_ = new Tensor[tensors_];
@@ -119,26 +100,14 @@ TensorStreamPatchDataset::TensorStreamPatchDataset(std::istream& training_stream
     LOGINFO << "Deserializing " << (tensor_count_training_ + tensor_count_testing_) / 2 << " Tensors..." << std::endl << std::flush;
   }
 
-	for (unsigned int t = 0; t < (tensor_count_training_ / 2); t++) {
-		data_[t].Deserialize(training_stream, false, true, training_fd);
-
-		unsigned int inner_width = data_[t].width() - (patchsize_x_ - 1);
-		unsigned int inner_height = data_[t].height() - (patchsize_y_ - 1);
+	for (unsigned int t = 0; t < tensors_; t++) {
+		const bool training = t < (tensor_count_training_ / 2);
+		TensorFile* file = training ? training_tensors : testing_tensors;
+		const unsigned int index = training ? t : t - (tensor_count_training_ / 2);
 
-		if (t == 0)
-			last_sample_[t] = inner_width * inner_height;
-		else
-			last_sample_[t] = last_sample_[t - 1] + (inner_width * inner_height);
-
-		sample_count_training_ += inner_width * inner_height;
-
-		labels_[t].Deserialize(training_stream, false, true, training_fd);
-    
-    std::cout << "." << std::flush;
-	}
-
-	for (unsigned int t = (tensor_count_training_ / 2); t < tensors_; t++) {
-		data_[t].Deserialize(testing_stream, false, true, testing_fd);
+		if (!file->Load(2 * index, data_[t], try_mmap) || !file->Load(2 * index + 1, labels_[t], try_mmap)) {
+			FATAL("Failed to load tensor " << index << " of " << (training ? training_file : testing_file) << "!");
+		}
 
 		unsigned int inner_width = data_[t].width() - (patchsize_x_ - 1);
 		unsigned int inner_height = data_[t].height() - (patchsize_y_ - 1);
@@ -148,13 +117,17 @@ TensorStreamPatchDataset::TensorStreamPatchDataset(std::istream& training_stream
 		else
 			last_sample_[t] = last_sample_[t - 1] + (inner_width * inner_height);
 
-		sample_count_testing_ += inner_width * inner_height;
+		if (training)
+			sample_count_training_ += inner_width * inner_height;
+		else
+			sample_count_testing_ += inner_width * inner_height;
 
-		labels_[t].Deserialize(testing_stream, false, true, testing_fd);
-    
     std::cout << "." << std::flush;
 	}
 
+	delete training_tensors;
+	delete testing_tensors;
+
 	input_maps_ = data_[0].maps();
 	label_maps_ = labels_[0].maps();
 }
@@ -320,8 +293,6 @@ TensorStreamPatchDataset* TensorStreamPatchDataset::CreateFromConfiguration (std
   dataset_localized_error_function error_function = DefaultLocalizedErrorFunction;
   std::string training_file;
   std::string testing_file;
-  int training_fd = 0;
-  int testing_fd = 0;
   bool no_mmap = false;
 
   file.clear();
@@ -400,49 +371,19 @@ TensorStreamPatchDataset* TensorStreamPatchDataset::CreateFromConfiguration (std
   LOGDEBUG << "Training tensor: " << training_file;
   LOGDEBUG << "Testing tensor: " << testing_file;
 
-  std::istream* training_stream = nullptr;
-  std::istream* testing_stream = nullptr;
-
-  if (!dont_load && (selection == LOAD_BOTH || selection == LOAD_TRAINING_ONLY) && training_file.length() > 0) {
-    training_stream = new std::ifstream (training_file, std::ios::in | std::ios::binary);
-    if(!training_stream->good()) {
-      FATAL("Failed to load " << training_file << "!");
-    }
-#ifdef BUILD_POSIX
-    if(!no_mmap)
-      training_fd = open(training_file.c_str(), O_RDONLY);
-    if(training_fd < 0) {
-      FATAL("Failed to load " << training_file << "!");
-    }
-#endif
-  } else {
-    training_stream = new std::istringstream();
-  }
-
-  if (!dont_load && (selection == LOAD_BOTH || selection == LOAD_TESTING_ONLY) && testing_file.length() > 0) {
-    testing_stream = new std::ifstream (testing_file, std::ios::in | std::ios::binary);
-    if(!testing_stream->good()) {
-      FATAL("Failed to load " << testing_file << "!");
-    }
-#ifdef BUILD_POSIX
-    if(!no_mmap)
-      testing_fd = open(training_file.c_str(), O_RDONLY);
-    if(testing_fd < 0) {
-      FATAL("Failed to load " << testing_file << "!");
-    }
-#endif
-  } else {
-    testing_stream = new std::istringstream();
-  }
+  if (dont_load || selection == LOAD_TESTING_ONLY)
+    training_file = "";
+  if (dont_load || selection == LOAD_TRAINING_ONLY)
+    testing_file = "";
 
 	if (class_weights.size() != classes) {
 		for (unsigned int c = 0; c < classes; c++)
 			class_weights.push_back(1.0);
 	}
 
-  return new TensorStreamPatchDataset (*training_stream, *testing_stream, classes,
+  return new TensorStreamPatchDataset (training_file, testing_file, classes,
                                        class_names, class_colors, class_weights, patchsize_x,
-                                       patchsize_y, class_manager, error_function, training_fd, testing_fd);
+                                       patchsize_y, class_manager, error_function, !no_mmap);
 }
 
 }
@@ -8,6 +8,7 @@
 #include "ActiveLearningPolicy.h"
 
 #include <cmath>
+#include <vector>
 
 namespace Conv {
 
@@ -34,17 +35,19 @@ datum YOLOProposalSum1vs2ActiveLearningPolicy::ScoreW(Tensor &output, DatasetMet
 
   datum total_score = 0;
 
+  // Bucket proposals by cell once instead of scanning them for every cell
+  std::vector<bool> cell_has_proposal(horizontal_cells_ * vertical_cells_, false);
+  for(unsigned int p = 0; p < proposals.size(); p++) {
+    if(proposals[p].cell_id < cell_has_proposal.size())
+      cell_has_proposal[proposals[p].cell_id] = true;
+  }
+
   // Loop over all cells
   for (unsigned int vcell = 0; vcell < vertical_cells_; vcell++) {
     for (unsigned int hcell = 0; hcell < horizontal_cells_; hcell++) {
       unsigned int cell_id = vcell * horizontal_cells_ + hcell;
 
-      bool has_proposal = false;
-      for(unsigned int p = 0; p < proposals.size(); p++) {
-        if(proposals[p].cell_id == cell_id)
-          has_proposal = true;
-      }
-      if(!has_proposal)
+      if(!cell_has_proposal[cell_id])
         continue;
 
 
@@ -99,17 +102,19 @@ datum YOLOProposalMax1vs2ActiveLearningPolicy::ScoreW(Tensor &output, DatasetMet
 
   datum total_score = 0;
 
+  // Bucket proposals by cell once instead of scanning them for every cell
+  std::vector<bool> cell_has_proposal(horizontal_cells_ * vertical_cells_, false);
+  for(unsigned int p = 0; p < proposals.size(); p++) {
+    if(proposals[p].cell_id < cell_has_proposal.size())
+      cell_has_proposal[proposals[p].cell_id] = true;
+  }
+
   // Loop over all cells
   for (unsigned int vcell = 0; vcell < vertical_cells_; vcell++) {
     for (unsigned int hcell = 0; hcell < horizontal_cells_; hcell++) {
       unsigned int cell_id = vcell * horizontal_cells_ + hcell;
 
-      bool has_proposal = false;
-      for(unsigned int p = 0; p < proposals.size(); p++) {
-        if(proposals[p].cell_id == cell_id)
-          has_proposal = true;
-      }
-      if(!has_proposal)
+      if(!cell_has_proposal[cell_id])
         continue;
       datum max_class_score = 0;
       datum second_max_class_score = 0;
@@ -165,17 +170,19 @@ datum YOLOProposalAvg1vs2ActiveLearningPolicy::ScoreW(Tensor &output, DatasetMet
   datum total_score = 0;
   datum total_score_components = 0;
 
+  // Bucket proposals by cell once instead of scanning them for every cell
+  std::vector<bool> cell_has_proposal(horizontal_cells_ * vertical_cells_, false);
+  for(unsigned int p = 0; p < proposals.size(); p++) {
+    if(proposals[p].cell_id < cell_has_proposal.size())
+      cell_has_proposal[proposals[p].cell_id] = true;
+  }
+
   // Loop over all cells
   for (unsigned int vcell = 0; vcell < vertical_cells_; vcell++) {
     for (unsigned int hcell = 0; hcell < horizontal_cells_; hcell++) {
       unsigned int cell_id = vcell * horizontal_cells_ + hcell;
 
-      bool has_proposal = false;
-      for(unsigned int p = 0; p < proposals.size(); p++) {
-        if(proposals[p].cell_id == cell_id)
-          has_proposal = true;
-      }
-      if(!has_proposal)
+      if(!cell_has_proposal[cell_id])
         continue;
       datum max_class_score = 0;
       datum second_max_class_score = 0;
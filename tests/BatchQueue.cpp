@@ -0,0 +1,219 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+typedef Conv::BatchQueue<int>::Clock Clock;
+
+const char* dataset_config = R"({
+  "name": "Batches",
+  "task": "segmentation",
+  "classes": [
+    { "name": "first", "color": "0xff0000" },
+    { "name": "second", "color": "0x00ff00" }
+  ],
+  "input_maps": 3,
+  "data": []
+})";
+
+const char* net_config = R"({
+  "net": {
+    "input": "resize",
+    "output": "tanh2",
+    "error_layer": "no",
+    "nodes": {
+      "resize": { "layer": { "type": "resize", "border": [4,4] } },
+      "conv1": { "input": "resize", "layer": { "type": "convolution", "size": [3,3], "kernels": 4 } },
+      "tanh1": { "input": "conv1", "layer": "tanh" },
+      "conv2": { "input": "tanh1", "layer": { "type": "convolution", "size": [3,3], "kernels": 2 } },
+      "tanh2": { "input": "conv2", "layer": "tanh" }
+    }
+  }
+})";
+
+double MillisecondsSince(Clock::time_point start) {
+  std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+  return elapsed.count();
+}
+
+bool CheckBatching() {
+  // Full batches don't wait for the deadline
+  Conv::BatchQueue<int> slow_queue(std::chrono::milliseconds(10000));
+  for(int i = 0; i < 5; i++)
+    slow_queue.Push(i);
+  std::vector<int> batch;
+  Clock::time_point start = Clock::now();
+  if(!slow_queue.PopBatch(batch, 2) || batch.size() != 2 || batch[0] != 0 || batch[1] != 1 ||
+    !slow_queue.PopBatch(batch, 2) || batch.size() != 2 || batch[0] != 2 || batch[1] != 3) {
+    LOGERROR << "Wrong full batches";
+    return false;
+  }
+  if(MillisecondsSince(start) > 5000) {
+    LOGERROR << "Full batches waited for the deadline";
+    return false;
+  }
+
+  // The deadline is counted from the arrival
+  Conv::BatchQueue<int> late_queue(std::chrono::milliseconds(10000));
+  late_queue.Push(4, Clock::now() - std::chrono::milliseconds(20000));
+  late_queue.Push(5);
+  start = Clock::now();
+  if(!late_queue.PopBatch(batch, 8) || batch.size() != 2 || batch[0] != 4 || batch[1] != 5) {
+    LOGERROR << "Wrong partial batch";
+    return false;
+  }
+  if(MillisecondsSince(start) > 5000) {
+    LOGERROR << "A batch with an overdue item waited";
+    return false;
+  }
+
+  // A partial batch runs when the oldest item is due
+  Conv::BatchQueue<int> fast_queue(std::chrono::milliseconds(50));
+  start = Clock::now();
+  fast_queue.Push(6);
+  if(!fast_queue.PopBatch(batch, 8) || batch.size() != 1 || batch[0] != 6) {
+    LOGERROR << "Wrong partial batch";
+    return false;
+  }
+  if(MillisecondsSince(start) < 50) {
+    LOGERROR << "A partial batch did not wait for its deadline";
+    return false;
+  }
+
+  // Closing wakes up a waiting consumer, the rest can be drained
+  bool popped = true;
+  std::thread consumer([&] {
+    std::vector<int> consumer_batch;
+    popped = slow_queue.PopBatch(consumer_batch, 3);
+  });
+  slow_queue.Push(7);
+  slow_queue.Close();
+  consumer.join();
+  if(popped || slow_queue.Push(8)) {
+    LOGERROR << "The queue still works after closing it";
+    return false;
+  }
+  slow_queue.Drain(batch);
+  if(batch.size() != 2 || batch[0] != 4 || batch[1] != 7) {
+    LOGERROR << "Wrong remaining items";
+    return false;
+  }
+  return true;
+}
+
+// Requests are collected into batches for one predictor, every sample
+// must get the same output as a single image prediction
+bool CheckPredictorBatches() {
+  Conv::ClassManager class_manager;
+  Conv::Dataset* dataset = Conv::JSONDatasetFactory::ConstructDataset(Conv::JSON::parse(dataset_config), &class_manager);
+  Conv::JSONNetGraphFactory factory(Conv::JSON::parse(net_config));
+
+  const unsigned int batch_size = 3, requests = 7;
+  Conv::BatchPredictor single(&factory, dataset, &class_manager, 1, 32, 32);
+  Conv::BatchPredictor batched(&factory, dataset, &class_manager, batch_size, 32, 32);
+  single.GetGraph().InitializeWeights();
+  batched.GetGraph().InitializeWeights();
+
+  std::vector<Conv::Tensor> images(requests);
+  std::mt19937 generator(7);
+  std::uniform_real_distribution<Conv::datum> distribution(0, 1);
+  for(unsigned int r = 0; r < requests; r++) {
+    images[r].Resize(1, 20 + r, 16, 3);
+    for(unsigned int e = 0; e < images[r].elements(); e++)
+      images[r](e) = distribution(generator);
+  }
+
+  Conv::BatchQueue<unsigned int> queue(std::chrono::milliseconds(20));
+  for(unsigned int r = 0; r < requests; r++)
+    queue.Push(r);
+
+  bool success = true;
+  std::vector<unsigned int> batch, batch_sizes;
+  unsigned int processed = 0;
+  while(processed < requests && queue.PopBatch(batch, batch_size)) {
+    batch_sizes.push_back((unsigned int)batch.size());
+    for(unsigned int sample = 0; sample < batch_size; sample++) {
+      if(sample < batch.size())
+        batched.SetSample(sample, images[batch[sample]]);
+      else
+        batched.ClearSample(sample);
+    }
+    batched.Predict();
+    Conv::Tensor& batched_output = batched.GetGraph().GetDefaultOutputNode()->output_buffers[0].combined_tensor->data;
+#ifdef BUILD_OPENCL
+    batched_output.MoveToCPU();
+#endif
+
+    for(unsigned int sample = 0; sample < batch.size(); sample++) {
+      Conv::Tensor& image = images[batch[sample]];
+      single.SetSample(0, image);
+      single.Predict();
+      Conv::Tensor& single_output = single.GetGraph().GetDefaultOutputNode()->output_buffers[0].combined_tensor->data;
+#ifdef BUILD_OPENCL
+      single_output.MoveToCPU();
+#endif
+      for(unsigned int m = 0; m < single_output.maps(); m++) {
+        for(unsigned int y = 0; y < image.height(); y++) {
+          for(unsigned int x = 0; x < image.width(); x++) {
+            if(std::fabs(*single_output.data_ptr_const(x, y, m, 0) - *batched_output.data_ptr_const(x, y, m, sample)) > 0.0001) {
+              LOGERROR << "Request " << batch[sample] << " differs at (" << x << "," << y << "," << m << ")";
+              success = false;
+            }
+          }
+        }
+      }
+    }
+    processed += (unsigned int)batch.size();
+  }
+
+  if(batch_sizes.size() != 3 || batch_sizes[0] != 3 || batch_sizes[1] != 3 || batch_sizes[2] != 1) {
+    LOGERROR << "Wrong batches for " << requests << " requests";
+    success = false;
+  }
+
+  delete dataset;
+  return success;
+}
+
+bool CheckListenerShutdown() {
+#ifdef BUILD_POSIX
+  Conv::LocalSocket listener;
+  if(!listener.Listen("tmp_test_batchqueue_socket")) {
+    LOGERROR << "Cannot listen";
+    return false;
+  }
+  int descriptor = 0;
+  std::thread accept_thread([&] { descriptor = listener.Accept(); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  listener.Shutdown();
+  accept_thread.join();
+  listener.Close();
+  if(descriptor >= 0) {
+    LOGERROR << "Accept succeeded after shutting the listener down";
+    return false;
+  }
+#endif
+  return true;
+}
+
+int main() {
+  Conv::System::Init();
+
+  if(!CheckBatching() || !CheckPredictorBatches() || !CheckListenerShutdown()) {
+    LOGEND;
+    return -1;
+  }
+
+  LOGEND;
+  return 0;
+}
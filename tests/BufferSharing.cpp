@@ -0,0 +1,155 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <cmath>
+#include <vector>
+
+#include "TestNets.h"
+
+struct TestNet {
+  Conv::NetGraph graph;
+  Conv::ConcatenationLayer* concatenation = nullptr;
+  std::vector<Conv::NetGraphNode*> concatenated;
+  std::vector<Conv::NetGraphNode*> summands;
+  std::vector<Conv::NetGraphNode*> backward_order;
+};
+
+// sum(sigm(concat(tanh(input), relu(input))),
+//     tanh(concat(leaky relu(input), tanh(input))))
+void BuildNet(TestNet& net, Conv::Tensor& data, Conv::Tensor& helper, bool sharing) {
+  Conv::NetGraphNode* input_node = new Conv::NetGraphNode(new Conv::InputLayer(data, helper));
+  input_node->is_input = true;
+  net.graph.AddNode(input_node);
+
+  std::vector<Conv::Layer*> layers = {new Conv::TanhLayer(), new Conv::ReLULayer(),
+    new Conv::LeakyReLULayer(), new Conv::TanhLayer()};
+  for(Conv::Layer* layer : layers) {
+    Conv::NetGraphNode* node = new Conv::NetGraphNode(layer, Conv::NetGraphConnection(input_node));
+    net.graph.AddNode(node);
+    net.concatenated.push_back(node);
+  }
+
+  net.concatenation = new Conv::ConcatenationLayer();
+  Conv::NetGraphNode* concat_a = new Conv::NetGraphNode(net.concatenation,
+    Conv::NetGraphConnection(net.concatenated[0]));
+  concat_a->input_connections.push_back(Conv::NetGraphConnection(net.concatenated[1]));
+  Conv::NetGraphNode* concat_b = new Conv::NetGraphNode(new Conv::ConcatenationLayer(),
+    Conv::NetGraphConnection(net.concatenated[2]));
+  concat_b->input_connections.push_back(Conv::NetGraphConnection(net.concatenated[3]));
+  net.graph.AddNode(concat_a);
+  net.graph.AddNode(concat_b);
+
+  net.summands.push_back(new Conv::NetGraphNode(new Conv::SigmoidLayer(), Conv::NetGraphConnection(concat_a)));
+  net.summands.push_back(new Conv::NetGraphNode(new Conv::TanhLayer(), Conv::NetGraphConnection(concat_b)));
+  net.graph.AddNode(net.summands[0]);
+  net.graph.AddNode(net.summands[1]);
+
+  Conv::NetGraphNode* sum = new Conv::NetGraphNode(new Conv::SumLayer(), Conv::NetGraphConnection(net.summands[0]));
+  sum->input_connections.push_back(Conv::NetGraphConnection(net.summands[1]));
+  sum->is_output = true;
+  net.graph.AddNode(sum);
+
+  net.backward_order = {sum, net.summands[0], net.summands[1], concat_a, concat_b};
+  net.graph.SetFusionEnabled(false);
+  net.graph.SetBufferSharingEnabled(sharing);
+  net.graph.Initialize();
+}
+
+// Without parameters, NetGraph::BackPropagate() has nothing to do, so the
+// layers are called directly
+void Run(TestNet& net, Conv::Tensor& data, Conv::Tensor& helper) {
+  Conv::FillInput(data, helper);
+  net.graph.FeedForward();
+  Conv::Tensor& output_delta = net.graph.GetDefaultOutputNode()->output_buffers[0].combined_tensor->delta;
+  for(std::size_t e = 0; e < output_delta.elements(); e++)
+    output_delta[e] = (Conv::datum)std::cos(0.1 * e);
+  for(Conv::NetGraphNode* node : net.backward_order)
+    node->layer->BackPropagate();
+}
+
+bool SameResults(TestNet& shared, TestNet& copying) {
+  if(!Conv::Identical(Conv::Output(shared.graph), Conv::Output(copying.graph))) {
+    LOGERROR << "Forward pass differs";
+    return false;
+  }
+  for(unsigned int n = 0; n < shared.concatenated.size(); n++) {
+    if(!Conv::Identical(shared.concatenated[n]->output_buffers[0].combined_tensor->delta,
+                        copying.concatenated[n]->output_buffers[0].combined_tensor->delta)) {
+      LOGERROR << "Backward pass differs at input " << n << " of the concatenations";
+      return false;
+    }
+  }
+  return true;
+}
+
+int main() {
+  Conv::System::Init();
+
+  Conv::Tensor shared_data(1, 5, 4, 2), shared_helper(1, 5, 4, 1);
+  Conv::Tensor copying_data(1, 5, 4, 2), copying_helper(1, 5, 4, 1);
+  TestNet shared, copying;
+  BuildNet(shared, shared_data, shared_helper, true);
+  BuildNet(copying, copying_data, copying_helper, false);
+
+  // A single sample is concatenated in place and the sum's inputs share
+  // its gradient
+  if(!shared.concatenation->IsViewingData() || !shared.concatenation->IsViewingDelta()) {
+    LOGERROR << "The concatenation does not view its inputs";
+    LOGEND;
+    return -1;
+  }
+  if(copying.concatenation->IsViewingData() || copying.concatenation->IsViewingDelta()) {
+    LOGERROR << "The concatenation views its inputs without buffer sharing";
+    LOGEND;
+    return -1;
+  }
+  for(Conv::NetGraphNode* summand : shared.summands) {
+    if(!summand->output_buffers[0].combined_tensor->delta.is_shadow()) {
+      LOGERROR << "The sum does not share its gradient";
+      LOGEND;
+      return -1;
+    }
+  }
+
+  Run(shared, shared_data, shared_helper);
+  Run(copying, copying_data, copying_helper);
+  if(!SameResults(shared, copying)) {
+    LOGEND;
+    return -1;
+  }
+
+  // The inputs of a batch are strided in the output, so it is copied
+  if(!shared.graph.Reshape(3) || !copying.graph.Reshape(3)) {
+    LOGERROR << "Reshape failed";
+    LOGEND;
+    return -1;
+  }
+  if(shared.concatenation->IsViewingData() || shared.concatenation->IsViewingDelta()) {
+    LOGERROR << "The concatenation views its inputs with several samples";
+    LOGEND;
+    return -1;
+  }
+
+  Run(shared, shared_data, shared_helper);
+  Run(copying, copying_data, copying_helper);
+  if(!SameResults(shared, copying)) {
+    LOGEND;
+    return -1;
+  }
+
+  // Going back to a single sample concatenates in place again
+  if(!shared.graph.Reshape(1) || !shared.concatenation->IsViewingData()) {
+    LOGERROR << "The concatenation does not view its inputs after reshaping back";
+    LOGEND;
+    return -1;
+  }
+
+  LOGEND;
+  return 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+// Sorts all detections and adds a point to the precision/recall curve
+// for every distinct score
+Conv::datum ExactAP(std::vector<std::pair<Conv::datum, bool>> detections, unsigned int positives) {
+  std::sort(detections.begin(), detections.end(), [](const std::pair<Conv::datum, bool>& a, const std::pair<Conv::datum, bool>& b) {
+    return a.first > b.first;
+  });
+
+  std::vector<Conv::datum> precision = {0}, recall = {0};
+  Conv::datum tp = 0, fp = 0;
+  for(unsigned int d = 0; d < detections.size(); d++) {
+    if(detections[d].second)
+      tp += 1;
+    else
+      fp += 1;
+    if(d == detections.size() - 1 || detections[d + 1].first != detections[d].first) {
+      precision.push_back(tp / (tp + fp));
+      recall.push_back(tp / (Conv::datum)positives);
+    }
+  }
+  precision.push_back(0);
+  recall.push_back(1);
+
+  for(int i = (int)precision.size() - 2; i >= 0; i--)
+    precision[i] = std::max(precision[i], precision[i + 1]);
+
+  Conv::datum ap = 0;
+  for(unsigned int i = 1; i < recall.size(); i++) {
+    if(recall[i] != recall[i - 1])
+      ap += (recall[i] - recall[i - 1]) * precision[i];
+  }
+  return ap;
+}
+
+Conv::BoundingBox Box(Conv::datum x, Conv::datum y, Conv::datum size, unsigned int c, Conv::datum score = 0) {
+  Conv::BoundingBox box(x, y, size, size);
+  box.c = c;
+  box.score = score;
+  return box;
+}
+
+int main() {
+  Conv::System::Init();
+
+  Conv::ClassManager class_manager;
+  class_manager.RegisterClassByName("object", 0, 1);
+  const unsigned int c = class_manager.GetClassIdByName("object");
+
+  std::vector<Conv::BoundingBox> truth[2], detected[2];
+  truth[0] = {Box(0.2, 0.2, 0.1, c), Box(0.6, 0.6, 0.1, c)};
+  truth[1] = {Box(0.4, 0.4, 0.2, c)};
+
+  // YOLO confidences above 1 must still be ranked apart
+  detected[0] = {Box(0.2, 0.2, 0.1, c, 2.5), Box(0.9, 0.1, 0.1, c, 1.8),
+                 Box(0.6, 0.6, 0.1, c, 0.7), Box(0.21, 0.2, 0.1, c, 0.4)};
+  detected[1] = {Box(0.9, 0.9, 0.1, c, 1.2), Box(0.4, 0.41, 0.2, c, 0.05)};
+
+  // The second detection of the first truth box is a false positive
+  const std::vector<std::pair<Conv::datum, bool>> expected_matches = {
+    {2.5, true}, {1.8, false}, {0.7, true}, {0.4, false}, {1.2, false}, {0.05, true}};
+
+  Conv::DatasetMetadataPointer detected_metadata[2] = {&detected[0], &detected[1]};
+  Conv::DatasetMetadataPointer truth_metadata[2] = {&truth[0], &truth[1]};
+  Conv::CombinedTensor detected_tensor(2, 1, 1, 1, detected_metadata);
+  Conv::CombinedTensor truth_tensor(2, 1, 1, 1, truth_metadata);
+  Conv::CombinedTensor weight_tensor(2);
+
+  Conv::DetectionStatLayer layer(&class_manager);
+  std::vector<Conv::CombinedTensor*> inputs = {&detected_tensor, &truth_tensor, &weight_tensor}, outputs;
+  if(!layer.CreateOutputs(inputs, outputs) || !layer.Connect(inputs, outputs, nullptr)) {
+    LOGERROR << "Cannot connect the detection stat layer";
+    return -1;
+  }
+
+  // Feed one sample at a time, so the score range grows between batches
+  *weight_tensor.data.data_ptr(0, 0, 0, 0) = 0;
+  *weight_tensor.data.data_ptr(0, 0, 0, 1) = 1;
+  layer.FeedForward();
+  *weight_tensor.data.data_ptr(0, 0, 0, 0) = 1;
+  *weight_tensor.data.data_ptr(0, 0, 0, 1) = 0;
+  layer.FeedForward();
+
+  const Conv::datum exact_ap = ExactAP(expected_matches, 3);
+  const Conv::datum streaming_ap = layer.GetAveragePrecision(c);
+  if(std::abs(exact_ap - streaming_ap) > (Conv::datum)1e-5) {
+    LOGERROR << "Streaming AP " << streaming_ap << " differs from exact AP " << exact_ap;
+    return -1;
+  }
+
+  // A second pass over the same samples doubles every count and keeps the AP
+  weight_tensor.data.Clear(1);
+  layer.FeedForward();
+  if(std::abs(exact_ap - layer.GetAveragePrecision(c)) > (Conv::datum)1e-5) {
+    LOGERROR << "Streaming AP " << layer.GetAveragePrecision(c) << " differs from exact AP " << exact_ap << " after two passes";
+    return -1;
+  }
+
+  LOGEND;
+  return 0;
+}
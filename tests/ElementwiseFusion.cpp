@@ -0,0 +1,112 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <cmath>
+#include <vector>
+
+struct TestNet {
+  Conv::NetGraph graph;
+  Conv::NetGraphNode* summand_a = nullptr;
+  Conv::NetGraphNode* summand_b = nullptr;
+  std::vector<Conv::NetGraphNode*> chain;
+};
+
+// input -> (tanh, leaky relu) -> sum -> relu -> sigm -> tanh -> leaky relu
+void BuildNet(TestNet& net, Conv::Tensor& data, Conv::Tensor& helper, bool fusion) {
+  Conv::NetGraphNode* input_node = new Conv::NetGraphNode(new Conv::InputLayer(data, helper));
+  input_node->is_input = true;
+  net.graph.AddNode(input_node);
+
+  net.summand_a = new Conv::NetGraphNode(new Conv::TanhLayer(), Conv::NetGraphConnection(input_node));
+  net.summand_b = new Conv::NetGraphNode(new Conv::LeakyReLULayer(), Conv::NetGraphConnection(input_node));
+  net.graph.AddNode(net.summand_a);
+  net.graph.AddNode(net.summand_b);
+
+  Conv::NetGraphNode* sum_node = new Conv::NetGraphNode(new Conv::SumLayer(), Conv::NetGraphConnection(net.summand_a));
+  sum_node->input_connections.push_back(Conv::NetGraphConnection(net.summand_b));
+  net.graph.AddNode(sum_node);
+  net.chain.push_back(sum_node);
+
+  std::vector<Conv::Layer*> layers = {new Conv::ReLULayer(), new Conv::SigmoidLayer(),
+    new Conv::TanhLayer(), new Conv::LeakyReLULayer()};
+  for(Conv::Layer* layer : layers) {
+    Conv::NetGraphNode* node = new Conv::NetGraphNode(layer, Conv::NetGraphConnection(net.chain.back()));
+    node->is_output = layer == layers.back();
+    net.graph.AddNode(node);
+    net.chain.push_back(node);
+  }
+
+  net.graph.SetFusionEnabled(fusion);
+  net.graph.Initialize();
+}
+
+bool Identical(const Conv::Tensor& a, const Conv::Tensor& b) {
+  if(a.elements() != b.elements())
+    return false;
+  for(std::size_t e = 0; e < a.elements(); e++) {
+    if(a.data_ptr_const()[e] != b.data_ptr_const()[e])
+      return false;
+  }
+  return true;
+}
+
+int main() {
+  Conv::System::Init();
+
+  Conv::Tensor data(3, 5, 4, 2), helper(3, 5, 4, 1);
+  for(std::size_t e = 0; e < data.elements(); e++)
+    data[e] = 3 * std::sin(0.37 * e);
+
+  TestNet separate, fused;
+  BuildNet(separate, data, helper, false);
+  BuildNet(fused, data, helper, true);
+
+  // The sum and the four nonlinearities become one node
+  if(fused.graph.GetNodes().size() + 4 != separate.graph.GetNodes().size()) {
+    LOGERROR << "Chain was not fused, " << fused.graph.GetNodes().size() << " nodes left";
+    return -1;
+  }
+
+  Conv::NetGraphNode* fused_node = fused.graph.GetDefaultOutputNode();
+  if(dynamic_cast<Conv::FusedElementwiseLayer*>(fused_node->layer) == nullptr) {
+    LOGERROR << "Output node is not fused: " << fused_node->layer->GetLayerDescription();
+    return -1;
+  }
+
+  separate.graph.FeedForward();
+  fused.graph.FeedForward();
+
+  Conv::CombinedTensor* separate_output = separate.graph.GetDefaultOutputNode()->output_buffers[0].combined_tensor;
+  Conv::CombinedTensor* fused_output = fused_node->output_buffers[0].combined_tensor;
+  if(!Identical(separate_output->data, fused_output->data)) {
+    LOGERROR << "Fused forward pass differs";
+    return -1;
+  }
+
+  // Without parameters, NetGraph::BackPropagate() has nothing to do, so the
+  // layers are called directly
+  for(std::size_t e = 0; e < separate_output->delta.elements(); e++) {
+    separate_output->delta[e] = std::cos(0.1 * e);
+    fused_output->delta[e] = std::cos(0.1 * e);
+  }
+  for(auto node = separate.chain.rbegin(); node != separate.chain.rend(); node++)
+    (*node)->layer->BackPropagate();
+  fused_node->layer->BackPropagate();
+
+  if(!Identical(separate.summand_a->output_buffers[0].combined_tensor->delta,
+                fused.summand_a->output_buffers[0].combined_tensor->delta) ||
+     !Identical(separate.summand_b->output_buffers[0].combined_tensor->delta,
+                fused.summand_b->output_buffers[0].combined_tensor->delta)) {
+    LOGERROR << "Fused backward pass differs";
+    return -1;
+  }
+
+  LOGEND;
+  return 0;
+}
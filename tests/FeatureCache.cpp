@@ -0,0 +1,153 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <string>
+#include <vector>
+
+#include "TestNets.h"
+
+// conv1 is frozen, so conv1 -> relu1 is the cached prefix
+const char* net_json = R"({
+  "net": {"input":"conv1","output":"conv2","error_layer":"square",
+    "nodes":{
+      "conv1":{"layer":{"type":"convolution","size":[3,3],"pad":[1,1],"kernels":4,"llr":0}},
+      "relu1":{"input":"conv1","layer":"relu"},
+      "conv2":{"input":"relu1","layer":{"type":"convolution","size":[1,1],"kernels":2}}}},
+  "hyperparameters": {"batch_size_parallel":2}
+})";
+
+const char* dataset_json = R"({"special":"synthetic","task":"segmentation","width":16,"height":16,
+  "classes":2,"training_samples":4,"testing_samples":0,"seed":3})";
+
+const Conv::datum sentinel = 12345;
+
+struct TestGraph {
+  Conv::NetGraph graph;
+  Conv::DatasetInputLayer* input_layer = nullptr;
+  Conv::NetGraphNode* conv1 = nullptr;
+  Conv::NetGraphNode* conv2 = nullptr;
+
+  // The output of the prefix that the trained part reads
+  Conv::CombinedTensor* Boundary() {
+    Conv::NetGraphConnection& connection = conv2->input_connections[0];
+    return connection.node->output_buffers[connection.buffer].combined_tensor;
+  }
+
+  void Build(Conv::Dataset* dataset, Conv::ClassManager* class_manager) {
+    Conv::JSONNetGraphFactory factory(Conv::JSON::parse(net_json), 1);
+    input_layer = new Conv::DatasetInputLayer(factory.GetDataInput(), dataset, 2, 1.0, 7);
+    Conv::NetGraphNode* input_node = new Conv::NetGraphNode(input_layer);
+    input_node->is_input = true;
+    graph.AddNode(input_node);
+    if(!factory.AddLayers(graph, class_manager)) {
+      FATAL("Cannot build the net");
+    }
+    graph.Initialize();
+    graph.InitializeWeights();
+    for(Conv::NetGraphNode* node : graph.GetNodes()) {
+      if(node->unique_name.compare("conv1") == 0)
+        conv1 = node;
+      else if(node->unique_name.compare("conv2") == 0)
+        conv2 = node;
+    }
+  }
+};
+
+void ScaleParameters(Conv::NetGraphNode* node, Conv::datum factor) {
+  for(Conv::CombinedTensor* parameters : node->layer->parameters()) {
+    for(std::size_t e = 0; e < parameters->data.elements(); e++)
+      parameters->data[e] *= factor;
+  }
+}
+
+int main() {
+  Conv::System::Init();
+
+  Conv::ClassManager class_manager;
+  Conv::Dataset* dataset = Conv::JSONDatasetFactory::ConstructDataset(Conv::JSON::parse(dataset_json), &class_manager);
+
+  // Both graphs select the same samples, only the first one caches
+  TestGraph cached, reference;
+  cached.Build(dataset, &class_manager);
+  reference.Build(dataset, &class_manager);
+  std::vector<Conv::CombinedTensor*> cached_parameters, reference_parameters;
+  cached.graph.GetParameters(cached_parameters);
+  reference.graph.GetParameters(reference_parameters);
+  for(unsigned int p = 0; p < cached_parameters.size(); p++)
+    Conv::Tensor::Copy(cached_parameters[p]->data, reference_parameters[p]->data);
+  cached.graph.EnableFeatureCache("tmp_test_featurecache");
+
+  Conv::Tensor& conv1_output = cached.conv1->output_buffers[0].combined_tensor->data;
+
+  // Runs one batch through both graphs. Returns true if the cached graph
+  // skipped the prefix, which leaves the inside of the prefix untouched.
+  auto feed_forward = [&]() -> bool {
+    cached.input_layer->SelectAndLoadSamples();
+    reference.input_layer->SelectAndLoadSamples();
+    conv1_output.Clear(sentinel);
+    cached.graph.FeedForward();
+    reference.graph.FeedForward();
+    if(!Conv::Identical(Conv::Output(cached.graph), Conv::Output(reference.graph))) {
+      FATAL("Cached output differs: " << Conv::Output(cached.graph) << " vs. " << Conv::Output(reference.graph));
+    }
+    return conv1_output[0] == sentinel;
+  };
+
+  // The four samples are cached after a few batches
+  unsigned int hits = 0;
+  for(unsigned int iteration = 0; iteration < 12; iteration++) {
+    if(feed_forward())
+      hits++;
+  }
+  if(hits == 0) {
+    LOGERROR << "The frozen prefix was never loaded from the cache";
+    return -1;
+  }
+
+  // Backpropagation stops at the frozen boundary
+  cached.Boundary()->delta.Clear(sentinel);
+  for(Conv::CombinedTensor* parameters : cached.conv1->layer->parameters())
+    parameters->delta.Clear(sentinel);
+  cached.graph.BackPropagate();
+  if(cached.Boundary()->delta[0] != sentinel) {
+    LOGERROR << "The gradient of the frozen prefix was computed";
+    return -1;
+  }
+  for(Conv::CombinedTensor* parameters : cached.conv1->layer->parameters()) {
+    if(parameters->delta[0] != sentinel) {
+      LOGERROR << "The frozen layer was backpropagated";
+      return -1;
+    }
+  }
+
+  // Unfreezing conv1 drops the cache. Its new weights would give different
+  // outputs than the cached features.
+  cached.conv1->layer->SetLocalLearningRate(1);
+  reference.conv1->layer->SetLocalLearningRate(1);
+  ScaleParameters(cached.conv1, 0.5);
+  ScaleParameters(reference.conv1, 0.5);
+  for(unsigned int iteration = 0; iteration < 4; iteration++) {
+    if(feed_forward()) {
+      LOGERROR << "The prefix was loaded from the cache after unfreezing";
+      return -1;
+    }
+  }
+
+  cached.Boundary()->delta.Clear(sentinel);
+  cached.graph.BackPropagate();
+  if(cached.Boundary()->delta[0] == sentinel) {
+    LOGERROR << "The unfrozen layer was not backpropagated";
+    return -1;
+  }
+
+  delete dataset;
+
+  LOGEND;
+  return 0;
+}
@@ -0,0 +1,186 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <cmath>
+#include <vector>
+
+#include "TestNets.h"
+
+const char* trainer_net_json = R"({
+  "net": {"input":"conv1","output":"conv2","error_layer":"square",
+    "nodes":{
+      "conv1":{"layer":{"type":"convolution","size":[3,3],"pad":[1,1],"kernels":4}},
+      "relu1":{"input":"conv1","layer":"relu"},
+      "conv2":{"input":"relu1","layer":{"type":"convolution","size":[1,1],"kernels":2}}}},
+  "hyperparameters": {"learning_rate":0.1,"epoch_iterations":1,"enable_stats_during_training":false}
+})";
+
+const char* trainer_dataset_json = R"({"special":"synthetic","task":"segmentation","width":8,"height":8,
+  "classes":2,"training_samples":8,"testing_samples":0,"seed":5})";
+
+// Trains one iteration on a graph that was built with a batch size of
+// build_batch_size and reshaped to train_batch_size after creating the
+// Trainer
+void TrainOneIteration(Conv::Dataset* dataset, Conv::ClassManager* class_manager, unsigned int build_batch_size,
+  unsigned int train_batch_size, std::vector<Conv::Tensor>& parameters) {
+  Conv::JSONNetGraphFactory factory(Conv::JSON::parse(trainer_net_json), 1);
+  Conv::NetGraph graph;
+  Conv::NetGraphNode* input_node = new Conv::NetGraphNode(
+    new Conv::DatasetInputLayer(factory.GetDataInput(), dataset, build_batch_size, 1.0, 3));
+  input_node->is_input = true;
+  graph.AddNode(input_node);
+  if(!factory.AddLayers(graph, class_manager)) {
+    FATAL("Cannot build the net");
+  }
+  graph.Initialize();
+  graph.InitializeWeights();
+
+  Conv::Trainer trainer(graph, factory.GetHyperparameters());
+  if(!graph.Reshape(train_batch_size)) {
+    FATAL("Cannot reshape the net");
+  }
+  trainer.Train(1, false);
+
+  std::vector<Conv::CombinedTensor*> graph_parameters;
+  graph.GetParameters(graph_parameters);
+  parameters.resize(graph_parameters.size());
+  for(unsigned int p = 0; p < graph_parameters.size(); p++) {
+    parameters[p].Resize(graph_parameters[p]->data);
+    Conv::Tensor::Copy(graph_parameters[p]->data, parameters[p]);
+  }
+}
+
+int main() {
+  Conv::System::Init();
+
+  Conv::Tensor data(1, 16, 12, 3), helper(1, 16, 12, 2);
+  Conv::NetGraph graph;
+  Conv::BuildTestNet(graph, data, helper);
+  Conv::FillInput(data, helper);
+  graph.FeedForward();
+  Conv::Tensor original_output;
+  original_output.Resize(Conv::Output(graph));
+  Conv::Tensor::CopySample(Conv::Output(graph), 0, original_output, 0);
+
+  std::vector<Conv::CombinedTensor*> parameters;
+  graph.GetParameters(parameters);
+  std::vector<Conv::Tensor> original_parameters(parameters.size());
+  for(unsigned int p = 0; p < parameters.size(); p++) {
+    original_parameters[p].Resize(parameters[p]->data);
+    Conv::Tensor::Copy(parameters[p]->data, original_parameters[p]);
+  }
+
+  // A larger batch and input must give the same result as a new graph
+  if(!graph.Reshape(3, 24, 20)) {
+    LOGERROR << "Reshape failed";
+    LOGEND;
+    return -1;
+  }
+  if(data.samples() != 3 || data.width() != 24 || data.height() != 20 || helper.width() != 24) {
+    LOGERROR << "Input tensors were not resized: " << data << ", " << helper;
+    LOGEND;
+    return -1;
+  }
+  Conv::FillInput(data, helper);
+  graph.FeedForward();
+
+  Conv::Tensor reference_data(3, 24, 20, 3), reference_helper(3, 24, 20, 2);
+  Conv::NetGraph reference;
+  Conv::BuildTestNet(reference, reference_data, reference_helper);
+  std::vector<Conv::CombinedTensor*> reference_parameters;
+  reference.GetParameters(reference_parameters);
+  for(unsigned int p = 0; p < parameters.size(); p++)
+    Conv::Tensor::Copy(parameters[p]->data, reference_parameters[p]->data);
+  Conv::FillInput(reference_data, reference_helper);
+  reference.FeedForward();
+
+  if(!Conv::Identical(Conv::Output(graph), Conv::Output(reference))) {
+    LOGERROR << "Reshaped output differs: " << Conv::Output(graph) << " vs. " << Conv::Output(reference);
+    LOGEND;
+    return -1;
+  }
+
+  for(unsigned int p = 0; p < parameters.size(); p++) {
+    if(!Conv::Identical(parameters[p]->data, original_parameters[p])) {
+      LOGERROR << "Parameter " << p << " changed";
+      return -1;
+    }
+  }
+
+  // Going back gives the original result
+  if(!graph.Reshape(1, 16, 12)) {
+    LOGERROR << "Reshape back failed";
+    LOGEND;
+    return -1;
+  }
+  Conv::FillInput(data, helper);
+  graph.FeedForward();
+  if(!Conv::Identical(Conv::Output(graph), original_output)) {
+    LOGERROR << "Output differs after reshaping back";
+    LOGEND;
+    return -1;
+  }
+
+  // The pooling layer rejects odd widths, the graph keeps its shape
+  if(graph.Reshape(1, 15, 12)) {
+    LOGERROR << "Reshape to an odd width succeeded";
+    LOGEND;
+    return -1;
+  }
+  if(data.width() != 16 || data.height() != 12) {
+    LOGERROR << "Failed reshape changed the input: " << data;
+    LOGEND;
+    return -1;
+  }
+  Conv::FillInput(data, helper);
+  graph.FeedForward();
+  if(!Conv::Identical(Conv::Output(graph), original_output)) {
+    LOGERROR << "Output differs after a failed reshape";
+    LOGEND;
+    return -1;
+  }
+
+  // Layers without support are rejected
+  Conv::Tensor other_data(1, 16, 12, 3), other_helper(1, 16, 12, 2);
+  Conv::NetGraph other;
+  Conv::NetGraphNode* input_node = new Conv::NetGraphNode(new Conv::InputLayer(other_data, other_helper));
+  input_node->is_input = true;
+  other.AddNode(input_node);
+  Conv::NetGraphNode* downsampling = new Conv::NetGraphNode(new Conv::InputDownSamplingLayer(2, 2),
+    Conv::NetGraphConnection(input_node));
+  downsampling->is_output = true;
+  other.AddNode(downsampling);
+  other.Initialize();
+  if(other.Reshape(2) || other_data.samples() != 1) {
+    LOGERROR << "Unsupported layer was reshaped";
+    LOGEND;
+    return -1;
+  }
+
+  // A Trainer scales the gradients by the current batch size, even if the
+  // graph was reshaped after the Trainer was created
+  Conv::ClassManager class_manager;
+  Conv::Dataset* dataset = Conv::JSONDatasetFactory::ConstructDataset(Conv::JSON::parse(trainer_dataset_json), &class_manager);
+  std::vector<Conv::Tensor> reshaped_trained, reference_trained;
+  TrainOneIteration(dataset, &class_manager, 2, 4, reshaped_trained);
+  TrainOneIteration(dataset, &class_manager, 4, 4, reference_trained);
+  delete dataset;
+  for(unsigned int p = 0; p < reference_trained.size(); p++) {
+    for(std::size_t e = 0; e < reference_trained[p].elements(); e++) {
+      if(std::fabs(reshaped_trained[p](e) - reference_trained[p](e)) > 1e-5) {
+        LOGERROR << "Parameter " << p << " was trained differently after reshaping the batch";
+        LOGEND;
+        return -1;
+      }
+    }
+  }
+
+  LOGEND;
+  return 0;
+}
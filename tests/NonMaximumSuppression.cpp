@@ -0,0 +1,106 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+int main() {
+  Conv::System::Init();
+
+  std::mt19937 generator(4242);
+  std::uniform_real_distribution<Conv::datum> dist_pos(0, 1);
+  std::uniform_real_distribution<Conv::datum> dist_size(0.02, 0.3);
+  std::uniform_real_distribution<Conv::datum> dist_score(0.01, 1);
+
+  for(unsigned int run = 0; run < 20; run++) {
+    std::vector<Conv::BoundingBox> boxes;
+    for(unsigned int b = 0; b < 300; b++) {
+      Conv::BoundingBox box(dist_pos(generator), dist_pos(generator), dist_size(generator), dist_size(generator));
+      box.c = generator() % 3;
+      box.score = dist_score(generator);
+      boxes.push_back(box);
+    }
+
+    // Reference: all pairs, a box is removed if any higher scoring box
+    // of the same class overlaps it by more than 0.5
+    std::vector<Conv::BoundingBox> reference;
+    for(unsigned int b1 = 0; b1 < boxes.size(); b1++) {
+      bool suppressed = false;
+      for(unsigned int b2 = 0; b2 < boxes.size(); b2++) {
+        if(boxes[b1].c == boxes[b2].c && boxes[b2].score > boxes[b1].score &&
+           boxes[b1].IntersectionOverUnion(&boxes[b2]) > (Conv::datum)0.5)
+          suppressed = true;
+      }
+      if(!suppressed)
+        reference.push_back(boxes[b1]);
+    }
+    std::sort(reference.begin(), reference.end(), Conv::BoundingBox::CompareScore);
+
+    Conv::NonMaximumSuppression nms;
+    std::vector<Conv::BoundingBox> result = boxes;
+    nms.Apply(result);
+
+    Conv::AssertEqual(reference.size(), result.size(), "number of boxes after NMS");
+    for(unsigned int b = 0; b < result.size(); b++) {
+      Conv::AssertEqual(reference[b].score, result[b].score, "box score");
+      Conv::AssertEqual(reference[b].c, result[b].c, "box class");
+    }
+
+    // Top-k keeps exactly the k best survivors of each class
+    nms.top_k = 2;
+    result = boxes;
+    nms.Apply(result);
+    for(unsigned int c = 0; c < 3; c++) {
+      std::vector<Conv::datum> expected_scores, actual_scores;
+      for(unsigned int b = reference.size(); b > 0; b--) {
+        if(reference[b - 1].c == c && expected_scores.size() < 2)
+          expected_scores.push_back(reference[b - 1].score);
+      }
+      for(unsigned int b = result.size(); b > 0; b--) {
+        if(result[b - 1].c == c)
+          actual_scores.push_back(result[b - 1].score);
+      }
+      Conv::AssertEqual((std::size_t)2, actual_scores.size(), "number of boxes per class after top-k NMS");
+      for(unsigned int b = 0; b < 2; b++)
+        Conv::AssertEqual(expected_scores[b], actual_scores[b], "box score after top-k NMS");
+    }
+  }
+
+  // Soft NMS on a fixed set. B overlaps A with an IoU of 0.6 and decays to
+  // 0.8 * 0.4. C overlaps A and B heavily and falls below min_score, just
+  // like D. E has A's geometry, but another class, so it is untouched.
+  std::vector<Conv::BoundingBox> boxes;
+  Conv::BoundingBox box_a(0.5, 0.5, 0.2, 0.2); box_a.score = 0.9;
+  Conv::BoundingBox box_b(0.55, 0.5, 0.2, 0.2); box_b.score = 0.8;
+  Conv::BoundingBox box_c(0.51, 0.5, 0.2, 0.2); box_c.score = 0.5;
+  Conv::BoundingBox box_d(0.1, 0.1, 0.1, 0.1); box_d.score = 0.2;
+  Conv::BoundingBox box_e(0.5, 0.5, 0.2, 0.2); box_e.score = 0.6; box_e.c = 1;
+  boxes.push_back(box_a); boxes.push_back(box_b); boxes.push_back(box_c);
+  boxes.push_back(box_d); boxes.push_back(box_e);
+
+  Conv::NonMaximumSuppression soft_nms;
+  soft_nms.method = Conv::NonMaximumSuppression::NMS_SOFT_LINEAR;
+  soft_nms.min_score = 0.25;
+  soft_nms.Apply(boxes);
+
+  // Sorted by ascending score
+  const Conv::datum expected_scores[] = {0.32, 0.6, 0.9};
+  const Conv::datum expected_x[] = {0.55, 0.5, 0.5};
+  const unsigned int expected_classes[] = {0, 1, 0};
+  Conv::AssertEqual((std::size_t)3, boxes.size(), "number of boxes after soft NMS");
+  for(unsigned int b = 0; b < 3; b++) {
+    Conv::AssertLess((Conv::datum)1e-5, std::abs(expected_scores[b] - boxes[b].score), "score error after soft NMS");
+    Conv::AssertEqual(expected_x[b], boxes[b].x, "box position after soft NMS");
+    Conv::AssertEqual(expected_classes[b], boxes[b].c, "box class after soft NMS");
+  }
+
+  LOGEND;
+  return 0;
+}
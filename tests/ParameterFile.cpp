@@ -0,0 +1,213 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cstdio>
+#include <fstream>
+
+#include <cn24.h>
+
+#include "TestNets.h"
+
+bool CheckFile(Conv::IndexedParameterFile& file, Conv::Tensor& weights, Conv::Tensor& biases, bool view) {
+  if(!file.IsValid() || file.GetSetCount() != 2) {
+    LOGERROR << "Wrong set count!";
+    return false;
+  }
+
+  int set = file.Find("conv1");
+  if(set < 0 || file.GetTensorCount(set) != 2 || file.GetMetadata(set).compare("{}") != 0) {
+    LOGERROR << "Set conv1 not found or wrong!";
+    return false;
+  }
+  if(file.Find("missing") != -1) {
+    LOGERROR << "Found a set that does not exist!";
+    return false;
+  }
+
+  Conv::Tensor* expected[] = {&weights, &biases};
+  for(unsigned int t = 0; t < 2; t++) {
+    Conv::Tensor loaded;
+    if(view) {
+      if(!file.View(set, t, loaded)) {
+        LOGERROR << "Cannot view tensor " << t;
+        return false;
+      }
+      if(!file.Contains(loaded.data_ptr_const())) {
+        LOGERROR << "View of tensor " << t << " is not in file memory";
+        return false;
+      }
+#ifdef BUILD_POSIX
+      // The file is mapped at a page boundary
+      if(((std::size_t)loaded.data_ptr_const()) % Conv::IndexedParameterFile::alignment != 0) {
+        LOGERROR << "View of tensor " << t << " is not aligned";
+        return false;
+      }
+#endif
+    } else {
+      file.Copy(set, t, loaded);
+    }
+
+    if(loaded.samples() != expected[t]->samples() || loaded.width() != expected[t]->width() ||
+      loaded.height() != expected[t]->height() || loaded.maps() != expected[t]->maps()) {
+      LOGERROR << "Wrong shape of tensor " << t << ": " << loaded;
+      return false;
+    }
+    for(unsigned int e = 0; e < loaded.elements(); e++) {
+      if(loaded(e) != (*expected[t])(e)) {
+        LOGERROR << "Wrong value in tensor " << t << " at " << e;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void ScaleParameters(const std::vector<Conv::CombinedTensor*>& parameters, Conv::datum factor) {
+  for(Conv::CombinedTensor* layer_parameters : parameters) {
+    for(std::size_t e = 0; e < layer_parameters->data.elements(); e++)
+      layer_parameters->data[e] = factor * layer_parameters->data[e] + 0.01f;
+  }
+}
+
+// Writes a graph's parameters, maps them into a second graph and later
+// loads a file with only some of the nodes, which has to detach the rest
+// from the first mapping
+bool CheckNetGraphRoundTrip() {
+  const std::string first_filename = "tmp_test_parameterfile_net1";
+  const std::string second_filename = "tmp_test_parameterfile_net2";
+  const std::string sequential_filename = "tmp_test_parameterfile_net3";
+
+  Conv::Tensor source_data(1, 16, 12, 3), source_helper(1, 16, 12, 2);
+  Conv::Tensor loaded_data(1, 16, 12, 3), loaded_helper(1, 16, 12, 2);
+  Conv::NetGraph source, loaded;
+  Conv::BuildTestNet(source, source_data, source_helper);
+  Conv::BuildTestNet(loaded, loaded_data, loaded_helper);
+  std::vector<Conv::CombinedTensor*> source_parameters;
+  source.GetParameters(source_parameters);
+  ScaleParameters(source_parameters, 0.5);
+
+  auto same_output = [&]() {
+    Conv::FillInput(source_data, source_helper);
+    Conv::FillInput(loaded_data, loaded_helper);
+    source.FeedForward();
+    loaded.FeedForward();
+    return Conv::Identical(Conv::Output(source), Conv::Output(loaded));
+  };
+
+  {
+    std::ofstream output(first_filename, std::ios::out | std::ios::binary);
+    source.SerializeParameters(output, true);
+  }
+  if(!loaded.LoadParameters(first_filename) || !same_output()) {
+    LOGERROR << "Indexed parameters were not loaded";
+    return false;
+  }
+#ifndef BUILD_OPENCL
+  std::vector<Conv::CombinedTensor*> loaded_parameters;
+  loaded.GetParameters(loaded_parameters);
+  for(Conv::CombinedTensor* layer_parameters : loaded_parameters) {
+    if(!layer_parameters->data.is_shadow()) {
+      LOGERROR << "Loaded parameters do not use the mapped file";
+      return false;
+    }
+  }
+#endif
+
+  // The second file only has the first convolution
+  Conv::NetGraphNode* conv1 = source.GetNodes()[1];
+  ScaleParameters(conv1->layer->parameters(), 2);
+  std::vector<Conv::ParameterSet> parameter_sets(1);
+  parameter_sets[0].name = conv1->unique_name;
+  for(Conv::CombinedTensor* layer_parameters : conv1->layer->parameters())
+    parameter_sets[0].tensors.push_back(&layer_parameters->data);
+  {
+    std::ofstream output(second_filename, std::ios::out | std::ios::binary);
+    Conv::IndexedParameterFile::Write(output, parameter_sets);
+  }
+  std::remove(first_filename.c_str());
+  if(!loaded.LoadParameters(second_filename) || !same_output()) {
+    LOGERROR << "Parameters were not detached from the first file";
+    return false;
+  }
+
+  // Sequential files go through DeserializeParameters
+  ScaleParameters(source_parameters, 0.5);
+  {
+    std::ofstream output(sequential_filename, std::ios::out | std::ios::binary);
+    source.SerializeParameters(output, false);
+  }
+  if(!loaded.LoadParameters(sequential_filename) || !same_output()) {
+    LOGERROR << "Sequential parameters were not loaded";
+    return false;
+  }
+
+  {
+    std::ofstream output(sequential_filename, std::ios::out | std::ios::binary);
+    output << "not a parameter file";
+  }
+  if(loaded.LoadParameters(sequential_filename)) {
+    LOGERROR << "Loaded parameters from an invalid file";
+    return false;
+  }
+
+  std::remove(second_filename.c_str());
+  std::remove(sequential_filename.c_str());
+  return true;
+}
+
+int main() {
+  Conv::System::Init();
+
+  const std::string test_filename = "tmp_test_parameterfile";
+  Conv::Tensor weights(4, 3, 3, 2), biases(1, 4), empty;
+  for(unsigned int e = 0; e < weights.elements(); e++)
+    weights(e) = (Conv::datum)e * 0.25f - 3.0f;
+  for(unsigned int e = 0; e < biases.elements(); e++)
+    biases(e) = (Conv::datum)e;
+
+  std::vector<Conv::ParameterSet> parameter_sets(2);
+  parameter_sets[0].name = "__metadata";
+  parameter_sets[0].tensors.push_back(&empty);
+  parameter_sets[1].name = "conv1";
+  parameter_sets[1].metadata = "{}";
+  parameter_sets[1].tensors.push_back(&weights);
+  parameter_sets[1].tensors.push_back(&biases);
+
+  std::ofstream output_stream(test_filename, std::ios::out | std::ios::binary);
+  if(!output_stream.good() || !Conv::IndexedParameterFile::Write(output_stream, parameter_sets)) {
+    LOGERROR << "Cannot write test data!";
+    LOGEND;
+    return -1;
+  }
+  output_stream.close();
+
+  bool success;
+  {
+    // Read as a stream, the caller reads the magic number
+    std::ifstream input_stream(test_filename, std::ios::in | std::ios::binary);
+    uint64_t magic = 0;
+    input_stream.read((char*)&magic, sizeof(uint64_t));
+    Conv::IndexedParameterFile file(input_stream);
+    success = magic == CN24_PARIDX_MAGIC && CheckFile(file, weights, biases, false);
+  }
+
+  if(success) {
+    Conv::IndexedParameterFile file(test_filename);
+#ifdef BUILD_OPENCL
+    // Tensors cannot view other Tensors' memory with OpenCL
+    success = CheckFile(file, weights, biases, false);
+#else
+    success = CheckFile(file, weights, biases, true);
+#endif
+  }
+
+  std::remove(test_filename.c_str());
+  if(success)
+    success = CheckNetGraphRoundTrip();
+  LOGEND;
+  return success ? 0 : -1;
+}
@@ -0,0 +1,66 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+bool TestRoundTrip(bool compress) {
+  const std::string test_filename = "tmp_test_predictiondump";
+  Conv::ClassManager class_manager;
+  class_manager.RegisterClassByName("car", 0, 1);
+  class_manager.RegisterClassByName("pedestrian", 0, 1);
+
+  std::vector<std::string> segment_names = {"first", "second"};
+
+  Conv::Tensor prediction(3, 4, 2, 5);
+  for(unsigned int e = 0; e < prediction.elements(); e++) {
+    // Some runs of equal values to exercise the compression
+    prediction[e] = (e % 7 < 3) ? 0 : (Conv::datum)e * 0.25f;
+  }
+
+  {
+    Conv::PredictionDumpWriter writer(test_filename, prediction, &class_manager, segment_names, compress);
+    for(unsigned int s = 0; s < prediction.samples(); s++)
+      writer.WriteRow(s % 2, s, (Conv::datum)s + 0.5f, prediction, s);
+  }
+
+  Conv::PredictionDumpReader reader(test_filename);
+  Conv::AssertEqual(true, reader.good(), "reader state");
+  Conv::AssertEqual(compress, reader.compressed(), "compression flag");
+  Conv::AssertEqual(prediction.maps(), reader.maps(), "maps");
+  Conv::AssertEqual((std::size_t)2, reader.class_names().size(), "class count");
+  Conv::AssertEqual(std::string("pedestrian"), reader.class_names()[1].second, "class name");
+  Conv::AssertEqual(std::string("second"), reader.segment_names()[1], "segment name");
+
+  unsigned int segment, sample; Conv::datum score; Conv::Tensor row;
+  unsigned int rows = 0;
+  while(reader.ReadRow(segment, sample, score, row)) {
+    Conv::AssertEqual(rows % 2, segment, "segment index");
+    Conv::AssertEqual(rows, sample, "sample index");
+    Conv::AssertEqual((Conv::datum)rows + 0.5f, score, "score");
+    for(unsigned int e = 0; e < row.elements(); e++) {
+      if(row(e) != prediction(prediction.Offset(0, 0, 0, rows) + e)) {
+        LOGERROR << "Payload mismatch at row " << rows << ", element " << e;
+        return false;
+      }
+    }
+    rows++;
+  }
+  Conv::AssertEqual((unsigned int)prediction.samples(), rows, "row count");
+  return true;
+}
+
+int main() {
+  Conv::System::Init();
+
+  if(!TestRoundTrip(false) || !TestRoundTrip(true)) {
+    LOGEND;
+    return -1;
+  }
+
+  LOGEND;
+  return 0;
+}
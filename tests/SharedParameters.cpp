@@ -0,0 +1,101 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <thread>
+#include <vector>
+
+#include "TestNets.h"
+
+const unsigned int workers = 4;
+const unsigned int passes = 5;
+
+int main() {
+  Conv::System::Init();
+
+  Conv::Tensor source_data(2, 16, 12, 3), source_helper(2, 16, 12, 2);
+  Conv::NetGraph source;
+  Conv::BuildTestNet(source, source_data, source_helper);
+  source.SetIsTesting(true);
+
+  // Make the source's parameters differ from a freshly initialized graph
+  std::vector<Conv::CombinedTensor*> source_parameters;
+  source.GetParameters(source_parameters);
+  for(Conv::CombinedTensor* parameters : source_parameters) {
+    for(std::size_t e = 0; e < parameters->data.elements(); e++)
+      parameters->data[e] = 0.5f * parameters->data[e] + 0.01f;
+  }
+
+  // The expected outputs, one input per worker
+  std::vector<Conv::Tensor> expected(workers);
+  for(unsigned int w = 0; w < workers; w++) {
+    Conv::FillInput(source_data, source_helper, w);
+    source.FeedForward();
+    expected[w].Resize(Conv::Output(source));
+    Conv::Tensor::Copy(Conv::Output(source), expected[w]);
+  }
+
+  std::vector<Conv::Tensor> data(workers), helper(workers);
+  std::vector<Conv::NetGraph*> graphs(workers);
+  for(unsigned int w = 0; w < workers; w++) {
+    data[w].Resize(2, 16, 12, 3);
+    helper[w].Resize(2, 16, 12, 2);
+    graphs[w] = new Conv::NetGraph();
+    Conv::BuildTestNet(*graphs[w], data[w], helper[w]);
+    graphs[w]->SetIsTesting(true);
+    if(!graphs[w]->ShareParameters(source)) {
+      LOGERROR << "Cannot share parameters with graph " << w;
+      return -1;
+    }
+
+    std::vector<Conv::CombinedTensor*> parameters;
+    graphs[w]->GetParameters(parameters);
+    for(unsigned int p = 0; p < parameters.size(); p++) {
+      if(parameters[p]->data.data_ptr_const() != source_parameters[p]->data.data_ptr_const()) {
+        LOGERROR << "Parameter set " << p << " of graph " << w << " is not shared";
+        return -1;
+      }
+    }
+  }
+
+  // Every graph runs in its own thread at the same time
+  std::vector<char> correct(workers, 1);
+  std::vector<std::thread> threads;
+  for(unsigned int w = 0; w < workers; w++) {
+    threads.push_back(std::thread([&, w] {
+      for(unsigned int pass = 0; pass < passes; pass++) {
+        Conv::FillInput(data[w], helper[w], w);
+        graphs[w]->FeedForward();
+        if(!Conv::Identical(Conv::Output(*graphs[w]), expected[w]))
+          correct[w] = 0;
+      }
+    }));
+  }
+  for(std::thread& thread : threads)
+    thread.join();
+
+  for(unsigned int w = 0; w < workers; w++) {
+    if(!correct[w]) {
+      LOGERROR << "Graph " << w << " computed a wrong output";
+      return -1;
+    }
+    delete graphs[w];
+  }
+
+  // Graphs with different parameter shapes are rejected
+  Conv::Tensor other_data(2, 16, 12, 4), other_helper(2, 16, 12, 2);
+  Conv::NetGraph other;
+  Conv::BuildTestNet(other, other_data, other_helper);
+  if(other.ShareParameters(source)) {
+    LOGERROR << "Shared parameters of a different shape";
+    return -1;
+  }
+
+  LOGEND;
+  return 0;
+}
@@ -28,6 +28,7 @@ std::vector<std::pair<std::string, bool>> test_layers_and_runs = {
   {"{\"layer\":{\"type\":\"advanced_maxpooling\",\"size\":[3,3]}}",false},
   {"{\"layer\":{\"type\":\"advanced_maxpooling\",\"size\":[3,2]}}",false},
   {"{\"layer\":{\"type\":\"advanced_maxpooling\",\"size\":[3,3],\"stride\":[2,2]}}",false},
+  {"{\"layer\":{\"type\":\"advanced_maxpooling\",\"size\":[2,2],\"stride\":[2,2]}}",false},
   {"{\"layer\":{\"type\":\"convolution\",\"size\":[3,3],\"kernels\":3}}",true},
   {"{\"layer\":{\"type\":\"convolution\",\"size\":[3,3],\"stride\":[2,2],\"kernels\":3}}",true},
 	{"{\"layer\":{\"type\":\"convolution\",\"size\":[3,3],\"pad\":[2,2],\"kernels\":3}}",true},
@@ -43,7 +44,9 @@ std::vector<std::pair<std::string, bool>> test_layers_and_runs = {
   {"{\"layer\":\"relu\"}",false},
 	{"{\"layer\":\"leaky\"}",false},
   {"{\"layer\":{\"type\":\"gradient_accumulation\",\"outputs\":2}}",false},
-  {"{\"layer\":{\"type\":\"resize\",\"border\":[2,2]}}",false}
+  {"{\"layer\":{\"type\":\"resize\",\"border\":[2,2]}}",false},
+  {"{\"layer\":{\"type\":\"local_response_normalization\",\"size\":3,\"alpha\":0.5}}",false},
+  {"{\"layer\":{\"type\":\"local_response_normalization\",\"size\":4,\"alpha\":0.5,\"method\":\"within\"}}",false}
 };
 
 // UTILITIES
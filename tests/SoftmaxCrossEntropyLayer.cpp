@@ -0,0 +1,105 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+Conv::SoftmaxCrossEntropyLayer* global_loss_layer = nullptr;
+
+void WriteLossDeltas(const std::vector<Conv::CombinedTensor*>& outputs) {
+  UNREFERENCED_PARAMETER(outputs);
+}
+
+Conv::datum CalculateLoss(Conv::Layer* layer, const std::vector<Conv::CombinedTensor*>& outputs) {
+  UNREFERENCED_PARAMETER(layer);
+  UNREFERENCED_PARAMETER(outputs);
+  return global_loss_layer->CalculateLossFunction();
+}
+
+int main() {
+  Conv::System::Init();
+
+  const unsigned int SAMPLES = 3, WIDTH = 5, HEIGHT = 4, MAPS = 6;
+  std::mt19937 generator(31337);
+  std::uniform_real_distribution<Conv::datum> dist_score(-3, 3);
+  std::uniform_real_distribution<Conv::datum> dist_weight(0, 1);
+
+  Conv::CombinedTensor scores(SAMPLES, WIDTH, HEIGHT, MAPS);
+  Conv::CombinedTensor labels(SAMPLES, WIDTH, HEIGHT, MAPS);
+  Conv::CombinedTensor weights(SAMPLES, WIDTH, HEIGHT, 1);
+
+  labels.data.Clear(0);
+  for(unsigned int sample = 0; sample < SAMPLES; sample++) {
+    for(unsigned int y = 0; y < HEIGHT; y++) {
+      for(unsigned int x = 0; x < WIDTH; x++) {
+        *labels.data.data_ptr(x, y, generator() % MAPS, sample) = 1;
+        *weights.data.data_ptr(x, y, 0, sample) = dist_weight(generator);
+      }
+    }
+  }
+  for(unsigned int e = 0; e < scores.data.elements(); e++)
+    scores.data[e] = dist_score(generator);
+
+  // Large scores would overflow a naive softmax
+  scores.data[0] = 200;
+  scores.data[1] = -200;
+
+  Conv::SoftmaxCrossEntropyLayer loss_layer;
+  global_loss_layer = &loss_layer;
+  Conv::NetStatus net_status;
+  std::vector<Conv::CombinedTensor*> outputs;
+  Conv::Layer& layer = loss_layer;
+  if(!layer.CreateOutputs({&scores, &labels, &weights}, outputs) ||
+     !layer.Connect({&scores, &labels, &weights}, outputs, &net_status)) {
+    LOGERROR << "Layer will not connect!";
+    LOGEND;
+    return -1;
+  }
+
+  loss_layer.FeedForward();
+
+  // Reference computation in double precision
+  double reference_loss = 0;
+  for(unsigned int sample = 0; sample < SAMPLES; sample++) {
+    for(unsigned int y = 0; y < HEIGHT; y++) {
+      for(unsigned int x = 0; x < WIDTH; x++) {
+        double maximum = -1e30;
+        for(unsigned int map = 0; map < MAPS; map++)
+          maximum = std::max(maximum, (double)*scores.data.data_ptr(x, y, map, sample));
+        double sum = 0;
+        for(unsigned int map = 0; map < MAPS; map++)
+          sum += std::exp((double)*scores.data.data_ptr(x, y, map, sample) - maximum);
+        for(unsigned int map = 0; map < MAPS; map++) {
+          const double log_probability = (double)*scores.data.data_ptr(x, y, map, sample) - maximum - std::log(sum);
+          reference_loss -= (double)*weights.data.data_ptr(x, y, 0, sample) * (double)*labels.data.data_ptr(x, y, map, sample) * log_probability;
+        }
+      }
+    }
+  }
+
+  const double loss = (double)loss_layer.CalculateLossFunction();
+  if(std::fabs(loss - reference_loss) > 1e-3 * std::fabs(reference_loss) || !std::isfinite(loss)) {
+    LOGERROR << "Loss mismatch: " << loss << ", expected " << reference_loss;
+    LOGEND;
+    return -1;
+  }
+
+  // Extreme scores saturate the softmax, check the gradient on the rest
+  scores.data[0] = 0.5;
+  scores.data[1] = -0.5;
+  if(!Conv::GradientTester::DoGradientTest(&loss_layer, scores.data, scores.delta, outputs, 0.005, WriteLossDeltas, CalculateLoss)) {
+    LOGERROR << "Failed gradient test!";
+    LOGEND;
+    return -1;
+  }
+
+  LOGEND;
+  return 0;
+}
@@ -0,0 +1,160 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <vector>
+
+#include "TestNets.h"
+
+const char* segmentation_descriptor = R"({"special":"synthetic","task":"segmentation","width":24,"height":16,
+  "classes":3,"training_samples":8,"testing_samples":2,"seed":7})";
+const char* detection_descriptor = R"({"special":"synthetic","task":"detection","width":32,"height":32,
+  "classes":4,"training_samples":8,"testing_samples":2,"max_objects":3,"seed":7})";
+
+const char* classification_descriptor = R"({"special":"synthetic","task":"classification","width":16,"height":16,
+  "classes":5,"training_samples":8,"testing_samples":4,"seed":7})";
+
+const char* net_json = R"({
+  "net": {"input":"conv1","output":"conv1","error_layer":"square",
+    "nodes":{"conv1":{"layer":{"type":"convolution","size":[1,1],"kernels":3}}}},
+  "hyperparameters": {"learning_rate":0.01,"batch_size_parallel":2,"epoch_iterations":4,
+    "enable_stats_during_training":false}
+})";
+
+int main() {
+  Conv::System::Init();
+
+  // The same descriptor gives the same samples
+  Conv::ClassManager class_manager1, class_manager2;
+  Conv::Dataset* dataset1 = Conv::JSONDatasetFactory::ConstructDataset(Conv::JSON::parse(segmentation_descriptor), &class_manager1);
+  Conv::Dataset* dataset2 = Conv::JSONDatasetFactory::ConstructDataset(Conv::JSON::parse(segmentation_descriptor), &class_manager2);
+  if(dataset1->GetTask() != Conv::SEMANTIC_SEGMENTATION || dataset1->GetLabelMaps() != 3 || class_manager1.GetClassCount() != 3) {
+    LOGERROR << "Wrong segmentation dataset properties";
+    return -1;
+  }
+
+  Conv::Tensor data1(1, 24, 16, 3), label1(1, 24, 16, 3), helper1(1, 24, 16, 2), weight1(1, 24, 16, 1);
+  Conv::Tensor data2(1, 24, 16, 3), label2(1, 24, 16, 3), helper2(1, 24, 16, 2), weight2(1, 24, 16, 1);
+  for(unsigned int index = 0; index < dataset1->GetTrainingSamples(); index++) {
+    dataset1->GetTrainingSample(data1, label1, helper1, weight1, 0, index);
+    dataset2->GetTrainingSample(data2, label2, helper2, weight2, 0, index);
+    if(!Conv::Identical(data1, data2) || !Conv::Identical(label1, label2)) {
+      LOGERROR << "Training sample " << index << " differs between two datasets";
+      return -1;
+    }
+
+    // Every pixel has exactly one class
+    for(unsigned int y = 0; y < 16; y++) {
+      for(unsigned int x = 0; x < 24; x++) {
+        Conv::datum sum = 0;
+        for(unsigned int c = 0; c < 3; c++)
+          sum += *label1.data_ptr_const(x, y, c, 0);
+        if(sum != 1) {
+          LOGERROR << "Pixel " << x << "," << y << " of sample " << index << " has " << sum << " classes";
+          return -1;
+        }
+      }
+    }
+  }
+  if(dataset1->GetTestingSample(data1, label1, helper1, weight1, 0, 2)) {
+    LOGERROR << "Loaded a testing sample that does not exist";
+    return -1;
+  }
+
+  // Detection samples have boxes inside the image
+  Conv::ClassManager detection_class_manager;
+  Conv::Dataset* detection_dataset = Conv::JSONDatasetFactory::ConstructDataset(Conv::JSON::parse(detection_descriptor), &detection_class_manager);
+  for(unsigned int index = 0; index < detection_dataset->GetTrainingSamples(); index++) {
+    Conv::DatasetMetadataPointer metadata[1];
+    if(!detection_dataset->GetTrainingMetadata(metadata, 0, index)) {
+      LOGERROR << "No metadata for detection sample " << index;
+      return -1;
+    }
+    std::vector<Conv::BoundingBox>* boxes = (std::vector<Conv::BoundingBox>*)metadata[0];
+    if(boxes->size() < 1 || boxes->size() > 3) {
+      LOGERROR << "Detection sample " << index << " has " << boxes->size() << " boxes";
+      return -1;
+    }
+    for(Conv::BoundingBox& box : *boxes) {
+      if(box.x - box.w / 2 < 0 || box.x + box.w / 2 > 1 || box.y - box.h / 2 < 0 || box.y + box.h / 2 > 1 || box.c >= 4) {
+        LOGERROR << "Invalid box in detection sample " << index;
+        return -1;
+      }
+    }
+  }
+
+  // Classification labels have exactly one class
+  Conv::ClassManager classification_class_manager;
+  Conv::Dataset* classification_dataset = Conv::JSONDatasetFactory::ConstructDataset(Conv::JSON::parse(classification_descriptor), &classification_class_manager);
+  if(classification_dataset->GetTask() != Conv::CLASSIFICATION || classification_dataset->GetLabelMaps() != 5) {
+    LOGERROR << "Wrong classification dataset properties";
+    return -1;
+  }
+  Conv::Tensor classification_data(1, 16, 16, 3), classification_label(1, 1, 1, 5), classification_helper(1, 16, 16, 2),
+    classification_weight(1, 1, 1, 1);
+  for(unsigned int index = 0; index < 12; index++) {
+    const bool training = index < 8;
+    const bool loaded = training ?
+      classification_dataset->GetTrainingSample(classification_data, classification_label, classification_helper, classification_weight, 0, index) :
+      classification_dataset->GetTestingSample(classification_data, classification_label, classification_helper, classification_weight, 0, index - 8);
+    if(!loaded) {
+      LOGERROR << "Cannot load classification sample " << index;
+      return -1;
+    }
+    unsigned int hot = 0;
+    for(unsigned int c = 0; c < 5; c++) {
+      const Conv::datum value = *classification_label.data_ptr_const(0, 0, c, 0);
+      if(value == 1) {
+        hot++;
+      } else if(value != 0) {
+        LOGERROR << "Classification sample " << index << " has label value " << value;
+        return -1;
+      }
+    }
+    if(hot != 1) {
+      LOGERROR << "Classification sample " << index << " has " << hot << " classes";
+      return -1;
+    }
+  }
+
+  // The trainer reports the time spent in each phase
+  {
+    Conv::JSONNetGraphFactory factory(Conv::JSON::parse(net_json), 1);
+    Conv::NetGraph graph;
+    Conv::NetGraphNode* input_node = new Conv::NetGraphNode(new Conv::DatasetInputLayer(factory.GetDataInput(), dataset1, 2));
+    input_node->is_input = true;
+    graph.AddNode(input_node);
+    if(!factory.AddLayers(graph, &class_manager1)) {
+      LOGERROR << "Cannot build the net";
+      return -1;
+    }
+    graph.InitializeWeights();
+
+    Conv::Trainer trainer(graph, factory.GetHyperparameters());
+    trainer.Train(1, false);
+    const Conv::TrainerPhaseTimes& phase_times = trainer.phase_times();
+    if(!(phase_times.load > 0 && phase_times.forward > 0 && phase_times.backward > 0 && phase_times.optimizer > 0)) {
+      LOGERROR << "Missing phase times: " << phase_times.load << ", " << phase_times.forward << ", "
+        << phase_times.backward << ", " << phase_times.optimizer;
+      return -1;
+    }
+    trainer.ResetPhaseTimes();
+    if(trainer.phase_times().forward != 0) {
+      LOGERROR << "Phase times were not reset";
+      return -1;
+    }
+  }
+
+  delete dataset1;
+  delete dataset2;
+  delete detection_dataset;
+  delete classification_dataset;
+
+  LOGEND;
+  return 0;
+}
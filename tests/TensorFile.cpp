@@ -0,0 +1,174 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include <cn24.h>
+
+bool CheckTensors(const std::string& filename, Conv::Tensor* tensors, unsigned int count, bool aligned) {
+  for(unsigned int mmap = 0; mmap < 2; mmap++) {
+    Conv::TensorFile file(filename);
+    if(!file.IsValid() || file.IsAligned() != aligned || file.GetTensorCount() != count) {
+      LOGERROR << "Wrong format or tensor count in " << filename;
+      return false;
+    }
+
+    for(unsigned int t = 0; t < count; t++) {
+      Conv::Tensor loaded;
+      if(!file.Load(t, loaded, mmap == 1)) {
+        LOGERROR << "Cannot load tensor " << t << " from " << filename;
+        return false;
+      }
+#ifdef BUILD_POSIX
+      if(aligned && mmap == 1 && ((std::size_t)loaded.data_ptr_const()) % Conv::TensorFile::alignment != 0) {
+        LOGERROR << "Tensor " << t << " is not aligned";
+        return false;
+      }
+#endif
+      if(loaded.samples() != tensors[t].samples() || loaded.width() != tensors[t].width() ||
+        loaded.height() != tensors[t].height() || loaded.maps() != tensors[t].maps()) {
+        LOGERROR << "Wrong shape of tensor " << t << ": " << loaded;
+        return false;
+      }
+      for(unsigned int e = 0; e < loaded.elements(); e++) {
+        if(loaded(e) != tensors[t](e)) {
+          LOGERROR << "Wrong value in tensor " << t << " at " << e;
+          return false;
+        }
+      }
+
+      // Writing to a mapped tensor must not change the file
+      loaded.Clear(-1.0);
+    }
+  }
+  return true;
+}
+
+// Loads image/label pairs from an aligned file as a patch dataset
+bool CheckPatchDataset(const std::string& filename, bool mmap) {
+  const unsigned int width = 6, height = 5, patchsize = 3;
+
+  Conv::Tensor image(1, width, height, 2), label(1, width, height, 2);
+  for(unsigned int e = 0; e < image.elements(); e++)
+    image(e) = (Conv::datum)e * 0.25f;
+  label.Clear();
+  for(unsigned int y = 0; y < height; y++) {
+    for(unsigned int x = 0; x < width; x++)
+      *label.data_ptr(x, y, (x + y) % 2, 0) = 1;
+  }
+
+  std::ofstream output(filename, std::ios::out | std::ios::binary);
+  Conv::TensorFileWriter writer(output);
+  writer.Write(image);
+  writer.Write(label);
+  if(!writer.Finish()) {
+    LOGERROR << "Cannot write test data!";
+    return false;
+  }
+  output.close();
+
+  std::stringstream configuration;
+  configuration << "training=" << filename << "\nclasses=2\na\nb\ncolors\n0xFF0000\n0x00FF00\n";
+  if(!mmap)
+    configuration << "nommap\n";
+  Conv::ClassManager class_manager;
+  Conv::TensorStreamPatchDataset* dataset = Conv::TensorStreamPatchDataset::CreateFromConfiguration(configuration,
+    false, Conv::LOAD_TRAINING_ONLY, patchsize, patchsize, &class_manager);
+
+  const unsigned int inner_width = width - (patchsize - 1);
+  bool success = true;
+  if(dataset->GetTrainingSamples() != inner_width * (height - (patchsize - 1))) {
+    LOGERROR << "Wrong sample count: " << dataset->GetTrainingSamples();
+    success = false;
+  }
+
+  Conv::Tensor data(1, patchsize, patchsize, 2), labels(1, 1, 1, 2), helper(1, 1, 1, 2), weight(1);
+  for(unsigned int index = 0; success && index < dataset->GetTrainingSamples(); index++) {
+    const unsigned int col = index % inner_width, row = index / inner_width;
+    if(!dataset->GetTrainingSample(data, labels, helper, weight, 0, index)) {
+      LOGERROR << "Cannot load sample " << index;
+      success = false;
+      break;
+    }
+    for(unsigned int map = 0; map < 2; map++) {
+      for(unsigned int y = 0; y < patchsize; y++) {
+        for(unsigned int x = 0; x < patchsize; x++) {
+          if(*data.data_ptr(x, y, map, 0) != *image.data_ptr(col + x, row + y, map, 0)) {
+            LOGERROR << "Wrong patch value in sample " << index;
+            success = false;
+          }
+        }
+      }
+      if(*labels.data_ptr(0, 0, map, 0) != *label.data_ptr(col + 1, row + 1, map, 0)) {
+        LOGERROR << "Wrong label in sample " << index;
+        success = false;
+      }
+    }
+  }
+
+  delete dataset;
+  std::remove(filename.c_str());
+  return success;
+}
+
+int main() {
+  Conv::System::Init();
+
+  const std::string aligned_filename = "tmp_test_tensorfile_aligned";
+  const std::string legacy_filename = "tmp_test_tensorfile_legacy";
+  const unsigned int count = 3;
+
+  Conv::Tensor tensors[count];
+  tensors[0].Resize(2, 7, 5, 3);
+  tensors[1].Resize(1, 1);
+  tensors[2].Resize(1, 33, 17, 2);
+  for(unsigned int t = 0; t < count; t++) {
+    for(unsigned int e = 0; e < tensors[t].elements(); e++)
+      tensors[t](e) = (Conv::datum)(e * (t + 1)) * 0.5f;
+  }
+
+  std::ofstream aligned_output(aligned_filename, std::ios::out | std::ios::binary);
+  std::ofstream legacy_output(legacy_filename, std::ios::out | std::ios::binary);
+  Conv::TensorFileWriter writer(aligned_output);
+  for(unsigned int t = 0; t < count; t++) {
+    writer.Write(tensors[t]);
+    tensors[t].Serialize(legacy_output);
+  }
+  if(!writer.Finish() || !legacy_output.good()) {
+    LOGERROR << "Cannot write test data!";
+    LOGEND;
+    return -1;
+  }
+  aligned_output.close();
+  legacy_output.close();
+
+  // The second pass also checks that the file is unchanged
+  bool success = CheckTensors(aligned_filename, tensors, count, true) &&
+    CheckTensors(aligned_filename, tensors, count, true) &&
+    CheckTensors(legacy_filename, tensors, count, false);
+
+  std::remove(aligned_filename.c_str());
+  std::remove(legacy_filename.c_str());
+
+  // Offsets are counted from the beginning of the stream, a writer that
+  // starts after other data would produce a broken file
+  std::stringstream prefixed;
+  prefixed << "prefix";
+  Conv::TensorFileWriter prefixed_writer(prefixed);
+  prefixed_writer.Write(tensors[0]);
+  if(prefixed_writer.Finish()) {
+    LOGERROR << "Finished a tensor file that does not start at the beginning of the stream";
+    success = false;
+  }
+
+  success = success && CheckPatchDataset("tmp_test_tensorfile_patches", true) &&
+    CheckPatchDataset("tmp_test_tensorfile_patches", false);
+  LOGEND;
+  return success ? 0 : -1;
+}
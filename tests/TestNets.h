@@ -0,0 +1,103 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file TestNets.h
+ * @brief Small nets and tensor helpers shared by the tests
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#ifndef CONV_TESTNETS_H
+#define CONV_TESTNETS_H
+
+#include <cn24.h>
+
+#include <cmath>
+
+namespace Conv {
+
+/**
+ * @brief Builds and initializes a net that covers most of the layer kinds
+ *   with parameters, pooling, upscaling, sums and concatenations:
+ *
+ * input -> conv -> (pool -> conv -> upscale, identity) -> sum -> relu
+ *   -> concat with tanh(input) -> conv
+ */
+inline void BuildTestNet(NetGraph& graph, Tensor& data, Tensor& helper) {
+  NetGraphNode* input_node = new NetGraphNode(new InputLayer(data, helper));
+  input_node->is_input = true;
+  graph.AddNode(input_node);
+
+  NetGraphNode* conv1 = new NetGraphNode(new ConvolutionLayer(3, 3, 4, 1, 1, 1, 1, 1, 1),
+    NetGraphConnection(input_node));
+  NetGraphNode* pool = new NetGraphNode(new MaxPoolingLayer(2, 2), NetGraphConnection(conv1));
+  NetGraphNode* conv2 = new NetGraphNode(new ConvolutionLayer(1, 1, 4, 1, 1, 0, 0, 1, 2),
+    NetGraphConnection(pool));
+  NetGraphNode* upscale = new NetGraphNode(new UpscaleLayer(2, 2), NetGraphConnection(conv2));
+  graph.AddNode(conv1);
+  graph.AddNode(pool);
+  graph.AddNode(conv2);
+  graph.AddNode(upscale);
+
+  NetGraphNode* sum = new NetGraphNode(new SumLayer(), NetGraphConnection(upscale));
+  sum->input_connections.push_back(NetGraphConnection(conv1));
+  NetGraphNode* relu = new NetGraphNode(new ReLULayer(), NetGraphConnection(sum));
+  NetGraphNode* tanh = new NetGraphNode(new TanhLayer(), NetGraphConnection(input_node));
+  graph.AddNode(sum);
+  graph.AddNode(relu);
+  graph.AddNode(tanh);
+
+  NetGraphNode* concat = new NetGraphNode(new ConcatenationLayer(), NetGraphConnection(relu));
+  concat->input_connections.push_back(NetGraphConnection(tanh));
+  NetGraphNode* conv3 = new NetGraphNode(new ConvolutionLayer(1, 1, 2, 1, 1, 0, 0, 1, 3),
+    NetGraphConnection(concat));
+  conv3->is_output = true;
+  graph.AddNode(concat);
+  graph.AddNode(conv3);
+
+  graph.Initialize();
+  graph.InitializeWeights();
+}
+
+/**
+ * @brief Fills the data with a deterministic pattern that depends on the
+ *   seed and clears the helper
+ */
+inline void FillInput(Tensor& data, Tensor& helper, unsigned int seed = 0) {
+  for(std::size_t e = 0; e < data.elements(); e++)
+    data[e] = (datum)std::sin(0.37 * e + seed);
+  helper.Clear();
+}
+
+/**
+ * @brief Returns the data of the default output node, on the CPU
+ */
+inline Tensor& Output(NetGraph& graph) {
+  Tensor& output = graph.GetDefaultOutputNode()->output_buffers[0].combined_tensor->data;
+#ifdef BUILD_OPENCL
+  output.MoveToCPU();
+#endif
+  return output;
+}
+
+/**
+ * @brief Returns true if both Tensors have the same shape and are equal
+ *   bit for bit
+ */
+inline bool Identical(const Tensor& a, const Tensor& b) {
+  if(a.samples() != b.samples() || a.width() != b.width() || a.height() != b.height() || a.maps() != b.maps())
+    return false;
+  for(std::size_t e = 0; e < a.elements(); e++) {
+    if(a.data_ptr_const()[e] != b.data_ptr_const()[e])
+      return false;
+  }
+  return true;
+}
+
+}
+
+#endif
@@ -0,0 +1,142 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <cmath>
+#include <random>
+
+const char* dataset_config = R"({
+  "name": "Tiles",
+  "task": "segmentation",
+  "classes": [
+    { "name": "first", "color": "0xff0000" },
+    { "name": "second", "color": "0x00ff00" },
+    { "name": "third", "color": "0x0000ff" }
+  ],
+  "input_maps": 3,
+  "data": []
+})";
+
+// Two 5x5 convolutions, the receptive field's radius is 4
+const char* conv_net_config = R"({
+  "net": {
+    "input": "resize",
+    "output": "tanh2",
+    "error_layer": "no",
+    "nodes": {
+      "resize": { "layer": { "type": "resize", "border": [8,8] } },
+      "conv1": { "input": "resize", "layer": { "type": "convolution", "size": [5,5], "kernels": 4 } },
+      "tanh1": { "input": "conv1", "layer": "tanh" },
+      "conv2": { "input": "tanh1", "layer": { "type": "convolution", "size": [5,5], "kernels": 3 } },
+      "tanh2": { "input": "conv2", "layer": "tanh" }
+    }
+  }
+})";
+
+// Pooling and upscaling make the output depend on the position of each
+// pixel on the pooling grid
+const char* pooling_net_config = R"({
+  "net": {
+    "input": "resize",
+    "output": "tanh2",
+    "error_layer": "no",
+    "nodes": {
+      "resize": { "layer": { "type": "resize", "border": [4,4] } },
+      "conv1": { "input": "resize", "layer": { "type": "convolution", "size": [3,3], "kernels": 4 } },
+      "tanh1": { "input": "conv1", "layer": "tanh" },
+      "pool": { "input": "tanh1", "layer": { "type": "simple_maxpooling", "size": [2,2] } },
+      "conv2": { "input": "pool", "layer": { "type": "convolution", "size": [1,1], "kernels": 4 } },
+      "upscale": { "input": "conv2", "layer": { "type": "upscale", "size": [2,2] } },
+      "conv3": { "input": "upscale", "layer": { "type": "convolution", "size": [3,3], "kernels": 3 } },
+      "tanh2": { "input": "conv3", "layer": "tanh" }
+    }
+  }
+})";
+
+bool CheckTiledPrediction(const char* net_config, unsigned int tile_size) {
+  Conv::ClassManager class_manager;
+  Conv::Dataset* dataset = Conv::JSONDatasetFactory::ConstructDataset(Conv::JSON::parse(dataset_config), &class_manager);
+  Conv::JSONNetGraphFactory factory(Conv::JSON::parse(net_config));
+
+  const unsigned int width = 90, height = 60;
+  Conv::Tensor image(1, width, height, 3);
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<Conv::datum> distribution(0, 1);
+  for(unsigned int e = 0; e < image.elements(); e++)
+    image(e) = distribution(generator);
+
+  // Both predictors get the same weights from the factory's default seed
+  Conv::BatchPredictor whole(&factory, dataset, &class_manager, 1, width, height);
+  Conv::BatchPredictor tiled(&factory, dataset, &class_manager, 3, tile_size, tile_size);
+  whole.GetGraph().InitializeWeights();
+  tiled.GetGraph().InitializeWeights();
+
+  whole.SetSample(0, image);
+  whole.Predict();
+  Conv::Tensor& whole_output = whole.GetGraph().GetDefaultOutputNode()->output_buffers[0].combined_tensor->data;
+#ifdef BUILD_OPENCL
+  whole_output.MoveToCPU();
+#endif
+
+  // An odd overlap would put the tiles off the pooling grid if it wasn't
+  // rounded up
+  unsigned int radius = tiled.EstimateReceptiveField();
+  Conv::Tensor tiled_output;
+  bool success = tiled.PredictTiled(image, tiled_output, 2 * radius + 1);
+  if(!success) {
+    LOGERROR << "Tiled prediction failed!";
+  } else if(tiled_output.width() != width || tiled_output.height() != height || tiled_output.maps() != whole_output.maps()) {
+    LOGERROR << "Wrong output shape: " << tiled_output;
+    success = false;
+  }
+
+  for(unsigned int m = 0; success && m < tiled_output.maps(); m++) {
+    for(unsigned int y = 0; success && y < height; y++) {
+      for(unsigned int x = 0; success && x < width; x++) {
+        const Conv::datum expected = *whole_output.data_ptr_const(x, y, m, 0);
+        const Conv::datum actual = *tiled_output.data_ptr_const(x, y, m, 0);
+        if(std::fabs(expected - actual) > 0.0001) {
+          LOGERROR << "Tiled output differs at (" << x << "," << y << "," << m << "): " << actual << " vs. " << expected;
+          success = false;
+        }
+      }
+    }
+  }
+
+  delete dataset;
+  return success;
+}
+
+int main() {
+  Conv::System::Init();
+
+  // The receptive field estimate is exact for convolutions
+  {
+    Conv::ClassManager class_manager;
+    Conv::Dataset* dataset = Conv::JSONDatasetFactory::ConstructDataset(Conv::JSON::parse(dataset_config), &class_manager);
+    Conv::JSONNetGraphFactory factory(Conv::JSON::parse(conv_net_config));
+    Conv::BatchPredictor predictor(&factory, dataset, &class_manager, 1, 32, 32);
+    predictor.GetGraph().InitializeWeights();
+    unsigned int radius = predictor.EstimateReceptiveField();
+    delete dataset;
+    if(radius != 4) {
+      LOGERROR << "Wrong receptive field radius: " << radius;
+      LOGEND;
+      return -1;
+    }
+  }
+
+  // Tiles of 96 pixels with an overlap of 32 pixels on each side
+  if(!CheckTiledPrediction(conv_net_config, 96) || !CheckTiledPrediction(pooling_net_config, 96)) {
+    LOGEND;
+    return -1;
+  }
+
+  LOGEND;
+  return 0;
+}
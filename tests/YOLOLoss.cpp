@@ -0,0 +1,184 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+
+#include <cn24.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+const unsigned int samples = 5;
+const unsigned int horizontal_cells = 3;
+const unsigned int vertical_cells = 2;
+const unsigned int boxes_per_cell = 2;
+const unsigned int classes = 4;
+const unsigned int cells = horizontal_cells * vertical_cells;
+const unsigned int maps = cells * (5 * boxes_per_cell + classes);
+const Conv::datum scale_noobj = 0.5;
+const Conv::datum scale_coord = 5;
+
+// The sequential implementation the layer replaced. It scans the truth
+// list for every cell, the first box in a cell wins.
+long double ReferenceLoss(const Conv::Tensor& input, Conv::Tensor& delta, std::vector<Conv::BoundingBox>* truth,
+  const Conv::Tensor& weights) {
+  delta.Clear(0);
+  long double loss = 0;
+  const Conv::datum* data = input.data_ptr_const();
+
+  for(unsigned int sample = 0; sample < samples; sample++) {
+    if(weights(sample) == 0)
+      continue;
+    std::vector<Conv::BoundingBox>& truth_boxes = truth[sample];
+    const unsigned int sample_index = sample * maps;
+    const unsigned int class_index = sample_index + cells * boxes_per_cell * 5;
+
+    for(unsigned int vcell = 0; vcell < vertical_cells; vcell++) {
+      for(unsigned int hcell = 0; hcell < horizontal_cells; hcell++) {
+        const unsigned int cell_id = vcell * horizontal_cells + hcell;
+        const Conv::datum box_xmin = ((Conv::datum)hcell) / (Conv::datum)horizontal_cells;
+        const Conv::datum box_ymin = ((Conv::datum)vcell) / (Conv::datum)vertical_cells;
+        const Conv::datum box_xmax = ((Conv::datum)(hcell + 1)) / (Conv::datum)horizontal_cells;
+        const Conv::datum box_ymax = ((Conv::datum)(vcell + 1)) / (Conv::datum)vertical_cells;
+
+        Conv::BoundingBox* truth_box = nullptr;
+        for(Conv::BoundingBox& tbox : truth_boxes) {
+          if(tbox.x >= box_xmin && tbox.x < box_xmax && tbox.y >= box_ymin && tbox.y < box_ymax) {
+            truth_box = &tbox;
+            break;
+          }
+        }
+
+        Conv::datum best_iou = 0;
+        int responsible_box = -1;
+        if(truth_box != nullptr) {
+          for(unsigned int b = 0; b < boxes_per_cell; b++) {
+            const unsigned int index = sample_index + 5 * (boxes_per_cell * cell_id + b);
+            Conv::BoundingBox box(box_xmin + data[index] / (Conv::datum)horizontal_cells,
+              box_ymin + data[index + 1] / (Conv::datum)vertical_cells,
+              data[index + 2] * data[index + 2], data[index + 3] * data[index + 3]);
+            const Conv::datum iou = box.IntersectionOverUnion(truth_box);
+            if(iou > best_iou) {
+              responsible_box = (int)b;
+              best_iou = iou;
+            }
+          }
+
+          for(unsigned int c = 0; c < classes; c++) {
+            const unsigned int index = class_index + cells * c + cell_id;
+            const Conv::datum class_delta = data[index] - (truth_box->c == c ? (Conv::datum)1.0 : (Conv::datum)0.0);
+            delta[index] = (Conv::datum)2.0 * class_delta;
+            loss += class_delta * class_delta;
+          }
+        }
+
+        for(unsigned int b = 0; b < boxes_per_cell; b++) {
+          const unsigned int index = sample_index + 5 * (boxes_per_cell * cell_id + b);
+          const Conv::datum confidence = data[index + 4];
+          if((int)b == responsible_box) {
+            const Conv::datum x = box_xmin + data[index] / (Conv::datum)horizontal_cells;
+            const Conv::datum y = box_ymin + data[index + 1] / (Conv::datum)vertical_cells;
+            const Conv::datum w = data[index + 2], h = data[index + 3];
+            Conv::BoundingBox box(x, y, w * w, h * h);
+            const Conv::datum iou = box.IntersectionOverUnion(truth_box);
+
+            const Conv::datum x_delta = (x - truth_box->x) * (Conv::datum)horizontal_cells;
+            const Conv::datum y_delta = (y - truth_box->y) * (Conv::datum)vertical_cells;
+            delta[index] = scale_coord * (Conv::datum)2.0 * x_delta;
+            delta[index + 1] = scale_coord * (Conv::datum)2.0 * y_delta;
+            loss += (Conv::datum)(scale_coord * x_delta * x_delta) + (Conv::datum)(scale_coord * y_delta * y_delta);
+
+            const Conv::datum w_delta = w - std::sqrt(truth_box->w);
+            const Conv::datum h_delta = h - std::sqrt(truth_box->h);
+            delta[index + 2] = scale_coord * (Conv::datum)2.0 * w_delta;
+            delta[index + 3] = scale_coord * (Conv::datum)2.0 * h_delta;
+            loss += (Conv::datum)(scale_coord * w_delta * w_delta) + (Conv::datum)(scale_coord * h_delta * h_delta);
+
+            const Conv::datum conf_delta = confidence - iou;
+            loss += (Conv::datum)(conf_delta * conf_delta);
+            delta[index + 4] = (Conv::datum)2.0 * conf_delta;
+          } else {
+            delta[index + 4] = scale_noobj * ((Conv::datum)2.0 * confidence);
+            loss += (Conv::datum)(scale_noobj * confidence * confidence);
+          }
+        }
+      }
+    }
+  }
+  return loss;
+}
+
+Conv::BoundingBox Box(Conv::datum x, Conv::datum y, Conv::datum w, Conv::datum h, unsigned int c) {
+  Conv::BoundingBox box(x, y, w, h);
+  box.c = c;
+  return box;
+}
+
+int main() {
+  Conv::System::Init();
+
+  std::vector<Conv::BoundingBox> truth[samples];
+  // Two boxes in the same cell, only the first one is trained on
+  truth[0] = {Box(0.1, 0.2, 0.2, 0.3, 1), Box(0.2, 0.3, 0.1, 0.1, 3), Box(0.8, 0.7, 0.3, 0.4, 2)};
+  // Boxes on cell borders and outside of the image
+  truth[1] = {Box(1.0f / 3.0f, 0.5, 0.2, 0.2, 0), Box(2.0f / 3.0f, 0.25, 0.3, 0.3, 1), Box(1.0, 0.5, 0.1, 0.1, 2),
+              Box(-0.1, 0.5, 0.1, 0.1, 2)};
+  // No boxes at all
+  truth[2] = {};
+  // Ignored because of its weight
+  truth[3] = {Box(0.5, 0.5, 0.4, 0.4, 1)};
+  // Several cells, two of them with a second box
+  truth[4] = {Box(0.5, 0.75, 0.5, 0.4, 3), Box(0.55, 0.8, 0.2, 0.2, 0), Box(0.9, 0.1, 0.15, 0.3, 1),
+              Box(0.95, 0.2, 0.1, 0.1, 2), Box(0.1, 0.9, 0.2, 0.2, 0)};
+
+  Conv::DatasetMetadataPointer metadata[samples];
+  for(unsigned int s = 0; s < samples; s++)
+    metadata[s] = &truth[s];
+
+  Conv::CombinedTensor input(samples, 1, 1, maps);
+  Conv::CombinedTensor label(samples, 1, 1, 1, metadata);
+  Conv::CombinedTensor weight(samples);
+  weight.data.Clear(1);
+  weight.data(3) = 0;
+
+  Conv::YOLOLossLayer layer(Conv::JSON::parse(R"({"boxes_per_cell":2,"horizontal_cells":3,"vertical_cells":2})"));
+  std::vector<Conv::CombinedTensor*> inputs = {&input, &label, &weight}, outputs;
+  if(!layer.CreateOutputs(inputs, outputs) || !layer.Connect(inputs, outputs, nullptr)) {
+    LOGERROR << "Cannot connect the YOLO loss layer";
+    LOGEND;
+    return -1;
+  }
+
+  std::mt19937 generator(1234);
+  std::uniform_real_distribution<Conv::datum> distribution(-0.1, 1.1);
+  Conv::Tensor reference_delta(samples, 1, 1, maps);
+  for(unsigned int run = 0; run < 10; run++) {
+    for(unsigned int e = 0; e < input.data.elements(); e++)
+      input.data(e) = distribution(generator);
+
+    layer.FeedForward();
+    layer.BackPropagate();
+    const long double reference_loss = ReferenceLoss(input.data, reference_delta, truth, weight.data);
+
+    // The loss is summed in a different order, the deltas are the same
+    const long double loss = layer.CalculateLossFunction();
+    if(std::fabs((double)(loss - reference_loss)) > 1e-4 * std::fabs((double)reference_loss)) {
+      LOGERROR << "Loss " << (double)loss << " differs from the reference " << (double)reference_loss;
+      LOGEND;
+      return -1;
+    }
+    for(unsigned int e = 0; e < reference_delta.elements(); e++) {
+      if(input.delta(e) != reference_delta(e)) {
+        LOGERROR << "Delta " << e << " of run " << run << " is " << input.delta(e) << " instead of " << reference_delta(e);
+        LOGEND;
+        return -1;
+      }
+    }
+  }
+
+  LOGEND;
+  return 0;
+}
@@ -0,0 +1,298 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file cn24-bench.cpp
+ * @brief Measures the speed of single layers.
+ *
+ * The benchmark file is a JSON array of layer descriptors as understood by
+ * the LayerFactory, each with an additional "input" shape
+ * [samples, width, height, maps] and an optional "name". yolo_output and
+ * yolo_loss descriptors may set "classes". Without a file, a default suite
+ * is run.
+ *
+ * Every layer is run warmup=<n> times, then FeedForward and BackPropagate
+ * are timed repeat=<n> times each. The results are written as JSON to
+ * output=<file> or to stdout.
+ *
+ * FLOP and byte counts are estimates: layers with weights count two
+ * operations per weight and output pixel, other layers one operation per
+ * input and output element. Bytes are the tensors read and written once.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include <cn24.h>
+#include <private/ConfigParsing.h>
+
+#ifdef BUILD_OPENCL
+#include <private/CLHelper.h>
+#endif
+
+const char* default_benchmarks = R"([
+  {"layer":{"type":"convolution","size":[3,3],"kernels":32},"input":[2,32,32,32]},
+  {"layer":{"type":"convolution","size":[3,3],"stride":[2,2],"pad":[1,1],"kernels":64},"input":[2,32,32,32]},
+  {"layer":{"type":"convolution","size":[1,1],"kernels":128},"input":[2,32,32,64]},
+  {"layer":{"type":"convolution","size":[3,3],"group":4,"kernels":64},"input":[2,32,32,64]},
+  {"layer":{"type":"simple_maxpooling","size":[2,2]},"input":[4,64,64,32]},
+  {"layer":{"type":"advanced_maxpooling","size":[3,3],"stride":[2,2]},"input":[4,63,63,32]},
+  {"layer":{"type":"local_response_normalization","size":5,"alpha":0.0001,"beta":0.75},"input":[4,32,32,64]},
+  {"layer":{"type":"local_response_normalization","size":3,"alpha":0.0001,"beta":0.75,"method":"within"},"input":[4,32,32,64]},
+  {"layer":"relu","input":[4,64,64,32]},
+  {"layer":"leaky","input":[4,64,64,32]},
+  {"layer":"tanh","input":[4,64,64,32]},
+  {"layer":"sigm","input":[4,64,64,32]},
+  {"layer":{"type":"resize","border":[4,4]},"input":[4,64,64,32]},
+  {"layer":{"type":"upscale","size":[2,2]},"input":[4,32,32,32]},
+  {"layer":{"type":"yolo_output","yolo_configuration":{"boxes_per_cell":2,"horizontal_cells":7,"vertical_cells":7}},"classes":20,"input":[4,1,1,1024]},
+  {"layer":{"type":"yolo_loss","yolo_configuration":{"boxes_per_cell":2,"horizontal_cells":7,"vertical_cells":7}},"classes":20,"input":[4,1,1,1470]}
+])";
+
+void Synchronize() {
+#ifdef BUILD_OPENCL
+  clFinish(Conv::CLHelper::queue);
+#endif
+}
+
+void Fill(Conv::Tensor& tensor, double phase) {
+#ifdef BUILD_OPENCL
+  tensor.MoveToCPU();
+#endif
+  for(std::size_t e = 0; e < tensor.elements(); e++)
+    tensor[e] = (Conv::datum)(0.5 * std::sin(0.37 * (double)e + phase));
+}
+
+Conv::JSON Summarize(std::vector<double>& seconds, double flops, double bytes) {
+  std::sort(seconds.begin(), seconds.end());
+  const std::size_t n = seconds.size();
+  const double median = n % 2 == 1 ? seconds[n / 2] : 0.5 * (seconds[n / 2 - 1] + seconds[n / 2]);
+  const std::size_t p95_index = (std::size_t)std::ceil(0.95 * (double)n) - 1;
+  const double p95 = seconds[std::min(p95_index, n - 1)];
+
+  Conv::JSON result = Conv::JSON::object();
+  result["median_ms"] = median * 1000.0;
+  result["p95_ms"] = p95 * 1000.0;
+  result["min_ms"] = seconds.front() * 1000.0;
+  result["gflops"] = median > 0 ? flops / median / 1e9 : 0.0;
+  result["gbps"] = median > 0 ? bytes / median / 1e9 : 0.0;
+  return result;
+}
+
+template <typename F>
+std::vector<double> Time(F step, unsigned int repeat) {
+  std::vector<double> seconds;
+  for(unsigned int r = 0; r < repeat; r++) {
+    auto start = std::chrono::steady_clock::now();
+    step();
+    Synchronize();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    seconds.push_back(elapsed.count());
+  }
+  return seconds;
+}
+
+bool RunBenchmark(Conv::JSON& benchmark, unsigned int warmup, unsigned int repeat, Conv::JSON& result) {
+  if(!Conv::LayerFactory::IsValidDescriptor(benchmark)) {
+    LOGERROR << "Invalid layer descriptor: " << benchmark.dump();
+    return false;
+  }
+  if(benchmark.count("input") != 1 || !benchmark["input"].is_array() || benchmark["input"].size() != 4) {
+    LOGERROR << "Missing input shape [samples, width, height, maps]: " << benchmark.dump();
+    return false;
+  }
+
+  const std::string type = Conv::LayerFactory::ExtractLayerType(benchmark);
+  Conv::JSON configuration = Conv::LayerFactory::ExtractConfiguration(benchmark);
+  const unsigned int samples = benchmark["input"][0], width = benchmark["input"][1],
+    height = benchmark["input"][2], maps = benchmark["input"][3];
+  const unsigned int classes = benchmark.count("classes") == 1 ? (unsigned int)benchmark["classes"] : 20;
+
+  Conv::ClassManager class_manager;
+  for(unsigned int c = 0; c < classes; c++)
+    class_manager.RegisterClassByName("class" + std::to_string(c), 0, 1);
+
+  Conv::NetStatus net_status;
+  net_status.SetIsTesting(false);
+
+  Conv::CombinedTensor input(samples, width, height, maps);
+  Fill(input.data, 0);
+  input.delta.Clear(0);
+  std::vector<Conv::CombinedTensor*> inputs = {&input};
+
+  // The YOLO loss needs ground truth boxes and sample weights
+  Conv::CombinedTensor* label = nullptr;
+  Conv::CombinedTensor* weight = nullptr;
+  std::vector<std::vector<Conv::BoundingBox>> truth_boxes(samples);
+
+  Conv::Layer* layer;
+  if(type.compare("yolo_output") == 0) {
+    layer = new Conv::YOLODynamicOutputLayer(configuration, &class_manager);
+  } else if(type.compare("yolo_loss") == 0) {
+    if(configuration.count("yolo_configuration") != 1 || !configuration["yolo_configuration"].is_object()) {
+      LOGERROR << "Missing YOLO configuration: " << benchmark.dump();
+      return false;
+    }
+    layer = new Conv::YOLOLossLayer(configuration["yolo_configuration"]);
+
+    label = new Conv::CombinedTensor(samples, 1, 1, 1, new Conv::DatasetMetadataPointer[samples]);
+    weight = new Conv::CombinedTensor(samples);
+    weight->data.Clear(1);
+    for(unsigned int s = 0; s < samples; s++) {
+      for(unsigned int b = 0; b < 3; b++) {
+        Conv::BoundingBox box(0.2f + 0.25f * (Conv::datum)b, 0.3f + 0.1f * (Conv::datum)s, 0.2f, 0.3f);
+        box.c = (b + s) % classes;
+        truth_boxes[s].push_back(box);
+      }
+      label->metadata[s] = &truth_boxes[s];
+    }
+    inputs.push_back(label);
+    inputs.push_back(weight);
+  } else {
+    layer = Conv::LayerFactory::ConstructLayer(benchmark);
+  }
+
+  if(layer == nullptr) {
+    LOGERROR << "Cannot construct layer: " << benchmark.dump();
+    return false;
+  }
+
+  std::vector<Conv::CombinedTensor*> outputs;
+  bool connected = layer->CreateOutputs(inputs, outputs) && layer->Connect(inputs, outputs, &net_status);
+  if(!connected) {
+    LOGERROR << "Cannot connect layer to input " << input.data << ": " << benchmark.dump();
+    delete layer;
+    return false;
+  }
+  layer->OnLayerConnect({}, false);
+
+  for(Conv::CombinedTensor* output : outputs)
+    Fill(output->delta, 1);
+
+  // Estimate the work done per pass
+  std::size_t input_elements = input.data.elements(), output_elements = 0, output_pixels = 0;
+  std::size_t weights = 0;
+  for(Conv::CombinedTensor* output : outputs) {
+    output_elements += output->data.elements();
+    output_pixels += output->data.samples() * output->data.width() * output->data.height();
+  }
+  for(Conv::CombinedTensor* parameters : layer->parameters())
+    weights += parameters->data.elements();
+
+  const double forward_flops = weights > 0 ? 2.0 * (double)weights * (double)output_pixels
+    : (double)(input_elements + output_elements);
+  const double backward_flops = weights > 0 ? 2.0 * forward_flops : forward_flops;
+  const double forward_bytes = sizeof(Conv::datum) * (double)(input_elements + output_elements + weights);
+  const double backward_bytes = sizeof(Conv::datum) * (double)(2 * input_elements + output_elements + 2 * weights);
+
+  for(unsigned int w = 0; w < warmup; w++) {
+    layer->FeedForward();
+    layer->BackPropagate();
+  }
+  Synchronize();
+
+  std::vector<double> forward_seconds = Time([layer] { layer->FeedForward(); }, repeat);
+  std::vector<double> backward_seconds = Time([layer] { layer->BackPropagate(); }, repeat);
+
+  result = Conv::JSON::object();
+  if(benchmark.count("name") == 1)
+    result["name"] = benchmark["name"];
+  result["layer"] = benchmark["layer"];
+  result["input"] = benchmark["input"];
+  result["description"] = layer->GetLayerDescription();
+  result["forward"] = Summarize(forward_seconds, forward_flops, forward_bytes);
+  result["backward"] = Summarize(backward_seconds, backward_flops, backward_bytes);
+
+  LOGINFO << layer->GetLayerDescription() << " on " << input.data << ": forward "
+    << result["forward"]["median_ms"].get<double>() << " ms, backward "
+    << result["backward"]["median_ms"].get<double>() << " ms (median)";
+
+  delete layer;
+  for(Conv::CombinedTensor* output : outputs)
+    delete output;
+  if(label != nullptr) {
+    delete[] label->metadata;
+    delete label;
+  }
+  delete weight;
+  return true;
+}
+
+int main(int argc, char** argv) {
+  std::string benchmark_fname;
+  std::string options;
+  for(int a = 1; a < argc; a++) {
+    std::string argument(argv[a]);
+    if(argument.find('=') != std::string::npos)
+      options += argument + " ";
+    else
+      benchmark_fname = argument;
+  }
+
+  unsigned int warmup = 3, repeat = 20;
+  std::string output_fname;
+  Conv::ParseCountIfPossible(options, "warmup", warmup);
+  Conv::ParseCountIfPossible(options, "repeat", repeat);
+  Conv::ParseStringParamIfPossible(options, "output", output_fname);
+  repeat = std::max(repeat, 1u);
+
+  // Keep stdout clean for the results
+  Conv::System::Init(output_fname.length() > 0 ? -1 : 0);
+
+  Conv::JSON benchmarks;
+  if(benchmark_fname.length() > 0) {
+    std::ifstream benchmark_file(benchmark_fname, std::ios::in);
+    if(!benchmark_file.good()) {
+      LOGERROR << "USAGE: " << argv[0] << " [<benchmark file>] [warmup=<n>] [repeat=<n>] [output=<file>]";
+      LOGERROR << "Cannot open benchmark file: " << benchmark_fname;
+      LOGEND;
+      return -1;
+    }
+    benchmarks = Conv::JSON::parse(benchmark_file);
+  } else {
+    benchmarks = Conv::JSON::parse(default_benchmarks);
+  }
+
+  if(!benchmarks.is_array()) {
+    LOGERROR << "The benchmark file must contain an array of layer descriptors";
+    LOGEND;
+    return -1;
+  }
+
+  Conv::JSON results = Conv::JSON::object();
+  results["warmup"] = warmup;
+  results["repeat"] = repeat;
+  results["benchmarks"] = Conv::JSON::array();
+
+  bool failed = false;
+  for(Conv::JSON& benchmark : benchmarks) {
+    Conv::JSON result;
+    if(RunBenchmark(benchmark, warmup, repeat, result))
+      results["benchmarks"].push_back(result);
+    else
+      failed = true;
+  }
+
+  if(output_fname.length() > 0) {
+    std::ofstream output_file(output_fname, std::ios::out);
+    if(!output_file.good()) {
+      FATAL("Cannot open output file: " << output_fname);
+    }
+    output_file << results.dump(2) << std::endl;
+  } else {
+    std::cout << results.dump(2) << std::endl;
+  }
+
+  LOGEND;
+  return failed ? -1 : 0;
+}
@@ -597,16 +597,13 @@ bool parseCommand (Conv::ClassManager& class_manager, Conv::SegmentSetInputLayer
     } else if(set_command.compare(0, 7, "novelty") == 0) {
       std::string source_set_name;
       std::string policy_str = "default";
+      unsigned int compress = 0;
       Conv::ParseStringParamIfPossible(set_command, "name", source_set_name);
       Conv::ParseStringParamIfPossible(set_command, "policy", policy_str);
+      Conv::ParseCountIfPossible(set_command, "compress", compress);
       Conv::SegmentSet *source_set = findSegmentSet(input_layer, source_set_name);
       LOGDEBUG << "Running novelty detection for policy \"" << policy_str << "\"...";
 
-      std::stringstream ss;
-      ss << "log/novelty-" << policy_str;
-      std::ofstream log_file(ss.str(), std::ios::out);
-
-
       if(source_set == nullptr) {
         LOGWARN << "Could not find SegmentSet \"" << source_set_name << "\"";
       } else {
@@ -616,6 +613,15 @@ bool parseCommand (Conv::ClassManager& class_manager, Conv::SegmentSetInputLayer
         Conv::DatasetMetadataPointer* predicted_metadata = prediction_buffer.combined_tensor->metadata;
         unsigned int batch_size = prediction_buffer.combined_tensor->data.samples();
 
+        std::vector<std::string> segment_names;
+        for(unsigned int s = 0; s < source_set->GetSegmentCount(); s++)
+          segment_names.push_back(source_set->GetSegment(s)->name);
+
+        std::stringstream ss;
+        ss << "log/novelty-" << policy_str;
+        Conv::PredictionDumpWriter log_file(ss.str(), prediction_buffer.combined_tensor->data,
+                                            &class_manager, segment_names, compress != 0);
+
         input_layer->ForceWeightsZero();
         graph.SetIsTesting(true);
 
@@ -674,11 +680,7 @@ bool parseCommand (Conv::ClassManager& class_manager, Conv::SegmentSetInputLayer
 
               // std::cout << "." << std::flush;
               segment_score += sample_score;
-              log_file << segment->name << ";" << sample_score;
-              for(unsigned int i=0; i < prediction_buffer.combined_tensor->data.elements(); i++) {
-                Conv::datum value = prediction_buffer.combined_tensor->data.data_ptr_const()[i];
-                log_file << ";" << value;
-              }
+              log_file.WriteRow(s, sample + bindex, sample_score, prediction_buffer.combined_tensor->data, bindex);
             }
           }
           segment_score /= (Conv::datum)segment->GetSampleCount();
@@ -686,7 +688,7 @@ bool parseCommand (Conv::ClassManager& class_manager, Conv::SegmentSetInputLayer
           LOGINFO << "Score for segment \"" << segment->name << "\": " << segment->score;
         }
         LOGINFO << "Finished scoring SegmentSet \"" << source_set->name << "\"";
-        log_file.close();
+        log_file.Close();
       }
     } else if(set_command.compare(0, 4, "hypo") == 0) {
       std::string source_set_name;
@@ -1049,13 +1051,16 @@ void saveModel(Conv::NetGraph &graph, const std::string &command) {
   std::string param_file_name;
   Conv::ParseStringParamIfPossible (command, "file", param_file_name);
 
+  std::string format = "parex";
+  Conv::ParseStringParamIfPossible (command, "format", format);
+
   if (param_file_name.length() == 0) {
       LOGERROR << "Filename needed!";
     } else {
       std::ofstream param_file (param_file_name, std::ios_base::out | std::ios_base::binary);
 
       if (param_file.good()) {
-        graph.SerializeParameters (param_file);
+        graph.SerializeParameters (param_file, format.compare("indexed") == 0);
         LOGINFO << "Written parameters to " << param_file_name;
       } else {
         LOGERROR << "Cannot open " << param_file_name;
@@ -1072,16 +1077,9 @@ void loadModel(Conv::NetGraph &graph, const std::string &command) {
   if (param_file_name.length() == 0) {
       LOGERROR << "Filename needed!";
     } else {
-      std::ifstream param_file (param_file_name, std::ios_base::in | std::ios_base::binary);
-
-      if (param_file.good()) {
-        graph.DeserializeParameters (param_file);
+      if (graph.LoadParameters (param_file_name)) {
         LOGINFO << "Loaded parameters from " << param_file_name;
-      } else {
-        LOGERROR << "Cannot open " << param_file_name;
       }
-
-      param_file.close();
     }
 }
 
@@ -1252,8 +1250,8 @@ void help() {
       << "    Load parameters from a file for all layers up to l (default: all layers)\n\n"
 			<< "  graph file=<path> {test|train}\n"
 			<< "    Write the network architecture for training/testing to a file in graphviz format\n\n"
-      << "  save file=<path>\n"
-      << "    Save parameters to a file\n\n"
+      << "  save file=<path> [format=indexed]\n"
+      << "    Save parameters to a file, optionally in the indexed format that loads via mmap\n\n"
       << "  tstat enable=<1|0>\n"
       << "    Enable statistics during training (1: yes, 0: no)\n";
 }
@@ -0,0 +1,202 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file cn24-train-bench.cpp
+ * @brief Measures the training throughput of nets on synthetic data.
+ *
+ * The suite file is a JSON array of runs, each with a "name", a "net"
+ * configuration file (relative to the suite file) and a "dataset"
+ * descriptor, usually a synthetic dataset that is generated in memory.
+ * An optional "hyperparameters" object overrides those of the net.
+ *
+ * Every run trains for warmup=<n> iterations, then for iterations=<n>
+ * timed iterations. The results (samples per second, the time spent
+ * loading samples, in the forward and backward passes and in the
+ * optimizer, and the peak resident set size of the process so far) are
+ * written as JSON to output=<file> or to stdout.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
+
+#ifdef BUILD_POSIX
+#include <sys/resource.h>
+#endif
+
+#include <cn24.h>
+#include <private/ConfigParsing.h>
+
+const unsigned int RANDOM_SEED = 93023;
+
+long PeakResidentSetSize() {
+#ifdef BUILD_POSIX
+  struct rusage usage;
+  if(getrusage(RUSAGE_SELF, &usage) == 0)
+    return usage.ru_maxrss;
+#endif
+  return 0;
+}
+
+bool RunBenchmark(Conv::JSON& run, const std::string& suite_directory, unsigned int warmup, unsigned int iterations, Conv::JSON& result);
+
+int main(int argc, char** argv) {
+  if(argc < 2) {
+    LOGERROR << "USAGE: " << argv[0] << " <suite file> [iterations=<n>] [warmup=<n>] [output=<file>]";
+    LOGEND;
+    return -1;
+  }
+
+  std::string suite_fname(argv[1]);
+  std::string options;
+  for(int a = 2; a < argc; a++)
+    options += std::string(argv[a]) + " ";
+
+  unsigned int iterations = 20, warmup = 2;
+  std::string output_fname;
+  Conv::ParseCountIfPossible(options, "iterations", iterations);
+  Conv::ParseCountIfPossible(options, "warmup", warmup);
+  Conv::ParseStringParamIfPossible(options, "output", output_fname);
+  iterations = std::max(iterations, 1u);
+
+  // Keep stdout clean for the results
+  Conv::System::Init(output_fname.length() > 0 ? -1 : 0);
+
+  std::ifstream suite_file(suite_fname, std::ios::in);
+  if(!suite_file.good()) {
+    FATAL("Cannot open suite file: " << suite_fname);
+  }
+  Conv::JSON suite = Conv::JSON::parse(suite_file);
+  if(!suite.is_array()) {
+    FATAL("The suite file must contain an array of runs");
+  }
+
+  std::size_t slash = suite_fname.rfind("/");
+  std::string suite_directory = slash == std::string::npos ? "" : suite_fname.substr(0, slash + 1);
+
+  Conv::JSON results = Conv::JSON::object();
+  results["warmup"] = warmup;
+  results["iterations"] = iterations;
+  results["runs"] = Conv::JSON::array();
+
+  bool failed = false;
+  for(Conv::JSON& run : suite) {
+    Conv::JSON result;
+    if(RunBenchmark(run, suite_directory, warmup, iterations, result))
+      results["runs"].push_back(result);
+    else
+      failed = true;
+  }
+
+  if(output_fname.length() > 0) {
+    std::ofstream output_file(output_fname, std::ios::out);
+    if(!output_file.good()) {
+      FATAL("Cannot open output file: " << output_fname);
+    }
+    output_file << results.dump(2) << std::endl;
+  } else {
+    std::cout << results.dump(2) << std::endl;
+  }
+
+  LOGEND;
+  return failed ? -1 : 0;
+}
+
+bool TrainAndMeasure(Conv::JSON& run, Conv::JSONNetGraphFactory& factory, Conv::Dataset* dataset,
+                     Conv::ClassManager* class_manager, unsigned int warmup, unsigned int iterations, Conv::JSON& result) {
+  unsigned int batch_size_parallel = 1, batch_size_sequential = 1;
+  Conv::JSON hyperparameters = factory.GetHyperparameters();
+  if(hyperparameters.count("batch_size_parallel") == 1 && hyperparameters["batch_size_parallel"].is_number())
+    batch_size_parallel = hyperparameters["batch_size_parallel"];
+  if(hyperparameters.count("batch_size_sequential") == 1 && hyperparameters["batch_size_sequential"].is_number())
+    batch_size_sequential = hyperparameters["batch_size_sequential"];
+
+  Conv::NetGraph graph;
+  Conv::DatasetInputLayer* data_layer = new Conv::DatasetInputLayer(factory.GetDataInput(), dataset,
+    batch_size_parallel, 0.5, RANDOM_SEED + 1);
+  Conv::NetGraphNode* input_node = new Conv::NetGraphNode(data_layer);
+  input_node->is_input = true;
+  graph.AddNode(input_node);
+
+  if(!factory.AddLayers(graph, class_manager)) {
+    LOGERROR << "Graph completeness test failed for " << run["net"].get<std::string>();
+    return false;
+  }
+  graph.Initialize();
+  graph.InitializeWeights();
+
+  Conv::Trainer trainer(graph, hyperparameters);
+  trainer.SetStatsDuringTraining(false);
+
+  if(warmup > 0) {
+    trainer.settings()["epoch_iterations"] = warmup;
+    trainer.Train(1, false);
+  }
+
+  trainer.settings()["epoch_iterations"] = iterations;
+  trainer.ResetPhaseTimes();
+  auto start_time = std::chrono::steady_clock::now();
+  trainer.Train(1, false);
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+
+  const double samples = (double)iterations * (double)batch_size_parallel * (double)batch_size_sequential;
+  const Conv::TrainerPhaseTimes& phase_times = trainer.phase_times();
+
+  result = Conv::JSON::object();
+  if(run.count("name") == 1)
+    result["name"] = run["name"];
+  result["net"] = run["net"];
+  result["dataset"] = dataset->GetName();
+  result["batch_size"] = batch_size_parallel * batch_size_sequential;
+  result["seconds"] = elapsed.count();
+  result["samples_per_second"] = samples / elapsed.count();
+  result["phase_seconds"] = {{"load", phase_times.load}, {"forward", phase_times.forward},
+    {"backward", phase_times.backward}, {"optimizer", phase_times.optimizer}};
+  result["peak_rss_kb"] = PeakResidentSetSize();
+
+  LOGINFO << (run.count("name") == 1 ? run["name"].get<std::string>() : run["net"].get<std::string>()) << ": "
+    << result["samples_per_second"].get<double>() << " samples/s";
+
+  return true;
+}
+
+bool RunBenchmark(Conv::JSON& run, const std::string& suite_directory, unsigned int warmup, unsigned int iterations, Conv::JSON& result) {
+  if(run.count("net") != 1 || !run["net"].is_string() || run.count("dataset") != 1 || !run["dataset"].is_object()) {
+    LOGERROR << "A run needs a net configuration file and a dataset: " << run.dump();
+    return false;
+  }
+
+  std::string net_fname = run["net"];
+  if(net_fname.length() > 0 && net_fname[0] != '/')
+    net_fname = suite_directory + net_fname;
+  std::ifstream net_file(net_fname, std::ios::in);
+  if(!net_file.good()) {
+    LOGERROR << "Cannot open net configuration file: " << net_fname;
+    return false;
+  }
+
+  Conv::JSON net_json = Conv::JSON::parse(net_file);
+  // The example nets predate error layer selection
+  if(net_json["net"].count("error_layer") == 0)
+    net_json["net"]["error_layer"] = "square";
+  if(run.count("hyperparameters") == 1 && run["hyperparameters"].is_object()) {
+    for(Conv::JSON::iterator it = run["hyperparameters"].begin(); it != run["hyperparameters"].end(); ++it)
+      net_json["hyperparameters"][it.key()] = it.value();
+  }
+  Conv::JSONNetGraphFactory factory(net_json, RANDOM_SEED);
+
+  Conv::ClassManager class_manager;
+  Conv::Dataset* dataset = Conv::JSONDatasetFactory::ConstructDataset(run["dataset"], &class_manager);
+
+  // The graph has to be gone before its dataset is deleted
+  bool success = TrainAndMeasure(run, factory, dataset, &class_manager, warmup, iterations, result);
+  delete dataset;
+  return success;
+}
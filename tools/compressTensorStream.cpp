@@ -20,10 +20,10 @@ int main(int argc, char** argv) {
   std::string input_file_name(argv[1]);
   std::string output_file_name(argv[2]);
   
-  std::ifstream input_tensor_stream(input_file_name, std::ios::in | std::ios::binary);
+  Conv::TensorFile input_tensor_file(input_file_name);
   std::ofstream output_tensor_stream(output_file_name, std::ios::out | std::ios::binary);
   
-  if(!input_tensor_stream.good())
+  if(!input_tensor_file.IsValid())
     FATAL("Cannot open " << input_file_name);
   
   if(!output_tensor_stream.good())
@@ -37,8 +37,8 @@ int main(int argc, char** argv) {
   uint64_t magic = CN24_CTS_MAGIC;
   output_tensor_stream.write((char*)&magic, sizeof(uint64_t)/sizeof(char));
   
-  while(!input_tensor_stream.eof()) {
-    tensor.Deserialize(input_tensor_stream);
+  for(unsigned int t = 0; t < input_tensor_file.GetTensorCount(); t++) {
+    input_tensor_file.Load(t, tensor);
     
     LOGDEBUG << "Input tensor: " << tensor;
     
@@ -62,8 +62,6 @@ int main(int argc, char** argv) {
     LOGINFO << "Ratio: " << 100.0 * (double)ctensor.compressed_length() / (double)(tensor.elements() * sizeof(Conv::datum)/sizeof(char)) << "%" << std::flush;
     compressed_total += ctensor.compressed_length();
     uncompressed_total += tensor.elements() * sizeof(Conv::datum)/sizeof(char);
-    
-    input_tensor_stream.peek();
   }
   LOGINFO << "Overall ratio: " << 100.0 * (double)compressed_total / (double)uncompressed_total << "%";
   LOGINFO << "Uncompressed: " << uncompressed_total;
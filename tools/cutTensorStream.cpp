@@ -22,46 +22,44 @@ int main(int argc, char* argv[]) {
   std::string s_tcnt(argv[2]);
   unsigned int t_count = atoi(s_tcnt.c_str());
 
-  // Open tensor stream
-  std::ifstream file_in(std::string(argv[1]), std::ios::in | std::ios::binary);
-
-  // Seek until eof to count tensors
-  Conv::Tensor tensor;
-  unsigned int tensors_in_file = 0;
-  for (; !file_in.eof(); tensors_in_file++) {
-    tensor.Deserialize(file_in);
-    file_in.peek();
-    LOGINFO << "Tensor loaded: " << tensor;
-  }
+  // Open tensor stream, this only reads the tensor sizes
+  Conv::TensorFile* file_in = new Conv::TensorFile(argv[1]);
+  unsigned int tensors_in_file = file_in->GetTensorCount();
 
   // Compare the number of tensors in the stream to the specified output number
   if (tensors_in_file < t_count) {
     LOGERROR << "There are less than " << t_count << " Tensors in the specified file!";
-    file_in.close();
+    delete file_in;
   }
   else if (tensors_in_file == t_count) {
     LOGINFO << "Nothing to do here!";
-    file_in.close();
+    delete file_in;
   }
   else {
-    // Rewind the stream
-    file_in.clear();
-    file_in.seekg(0, std::ios::beg);
-
-    // Read in all tensors
+    // Read in all tensors, without mapping because the file is overwritten
     Conv::Tensor* tensors = new Conv::Tensor[t_count];
     for (unsigned int t = 0; t < t_count; t++)
-      tensors[t].Deserialize(file_in);
+      file_in->Load(t, tensors[t], false);
 
-    // Close the istream, open an ostream
-    file_in.close();
+    // Close the input, open an ostream
+    bool aligned = file_in->IsAligned();
+    delete file_in;
 
+    // Keep the format of the input
     std::ofstream file_out(std::string(argv[1]), std::ios::out | std::ios::binary);
+    Conv::TensorFileWriter* writer = aligned ? new Conv::TensorFileWriter(file_out) : nullptr;
     for (unsigned int t = 0; t < t_count; t++)
     {
-      tensors[t].Serialize(file_out);
+      if (writer != nullptr)
+        writer->Write(tensors[t]);
+      else
+        tensors[t].Serialize(file_out);
       LOGINFO << "Serializing tensor " << t << ": " << tensors[t];
     }
+    if (writer != nullptr) {
+      writer->Finish();
+      delete writer;
+    }
 
     file_out.close();
 
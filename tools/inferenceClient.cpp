@@ -0,0 +1,147 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file inferenceClient.cpp
+ * @brief Sends a single request to an inferenceServer.
+ *
+ * "predict" lets the server load the image and write the output image,
+ * "pixels" decodes the image here and sends the raw pixels instead.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef BUILD_POSIX
+#include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+#include <cn24.h>
+
+std::string AbsolutePath(const std::string& path) {
+#ifdef BUILD_POSIX
+  // The server may run in a different working directory
+  char resolved[PATH_MAX];
+  if(realpath(path.c_str(), resolved) != nullptr)
+    return std::string(resolved);
+  if(path.length() > 0 && path[0] != '/') {
+    char working_directory[PATH_MAX];
+    if(getcwd(working_directory, PATH_MAX) != nullptr)
+      return std::string(working_directory) + "/" + path;
+  }
+#endif
+  return path;
+}
+
+int main (int argc, char* argv[]) {
+  if (argc < 3) {
+    LOGERROR << "USAGE: " << argv[0] << " <socket path> predict|pixels <input image file> [<output image file>]";
+    LOGERROR << "       " << argv[0] << " <socket path> stats|shutdown";
+    LOGEND;
+    return -1;
+  }
+
+  std::string socket_path (argv[1]);
+  std::string command (argv[2]);
+  std::string input_image_fname;
+  std::string output_image_fname;
+  if(argc > 3)
+    input_image_fname = argv[3];
+  if(argc > 4)
+    output_image_fname = argv[4];
+
+  Conv::System::Init(3);
+
+  Conv::LocalSocket connection;
+  if(!connection.Connect(socket_path)) {
+    LOGEND;
+    return -1;
+  }
+
+  bool sent = false;
+  if(command.compare("predict") == 0 && input_image_fname.length() > 0) {
+    std::string request = "predict " + AbsolutePath(input_image_fname);
+    if(output_image_fname.length() > 0)
+      request += " " + AbsolutePath(output_image_fname);
+    sent = connection.WriteLine(request);
+  } else if(command.compare("pixels") == 0 && input_image_fname.length() > 0) {
+    Conv::Tensor image;
+    if(!Conv::BatchPredictor::LoadImage(input_image_fname, image)) {
+      FATAL("Cannot load " << input_image_fname);
+    }
+    std::vector<unsigned char> pixels(image.elements());
+    for(unsigned int y = 0; y < image.height(); y++)
+      for(unsigned int x = 0; x < image.width(); x++)
+        for(unsigned int m = 0; m < image.maps(); m++)
+          pixels[((std::size_t)y * image.width() + x) * image.maps() + m] = UCHAR_FROM_DATUM(*image.data_ptr_const(x, y, m, 0));
+    std::stringstream ss;
+    ss << "pixels " << image.width() << " " << image.height() << " " << image.maps();
+    sent = connection.WriteLine(ss.str()) && connection.Write(&pixels[0], pixels.size());
+  } else if(command.compare("stats") == 0 || command.compare("shutdown") == 0) {
+    sent = connection.WriteLine(command);
+  } else {
+    FATAL("Unknown command: " << command);
+  }
+
+  std::string line;
+  if(!sent || !connection.ReadLine(line)) {
+    FATAL("Server closed the connection");
+  }
+
+  std::stringstream line_stream(line);
+  std::string response;
+  line_stream >> response;
+  if(response.compare("error") == 0) {
+    LOGERROR << line.substr(6);
+    LOGEND;
+    return -1;
+  } else if(response.compare("detections") == 0) {
+    unsigned int count = 0;
+    line_stream >> count;
+    LOGINFO << "Bounding boxes: " << count;
+    for(unsigned int b = 0; b < count && connection.ReadLine(line); b++) {
+      std::string class_name;
+      Conv::datum score, x, y, w, h;
+      std::stringstream box_stream(line);
+      box_stream >> class_name >> score >> x >> y >> w >> h;
+      LOGINFO << "Box\t" << b << ": " << class_name << " (" << score << ")";
+      LOGINFO << "  Center: (" << x << "," << y << ")";
+      LOGINFO << "  Size: (" << w << "x" << h << ")";
+    }
+  } else if(response.compare("segmentation") == 0) {
+    unsigned int width = 0, height = 0;
+    line_stream >> width >> height;
+    std::vector<unsigned char> pixels((std::size_t)width * height * 3);
+    if(pixels.size() > 0 && !connection.Read(&pixels[0], pixels.size())) {
+      FATAL("Server closed the connection");
+    }
+    LOGINFO << "Segmentation: " << width << "x" << height;
+
+    // With "predict", the server has already written the output image
+    if(command.compare("pixels") == 0 && output_image_fname.length() > 0) {
+      Conv::Tensor image(1, width, height, 3);
+      for(unsigned int y = 0; y < height; y++)
+        for(unsigned int x = 0; x < width; x++)
+          for(unsigned int m = 0; m < 3; m++)
+            *image.data_ptr(x, y, m, 0) = DATUM_FROM_UCHAR(pixels[((std::size_t)y * width + x) * 3 + m]);
+      if(!Conv::BatchPredictor::WriteImage(output_image_fname, image)) {
+        FATAL("Cannot write " << output_image_fname);
+      }
+    }
+  } else {
+    LOGINFO << line;
+  }
+
+  LOGEND;
+  return 0;
+}
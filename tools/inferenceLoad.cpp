@@ -0,0 +1,168 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file inferenceLoad.cpp
+ * @brief Sends concurrent requests to an inferenceServer and measures them.
+ *
+ * Every client has its own connection and sends its requests one after the
+ * other, so the number of clients is the number of requests in flight.
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#ifdef BUILD_POSIX
+#include <limits.h>
+#include <stdlib.h>
+#endif
+
+#include <cn24.h>
+#include <private/ConfigParsing.h>
+
+typedef std::chrono::steady_clock Clock;
+
+bool ReadResponse(Conv::LocalSocket& connection) {
+  std::string line;
+  if(!connection.ReadLine(line))
+    return false;
+
+  std::stringstream line_stream(line);
+  std::string response;
+  line_stream >> response;
+  if(response.compare("detections") == 0) {
+    unsigned int count = 0;
+    line_stream >> count;
+    for(unsigned int b = 0; b < count; b++) {
+      if(!connection.ReadLine(line))
+        return false;
+    }
+  } else if(response.compare("segmentation") == 0) {
+    unsigned int width = 0, height = 0;
+    line_stream >> width >> height;
+    std::vector<unsigned char> pixels((std::size_t)width * height * 3);
+    if(pixels.size() > 0 && !connection.Read(&pixels[0], pixels.size()))
+      return false;
+  }
+  return response.compare("error") != 0;
+}
+
+int main (int argc, char* argv[]) {
+  if (argc < 3) {
+    LOGERROR << "USAGE: " << argv[0] << " <socket path> <input image file> [clients=<n>] [requests=<n per client>] [mode=predict|pixels]";
+    LOGEND;
+    return -1;
+  }
+
+  std::string socket_path (argv[1]);
+  std::string input_image_fname (argv[2]);
+  std::string options;
+  for(int a = 3; a < argc; a++)
+    options += std::string(argv[a]) + " ";
+
+  unsigned int clients = 8, requests = 100;
+  std::string mode = "predict";
+  Conv::ParseCountIfPossible(options, "clients", clients);
+  Conv::ParseCountIfPossible(options, "requests", requests);
+  Conv::ParseStringParamIfPossible(options, "mode", mode);
+
+  Conv::System::Init(3);
+
+  // Prepare the request once, all clients send the same image
+  std::string request_line;
+  std::vector<unsigned char> pixels;
+  if(mode.compare("pixels") == 0) {
+    Conv::Tensor image;
+    if(!Conv::BatchPredictor::LoadImage(input_image_fname, image)) {
+      FATAL("Cannot load " << input_image_fname);
+    }
+    pixels.resize(image.elements());
+    for(unsigned int y = 0; y < image.height(); y++)
+      for(unsigned int x = 0; x < image.width(); x++)
+        for(unsigned int m = 0; m < image.maps(); m++)
+          pixels[((std::size_t)y * image.width() + x) * image.maps() + m] = UCHAR_FROM_DATUM(*image.data_ptr_const(x, y, m, 0));
+    std::stringstream ss;
+    ss << "pixels " << image.width() << " " << image.height() << " " << image.maps();
+    request_line = ss.str();
+  } else {
+#ifdef BUILD_POSIX
+    char resolved[PATH_MAX];
+    if(realpath(input_image_fname.c_str(), resolved) != nullptr)
+      input_image_fname = resolved;
+#endif
+    request_line = "predict " + input_image_fname;
+  }
+
+  std::vector<std::vector<double>> latencies(clients);
+  std::vector<unsigned int> errors(clients, 0);
+  std::vector<std::thread> threads;
+
+  LOGINFO << "Sending " << requests << " requests from each of " << clients << " clients...";
+  const Clock::time_point start = Clock::now();
+  for(unsigned int c = 0; c < clients; c++) {
+    threads.push_back(std::thread([&, c] {
+      Conv::LocalSocket connection;
+      if(!connection.Connect(socket_path)) {
+        errors[c] = requests;
+        return;
+      }
+      for(unsigned int r = 0; r < requests; r++) {
+        const Clock::time_point sent = Clock::now();
+        bool success = connection.WriteLine(request_line);
+        if(success && pixels.size() > 0)
+          success = connection.Write(&pixels[0], pixels.size());
+        if(success && ReadResponse(connection)) {
+          std::chrono::duration<double> latency = Clock::now() - sent;
+          latencies[c].push_back(latency.count());
+        } else {
+          errors[c]++;
+        }
+      }
+    }));
+  }
+  for(std::thread& thread : threads)
+    thread.join();
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+
+  std::vector<double> all_latencies;
+  unsigned int total_errors = 0;
+  for(unsigned int c = 0; c < clients; c++) {
+    all_latencies.insert(all_latencies.end(), latencies[c].begin(), latencies[c].end());
+    total_errors += errors[c];
+  }
+  std::sort(all_latencies.begin(), all_latencies.end());
+
+  double latency_sum = 0;
+  for(double latency : all_latencies)
+    latency_sum += latency;
+  auto percentile = [&all_latencies](double p) {
+    return all_latencies.size() > 0 ? 1000.0 * all_latencies[(std::size_t)(p * (double)(all_latencies.size() - 1))] : 0.0;
+  };
+
+  LOGINFO << "Requests: " << all_latencies.size() << ", errors: " << total_errors;
+  LOGINFO << "Throughput: " << (double)all_latencies.size() / elapsed.count() << " images/s";
+  if(all_latencies.size() > 0) {
+    LOGINFO << "Latency (ms): mean " << 1000.0 * latency_sum / (double)all_latencies.size()
+      << ", p50 " << percentile(0.5) << ", p99 " << percentile(0.99) << ", max " << 1000.0 * all_latencies.back();
+  }
+
+  // Also show the server's view
+  Conv::LocalSocket connection;
+  std::string line;
+  if(connection.Connect(socket_path) && connection.WriteLine("stats") && connection.ReadLine(line)) {
+    LOGINFO << "Server " << line;
+  }
+
+  LOGEND;
+  return total_errors > 0 ? -1 : 0;
+}
@@ -0,0 +1,423 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file inferenceServer.cpp
+ * @brief Keeps a pretrained net loaded and answers requests on a local socket.
+ *
+ * Concurrent requests are collected into one batch. A batch is run as soon
+ * as it is full or the oldest request has waited for the maximum wait time.
+ * With workers=<n>, up to n batches run at the same time on copies of the
+ * network that share one set of parameters.
+ *
+ * Requests (one line each, paths must not contain whitespace):
+ *   predict <image file> [<output image file>]
+ *   pixels <width> <height> <maps> [<output image file>]
+ *     followed by width*height*maps bytes, row by row, maps interleaved
+ *   stats
+ *   shutdown
+ *
+ * Responses:
+ *   error <message>
+ *   detections <n>, followed by n lines: <class> <score> <x> <y> <w> <h>
+ *   class <class> <score>
+ *   segmentation <width> <height>, followed by width*height*3 RGB bytes
+ *   stats <key>=<value> ...
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <cn24.h>
+#include <private/ConfigParsing.h>
+
+typedef std::chrono::steady_clock Clock;
+
+struct Request {
+  Conv::Tensor image;
+  Clock::time_point arrival;
+
+  bool done = false;
+  bool success = false;
+  std::vector<Conv::BoundingBox> boxes;
+  unsigned int class_id = 0;
+  Conv::datum score = 0;
+  Conv::Tensor segmentation;
+};
+
+class RequestStatistics {
+public:
+  RequestStatistics() : start_(Clock::now()) {}
+
+  void AddBatch(unsigned int size, double forward_seconds) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    batches_++;
+    batched_requests_ += size;
+    forward_seconds_ += forward_seconds;
+  }
+
+  void AddRequest(bool success, double latency_seconds) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(!success) {
+      errors_++;
+      return;
+    }
+    requests_++;
+    latency_seconds_ += latency_seconds;
+    if(latency_seconds > max_latency_seconds_)
+      max_latency_seconds_ = latency_seconds;
+    // Percentiles are calculated over the most recent requests
+    if(recent_latencies_.size() < recent_count)
+      recent_latencies_.push_back(latency_seconds);
+    else
+      recent_latencies_[requests_ % recent_count] = latency_seconds;
+  }
+
+  std::string Format() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::chrono::duration<double> uptime = Clock::now() - start_;
+    std::vector<double> sorted(recent_latencies_);
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&sorted](double p) {
+      return sorted.size() > 0 ? 1000.0 * sorted[(std::size_t)(p * (double)(sorted.size() - 1))] : 0.0;
+    };
+
+    std::stringstream ss;
+    ss << "requests=" << requests_ << " errors=" << errors_ << " batches=" << batches_;
+    ss << " mean_batch=" << (batches_ > 0 ? (double)batched_requests_ / (double)batches_ : 0.0);
+    ss << " uptime_s=" << uptime.count();
+    ss << " images_per_s=" << (uptime.count() > 0 ? (double)requests_ / uptime.count() : 0.0);
+    ss << " forward_mean_ms=" << (batches_ > 0 ? 1000.0 * forward_seconds_ / (double)batches_ : 0.0);
+    ss << " latency_mean_ms=" << (requests_ > 0 ? 1000.0 * latency_seconds_ / (double)requests_ : 0.0);
+    ss << " latency_p50_ms=" << percentile(0.5);
+    ss << " latency_p99_ms=" << percentile(0.99);
+    ss << " latency_max_ms=" << 1000.0 * max_latency_seconds_;
+    return ss.str();
+  }
+
+private:
+  static const std::size_t recent_count = 4096;
+
+  std::mutex mutex_;
+  Clock::time_point start_;
+  unsigned long requests_ = 0, errors_ = 0, batches_ = 0, batched_requests_ = 0;
+  double forward_seconds_ = 0, latency_seconds_ = 0, max_latency_seconds_ = 0;
+  std::vector<double> recent_latencies_;
+};
+
+class InferenceServer {
+public:
+  InferenceServer(std::vector<Conv::BatchPredictor*>& predictors, Conv::ClassManager& class_manager, unsigned int max_wait_ms)
+    : predictors_(predictors), class_manager_(class_manager), queue_(std::chrono::milliseconds(max_wait_ms)) {}
+
+  /**
+   * @brief Collects requests into batches for one of the predictors until
+   *   the server is shut down
+   */
+  void RunBatches(unsigned int worker) {
+    Conv::BatchPredictor& predictor = *predictors_[worker];
+    const unsigned int batch_size = predictor.GetBatchSize();
+    std::vector<Request*> batch;
+    while(queue_.PopBatch(batch, batch_size)) {
+      // Another worker may have taken the requests
+      if(batch.size() > 0)
+        RunBatch(predictor, batch);
+    }
+
+    // Fail everything that is still waiting
+    queue_.Drain(batch);
+    std::lock_guard<std::mutex> lock(done_mutex_);
+    for(Request* request : batch)
+      request->done = true;
+    done_condition_.notify_all();
+  }
+
+  /**
+   * @brief Answers requests on one connection until it is closed
+   */
+  void HandleConnection(int descriptor) {
+    Conv::LocalSocket connection(descriptor);
+    std::string line;
+    while(connection.ReadLine(line)) {
+      std::stringstream line_stream(line);
+      std::string command;
+      line_stream >> command;
+
+      if(command.compare("stats") == 0) {
+        connection.WriteLine("stats " + statistics_.Format());
+      } else if(command.compare("shutdown") == 0) {
+        // Answer first, the process may exit as soon as the workers stop
+        connection.WriteLine("stats " + statistics_.Format());
+        Stop();
+        return;
+      } else if(command.compare("predict") == 0 || command.compare("pixels") == 0) {
+        Request request;
+        request.arrival = Clock::now();
+        std::string output_fname, error;
+        bool success = false;
+
+        if(command.compare("predict") == 0) {
+          std::string input_fname;
+          line_stream >> input_fname >> output_fname;
+          success = Conv::BatchPredictor::LoadImage(input_fname, request.image);
+          if(!success)
+            error = "Cannot load " + input_fname;
+        } else {
+          unsigned int width = 0, height = 0, maps = 0;
+          line_stream >> width >> height >> maps >> output_fname;
+          const std::size_t length = (std::size_t)width * height * maps;
+          if(length == 0 || length > max_pixel_bytes) {
+            // The payload cannot be skipped safely, give up on the connection
+            connection.WriteLine("error Invalid image size");
+            return;
+          }
+          std::vector<unsigned char> pixels(length);
+          if(!connection.Read(&pixels[0], length))
+            return;
+          request.image.Resize(1, width, height, maps);
+          for(unsigned int y = 0; y < height; y++)
+            for(unsigned int x = 0; x < width; x++)
+              for(unsigned int m = 0; m < maps; m++)
+                *request.image.data_ptr(x, y, m, 0) = DATUM_FROM_UCHAR(pixels[((std::size_t)y * width + x) * maps + m]);
+          success = true;
+        }
+
+        if(success) {
+          Enqueue(request);
+          success = request.success;
+          if(!success)
+            error = "Cannot predict image of size " + std::to_string(request.image.width()) + "x"
+              + std::to_string(request.image.height()) + "x" + std::to_string(request.image.maps());
+        }
+        std::chrono::duration<double> latency = Clock::now() - request.arrival;
+        statistics_.AddRequest(success, latency.count());
+
+        if(!success) {
+          if(!connection.WriteLine("error " + error))
+            return;
+        } else if(!WriteResult(connection, request, output_fname)) {
+          return;
+        }
+      } else {
+        if(!connection.WriteLine("error Unknown command: " + command))
+          return;
+      }
+    }
+  }
+
+  void Stop() {
+    queue_.Close();
+  }
+
+  bool IsStopping() {
+    return queue_.IsClosed();
+  }
+
+  RequestStatistics& GetStatistics() { return statistics_; }
+
+private:
+  static const std::size_t max_pixel_bytes = 256 * 1024 * 1024;
+
+  void Enqueue(Request& request) {
+    if(!queue_.Push(&request, request.arrival))
+      return;
+    std::unique_lock<std::mutex> lock(done_mutex_);
+    done_condition_.wait(lock, [&request] { return request.done; });
+  }
+
+  void RunBatch(Conv::BatchPredictor& predictor, std::vector<Request*>& batch) {
+    const Clock::time_point forward_start = Clock::now();
+    std::vector<bool> valid(batch.size());
+    for(unsigned int sample = 0; sample < predictor.GetBatchSize(); sample++) {
+      if(sample < batch.size())
+        valid[sample] = predictor.SetSample(sample, batch[sample]->image);
+      else
+        predictor.ClearSample(sample);
+    }
+
+    // Don't run the network for a batch of invalid images
+    if(std::find(valid.begin(), valid.end(), true) != valid.end())
+      predictor.Predict();
+
+    for(unsigned int sample = 0; sample < batch.size(); sample++) {
+      Request* request = batch[sample];
+      request->success = valid[sample];
+      if(!valid[sample])
+        continue;
+      const unsigned int width = request->image.width(), height = request->image.height();
+      switch(predictor.GetTask()) {
+        case Conv::SEMANTIC_SEGMENTATION:
+          predictor.GetSegmentation(sample, width, height, request->segmentation);
+          break;
+        case Conv::DETECTION:
+          predictor.GetDetections(sample, width, height, request->boxes);
+          break;
+        case Conv::CLASSIFICATION:
+          request->class_id = predictor.GetClass(sample, request->score);
+          break;
+      }
+    }
+    std::chrono::duration<double> forward_time = Clock::now() - forward_start;
+    statistics_.AddBatch((unsigned int)batch.size(), forward_time.count());
+
+    std::lock_guard<std::mutex> lock(done_mutex_);
+    for(Request* request : batch)
+      request->done = true;
+    done_condition_.notify_all();
+  }
+
+  bool WriteResult(Conv::LocalSocket& connection, Request& request, const std::string& output_fname) {
+    std::stringstream ss;
+    switch(predictors_[0]->GetTask()) {
+      case Conv::SEMANTIC_SEGMENTATION: {
+        Conv::Tensor& image = request.segmentation;
+        if(output_fname.length() > 0 && !Conv::BatchPredictor::WriteImage(output_fname, image))
+          return connection.WriteLine("error Cannot write " + output_fname);
+        std::vector<unsigned char> pixels(image.width() * image.height() * 3);
+        for(unsigned int y = 0; y < image.height(); y++)
+          for(unsigned int x = 0; x < image.width(); x++)
+            for(unsigned int m = 0; m < 3; m++)
+              pixels[((std::size_t)y * image.width() + x) * 3 + m] = UCHAR_FROM_DATUM(*image.data_ptr_const(x, y, m, 0));
+        ss << "segmentation " << image.width() << " " << image.height();
+        return connection.WriteLine(ss.str()) && connection.Write(&pixels[0], pixels.size());
+      }
+      case Conv::DETECTION:
+        ss << "detections " << request.boxes.size() << "\n";
+        for(const Conv::BoundingBox& box : request.boxes) {
+          ss << class_manager_.GetClassInfoById(box.c).first << " " << box.score << " " << box.x << " " << box.y
+            << " " << box.w << " " << box.h << "\n";
+        }
+        return connection.Write(ss.str().c_str(), ss.str().length());
+      case Conv::CLASSIFICATION:
+        ss << "class " << class_manager_.GetClassInfoById(request.class_id).first << " " << request.score;
+        return connection.WriteLine(ss.str());
+    }
+    return false;
+  }
+
+  std::vector<Conv::BatchPredictor*> predictors_;
+  Conv::ClassManager& class_manager_;
+  RequestStatistics statistics_;
+  Conv::BatchQueue<Request*> queue_;
+
+  std::mutex done_mutex_;
+  std::condition_variable done_condition_;
+};
+
+int main (int argc, char* argv[]) {
+  if (argc < 5) {
+    LOGERROR << "USAGE: " << argv[0] << " <dataset config file> <net config file> <net parameter file> <socket path> [batch=<n>] [wait=<ms>] [width=<max width>] [height=<max height>] [workers=<n>]";
+    LOGEND;
+    return -1;
+  }
+
+  // Capture command line arguments
+  std::string socket_path (argv[4]);
+  std::string param_tensor_fname (argv[3]);
+  std::string net_config_fname (argv[2]);
+  std::string dataset_config_fname (argv[1]);
+  std::string options;
+  for(int a = 5; a < argc; a++)
+    options += std::string(argv[a]) + " ";
+
+  unsigned int batch_size = 8, max_wait_ms = 5, max_width = 512, max_height = 512, workers = 1;
+  Conv::ParseCountIfPossible(options, "batch", batch_size);
+  Conv::ParseCountIfPossible(options, "wait", max_wait_ms);
+  Conv::ParseCountIfPossible(options, "width", max_width);
+  Conv::ParseCountIfPossible(options, "height", max_height);
+  Conv::ParseCountIfPossible(options, "workers", workers);
+  workers = std::max(workers, 1u);
+
+  // Initialize CN24
+  Conv::System::Init(3);
+
+  // Open network and dataset configuration files
+  std::ifstream net_config_file(net_config_fname,std::ios::in);
+  std::ifstream dataset_config_file(dataset_config_fname,std::ios::in);
+
+  if(!net_config_file.good()) {
+    FATAL("Cannot open net configuration file!");
+  }
+  if(!dataset_config_file.good()) {
+    FATAL("Cannot open dataset configuration file!");
+  }
+
+  // Parse network configuration file
+  Conv::JSON net_json = Conv::JSON::parse(net_config_file);
+  net_json["net"]["error_layer"] = "no";
+  Conv::JSONNetGraphFactory* factory = new Conv::JSONNetGraphFactory(net_json);
+
+  // Parse dataset configuration file
+  Conv::JSON dataset_json = Conv::JSON::parse(dataset_config_file);
+  // Remove actual data to avoid loading times
+  dataset_json["data"] = Conv::JSON::array();
+
+  // Connection threads may outlive main, so the server is never deleted
+  Conv::ClassManager* class_manager = new Conv::ClassManager();
+  Conv::Dataset* dataset = Conv::JSONDatasetFactory::ConstructDataset(dataset_json, class_manager);
+
+  std::vector<Conv::BatchPredictor*> predictors;
+  predictors.push_back(new Conv::BatchPredictor(factory, dataset, class_manager, batch_size, max_width, max_height));
+  if(!predictors[0]->LoadParameters(param_tensor_fname)) {
+    FATAL("Cannot load param tensor file!");
+  }
+
+  // The other workers only need their own buffers
+  for(unsigned int w = 1; w < workers; w++) {
+    predictors.push_back(new Conv::BatchPredictor(factory, dataset, class_manager, batch_size, max_width, max_height));
+    if(!predictors[w]->ShareParameters(*predictors[0])) {
+      FATAL("Cannot share parameters with worker " << w);
+    }
+  }
+
+  Conv::LocalSocket listener;
+  if(!listener.Listen(socket_path)) {
+    FATAL("Cannot listen on " << socket_path);
+  }
+
+  InferenceServer* server = new InferenceServer(predictors, *class_manager, max_wait_ms);
+  LOGINFO << "Listening on " << socket_path << ", batch size " << predictors[0]->GetBatchSize()
+    << ", maximum wait " << max_wait_ms << "ms, " << workers << " workers";
+
+  // Connections are handled in their own threads, the first worker runs in
+  // this one
+  std::thread accept_thread([&listener, server] {
+    while(!server->IsStopping()) {
+      int descriptor = listener.Accept();
+      if(descriptor < 0)
+        break;
+      std::thread(&InferenceServer::HandleConnection, server, descriptor).detach();
+    }
+  });
+
+  std::vector<std::thread> worker_threads;
+  for(unsigned int w = 1; w < workers; w++)
+    worker_threads.push_back(std::thread(&InferenceServer::RunBatches, server, w));
+  server->RunBatches(0);
+  for(std::thread& thread : worker_threads)
+    thread.join();
+
+  // Shutting the listener down makes Accept fail. The accept thread must be
+  // done before the listener is closed and goes out of scope.
+  listener.Shutdown();
+  accept_thread.join();
+  listener.Close();
+
+  LOGINFO << "Statistics: " << server->GetStatistics().Format();
+  LOGINFO << "DONE!";
+  LOGEND;
+  return 0;
+}
@@ -8,17 +8,34 @@
  * @file makeCompressedTensorStream.cpp
  * @brief Tool to import datasets
  *
+ * Image and label pairs are decoded and compressed by a pool of threads=<n>
+ * workers. A single writer appends them in the order of the lists, so the
+ * output is the same for any number of workers. At most window=<n> pairs
+ * are kept in memory.
+ *
  * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
  */
 
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
 
 #include <cn24.h>
+#include <private/ConfigParsing.h>
+
+struct ImportedPair {
+  // Both stay null if the pair is skipped
+  Conv::CompressedTensor* image = nullptr;
+  Conv::CompressedTensor* label = nullptr;
+};
 
 int main ( int argc, char** argv ) {
   if ( argc < 8 ) {
-    LOGERROR << "USAGE: " << argv[0] << " <dataset config file> <image list file> <image directory> <label list file> <label directory> <output file> <true/false for direct RGB of labels>";
+    LOGERROR << "USAGE: " << argv[0] << " <dataset config file> <image list file> <image directory> <label list file> <label directory> <output file> <true/false for direct RGB of labels> [threads=<n>] [window=<n>]";
     LOGEND;
     return -1;
   }
@@ -33,6 +50,16 @@ int main ( int argc, char** argv ) {
   std::string image_directory ( argv[3] );
   std::string image_list_fname ( argv[2] );
   std::string dataset_config_fname ( argv[1] );
+  std::string options;
+  for ( int a = 8; a < argc; a++ )
+    options += std::string ( argv[a] ) + " ";
+
+  unsigned int threads = std::max ( std::thread::hardware_concurrency(), 1u ), window = 0;
+  Conv::ParseCountIfPossible ( options, "threads", threads );
+  Conv::ParseCountIfPossible ( options, "window", window );
+  threads = std::max ( threads, 1u );
+  if ( window == 0 )
+    window = 4 * threads;
 
   if(image_directory.back() != '/')
     image_directory += "/";
@@ -51,7 +78,9 @@ int main ( int argc, char** argv ) {
   // Load dataset
   Conv::ClassManager class_manager;
   Conv::TensorStreamDataset* dataset = Conv::TensorStreamDataset::CreateFromConfiguration ( dataset_config_file, true, Conv::LOAD_BOTH, &class_manager);
-  UNREFERENCED_PARAMETER(dataset);
+
+  // The label colors are mapped through the class manager
+  dataset->RegisterClasses(&class_manager);
 
   unsigned int number_of_classes = class_manager.GetMaxClassId() + 1;
   // arrays to store class colors in an easy to index way
@@ -80,6 +109,22 @@ int main ( int argc, char** argv ) {
     FATAL ( "Cannot open label list file!" );
   }
 
+  // Read both lists first, the workers pick pairs by index
+  std::vector<std::string> image_fnames;
+  std::vector<std::string> label_fnames;
+  while ( !image_list_file.eof() ) {
+    std::string image_fname;
+    std::string label_fname;
+    std::getline ( image_list_file, image_fname );
+    std::getline ( label_list_file, label_fname );
+
+    if ( image_fname.length() < 5 || label_fname.length() < 5 )
+      break;
+
+    image_fnames.push_back ( image_fname );
+    label_fnames.push_back ( label_fname );
+  }
+
   // Open output file
   std::ofstream output_file ( output_fname, std::ios::out | std::ios::binary );
 
@@ -91,24 +136,15 @@ int main ( int argc, char** argv ) {
   uint64_t magic = CN24_CTS_MAGIC;
   output_file.write((char*)&magic, sizeof(uint64_t)/sizeof(char));
 
-  // Iterate through lists of images and labels
-  while ( !image_list_file.eof() ) {
-    std::string image_fname;
-    std::string label_fname;
-    std::getline ( image_list_file, image_fname );
-    std::getline ( label_list_file, label_fname );
-
-    if ( image_fname.length() < 5 || label_fname.length() < 5 )
-      break;
+  // Decodes, converts and compresses one pair
+  auto import_pair = [&] ( std::size_t i, ImportedPair& pair ) {
+    Conv::Tensor* image_tensor = new Conv::Tensor ( image_directory + image_fnames[i] );
+    Conv::Tensor label_rgb_tensor ( label_directory + label_fnames[i] );
 
-    LOGINFO << "Importing files " << image_fname << " and " << label_fname << "...";
-    Conv::Tensor image_tensor ( image_directory + image_fname );
-    Conv::Tensor label_rgb_tensor ( label_directory + label_fname );
-
-    if ( image_tensor.width() != label_rgb_tensor.width() ||
-         image_tensor.height() != label_rgb_tensor.height() ) {
-      LOGERROR << "Dimensions don't match, skipping file!";
-      continue;
+    if ( image_tensor->width() != label_rgb_tensor.width() ||
+         image_tensor->height() != label_rgb_tensor.height() ) {
+      delete image_tensor;
+      return;
     }
  
     int label_tensor_width = number_of_classes; 
@@ -116,15 +152,15 @@ int main ( int argc, char** argv ) {
       label_tensor_width = 3;
     }
 	
-    Conv::Tensor label_tensor ( 1, label_rgb_tensor.width(), label_rgb_tensor.height(), label_tensor_width);
+    Conv::Tensor* label_tensor = new Conv::Tensor ( 1, label_rgb_tensor.width(), label_rgb_tensor.height(), label_tensor_width);
 
     if(directRGB == "true") {
       // no classes - interpret the label tensor input as the output (no class/color mapping)
        for ( unsigned int y = 0; y < label_rgb_tensor.height(); y++ ) {
         for ( unsigned int x = 0; x < label_rgb_tensor.width(); x++ ) {     
-          *label_tensor.data_ptr ( x,y,0,0 ) = *label_rgb_tensor.data_ptr_const ( x,y,0,0 );
-          *label_tensor.data_ptr ( x,y,1,0 ) = *label_rgb_tensor.data_ptr_const ( x,y,1,0 );
-          *label_tensor.data_ptr ( x,y,2,0 ) = *label_rgb_tensor.data_ptr_const ( x,y,2,0 );
+          *label_tensor->data_ptr ( x,y,0,0 ) = *label_rgb_tensor.data_ptr_const ( x,y,0,0 );
+          *label_tensor->data_ptr ( x,y,1,0 ) = *label_rgb_tensor.data_ptr_const ( x,y,1,0 );
+          *label_tensor->data_ptr ( x,y,2,0 ) = *label_rgb_tensor.data_ptr_const ( x,y,2,0 );
         }
       }
     } else if(number_of_classes == 1) {
@@ -154,12 +190,12 @@ int main ( int argc, char** argv ) {
                                           + ( lg - fg ) * ( lg - fg )
                                           + ( lb - fb ) * ( lb - fb ) ) / std::sqrt ( 3.0 );
           const Conv::datum val = 1.0 - 2.0 * class1_diff;
-          *label_tensor.data_ptr ( x,y,0,0 ) = val;
+          *label_tensor->data_ptr ( x,y,0,0 ) = val;
         }
       }
     } else {
       // any number of other classes      
-      label_tensor.Clear ( 0.0 );
+      label_tensor->Clear ( 0.0 );
 
       for ( unsigned int y = 0; y < label_rgb_tensor.height(); y++ ) {
         for ( unsigned int x = 0; x < label_rgb_tensor.width(); x++ ) {
@@ -179,20 +215,58 @@ int main ( int argc, char** argv ) {
 
           for ( unsigned int c = 0; c <number_of_classes; c++ ) {
             if(lr == cr[c] && lg == cg[c] && lb == cb[c])
-              *label_tensor.data_ptr ( x,y,c,0 ) = 1.0;
+              *label_tensor->data_ptr ( x,y,c,0 ) = 1.0;
           }
         }
       }
     } // end if
 
-    Conv::CompressedTensor compressed_image_tensor;
-    Conv::CompressedTensor compressed_label_tensor;
-    compressed_image_tensor.Compress(image_tensor);
-    compressed_label_tensor.Compress(label_tensor);
-    
-    compressed_image_tensor.Serialize ( output_file );
-    compressed_label_tensor.Serialize ( output_file );
+    pair.image = new Conv::CompressedTensor();
+    pair.label = new Conv::CompressedTensor();
+    pair.image->Compress ( *image_tensor );
+    pair.label->Compress ( *label_tensor );
+    delete image_tensor;
+    delete label_tensor;
+  };
+
+  Conv::ReorderWindow<ImportedPair> imported_pairs ( window );
+  std::atomic<std::size_t> next_pair ( 0 );
+  std::vector<std::thread> workers;
+  for ( unsigned int t = 0; t < threads; t++ ) {
+    workers.push_back ( std::thread ( [&] {
+      std::size_t i;
+      while ( ( i = next_pair++ ) < image_fnames.size() ) {
+        imported_pairs.Reserve ( i );
+        ImportedPair pair;
+        import_pair ( i, pair );
+        imported_pairs.Put ( i, pair );
+      }
+    } ) );
   }
 
+  LOGINFO << "Importing " << image_fnames.size() << " pairs with " << threads << " threads...";
+  auto start_time = std::chrono::steady_clock::now();
+
+  // Write the pairs in the order of the lists
+  for ( std::size_t i = 0; i < image_fnames.size(); i++ ) {
+    ImportedPair pair = imported_pairs.Take();
+    if ( pair.image == nullptr ) {
+      LOGERROR << "Dimensions of " << image_fnames[i] << " and " << label_fnames[i] << " don't match, skipping file!";
+      continue;
+    }
+
+    pair.image->Serialize ( output_file );
+    pair.label->Serialize ( output_file );
+    delete pair.image;
+    delete pair.label;
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+    LOGINFO << "Imported files " << image_fnames[i] << " and " << label_fnames[i] << " (" << i + 1 << "/"
+      << image_fnames.size() << ", " << (double) ( i + 1 ) / elapsed.count() << " pairs/s)";
+  }
+
+  for ( std::thread& worker : workers )
+    worker.join();
+
   LOGEND;
 }
@@ -24,6 +24,7 @@ struct NamedTensorArray {
 public:
   NamedTensorArray(std::string name) : name(name) {};
   std::string name;
+  std::string metadata;
   std::vector<Conv::Tensor*> tensors;
 };
 
@@ -60,7 +61,63 @@ int main(int argc, char **argv) {
       uint64_t magic = 0;
       input.read((char*)&magic, sizeof(uint64_t)/sizeof(char));
 
-      if(magic != CN24_PAR_MAGIC) {
+      if(magic == CN24_PARIDX_MAGIC) {
+        LOGINFO << "Indexed format found";
+
+        Conv::IndexedParameterFile file(input);
+        if(!file.IsValid()) {
+          LOGERROR << "Cannot read " << param_file_name;
+          continue;
+        }
+
+        for(unsigned int s = 0; s < file.GetSetCount(); s++) {
+          LOGINFO << "Using node name " << file.GetName(s);
+          NamedTensorArray* array = new NamedTensorArray(file.GetName(s));
+          array->metadata = file.GetMetadata(s);
+          for(unsigned int j = 0; j < file.GetTensorCount(s); j++) {
+            Conv::Tensor* tensor = new Conv::Tensor();
+            file.Copy(s, j, *tensor);
+            LOGINFO << "Loaded parameter tensor (" << j << "): " << *(tensor);
+            array->tensors.push_back(tensor);
+          }
+          tensors.push_back(array);
+        }
+      } else if(magic == CN24_PAREX_MAGIC) {
+        LOGINFO << "Extended format found";
+
+        while(input.good() && !input.eof()) {
+          // Read node name
+          unsigned int node_unique_name_length;
+          input.read((char*)&node_unique_name_length, sizeof(unsigned int) / sizeof(char));
+          std::string node_name(node_unique_name_length, '\0');
+          input.read(&node_name[0], node_unique_name_length);
+          LOGINFO << "Using node name " << node_name;
+
+          NamedTensorArray* array = new NamedTensorArray(node_name);
+
+          // Read metadata
+          unsigned int metadata_length;
+          input.read((char*)&metadata_length, sizeof(unsigned int) / sizeof(char));
+          array->metadata.resize(metadata_length);
+          if(metadata_length > 0)
+            input.read(&array->metadata[0], metadata_length);
+
+          // Read parameters
+          unsigned int parameter_set_size;
+          input.read((char*)&parameter_set_size, sizeof(unsigned int) / sizeof(char));
+          for(unsigned int j = 0; j < parameter_set_size; j++) {
+            Conv::Tensor* tensor = new Conv::Tensor();
+            tensor->Deserialize(input);
+            LOGINFO << "Loaded parameter tensor (" << j << "): " << *(tensor);
+            array->tensors.push_back(tensor);
+          }
+
+          tensors.push_back(array);
+
+          // Update EOF flag
+          input.peek();
+        }
+      } else if(magic != CN24_PAR_MAGIC) {
         LOGINFO << "No magic, assuming old format";
         input.seekg (0, std::ios::beg);
 
@@ -401,6 +458,13 @@ int main(int argc, char **argv) {
     } else if (command.compare(0, 5, "save ") == 0) {
       std::string param_file_name;
       Conv::ParseStringParamIfPossible(command, "file", param_file_name);
+      std::string format = "par";
+      Conv::ParseStringParamIfPossible(command, "format", format);
+
+      if(format.compare("par") != 0 && format.compare("parex") != 0 && format.compare("indexed") != 0) {
+        LOGERROR << "Unknown format: " << format;
+        continue;
+      }
 
       // Check if output can be written to
       std::ofstream output (param_file_name, std::ios::out | std::ios::binary);
@@ -411,6 +475,44 @@ int main(int argc, char **argv) {
         continue;
       }
 
+      if(format.compare("indexed") == 0) {
+        std::vector<Conv::ParameterSet> parameter_sets;
+        for (unsigned int i = 0; i < tensors.size(); i++) {
+          Conv::ParameterSet parameter_set;
+          parameter_set.name = tensors[i]->name;
+          parameter_set.metadata = tensors[i]->metadata;
+          parameter_set.tensors = tensors[i]->tensors;
+          parameter_sets.push_back(parameter_set);
+        }
+        if(!Conv::IndexedParameterFile::Write(output, parameter_sets)) {
+          LOGERROR << "Cannot write to " << param_file_name;
+        }
+        continue;
+      }
+
+      if(format.compare("parex") == 0) {
+        uint64_t magic = CN24_PAREX_MAGIC;
+        output.write((char*)&magic, sizeof(uint64_t)/sizeof(char));
+
+        for (unsigned int i = 0; i < tensors.size(); i++) {
+          // Write node name and metadata
+          unsigned int node_unique_name_length = tensors[i]->name.length();
+          output.write((const char *) &node_unique_name_length, sizeof(unsigned int) / sizeof(char));
+          output.write(tensors[i]->name.c_str(), node_unique_name_length);
+          unsigned int metadata_length = tensors[i]->metadata.length();
+          output.write((const char *) &metadata_length, sizeof(unsigned int) / sizeof(char));
+          output.write(tensors[i]->metadata.c_str(), metadata_length);
+
+          // Write parameters
+          unsigned int layer_parameters = tensors[i]->tensors.size();
+          output.write((const char*)&layer_parameters, sizeof(unsigned int)/sizeof(char));
+          for(unsigned int j=0; j < tensors[i]->tensors.size(); j++) {
+            tensors[i]->tensors[j]->Serialize(output);
+          }
+        }
+        continue;
+      }
+
       uint64_t magic = CN24_PAR_MAGIC;
       output.write((char*)&magic, sizeof(uint64_t)/sizeof(char));
 
@@ -480,8 +582,10 @@ int main(int argc, char **argv) {
       std::cout
           << "  load file=<name>\n"
           << "    Loads parameter sets from the specified file. Format will be detected automatically.\n\n"
-          << "  save file=<name>\n"
-          << "    Writes the parameters sets to the specified file in the new format.\n\n"
+          << "  save file=<name> [format=<par|parex|indexed>]\n"
+          << "    Writes the parameters sets to the specified file in the new format (par, default),\n"
+          << "    the extended format with layer metadata (parex) or the indexed, memory mappable\n"
+          << "    format (indexed).\n\n"
           << "  dump id=<id> tensor=<tensor> file=<name>\n"
           << "    Writes the specified tensor of the parameter set with the specified id to file in binary format\n\n"
           << "  list\n"
@@ -3,11 +3,24 @@
  * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
  *
  * For licensing information, see the LICENSE file included with this project.
- */  
+ */
 /**
  * @file predictImage.cpp
  * @brief Application that uses a pretrained net to segment images.
  *
+ * Given a directory or a file listing one image per line instead of an
+ * image, all images are predicted in batches. Decoding, the network and
+ * writing the results run in separate threads, connected by bounded queues.
+ * Segmentations are written as PNG images, detections and classifications
+ * as JSON files into the output directory.
+ *
+ * With tile=<size>, segmentation networks predict images of any size in
+ * overlapping tiles instead of padding them. The overlap defaults to twice
+ * the estimated receptive field's radius.
+ *
+ * Without width=<max width> and height=<max height>, the segmentation
+ * network is reshaped to the largest image of each batch.
+ *
  * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
  */
 
@@ -15,12 +28,316 @@
 #include <fstream>
 #include <cstring>
 #include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#ifdef BUILD_POSIX
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
 
 #include <cn24.h>
+#include <private/ConfigParsing.h>
+
+struct PredictionItem {
+  std::string input_fname;
+  Conv::Tensor image;
+  unsigned int width = 0, height = 0;
+
+  Conv::Tensor segmentation;
+  std::vector<Conv::BoundingBox> boxes;
+  unsigned int class_id = 0;
+  Conv::datum score = 0;
+};
+
+bool IsImageFile(const std::string& fname) {
+  const std::string suffixes[] = {".png", ".PNG", ".jpg", ".JPG", ".jpeg", ".JPEG"};
+  for(const std::string& suffix : suffixes) {
+    if(fname.length() >= suffix.length() && fname.compare(fname.length() - suffix.length(), suffix.length(), suffix) == 0)
+      return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Lists the images in a directory or a file list
+ */
+bool ListImages(const std::string& input, std::vector<std::string>& image_fnames) {
+#ifdef BUILD_POSIX
+  struct stat input_stat;
+  if(stat(input.c_str(), &input_stat) == 0 && S_ISDIR(input_stat.st_mode)) {
+    DIR* directory = opendir(input.c_str());
+    if(directory == nullptr)
+      return false;
+    struct dirent* entry;
+    while((entry = readdir(directory)) != nullptr) {
+      std::string entry_name(entry->d_name);
+      if(IsImageFile(entry_name))
+        image_fnames.push_back(input + "/" + entry_name);
+    }
+    closedir(directory);
+    std::sort(image_fnames.begin(), image_fnames.end());
+    return true;
+  }
+#endif
+  std::ifstream list_file(input, std::ios::in);
+  if(!list_file.good())
+    return false;
+  std::string line;
+  while(std::getline(list_file, line)) {
+    if(line.length() > 0)
+      image_fnames.push_back(line);
+  }
+  return true;
+}
+
+std::string OutputName(const std::string& output_directory, const std::string& input_fname, const std::string& extension) {
+  std::size_t name_start = input_fname.find_last_of('/');
+  name_start = name_start == std::string::npos ? 0 : name_start + 1;
+  std::size_t name_end = input_fname.find_last_of('.');
+  if(name_end == std::string::npos || name_end < name_start)
+    name_end = input_fname.length();
+  return output_directory + "/" + input_fname.substr(name_start, name_end - name_start) + extension;
+}
+
+bool WriteResult(PredictionItem& item, Conv::Task task, Conv::ClassManager& class_manager, const std::string& output_directory) {
+  if(task == Conv::SEMANTIC_SEGMENTATION)
+    return Conv::BatchPredictor::WriteImage(OutputName(output_directory, item.input_fname, ".png"), item.segmentation);
+
+  Conv::JSON result = Conv::JSON::object();
+  result["image"] = item.input_fname;
+  result["width"] = item.width;
+  result["height"] = item.height;
+  if(task == Conv::DETECTION) {
+    result["detections"] = Conv::JSON::array();
+    for(const Conv::BoundingBox& box : item.boxes) {
+      Conv::JSON detection = Conv::JSON::object();
+      detection["class"] = class_manager.GetClassInfoById(box.c).first;
+      detection["score"] = box.score;
+      detection["x"] = box.x;
+      detection["y"] = box.y;
+      detection["w"] = box.w;
+      detection["h"] = box.h;
+      result["detections"].push_back(detection);
+    }
+  } else {
+    result["class"] = class_manager.GetClassInfoById(item.class_id).first;
+    result["score"] = item.score;
+  }
+
+  std::ofstream output_file(OutputName(output_directory, item.input_fname, ".json"), std::ios::out);
+  output_file << result.dump(2) << "\n";
+  return output_file.good();
+}
+
+/**
+ * @brief Sets up tiled segmentation if requested by the options
+ */
+bool ParseTiling(const std::string& options, Conv::Dataset* dataset, unsigned int& tile_size, unsigned int& overlap) {
+  tile_size = 0;
+  overlap = 0;
+  Conv::ParseCountIfPossible(options, "tile", tile_size);
+  if(tile_size == 0 || dataset->GetTask() != Conv::SEMANTIC_SEGMENTATION)
+    return false;
+  // Zero means estimating the overlap from the network
+  Conv::ParseCountIfPossible(options, "overlap", overlap);
+  return true;
+}
+
+void EstimateOverlap(Conv::BatchPredictor& predictor, unsigned int& overlap) {
+  if(overlap == 0) {
+    overlap = 2 * predictor.EstimateReceptiveField();
+    LOGINFO << "Estimated tile overlap: " << overlap;
+  }
+}
+
+int PredictBatches(Conv::JSONNetGraphFactory* factory, Conv::Dataset* dataset, Conv::ClassManager& class_manager,
+  const std::string& param_tensor_fname, std::vector<std::string>& image_fnames, const std::string& output_directory,
+  const std::string& options) {
+  unsigned int batch_size = 8, decoders = 2, encoders = 2, max_width = 0, max_height = 0;
+  Conv::ParseCountIfPossible(options, "batch", batch_size);
+  Conv::ParseCountIfPossible(options, "decoders", decoders);
+  Conv::ParseCountIfPossible(options, "encoders", encoders);
+  Conv::ParseCountIfPossible(options, "width", max_width);
+  Conv::ParseCountIfPossible(options, "height", max_height);
+  decoders = std::max(decoders, 1u);
+  encoders = std::max(encoders, 1u);
+
+  unsigned int tile_size, overlap;
+  const bool tiled = ParseTiling(options, dataset, tile_size, overlap);
+  if(tiled)
+    max_width = max_height = tile_size;
+  const bool fit_batches = dataset->GetTask() == Conv::SEMANTIC_SEGMENTATION && (max_width == 0 || max_height == 0);
+
+  if(image_fnames.size() == 0) {
+    LOGERROR << "No images found!";
+    return -1;
+  }
+
+  // Without a maximum size, segment images of the first image's size
+  if(dataset->GetTask() == Conv::SEMANTIC_SEGMENTATION && (max_width == 0 || max_height == 0)) {
+    Conv::Tensor first_image;
+    unsigned int i = 0;
+    while(i < image_fnames.size() && !Conv::BatchPredictor::LoadImage(image_fnames[i], first_image))
+      i++;
+    if(i == image_fnames.size()) {
+      FATAL("Cannot load any of the images!");
+    }
+    max_width = max_width > 0 ? max_width : first_image.width();
+    max_height = max_height > 0 ? max_height : first_image.height();
+  }
+
+  Conv::BatchPredictor predictor(factory, dataset, &class_manager, batch_size, max_width, max_height);
+  if(!predictor.LoadParameters(param_tensor_fname)) {
+    FATAL("Cannot load param tensor file!");
+  }
+  const Conv::Task task = predictor.GetTask();
+  const bool write_output = output_directory.length() > 0;
+  if(tiled)
+    EstimateOverlap(predictor, overlap);
+
+  LOGINFO << "Predicting " << image_fnames.size() << " images in batches of " << predictor.GetBatchSize()
+    << " with " << decoders << " decoding and " << encoders << " writing threads...";
+  auto start_time = std::chrono::steady_clock::now();
+
+  // Two batches in each queue keep all stages busy
+  Conv::BoundedQueue<PredictionItem*> decoded_items(2 * predictor.GetBatchSize());
+  Conv::BoundedQueue<PredictionItem*> predicted_items(2 * predictor.GetBatchSize());
+  std::atomic<unsigned int> next_image(0), active_decoders(decoders), failed_images(0), written_images(0);
+
+  std::vector<std::thread> threads;
+  for(unsigned int d = 0; d < decoders; d++) {
+    threads.push_back(std::thread([&] {
+      unsigned int i;
+      while((i = next_image++) < image_fnames.size()) {
+        PredictionItem* item = new PredictionItem();
+        item->input_fname = image_fnames[i];
+        if(!Conv::BatchPredictor::LoadImage(item->input_fname, item->image)) {
+          LOGERROR << "Cannot load " << item->input_fname;
+          failed_images++;
+          delete item;
+          continue;
+        }
+        item->width = item->image.width();
+        item->height = item->image.height();
+        decoded_items.Push(item);
+      }
+      if(--active_decoders == 0)
+        decoded_items.Close();
+    }));
+  }
+
+  for(unsigned int e = 0; e < encoders; e++) {
+    threads.push_back(std::thread([&] {
+      PredictionItem* item;
+      while(predicted_items.Pop(item)) {
+        if(!write_output || WriteResult(*item, task, class_manager, output_directory)) {
+          written_images++;
+        } else {
+          LOGERROR << "Cannot write result for " << item->input_fname;
+          failed_images++;
+        }
+        delete item;
+      }
+    }));
+  }
+
+  // The network runs in this thread
+  std::vector<PredictionItem*> batch;
+  std::vector<bool> valid;
+  while(true) {
+    batch.clear();
+    PredictionItem* item;
+
+    // Tiled images fill the batches with their own tiles
+    if(tiled) {
+      if(!decoded_items.Pop(item))
+        break;
+      Conv::Tensor output;
+      if(predictor.PredictTiled(item->image, output, overlap)) {
+        item->image.DeleteIfPossible();
+        item->segmentation.Resize(1, item->width, item->height, 3);
+        dataset->Colorize(output, item->segmentation);
+        predicted_items.Push(item);
+      } else {
+        LOGERROR << "Cannot predict " << item->input_fname;
+        failed_images++;
+        delete item;
+      }
+      continue;
+    }
+
+    while(batch.size() < predictor.GetBatchSize() && decoded_items.Pop(item))
+      batch.push_back(item);
+    if(batch.size() == 0)
+      break;
+
+    if(fit_batches) {
+      unsigned int batch_width = 0, batch_height = 0;
+      for(PredictionItem* batch_item : batch) {
+        batch_width = std::max(batch_width, ((batch_item->width + 31) / 32) * 32);
+        batch_height = std::max(batch_height, ((batch_item->height + 31) / 32) * 32);
+      }
+      if((batch_width != predictor.GetWidth() || batch_height != predictor.GetHeight())
+        && !predictor.Reshape(predictor.GetBatchSize(), batch_width, batch_height)) {
+        LOGWARN << "Cannot reshape the network to " << batch_width << "x" << batch_height;
+      }
+    }
+
+    valid.assign(batch.size(), false);
+    for(unsigned int sample = 0; sample < predictor.GetBatchSize(); sample++) {
+      if(sample < batch.size()) {
+        valid[sample] = predictor.SetSample(sample, batch[sample]->image);
+        // The decoded image is not needed anymore
+        batch[sample]->image.DeleteIfPossible();
+      } else {
+        predictor.ClearSample(sample);
+      }
+    }
+
+    predictor.Predict();
+
+    for(unsigned int sample = 0; sample < batch.size(); sample++) {
+      item = batch[sample];
+      if(!valid[sample]) {
+        LOGERROR << "Cannot predict " << item->input_fname << " (" << item->width << "x" << item->height << ")";
+        failed_images++;
+        delete item;
+        continue;
+      }
+      switch(task) {
+        case Conv::SEMANTIC_SEGMENTATION:
+          predictor.GetSegmentation(sample, item->width, item->height, item->segmentation);
+          break;
+        case Conv::DETECTION:
+          predictor.GetDetections(sample, item->width, item->height, item->boxes);
+          break;
+        case Conv::CLASSIFICATION:
+          item->class_id = predictor.GetClass(sample, item->score);
+          break;
+      }
+      predicted_items.Push(item);
+    }
+  }
+
+  predicted_items.Close();
+  for(std::thread& thread : threads)
+    thread.join();
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+  LOGINFO << "Predicted " << written_images << " images in " << elapsed.count() << "s ("
+    << (double)written_images / elapsed.count() << " images/s), " << failed_images << " failed";
+  return failed_images > 0 ? -1 : 0;
+}
 
 int main (int argc, char* argv[]) {
   if (argc < 5) {
-    LOGERROR << "USAGE: " << argv[0] << " <dataset config file> <net config file> <net parameter tensor> <input image file> [<output image file>]";
+    LOGERROR << "USAGE: " << argv[0] << " <dataset config file> <net config file> <net parameter tensor> <input image file> [<output image file>] [tile=<size>] [overlap=<pixels>] [batch=<n>]";
+    LOGERROR << "       " << argv[0] << " <dataset config file> <net config file> <net parameter tensor> <input directory or image list> [<output directory>] [batch=<n>] [decoders=<n>] [encoders=<n>] [width=<max width>] [height=<max height>] [tile=<size>] [overlap=<pixels>]";
     LOGEND;
     return -1;
   }
@@ -33,7 +350,10 @@ int main (int argc, char* argv[]) {
   std::string param_tensor_fname (argv[3]);
   std::string net_config_fname (argv[2]);
   std::string dataset_config_fname (argv[1]);
-  
+  std::string options;
+  for(int a = 6; a < argc; a++)
+    options += std::string(argv[a]) + " ";
+
   // Initialize CN24
   Conv::System::Init(3);
 
@@ -41,7 +361,7 @@ int main (int argc, char* argv[]) {
   std::ifstream param_tensor_file(param_tensor_fname,std::ios::in | std::ios::binary);
   std::ifstream net_config_file(net_config_fname,std::ios::in);
   std::ifstream dataset_config_file(dataset_config_fname,std::ios::in);
-  
+
   if(!param_tensor_file.good()) {
     FATAL("Cannot open param tensor file!");
   }
@@ -66,229 +386,118 @@ int main (int argc, char* argv[]) {
   Conv::ClassManager class_manager;
   Conv::Dataset* dataset = Conv::JSONDatasetFactory::ConstructDataset(dataset_json, &class_manager);
 
+  if(!IsImageFile(input_image_fname)) {
+    std::vector<std::string> image_fnames;
+    if(!ListImages(input_image_fname, image_fnames)) {
+      FATAL("Cannot list images in " << input_image_fname);
+    }
+    int result = PredictBatches(factory, dataset, class_manager, param_tensor_fname, image_fnames, output_image_fname, options);
+    LOGINFO << "DONE!";
+    LOGEND;
+    return result;
+  }
+
   // Load image
   Conv::Tensor original_data_tensor(input_image_fname);
+  unsigned int original_width = original_data_tensor.width();
+  unsigned int original_height = original_data_tensor.height();
+
+  // Assemble net
+  unsigned int tile_size, overlap, batch_size = 8;
+  const bool tiled = ParseTiling(options, dataset, tile_size, overlap);
+  Conv::ParseCountIfPossible(options, "batch", batch_size);
+  Conv::BatchPredictor predictor(factory, dataset, &class_manager, tiled ? batch_size : 1,
+    tiled ? tile_size : original_width, tiled ? tile_size : original_height);
+
+  // Load network parameters
+  if (!predictor.LoadParameters(param_tensor_fname)) {
+    FATAL("Cannot load param tensor file!");
+  }
 
-  if(dataset->GetTask() == Conv::SEMANTIC_SEGMENTATION) {
-
-    // Rescale image
-    unsigned int width = original_data_tensor.width();
-    unsigned int height = original_data_tensor.height();
-    unsigned int original_width = original_data_tensor.width();
-    unsigned int original_height = original_data_tensor.height();
-
-    if (width & 1) width++; if (height & 1) height++;
-    if (width & 2) width += 2; if (height & 2) height += 2;
-    if (width & 4) width += 4; if (height & 4) height += 4;
-    if (width & 8) width += 8; if (height & 8) height += 8;
-    if (width & 16) width += 16; if (height & 16) height += 16;
-
-    Conv::Tensor data_tensor(1, width, height, original_data_tensor.maps());
-    Conv::Tensor helper_tensor(1, width, height, 2);
-    data_tensor.Clear();
-    helper_tensor.Clear();
-
-    // Copy sample because data_tensor may be slightly larger
-    Conv::Tensor::CopySample(original_data_tensor, 0, data_tensor, 0);
-
-    // Initialize helper (spatial prior) tensor
-
-    // Write spatial prior data to helper tensor
-    for (unsigned int y = 0; y < original_height; y++) {
-      for (unsigned int x = 0; x < original_width; x++) {
-        *helper_tensor.data_ptr(x, y, 0, 0) = ((Conv::datum) x) / ((Conv::datum) original_width - 1);
-        *helper_tensor.data_ptr(x, y, 1, 0) = ((Conv::datum) y) / ((Conv::datum) original_height - 1);
-      }
-      for (unsigned int x = original_width; x < width; x++) {
-        *helper_tensor.data_ptr(x, y, 0, 0) = 0;
-        *helper_tensor.data_ptr(x, y, 1, 0) = 0;
-      }
+  Conv::Tensor tiled_output;
+  if(tiled) {
+    EstimateOverlap(predictor, overlap);
+    LOGINFO << "Classifying in " << tile_size << "x" << tile_size << " tiles..." << std::flush;
+    if (!predictor.PredictTiled(original_data_tensor, tiled_output, overlap)) {
+      FATAL("Tiled prediction failed!");
     }
-    for (unsigned int y = original_height; y < height; y++) {
-      for (unsigned int x = 0; x < height; x++) {
-        *helper_tensor.data_ptr(x, y, 0, 0) = 0;
-        *helper_tensor.data_ptr(x, y, 1, 0) = 0;
-      }
+  } else {
+    if (!predictor.SetSample(0, original_data_tensor)) {
+      FATAL("Image does not fit the network's input!");
     }
 
-
-    // Assemble net
-    Conv::NetGraph graph;
-    Conv::InputLayer input_layer(data_tensor, helper_tensor);
-
-    Conv::NetGraphNode input_node(&input_layer);
-    input_node.is_input = true;
-
-    graph.AddNode(&input_node);
-    bool complete = factory->AddLayers(graph, &class_manager);
-    if (!complete) FATAL("Failed completeness check, inspect model!");
-
-    graph.Initialize();
-
-
-    // Load network parameters
-    graph.DeserializeParameters(param_tensor_file);
-
-    graph.SetIsTesting(true);
     LOGINFO << "Classifying..." << std::flush;
-    graph.FeedForward();
-
-    Conv::Tensor *net_output_tensor = &graph.GetDefaultOutputNode()->output_buffers[0].combined_tensor->data; // &net.buffer(output_layer_id)->data;
-    Conv::Tensor image_output_tensor(1, net_output_tensor->width(), net_output_tensor->height(), 3);
+    predictor.Predict();
+  }
 
+  if(dataset->GetTask() == Conv::SEMANTIC_SEGMENTATION) {
     LOGINFO << "Colorizing..." << std::flush;
-    dataset->Colorize(*net_output_tensor, image_output_tensor);
-
-    // Recrop image down
-    Conv::Tensor small(1, original_data_tensor.width(), original_data_tensor.height(), 3);
-    for (unsigned int m = 0; m < 3; m++)
-      for (unsigned int y = 0; y < small.height(); y++)
-        for (unsigned int x = 0; x < small.width(); x++)
-          *small.data_ptr(x, y, m, 0) = *image_output_tensor.data_ptr_const(x, y, m, 0);
+    Conv::Tensor small;
+    if(tiled) {
+      small.Resize(1, original_width, original_height, 3);
+      dataset->Colorize(tiled_output, small);
+    } else {
+      predictor.GetSegmentation(0, original_width, original_height, small);
+    }
 
     if(argc > 5)
       small.WriteToFile(output_image_fname);
-  } else if(dataset->GetTask() == Conv::CLASSIFICATION || dataset->GetTask() == Conv::DETECTION) {
-    // Rescale image
-    unsigned int width = dataset->GetWidth();
-    unsigned int height = dataset->GetHeight();
-    unsigned int original_width = original_data_tensor.width();
-    unsigned int original_height = original_data_tensor.height();
-
-    Conv::Tensor data_tensor(1, width, height, original_data_tensor.maps());
-    data_tensor.Clear();
-    Conv::Tensor::CopySample(original_data_tensor, 0, data_tensor, 0, false, true);
-
-    for(unsigned int map = 0; map < data_tensor.maps(); map++) {
-      for(unsigned int y = 0; y < height; y++) {
-        for(unsigned int x = 0; x < width; x++) {
-          *(data_tensor.data_ptr(x,y,map,0)) *= 2.0;
-          *(data_tensor.data_ptr(x,y,map,0)) -= 1.0;
-        }
-      }
-    }
-
-     // Assemble net
-    Conv::NetGraph graph;
-    Conv::InputLayer input_layer(data_tensor);
-
-    Conv::NetGraphNode input_node(&input_layer);
-    input_node.is_input = true;
-
-    graph.AddNode(&input_node);
-    bool complete = factory->AddLayers(graph, &class_manager);
-    if (!complete) FATAL("Failed completeness check, inspect model!");
-
-    graph.Initialize();
-
-    // Load network parameters
-    graph.DeserializeParameters(param_tensor_file);
-
-    graph.SetIsTesting(true);
-    LOGINFO << "Classifying..." << std::flush;
-    graph.FeedForward();
-
-    if(dataset->GetTask() == Conv::CLASSIFICATION) {
-      Conv::Tensor *net_output_tensor = &graph.GetDefaultOutputNode()->output_buffers[0].combined_tensor->data;
-      UNREFERENCED_PARAMETER(net_output_tensor);
-      // TODO display scores
-    } else {
-      Conv::Tensor *net_output_tensor = &graph.GetDefaultOutputNode()->output_buffers[0].combined_tensor->data;
-#ifdef BUILD_OPENCL
-      net_output_tensor->MoveToCPU();
-#endif
-      Conv::DatasetMetadataPointer* net_output = graph.GetDefaultOutputNode()->output_buffers[0].combined_tensor->metadata;
-      std::vector<Conv::BoundingBox>* output_boxes = (std::vector<Conv::BoundingBox>*)net_output[0];
-      const Conv::JSON& yolo_config = factory->GetYOLOConfiguration();
-      unsigned int horizontal_cells = yolo_config["horizontal_cells"];
-      unsigned int vertical_cells = yolo_config["vertical_cells"];
-      unsigned int boxes_per_cell = yolo_config["boxes_per_cell"];
-
-      LOGINFO << "Bounding boxes: " << output_boxes->size();
-      for(unsigned int b = 0; b < output_boxes->size(); b++) {
-        Conv::BoundingBox box = (*output_boxes)[b];
-        box.x *= (Conv::datum)original_width;
-        box.y *= (Conv::datum)original_height;
-        box.w *= (Conv::datum)original_width;
-        box.h *= (Conv::datum)original_height;
-
-        LOGINFO << "Box\t" << b << ": " << class_manager.GetClassInfoById(box.c).first << " (" << box.score << ")";
-        LOGINFO << "  Center: (" << box.x << "," << box.y << ")";
-        LOGINFO << "  Size: (" << box.w << "x" << box.h << ")";
-
-        Conv::datum gb = (box.c) < UNKNOWN_CLASS ? 1.0 : 0.0;
-
-        // Draw box into original data tensor
-        for(int bx = (int)(box.x - (box.w / 2)); bx <= (box.x + (box.w / 2)); bx++) {
-          int by_top = (int)(box.y - (box.h / 2));
-          int by_bot = (int)(box.y + (box.h / 2));
-          if(bx >= 0 && bx < (int)original_width) {
-            if (by_top >= 0 && by_top < (int)original_height) {
-              *(original_data_tensor.data_ptr((const size_t)bx, (const size_t)by_top, 0, 0)) = 1.0;
-              *(original_data_tensor.data_ptr((const size_t)bx, (const size_t)by_top, 1, 0)) = gb;
-              *(original_data_tensor.data_ptr((const size_t)bx, (const size_t)by_top, 2, 0)) = gb;
-            }
-            if (by_bot >= 0 && by_bot < (int)original_height) {
-              *(original_data_tensor.data_ptr((const size_t)bx, (const size_t)by_bot, 0, 0)) = 1.0;
-              *(original_data_tensor.data_ptr((const size_t)bx, (const size_t)by_bot, 1, 0)) = gb;
-              *(original_data_tensor.data_ptr((const size_t)bx, (const size_t)by_bot, 2, 0)) = gb;
-            }
+  } else if(dataset->GetTask() == Conv::CLASSIFICATION) {
+    Conv::datum score;
+    unsigned int class_id = predictor.GetClass(0, score);
+    LOGINFO << "Class: " << class_manager.GetClassInfoById(class_id).first << " (" << score << ")";
+  } else if(dataset->GetTask() == Conv::DETECTION) {
+    std::vector<Conv::BoundingBox> output_boxes;
+    predictor.GetDetections(0, original_width, original_height, output_boxes);
+
+    LOGINFO << "Bounding boxes: " << output_boxes.size();
+    for(unsigned int b = 0; b < output_boxes.size(); b++) {
+      Conv::BoundingBox box = output_boxes[b];
+
+      LOGINFO << "Box\t" << b << ": " << class_manager.GetClassInfoById(box.c).first << " (" << box.score << ")";
+      LOGINFO << "  Center: (" << box.x << "," << box.y << ")";
+      LOGINFO << "  Size: (" << box.w << "x" << box.h << ")";
+
+      Conv::datum gb = (box.c) < UNKNOWN_CLASS ? 1.0 : 0.0;
+
+      // Draw box into original data tensor
+      for(int bx = (int)(box.x - (box.w / 2)); bx <= (box.x + (box.w / 2)); bx++) {
+        int by_top = (int)(box.y - (box.h / 2));
+        int by_bot = (int)(box.y + (box.h / 2));
+        if(bx >= 0 && bx < (int)original_width) {
+          if (by_top >= 0 && by_top < (int)original_height) {
+            *(original_data_tensor.data_ptr((const size_t)bx, (const size_t)by_top, 0, 0)) = 1.0;
+            *(original_data_tensor.data_ptr((const size_t)bx, (const size_t)by_top, 1, 0)) = gb;
+            *(original_data_tensor.data_ptr((const size_t)bx, (const size_t)by_top, 2, 0)) = gb;
           }
-        }
-        // Draw vertical lines
-        for(int by = (int)(box.y - (box.h / 2)); by <= (box.y + (box.h / 2)); by++) {
-          int bx_top = (int)(box.x - (box.w / 2));
-          int bx_bot = (int)(box.x + (box.w / 2));
-          if(by >= 0 && by < (int)original_height) {
-            if (bx_top >= 0 && bx_top < (int)original_width) {
-              *(original_data_tensor.data_ptr((const std::size_t)bx_top, (const std::size_t)by, 0, 0)) = 1.0;
-              *(original_data_tensor.data_ptr((const std::size_t)bx_top, (const std::size_t)by, 1, 0)) = gb;
-              *(original_data_tensor.data_ptr((const std::size_t)bx_top, (const std::size_t)by, 2, 0)) = gb;
-            }
-            if (bx_bot >= 0 && bx_bot < (int)original_width) {
-              *(original_data_tensor.data_ptr((const std::size_t)bx_bot, (const std::size_t)by, 0, 0)) = 1.0;
-              *(original_data_tensor.data_ptr((const std::size_t)bx_bot, (const std::size_t)by, 1, 0)) = gb;
-              *(original_data_tensor.data_ptr((const std::size_t)bx_bot, (const std::size_t)by, 2, 0)) = gb;
-            }
+          if (by_bot >= 0 && by_bot < (int)original_height) {
+            *(original_data_tensor.data_ptr((const size_t)bx, (const size_t)by_bot, 0, 0)) = 1.0;
+            *(original_data_tensor.data_ptr((const size_t)bx, (const size_t)by_bot, 1, 0)) = gb;
+            *(original_data_tensor.data_ptr((const size_t)bx, (const size_t)by_bot, 2, 0)) = gb;
           }
         }
       }
-      
-      /*
-      Conv::datum max_iou = 0;
-      // Draw class info
-      for(int y = 0; y < original_height; y++) {
-      unsigned int vcell = (y * vertical_cells) / original_height;
-      for(int x = 0; x < original_width; x++) {
-        unsigned int hcell = (x * horizontal_cells) / original_width;
-        unsigned int cell_id = vcell * horizontal_cells + hcell;
-        Conv::datum iou = 0;
-        for(unsigned int b = 0; b < boxes_per_cell; b++) {
-          unsigned int iou_idx =  (cell_id * boxes_per_cell + b) * 5 + 4;
-          if((*net_output_tensor)(iou_idx) > iou) {
-            iou = (*net_output_tensor)(iou_idx);
-            if(iou > max_iou)
-              max_iou = iou;
+      // Draw vertical lines
+      for(int by = (int)(box.y - (box.h / 2)); by <= (box.y + (box.h / 2)); by++) {
+        int bx_top = (int)(box.x - (box.w / 2));
+        int bx_bot = (int)(box.x + (box.w / 2));
+        if(by >= 0 && by < (int)original_height) {
+          if (bx_top >= 0 && bx_top < (int)original_width) {
+            *(original_data_tensor.data_ptr((const std::size_t)bx_top, (const std::size_t)by, 0, 0)) = 1.0;
+            *(original_data_tensor.data_ptr((const std::size_t)bx_top, (const std::size_t)by, 1, 0)) = gb;
+            *(original_data_tensor.data_ptr((const std::size_t)bx_top, (const std::size_t)by, 2, 0)) = gb;
+          }
+          if (bx_bot >= 0 && bx_bot < (int)original_width) {
+            *(original_data_tensor.data_ptr((const std::size_t)bx_bot, (const std::size_t)by, 0, 0)) = 1.0;
+            *(original_data_tensor.data_ptr((const std::size_t)bx_bot, (const std::size_t)by, 1, 0)) = gb;
+            *(original_data_tensor.data_ptr((const std::size_t)bx_bot, (const std::size_t)by, 2, 0)) = gb;
           }
-        }
-//          LOGINFO << "Cell " << hcell << "," << vcell << " iou: " << iou;
-//           *(original_data_tensor.data_ptr(x, y, 0, 0)) *= (1.0f-iou);
-//           *(original_data_tensor.data_ptr(x, y, 0, 0)) += iou;
-          *(original_data_tensor.data_ptr(x, y, 0, 0)) *= 0.5;
-          *(original_data_tensor.data_ptr(x, y, 1, 0)) *= 0.5;
-          *(original_data_tensor.data_ptr(x, y, 2, 0)) *= 0.5;
-          *(original_data_tensor.data_ptr(x, y, 0, 0)) += iou * 0.5;
-          *(original_data_tensor.data_ptr(x, y, 1, 0)) += iou * 0.5;
-          *(original_data_tensor.data_ptr(x, y, 2, 0)) += iou * 0.5;
         }
       }
-
-      LOGINFO << "Max IoU: " << max_iou;
-      */
-      if(argc > 5)
-        original_data_tensor.WriteToFile(output_image_fname);
     }
 
+    if(argc > 5)
+      original_data_tensor.WriteToFile(output_image_fname);
   }
 
   LOGINFO << "DONE!";
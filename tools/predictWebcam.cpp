@@ -122,7 +122,9 @@ int main (int argc, char* argv[]) {
 
 
     // Load network parameters
-    graph.DeserializeParameters(param_tensor_file);
+    if (!graph.LoadParameters(param_tensor_fname)) {
+      FATAL("Cannot load param tensor file!");
+    }
 
     graph.SetIsTesting(true);
     LOGINFO << "Classifying..." << std::flush;
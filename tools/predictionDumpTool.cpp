@@ -0,0 +1,102 @@
+/*
+ * This file is part of the CN24 semantic segmentation software,
+ * copyright (C) 2015 Clemens-Alexander Brust (ikosa dot de at gmail dot com).
+ *
+ * For licensing information, see the LICENSE file included with this project.
+ */
+/**
+ * @file predictionDumpTool.cpp
+ * @brief Reads binary prediction dumps (e.g. log/novelty-*) and converts them
+ *
+ * @author Clemens-Alexander Brust (ikosa dot de at gmail dot com)
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+
+#include <cn24.h>
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    LOGERROR << "USAGE: " << argv[0] << " <prediction dump> {info | csv <output file> | tensor <output file> | scores <output file>}";
+    LOGEND;
+    return -1;
+  }
+
+  Conv::System::Init();
+
+  std::string dump_fname(argv[1]);
+  std::string command(argv[2]);
+
+  Conv::PredictionDumpReader reader(dump_fname);
+  if(!reader.good()) {
+    LOGERROR << "Could not read " << dump_fname;
+    LOGEND;
+    return -1;
+  }
+
+  if(command.compare("info") == 0) {
+    LOGINFO << "Row shape: " << reader.width() << "x" << reader.height() << "x" << reader.maps()
+            << (reader.compressed() ? " (compressed)" : "");
+    LOGINFO << "Classes: " << reader.class_names().size();
+    for(const std::pair<unsigned int, std::string>& class_name : reader.class_names())
+      LOGINFO << "  " << class_name.first << ": " << class_name.second;
+    LOGINFO << "Segments: " << reader.segment_names().size();
+
+    unsigned int segment, sample; Conv::datum score; Conv::Tensor row;
+    std::size_t rows = 0;
+    while(reader.ReadRow(segment, sample, score, row))
+      rows++;
+    LOGINFO << "Rows: " << rows;
+    LOGEND;
+    return 0;
+  }
+
+  if(argc < 4) {
+    LOGERROR << "Missing output file name";
+    LOGEND;
+    return -1;
+  }
+
+  std::string output_fname(argv[3]);
+  std::ofstream output(output_fname, std::ios::out | std::ios::binary);
+  if(!output.good()) {
+    LOGERROR << "Cannot open " << output_fname << " for writing!";
+    LOGEND;
+    return -1;
+  }
+
+  unsigned int segment, sample; Conv::datum score; Conv::Tensor row;
+  std::size_t rows = 0;
+  const std::vector<std::string>& segment_names = reader.segment_names();
+
+  if(command.compare("csv") == 0 || command.compare("scores") == 0) {
+    bool write_values = command.compare("csv") == 0;
+    while(reader.ReadRow(segment, sample, score, row)) {
+      output << (segment < segment_names.size() ? segment_names[segment] : std::to_string(segment))
+             << ";" << sample << ";" << score;
+      if(write_values) {
+        for(std::size_t e = 0; e < row.elements(); e++)
+          output << ";" << row(e);
+      }
+      output << "\n";
+      rows++;
+    }
+  } else if(command.compare("tensor") == 0) {
+    // Each row becomes a Tensor in a TensorStream compatible file
+    while(reader.ReadRow(segment, sample, score, row)) {
+      row.Serialize(output);
+      rows++;
+    }
+  } else {
+    LOGERROR << "Unknown command: " << command;
+    LOGEND;
+    return -1;
+  }
+
+  output.close();
+  LOGINFO << "Converted " << rows << " rows";
+  LOGEND;
+  return 0;
+}
@@ -42,17 +42,15 @@ int main ( int argc, char* argv[] ) {
   unsigned int tid = atoi ( s_tid.c_str() );
 
   // Open tensor stream
-  std::ifstream file ( std::string ( argv[1] ), std::ios::in | std::ios::binary );
+  std::string tensor_file_name ( argv[1] );
+  Conv::TensorFile file ( tensor_file_name );
 
-  // Seek until id is hit
+  // Read the tensor, it could be written back to the same file
   Conv::Tensor tensor;
-
-  for ( unsigned int t = 0; t < ( tid + 1 ); t++ ) {
-    tensor.Deserialize ( file );
+  if ( !file.Load ( tid, tensor, false ) ) {
+    LOGERROR << "Cannot load tensor " << tid;
   }
 
-  file.close();
-
   LOGINFO << "Tensor: " << tensor;
   LOGINFO << "Enter \"help\" for information on how to use this program";
   LOGEND;
@@ -281,20 +281,15 @@ bool parseCommand (Conv::ClassManager& class_manager, std::vector<Conv::Dataset*
     if (param_file_name.length() == 0) {
       LOGERROR << "Filename needed!";
     } else {
-      std::ifstream param_file (param_file_name, std::ios::in | std::ios::binary);
-
-      if (param_file.good()) {
-        graph.DeserializeParameters (param_file);
+      if (graph.LoadParameters (param_file_name)) {
         LOGINFO << "Loaded parameters from " << param_file_name;
-      } else {
-        LOGERROR << "Cannot open " << param_file_name;
       }
-
-      param_file.close();
     }
   } else if (command.compare (0, 4, "save") == 0) {
     std::string param_file_name;
     Conv::ParseStringParamIfPossible (command, "file", param_file_name);
+    std::string format = "parex";
+    Conv::ParseStringParamIfPossible (command, "format", format);
 
     if (param_file_name.length() == 0) {
       LOGERROR << "Filename needed!";
@@ -302,7 +297,7 @@ bool parseCommand (Conv::ClassManager& class_manager, std::vector<Conv::Dataset*
       std::ofstream param_file (param_file_name, std::ios::out | std::ios::binary);
 
       if (param_file.good()) {
-        graph.SerializeParameters (param_file);
+        graph.SerializeParameters (param_file, format.compare("indexed") == 0);
         LOGINFO << "Written parameters to " << param_file_name;
       } else {
         LOGERROR << "Cannot open " << param_file_name;
@@ -596,8 +591,8 @@ void help() {
       << "    Load parameters from a file for all layers up to l (default: all layers)\n\n"
 			<< "  graph file=<path> {test|train}\n"
 			<< "    Write the network architecture for training/testing to a file in graphviz format\n\n"
-      << "  save file=<path>\n"
-      << "    Save parameters to a file\n\n"
+      << "  save file=<path> [format=indexed]\n"
+      << "    Save parameters to a file, optionally in the indexed format that loads via mmap\n\n"
       << "  tstat enable=<1|0>\n"
       << "    Enable statistics during training (1: yes, 0: no)\n";
 }